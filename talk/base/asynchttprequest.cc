@@ -27,6 +27,11 @@
 
 #include "talk/base/asynchttprequest.h"
 
+#include <deque>
+#include <set>
+
+#include "talk/base/stringencode.h"
+
 namespace talk_base {
 
 enum {
@@ -35,6 +40,116 @@ enum {
 };
 static const int kDefaultHTTPTimeout = 30 * 1000;  // 30 sec
 
+///////////////////////////////////////////////////////////////////////////////
+// HttpConnectionPool
+///////////////////////////////////////////////////////////////////////////////
+
+// The connections to one server, and the requests using or waiting for them.
+class HttpConnectionPool::Server : public NewSocketPool {
+ public:
+  Server(HttpConnectionPool* parent, const std::string& user_agent)
+      : NewSocketPool(&factory_),
+        parent_(parent),
+        factory_(Thread::Current()->socketserver(), user_agent),
+        cache_(this) {
+  }
+
+  SslSocketFactory* factory() { return &factory_; }
+  StreamPool* cache() { return &cache_; }
+  std::set<AsyncHttpRequest*>& active() { return active_; }
+  std::deque<AsyncHttpRequest*>& waiting() { return waiting_; }
+
+  virtual StreamInterface* RequestConnectedStream(const SocketAddress& remote,
+                                                  int* err) {
+    StreamInterface* stream = NewSocketPool::RequestConnectedStream(remote,
+                                                                    err);
+    if (stream) {
+      ++parent_->connections_opened_;
+    }
+    return stream;
+  }
+
+ private:
+  HttpConnectionPool* parent_;
+  SslSocketFactory factory_;
+  StreamCache cache_;
+  std::set<AsyncHttpRequest*> active_;
+  std::deque<AsyncHttpRequest*> waiting_;
+};
+
+HttpConnectionPool::HttpConnectionPool(const std::string& user_agent,
+                                       size_t max_connections)
+    : agent_(user_agent),
+      max_connections_(max_connections),
+      connections_opened_(0),
+      thread_(Thread::Current()) {
+  ASSERT(max_connections_ > 0);
+}
+
+HttpConnectionPool::~HttpConnectionPool() {
+  for (ServerMap::iterator it = servers_.begin(); it != servers_.end(); ++it) {
+    ASSERT(it->second->active().empty());
+    ASSERT(it->second->waiting().empty());
+    delete it->second;
+  }
+}
+
+HttpConnectionPool::Server* HttpConnectionPool::GetServer(
+    AsyncHttpRequest* request) {
+  std::string key = request->host() + ":" + ToString(request->port());
+  if (request->secure()) {
+    key += ":ssl";
+  }
+  if (request->proxy_.type != PROXY_NONE) {
+    key += "@" + request->proxy_.address.ToString();
+  }
+
+  ServerMap::iterator it = servers_.find(key);
+  if (it != servers_.end()) {
+    return it->second;
+  }
+  Server* server = new Server(this, agent_);
+  server->factory()->SetProxy(request->proxy_);
+  if (request->secure()) {
+    server->factory()->UseSSL(request->host().c_str());
+  }
+  servers_[key] = server;
+  return server;
+}
+
+StreamPool* HttpConnectionPool::Acquire(AsyncHttpRequest* request) {
+  ASSERT(thread_->IsCurrent());
+  Server* server = GetServer(request);
+  if (server->active().size() >= max_connections_) {
+    server->waiting().push_back(request);
+    return NULL;
+  }
+  server->active().insert(request);
+  return server->cache();
+}
+
+void HttpConnectionPool::Release(AsyncHttpRequest* request) {
+  ASSERT(thread_->IsCurrent());
+  Server* server = GetServer(request);
+  std::deque<AsyncHttpRequest*>& waiting = server->waiting();
+  for (std::deque<AsyncHttpRequest*>::iterator it = waiting.begin();
+       it != waiting.end(); ++it) {
+    if (*it == request) {
+      waiting.erase(it);
+      return;
+    }
+  }
+
+  if (server->active().erase(request) == 0 || waiting.empty()) {
+    return;
+  }
+  // The connection that was just returned goes to the next request in line.
+  AsyncHttpRequest* next = waiting.front();
+  waiting.pop_front();
+  server->active().insert(next);
+  next->SendRequest(server->cache());
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // AsyncHttpRequest
 ///////////////////////////////////////////////////////////////////////////////
@@ -42,6 +157,8 @@ static const int kDefaultHTTPTimeout = 30 * 1000;  // 30 sec
 AsyncHttpRequest::AsyncHttpRequest(const std::string &user_agent)
     : start_delay_(0),
       firewall_(NULL),
+      connection_pool_(NULL),
+      using_connection_pool_(false),
       port_(80),
       secure_(false),
       timeout_(kDefaultHTTPTimeout),
@@ -52,9 +169,13 @@ AsyncHttpRequest::AsyncHttpRequest(const std::string &user_agent)
       error_(HE_NONE) {
   client_.SignalHttpClientComplete.connect(this,
       &AsyncHttpRequest::OnComplete);
+  // The request is driven by the sockets of the current thread, so it
+  // doesn't need one of its own.
+  SetRunsOnMainThread();
 }
 
 AsyncHttpRequest::~AsyncHttpRequest() {
+  ReleaseConnection();
 }
 
 void AsyncHttpRequest::OnWorkStart() {
@@ -66,7 +187,10 @@ void AsyncHttpRequest::OnWorkStart() {
 }
 
 void AsyncHttpRequest::OnWorkStop() {
-  // worker is already quitting, no need to explicitly quit
+  Thread::Current()->Clear(this, MSG_TIMEOUT);
+  Thread::Current()->Clear(this, MSG_LAUNCH_REQUEST);
+  client_.reset();
+  ReleaseConnection();
   LOG(LS_INFO) << "HttpRequest cancelled";
 }
 
@@ -85,15 +209,18 @@ void AsyncHttpRequest::OnComplete(HttpClient* client, HttpErrorType error) {
     LOG(LS_INFO) << "HttpRequest completed with error: " << error;
   }
 
-  worker()->Quit();
+  ReleaseConnection();
+  FinishWork();
 }
 
 void AsyncHttpRequest::OnMessage(Message* message) {
   switch (message->message_id) {
    case MSG_TIMEOUT:
     LOG(LS_INFO) << "HttpRequest timed out";
+    set_error(HE_OPERATION_CANCELLED);
     client_.reset();
-    worker()->Quit();
+    ReleaseConnection();
+    FinishWork();
     break;
    case MSG_LAUNCH_REQUEST:
     LaunchRequest();
@@ -105,29 +232,46 @@ void AsyncHttpRequest::OnMessage(Message* message) {
 }
 
 void AsyncHttpRequest::DoWork() {
-  // Do nothing while we wait for the request to finish. We only do this so
-  // that we can be a SignalThread; in the future this class should not be
-  // a SignalThread, since it does not need to spawn a new thread.
-  Thread::Current()->ProcessMessages(kForever);
+  // Never called, since the request runs on the main thread.
+  ASSERT(false);
 }
 
 void AsyncHttpRequest::LaunchRequest() {
-  factory_.SetProxy(proxy_);
-  if (secure_)
-    factory_.UseSSL(host_.c_str());
+  Thread::Current()->PostDelayed(timeout_, this, MSG_TIMEOUT);
+  if (connection_pool_) {
+    using_connection_pool_ = true;
+    if (StreamPool* stream_pool = connection_pool_->Acquire(this)) {
+      SendRequest(stream_pool);
+    }
+    // Otherwise, the pool sends the request once a connection is free.
+  } else {
+    factory_.SetProxy(proxy_);
+    if (secure_)
+      factory_.UseSSL(host_.c_str());
+    SendRequest(&pool_);
+  }
+}
 
+void AsyncHttpRequest::SendRequest(StreamPool* stream_pool) {
   bool transparent_proxy = (port_ == 80) &&
            ((proxy_.type == PROXY_HTTPS) || (proxy_.type == PROXY_UNKNOWN));
   if (transparent_proxy) {
     client_.set_proxy(proxy_);
   }
+  client_.set_pool(stream_pool);
   client_.set_fail_redirect(fail_redirect_);
   client_.set_server(SocketAddress(host_, port_));
 
   LOG(LS_INFO) << "HttpRequest start: " << host_ + client_.request().path;
 
-  Thread::Current()->PostDelayed(timeout_, this, MSG_TIMEOUT);
   client_.start();
 }
 
+void AsyncHttpRequest::ReleaseConnection() {
+  if (using_connection_pool_) {
+    using_connection_pool_ = false;
+    connection_pool_->Release(this);
+  }
+}
+
 }  // namespace talk_base
@@ -28,6 +28,7 @@
 #ifndef TALK_BASE_ASYNCHTTPREQUEST_H_
 #define TALK_BASE_ASYNCHTTPREQUEST_H_
 
+#include <map>
 #include <string>
 #include "talk/base/event.h"
 #include "talk/base/httpclient.h"
@@ -37,12 +38,60 @@
 
 namespace talk_base {
 
+class AsyncHttpRequest;
 class FirewallManager;
 
+///////////////////////////////////////////////////////////////////////////////
+// HttpConnectionPool
+// Keeps connections to HTTP servers open between the AsyncHttpRequests that
+// share it, so that requests to the same server reuse them.  At most
+// max_connections() are used per server at a time; further requests to it
+// wait for one of them to be returned.  Must only be used on one thread.
+///////////////////////////////////////////////////////////////////////////////
+
+class HttpConnectionPool {
+ public:
+  static const size_t kDefaultMaxConnections = 2;
+
+  explicit HttpConnectionPool(const std::string& user_agent,
+                              size_t max_connections = kDefaultMaxConnections);
+  ~HttpConnectionPool();
+
+  size_t max_connections() const { return max_connections_; }
+  // The thread the pool was created on.  Its sockets belong to that thread,
+  // so the pool must be used and deleted there.
+  Thread* thread() const { return thread_; }
+  // The number of connections that have been opened so far.
+  size_t connections_opened() const { return connections_opened_; }
+
+ private:
+  class Server;
+  typedef std::map<std::string, Server*> ServerMap;
+
+  // Returns the pool to use for the request's connection, or NULL if the
+  // request has to wait; it is then launched once a connection is available.
+  StreamPool* Acquire(AsyncHttpRequest* request);
+  // Called when the request is done with its connection, or no longer
+  // waiting for one.
+  void Release(AsyncHttpRequest* request);
+  Server* GetServer(AsyncHttpRequest* request);
+
+  std::string agent_;
+  size_t max_connections_;
+  size_t connections_opened_;
+  Thread* thread_;
+  ServerMap servers_;
+
+  friend class AsyncHttpRequest;
+  DISALLOW_COPY_AND_ASSIGN(HttpConnectionPool);
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 // AsyncHttpRequest
-// Performs an HTTP request on a background thread.  Notifies on the foreground
-// thread once the request is done (successfully or unsuccessfully).
+// Performs an HTTP request asynchronously on the thread it was created on.
+// Notifies on that thread once the request is done (successfully or
+// unsuccessfully).  Requests that share an HttpConnectionPool reuse its
+// connections; otherwise, each request opens its own.
 ///////////////////////////////////////////////////////////////////////////////
 
 class AsyncHttpRequest : public SignalThread {
@@ -62,6 +111,11 @@ class AsyncHttpRequest : public SignalThread {
     firewall_ = firewall;
   }
 
+  // Call before Start to get the connection from the given pool.
+  void set_connection_pool(HttpConnectionPool* pool) {
+    connection_pool_ = pool;
+  }
+
   // The DNS name of the host to connect to.
   const std::string& host() { return host_; }
   void set_host(const std::string& host) { host_ = host; }
@@ -99,10 +153,15 @@ class AsyncHttpRequest : public SignalThread {
 
  private:
   void LaunchRequest();
+  // Sends the request using a connection from stream_pool.
+  void SendRequest(StreamPool* stream_pool);
+  void ReleaseConnection();
 
   int start_delay_;
   ProxyInfo proxy_;
   FirewallManager* firewall_;
+  HttpConnectionPool* connection_pool_;
+  bool using_connection_pool_;
   std::string host_;
   int port_;
   bool secure_;
@@ -113,6 +172,8 @@ class AsyncHttpRequest : public SignalThread {
   HttpClient client_;
   HttpErrorType error_;
   std::string response_redirect_;
+
+  friend class HttpConnectionPool;
 };
 
 }  // namespace talk_base
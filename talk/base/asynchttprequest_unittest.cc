@@ -25,12 +25,15 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
 #include <string>
+#include <vector>
 #include "talk/base/asynchttprequest.h"
 #include "talk/base/gunit.h"
 #include "talk/base/httpserver.h"
 #include "talk/base/socketstream.h"
 #include "talk/base/thread.h"
+#include "talk/base/time.h"
 
 namespace talk_base {
 
@@ -43,22 +46,26 @@ static const char kServerResponse[] = "This is a test";
 class TestHttpServer : public HttpServer, public sigslot::has_slots<> {
  public:
   TestHttpServer(Thread* thread, const SocketAddress& addr)
-      : socket_(thread->socketserver()->CreateAsyncSocket(SOCK_STREAM)) {
+      : socket_(thread->socketserver()->CreateAsyncSocket(SOCK_STREAM)),
+        num_accepted_(0) {
     socket_->Bind(addr);
-    socket_->Listen(5);
+    socket_->Listen(128);
     socket_->SignalReadEvent.connect(this, &TestHttpServer::OnAccept);
   }
 
   SocketAddress address() const { return socket_->GetLocalAddress(); }
+  int num_accepted() const { return num_accepted_; }
 
  private:
   void OnAccept(AsyncSocket* socket) {
     AsyncSocket* new_socket = socket_->Accept(NULL);
     if (new_socket) {
+      ++num_accepted_;
       HandleConnection(new SocketStream(new_socket));
     }
   }
   talk_base::scoped_ptr<AsyncSocket> socket_;
+  int num_accepted_;
 };
 
 class AsyncHttpRequestTest : public testing::Test,
@@ -67,12 +74,14 @@ class AsyncHttpRequestTest : public testing::Test,
   AsyncHttpRequestTest()
       : started_(false),
         done_(false),
+        num_done_(0),
         server_(Thread::Current(), kServerAddr) {
     server_.SignalHttpRequest.connect(this, &AsyncHttpRequestTest::OnRequest);
   }
 
   bool started() const { return started_; }
   bool done() const { return done_; }
+  int num_done() const { return num_done_; }
 
   AsyncHttpRequest* CreateGetRequest(const std::string& host, int port,
                                      const std::string& path) {
@@ -133,11 +142,13 @@ class AsyncHttpRequestTest : public testing::Test,
   }
   void OnRequestDone(SignalThread* thread) {
     done_ = true;
+    ++num_done_;
   }
 
  private:
   bool started_;
   bool done_;
+  int num_done_;
   TestHttpServer server_;
 };
 
@@ -215,4 +226,100 @@ TEST_F(AsyncHttpRequestTest, TestGetSuccessDelay) {
   req->Release();
 }
 
+TEST_F(AsyncHttpRequestTest, TestConnectionPoolReusesConnection) {
+  HttpConnectionPool pool("unittest");
+  for (int i = 0; i < 3; ++i) {
+    AsyncHttpRequest* req = CreateGetRequest(
+        kServerAddr.IPAsString(), server().address().port(),
+        kServerGetPath);
+    req->set_connection_pool(&pool);
+    req->Start();
+    EXPECT_EQ_WAIT(i + 1, num_done(), 5000);
+    EXPECT_EQ(200U, req->response().scode);
+    req->Release();
+  }
+  EXPECT_EQ(1U, pool.connections_opened());
+  EXPECT_EQ(1, server().num_accepted());
+}
+
+TEST_F(AsyncHttpRequestTest, TestConnectionPoolQueuesRequests) {
+  HttpConnectionPool pool("unittest", 2);
+  std::vector<AsyncHttpRequest*> reqs;
+  for (int i = 0; i < 6; ++i) {
+    AsyncHttpRequest* req = CreateGetRequest(
+        kServerAddr.IPAsString(), server().address().port(),
+        kServerGetPath);
+    req->set_connection_pool(&pool);
+    req->Start();
+    reqs.push_back(req);
+  }
+  EXPECT_EQ_WAIT(6, num_done(), 5000);
+  for (size_t i = 0; i < reqs.size(); ++i) {
+    EXPECT_EQ(200U, reqs[i]->response().scode);
+    reqs[i]->Release();
+  }
+  EXPECT_EQ(2U, pool.connections_opened());
+}
+
+TEST_F(AsyncHttpRequestTest, TestConnectionPoolCancel) {
+  HttpConnectionPool pool("unittest", 1);
+  AsyncHttpRequest* first = CreateGetRequest(
+      kServerAddr.IPAsString(), server().address().port(),
+      kServerGetPath);
+  first->set_connection_pool(&pool);
+  AsyncHttpRequest* second = CreateGetRequest(
+      kServerAddr.IPAsString(), server().address().port(),
+      kServerGetPath);
+  second->set_connection_pool(&pool);
+  first->Start();
+  second->Start();
+  // Cancel one request while it's waiting for a connection, and the other
+  // while it's using one.
+  second->Destroy(true);
+  first->Destroy(true);
+  Thread::Current()->ProcessMessages(100);
+  EXPECT_EQ(0, num_done());
+
+  AsyncHttpRequest* third = CreateGetRequest(
+      kServerAddr.IPAsString(), server().address().port(),
+      kServerGetPath);
+  third->set_connection_pool(&pool);
+  third->Start();
+  EXPECT_EQ_WAIT(1, num_done(), 5000);
+  EXPECT_EQ(200U, third->response().scode);
+  third->Release();
+}
+
+// Measures requests per second for a burst of requests to one server, with
+// a connection per request and with a shared connection pool.
+TEST_F(AsyncHttpRequestTest, DISABLED_TestConnectionPoolBenchmark) {
+  const int kNumRequests = 100;
+  HttpConnectionPool pool("unittest");
+  HttpConnectionPool* pools[] = { NULL, &pool };
+  for (int i = 0; i < 2; ++i) {
+    int done_before = num_done();
+    int accepted_before = server().num_accepted();
+    std::vector<AsyncHttpRequest*> reqs;
+    uint32 start = Time();
+    for (int j = 0; j < kNumRequests; ++j) {
+      AsyncHttpRequest* req = CreateGetRequest(
+          kServerAddr.IPAsString(), server().address().port(),
+          kServerGetPath);
+      req->set_connection_pool(pools[i]);
+      req->Start();
+      reqs.push_back(req);
+    }
+    EXPECT_EQ_WAIT(done_before + kNumRequests, num_done(), 30000);
+    int elapsed = std::max(1, TimeSince(start));
+    for (size_t j = 0; j < reqs.size(); ++j) {
+      EXPECT_EQ(200U, reqs[j]->response().scode);
+      reqs[j]->Release();
+    }
+    LOG(LS_INFO) << (pools[i] ? "Pooled" : "Unpooled") << " requests: "
+                 << kNumRequests * 1000 / elapsed << " requests/sec, "
+                 << server().num_accepted() - accepted_before
+                 << " connections";
+  }
+}
+
 }  // namespace talk_base
@@ -74,6 +74,8 @@ class AsyncSocketAdapter : public AsyncSocket, public sigslot::has_slots<> {
   virtual int Send(const void* pv, size_t cb) {
     return socket_->Send(pv, cb);
   }
+  // SendV is deliberately not passed on: adapters that change what Send()
+  // puts on the wire rely on the default, which goes through Send().
   virtual int SendTo(const void* pv, size_t cb, const SocketAddress& addr) {
     return socket_->SendTo(pv, cb, addr);
   }
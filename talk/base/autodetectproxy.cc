@@ -49,6 +49,8 @@ static void SaveStringToStack(char *dst,
 
 AutoDetectProxy::AutoDetectProxy(const std::string& user_agent)
     : agent_(user_agent), socket_(NULL), next_(0) {
+  // Detection is started for every login, so don't spend a thread on each.
+  SetThreadPool(SignalThreadPool::Default());
 }
 
 AutoDetectProxy::~AutoDetectProxy() {
@@ -107,7 +109,10 @@ void AutoDetectProxy::OnMessage(Message *msg) {
                       proxy().address.hostname(),
                       sizeof address_hostname);
 
-    uint32 address_ip = proxy().address.ip();
+    char address_ip[kSavedStringLimit];
+    SaveStringToStack(address_ip,
+                      proxy().address.ipaddr().ToString(),
+                      sizeof address_ip);
 
     uint16 address_port = proxy().address.port();
 
@@ -89,12 +89,15 @@ class AutoDetectProxyTest : public testing::Test, public sigslot::has_slots<> {
 // the correct detection result since we don't know what proxy to expect on an
 // arbitrary machine.)
 TEST_F(AutoDetectProxyTest, TestProxyDetection) {
+  size_t runs = SignalThreadPool::Default()->num_runs();
   ASSERT_TRUE(Create(kUserAgent,
                      kPath,
                      kHost,
                      kPort,
                      kSecure));
   ASSERT_TRUE(Run(kTimeoutMs));
+  // The detection ran on the shared pool.
+  EXPECT_EQ(runs + 1, SignalThreadPool::Default()->num_runs());
 }
 
 }  // namespace talk_base
@@ -31,13 +31,147 @@
 #include <cassert>
 #include <cstring>
 
+#ifdef POSIX
+#include <pthread.h>
+#endif
+
 #include "talk/base/basictypes.h"
 #include "talk/base/byteorder.h"
+#include "talk/base/criticalsection.h"
 
 namespace talk_base {
 
 static const int DEFAULT_SIZE = 4096;
 
+namespace {
+
+// Storage is handed out in power-of-two sizes from kMinSlabSize to
+// kMaxSlabSize, and up to kMaxFreeSlabs of each size are kept for reuse.
+// Anything bigger goes straight to the heap.
+const size_t kMinSlabSize = 64;
+const size_t kMaxSlabSize = 64 * 1024;
+const int kNumSlabSizes = 11;
+const int kMaxFreeSlabs = 4;
+
+class SlabPool {
+ public:
+  SlabPool() {
+    memset(num_free_, 0, sizeof(num_free_));
+  }
+  ~SlabPool() {
+    for (int i = 0; i < kNumSlabSizes; ++i) {
+      for (int j = 0; j < num_free_[i]; ++j) {
+        delete [] free_[i][j];
+      }
+    }
+  }
+
+  // Returns storage for at least |*size| bytes, and sets |*size| to what
+  // was actually provided.
+  char* Allocate(size_t* size) {
+    int index = SizeIndex(*size);
+    if (index < 0) {
+      return new char[*size];
+    }
+    *size = kMinSlabSize << index;
+    if (num_free_[index] > 0) {
+      return free_[index][--num_free_[index]];
+    }
+    return new char[*size];
+  }
+
+  void Free(char* bytes, size_t size) {
+    int index = SizeIndex(size);
+    if (index >= 0 && (kMinSlabSize << index) == size &&
+        num_free_[index] < kMaxFreeSlabs) {
+      free_[index][num_free_[index]++] = bytes;
+    } else {
+      delete [] bytes;
+    }
+  }
+
+ private:
+  static int SizeIndex(size_t size) {
+    if (size > kMaxSlabSize) {
+      return -1;
+    }
+    int index = 0;
+    while ((kMinSlabSize << index) < size) {
+      ++index;
+    }
+    return index;
+  }
+
+  char* free_[kNumSlabSizes][kMaxFreeSlabs];
+  int num_free_[kNumSlabSizes];
+};
+
+#ifdef POSIX
+// Each thread has its own pool, so no locking is needed.  Storage freed on a
+// different thread from the one that allocated it simply moves pools.
+class ThreadSlabPools {
+ public:
+  static ThreadSlabPools* Instance() {
+    static ThreadSlabPools* instance = new ThreadSlabPools();
+    return instance;
+  }
+  ThreadSlabPools() {
+    pthread_key_create(&key_, &Delete);
+  }
+  SlabPool* Get() {
+    void* pool = pthread_getspecific(key_);
+    if (!pool) {
+      pool = new SlabPool();
+      pthread_setspecific(key_, pool);
+    }
+    return static_cast<SlabPool*>(pool);
+  }
+
+ private:
+  static void Delete(void* pool) {
+    delete static_cast<SlabPool*>(pool);
+  }
+  pthread_key_t key_;
+};
+
+// Make sure the key exists before any threads can race to create it.
+ThreadSlabPools* ignore = ThreadSlabPools::Instance();
+
+char* AllocateBytes(size_t* size) {
+  return ThreadSlabPools::Instance()->Get()->Allocate(size);
+}
+
+void FreeBytes(char* bytes, size_t size) {
+  ThreadSlabPools::Instance()->Get()->Free(bytes, size);
+}
+#endif
+
+#ifdef WIN32
+// TLS slots have no destructor to free a thread's pool when it exits, so
+// threads share one pool.
+CriticalSection* PoolCrit() {
+  static CriticalSection* crit = new CriticalSection();
+  return crit;
+}
+
+SlabPool* SharedPool() {
+  static SlabPool* pool = new SlabPool();
+  return pool;
+}
+
+char* AllocateBytes(size_t* size) {
+  CritScope cs(PoolCrit());
+  return SharedPool()->Allocate(size);
+}
+
+void FreeBytes(char* bytes, size_t size) {
+  CritScope cs(PoolCrit());
+  SharedPool()->Free(bytes, size);
+}
+#endif
+
+}  // namespace
+
 ByteBuffer::ByteBuffer() {
   Construct(NULL, DEFAULT_SIZE, ORDER_NETWORK);
 }
@@ -54,6 +188,19 @@ ByteBuffer::ByteBuffer(const char* bytes, size_t len, ByteOrder byte_order) {
   Construct(bytes, len, byte_order);
 }
 
+ByteBuffer::ByteBuffer(const char* bytes, size_t len, CopyMode copy_mode) {
+  if (copy_mode == COPY) {
+    Construct(bytes, len, ORDER_NETWORK);
+  } else {
+    bytes_      = const_cast<char*>(bytes);
+    size_       = len;
+    start_      = 0;
+    end_        = len;
+    byte_order_ = ORDER_NETWORK;
+    owned_      = false;
+  }
+}
+
 ByteBuffer::ByteBuffer(const char* bytes) {
   Construct(bytes, strlen(bytes), ORDER_NETWORK);
 }
@@ -61,20 +208,26 @@ ByteBuffer::ByteBuffer(const char* bytes) {
 void ByteBuffer::Construct(const char* bytes, size_t len,
                            ByteOrder byte_order) {
   start_      = 0;
-  size_       = len;
   byte_order_ = byte_order;
-  bytes_      = new char[size_];
+  owned_      = true;
 
   if (bytes) {
-    end_ = len;
+    size_  = len;
+    bytes_ = AllocateBytes(&size_);
+    end_   = len;
     memcpy(bytes_, bytes, end_);
   } else {
-    end_ = 0;
+    // Wait for the first write to take any storage.
+    size_  = 0;
+    bytes_ = NULL;
+    end_   = 0;
   }
 }
 
 ByteBuffer::~ByteBuffer() {
-  delete[] bytes_;
+  if (owned_ && bytes_) {
+    FreeBytes(bytes_, size_);
+  }
 }
 
 bool ByteBuffer::ReadUInt8(uint8* val) {
@@ -191,11 +344,42 @@ void ByteBuffer::WriteString(const std::string& val) {
 }
 
 void ByteBuffer::WriteBytes(const char* val, size_t len) {
-  if (Length() + len > Capacity())
-    Resize(Length() + len);
+  memcpy(ReserveWriteBuffer(len), val, len);
+}
 
-  memcpy(bytes_ + end_, val, len);
+char* ByteBuffer::ReserveWriteBuffer(size_t len) {
+  if (!owned_ || Length() + len > Capacity()) {
+    // An empty buffer starts at the default size, to leave room to grow.
+    Resize(_max(Length() + len,
+                size_ == 0 ? static_cast<size_t>(DEFAULT_SIZE) : 0));
+  }
+
+  char* start = bytes_ + end_;
   end_ += len;
+  return start;
+}
+
+bool ByteBuffer::WriteUInt8At(size_t pos, uint8 val) {
+  return WriteBytesAt(pos, reinterpret_cast<const char*>(&val), 1);
+}
+
+bool ByteBuffer::WriteUInt16At(size_t pos, uint16 val) {
+  uint16 v = (byte_order_ == ORDER_NETWORK) ? HostToNetwork16(val) : val;
+  return WriteBytesAt(pos, reinterpret_cast<const char*>(&v), 2);
+}
+
+bool ByteBuffer::WriteUInt32At(size_t pos, uint32 val) {
+  uint32 v = (byte_order_ == ORDER_NETWORK) ? HostToNetwork32(val) : val;
+  return WriteBytesAt(pos, reinterpret_cast<const char*>(&v), 4);
+}
+
+bool ByteBuffer::WriteBytesAt(size_t pos, const char* val, size_t len) {
+  if (pos > Length() || len > Length() - pos)
+    return false;
+
+  MakeWritable();
+  memcpy(bytes_ + start_ + pos, val, len);
+  return true;
 }
 
 void ByteBuffer::Resize(size_t size) {
@@ -203,14 +387,27 @@ void ByteBuffer::Resize(size_t size) {
     size = _max(size, 3 * size_ / 2);
 
   size_t len = _min(end_ - start_, size);
-  char* new_bytes = new char[size];
-  memcpy(new_bytes, bytes_ + start_, len);
-  delete [] bytes_;
+  char* new_bytes = AllocateBytes(&size);
+  if (len > 0)
+    memcpy(new_bytes, bytes_ + start_, len);
+  if (owned_ && bytes_)
+    FreeBytes(bytes_, size_);
 
   start_ = 0;
   end_   = len;
   size_  = size;
   bytes_ = new_bytes;
+  owned_ = true;
+}
+
+void ByteBuffer::Reserve(size_t size) {
+  if (!owned_ || size > Capacity())
+    Resize(_max(size, Length()));
+}
+
+void ByteBuffer::MakeWritable() {
+  if (!owned_)
+    Resize(Length());
 }
 
 bool ByteBuffer::Consume(size_t size) {
@@ -225,6 +422,12 @@ bool ByteBuffer::Shift(size_t size) {
   if (size > Length())
     return false;
 
+  if (!owned_) {
+    // The bytes can't be moved, but that is only to reclaim space anyway.
+    start_ += size;
+    return true;
+  }
+
   end_ = Length() - size;
   memmove(bytes_, bytes_ + start_ + size, end_);
   start_ = 0;
@@ -43,11 +43,21 @@ class ByteBuffer {
     ORDER_HOST,         // Use the native order of the host.
   };
 
-  // |byte_order| defines order of bytes in the buffer.
+  enum CopyMode {
+    COPY = 0,  // Default, the buffer takes its own copy of the bytes.
+    NO_COPY,   // The bytes are read in place, and must outlive the buffer.
+               // They are only copied if the buffer is written to.
+  };
+
+  // |byte_order| defines order of bytes in the buffer.  Storage comes from a
+  // per-thread pool and goes back to it when the buffer is destroyed, so
+  // short-lived buffers rarely allocate.  An empty buffer takes no storage
+  // until it is written to.
   ByteBuffer();
   explicit ByteBuffer(ByteOrder byte_order);
   ByteBuffer(const char* bytes, size_t len);
   ByteBuffer(const char* bytes, size_t len, ByteOrder byte_order);
+  ByteBuffer(const char* bytes, size_t len, CopyMode copy_mode);
 
   // Initializes buffer from a zero-terminated string.
   explicit ByteBuffer(const char* bytes);
@@ -81,9 +91,25 @@ class ByteBuffer {
   void WriteString(const std::string& val);
   void WriteBytes(const char* val, size_t len);
 
+  // Returns space for the next |len| bytes, which are added to the buffer as
+  // though written.  The caller must fill them in before reading them.
+  char* ReserveWriteBuffer(size_t len);
+
+  // Overwrite data already in the buffer, |pos| bytes from the read position;
+  // e.g. to fill in a length once the rest of a message has been written.
+  // Return false if the data doesn't lie within the buffer.
+  bool WriteUInt8At(size_t pos, uint8 val);
+  bool WriteUInt16At(size_t pos, uint16 val);
+  bool WriteUInt32At(size_t pos, uint32 val);
+  bool WriteBytesAt(size_t pos, const char* val, size_t len);
+
   // Resize the buffer to the specified |size|.
   void Resize(size_t size);
 
+  // Makes sure |size| bytes can be held from the read position onwards
+  // without reallocating.
+  void Reserve(size_t size);
+
   // Moves current position |size| bytes forward. Return false if
   // there is less than |size| bytes left in the buffer.
   bool Consume(size_t size);
@@ -94,12 +120,15 @@ class ByteBuffer {
 
  private:
   void Construct(const char* bytes, size_t size, ByteOrder byte_order);
+  // Takes a writable copy of data that isn't owned yet.
+  void MakeWritable();
 
   char* bytes_;
   size_t size_;
   size_t start_;
   size_t end_;
   ByteOrder byte_order_;
+  bool owned_;  // false while reading NO_COPY bytes
 
   // There are sensible ways to define these, but they aren't needed in our code
   // base.
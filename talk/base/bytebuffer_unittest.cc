@@ -25,10 +25,14 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <string.h>
+
 #include "talk/base/bytebuffer.h"
 #include "talk/base/byteorder.h"
 #include "talk/base/common.h"
 #include "talk/base/gunit.h"
+#include "talk/base/logging.h"
+#include "talk/base/time.h"
 
 namespace talk_base {
 
@@ -182,4 +186,136 @@ TEST(ByteBufferTest, TestReadWriteBuffer) {
   }
 }
 
+TEST(ByteBufferTest, TestWriteAt) {
+  ByteBuffer buffer;
+  buffer.WriteUInt16(1);
+  buffer.WriteUInt16(0);  // Length, filled in below.
+  buffer.WriteUInt32(0x01020304);
+  EXPECT_TRUE(buffer.WriteUInt16At(2, static_cast<uint16>(buffer.Length())));
+  EXPECT_TRUE(buffer.WriteUInt8At(7, 5));
+  EXPECT_FALSE(buffer.WriteUInt32At(6, 0));
+  EXPECT_FALSE(buffer.WriteBytesAt(9, "", 0));
+  EXPECT_TRUE(buffer.WriteBytesAt(8, "", 0));
+
+  uint16 u16;
+  uint32 u32;
+  EXPECT_TRUE(buffer.Consume(2));
+  EXPECT_TRUE(buffer.ReadUInt16(&u16));
+  EXPECT_EQ(8, u16);
+  EXPECT_TRUE(buffer.ReadUInt32(&u32));
+  EXPECT_EQ(0x01020305U, u32);
+}
+
+TEST(ByteBufferTest, TestReserve) {
+  ByteBuffer buffer;
+  buffer.Reserve(10000);
+  EXPECT_LE(10000U, buffer.Capacity());
+  const char* data = buffer.Data();
+
+  char* p = buffer.ReserveWriteBuffer(10000);
+  memset(p, 'x', 10000);
+  EXPECT_EQ(10000U, buffer.Length());
+  EXPECT_EQ(data, buffer.Data());
+  EXPECT_EQ('x', buffer.Data()[9999]);
+}
+
+TEST(ByteBufferTest, TestNoCopy) {
+  const char bytes[] = { 0, 1, 2, 3, 4, 5 };
+  ByteBuffer buffer(bytes, sizeof(bytes), ByteBuffer::NO_COPY);
+  EXPECT_EQ(bytes, buffer.Data());
+
+  uint16 u16;
+  EXPECT_TRUE(buffer.ReadUInt16(&u16));
+  EXPECT_EQ(1, u16);
+  EXPECT_TRUE(buffer.Shift(1));
+  EXPECT_EQ(bytes + 3, buffer.Data());
+
+  // Writing takes a copy, and leaves the original bytes alone.
+  EXPECT_TRUE(buffer.WriteUInt8At(0, 9));
+  EXPECT_NE(bytes + 3, buffer.Data());
+  EXPECT_EQ(3, bytes[3]);
+  buffer.WriteUInt8(6);
+  EXPECT_EQ(4U, buffer.Length());
+  EXPECT_EQ(0, memcmp("\x09\x04\x05\x06", buffer.Data(), 4));
+}
+
+// Encodes a STUN-style message: a header whose length is filled in at the
+// end, then some attributes.
+static void WriteMessage(ByteBuffer* buf) {
+  static const char kTransactionId[] = "0123456789ab";
+  static const char kUsername[] = "abcdefghijklmnopqrstuvwxyz012345";
+  buf->WriteUInt16(0x0001);
+  buf->WriteUInt16(0);
+  buf->WriteUInt32(0x2112A442);
+  buf->WriteBytes(kTransactionId, 12);
+  buf->WriteUInt16(0x0006);
+  buf->WriteUInt16(32);
+  buf->WriteBytes(kUsername, 32);
+  buf->WriteUInt16(0x0001);
+  buf->WriteUInt16(8);
+  buf->WriteUInt16(1);
+  buf->WriteUInt16(3478);
+  buf->WriteUInt32(0x7F000001);
+  buf->WriteUInt16At(2, static_cast<uint16>(buf->Length() - 20));
+}
+
+static bool ReadMessage(ByteBuffer* buf) {
+  uint16 type, length;
+  uint32 cookie;
+  std::string id;
+  if (!buf->ReadUInt16(&type) || !buf->ReadUInt16(&length) ||
+      !buf->ReadUInt32(&cookie) || !buf->ReadString(&id, 12))
+    return false;
+  while (buf->Length() > 0) {
+    std::string value;
+    if (!buf->ReadUInt16(&type) || !buf->ReadUInt16(&length) ||
+        !buf->ReadString(&value, length))
+      return false;
+  }
+  return true;
+}
+
+// Measures encoding and decoding many small messages, each in a buffer of
+// its own.
+TEST(ByteBufferTest, DISABLED_StunBenchmark) {
+  const int kNumMessages = 200000;
+  std::string packet;
+  {
+    ByteBuffer buf;
+    WriteMessage(&buf);
+    packet.assign(buf.Data(), buf.Length());
+  }
+
+  int64 start = TimeMicros();
+  size_t total = 0;
+  for (int i = 0; i < kNumMessages; ++i) {
+    ByteBuffer buf;
+    WriteMessage(&buf);
+    total += buf.Length();
+  }
+  int64 encode_us = TimeMicros() - start;
+  EXPECT_EQ(packet.size() * kNumMessages, total);
+
+  start = TimeMicros();
+  int decoded = 0;
+  for (int i = 0; i < kNumMessages; ++i) {
+    ByteBuffer buf(packet.data(), packet.size(), ByteBuffer::NO_COPY);
+    decoded += ReadMessage(&buf);
+  }
+  int64 decode_us = TimeMicros() - start;
+  EXPECT_EQ(kNumMessages, decoded);
+
+  start = TimeMicros();
+  for (int i = 0; i < kNumMessages; ++i) {
+    ByteBuffer buf(packet.data(), packet.size());
+    ReadMessage(&buf);
+  }
+  int64 decode_copy_us = TimeMicros() - start;
+
+  LOG(LS_INFO) << "Messages/sec: encode "
+               << kNumMessages * 1000 / (encode_us + 1) << "k, decode "
+               << kNumMessages * 1000 / (decode_us + 1) << "k, decode copied "
+               << kNumMessages * 1000 / (decode_copy_us + 1) << "k";
+}
+
 }  // namespace talk_base
@@ -156,8 +156,39 @@ class AtomicOps {
     CritScope scope(StaticCrit());
     return --(*i);
   }
+#endif
+
+  // Loads/stores a word-sized value with acquire/release ordering. This is
+  // enough to hand data between exactly one writer and one reader thread
+  // without a lock: the writer fills in its data and then publishes it with
+  // ReleaseStore(), and the reader observes it with AcquireLoad().
+  template <typename T>
+  static T AcquireLoad(volatile const T* p) {
+    T value = *p;
+    Barrier();
+    return value;
+  }
+
+  template <typename T>
+  static void ReleaseStore(volatile T* p, T value) {
+    Barrier();
+    *p = value;
+  }
+
+  // Orders every load and store before it ahead of every one after it.
+  // Needed when a thread stores one value and then loads another that a
+  // different thread stores, as neither AcquireLoad nor ReleaseStore keeps
+  // a store ahead of a later load.
+  static void Barrier() {
+#ifdef WIN32
+    ::MemoryBarrier();
+#else
+    __sync_synchronize();
+#endif
+  }
 
  private:
+#ifndef WIN32
   static CriticalSection* StaticCrit() {
     static CriticalSection* crit = new CriticalSection();
     return crit;
@@ -27,6 +27,8 @@
 
 #include "talk/base/helpers.h"
 
+#include <string.h>
+
 #include <limits>
 
 #ifdef WIN32
@@ -34,12 +36,14 @@
 #include <windows.h>
 #include <ntsecapi.h>
 #else
+#include <pthread.h>
 #ifdef SSL_USE_OPENSSL
 #include <openssl/rand.h>
 #endif
 #endif
 
 #include "talk/base/base64.h"
+#include "talk/base/criticalsection.h"
 #include "talk/base/logging.h"
 #include "talk/base/scoped_ptr.h"
 #include "talk/base/time.h"
@@ -192,6 +196,62 @@ class TestRandomGenerator : public RandomGenerator {
   int seed_;
 };
 
+// A ChaCha20 keystream generator, keyed from the system RNG.  Keystream is
+// produced a buffer at a time, so most requests are just a copy.  After each
+// refill the first 32 bytes of the new keystream become the next key and are
+// never handed out, so the state left in memory can't reproduce earlier
+// output.  One of these is kept per thread, so no lock is needed to use it.
+class ChaChaRandomGenerator {
+ public:
+  ChaChaRandomGenerator() : pos_(kBufferSize), bytes_until_reseed_(0),
+                            generation_(-1) {
+    memset(key_, 0, sizeof(key_));
+  }
+  ~ChaChaRandomGenerator() {
+    memset(key_, 0, sizeof(key_));
+    memset(buffer_, 0, sizeof(buffer_));
+  }
+
+  // Reseeds from the system RNG before the next output whenever 'generation'
+  // differs from the last one it saw.
+  bool Generate(void* buf, size_t len, int generation) {
+    if (generation != generation_) {
+      generation_ = generation;
+      bytes_until_reseed_ = 0;
+      pos_ = kBufferSize;
+    }
+    uint8* out = static_cast<uint8*>(buf);
+    while (len > 0) {
+      if (pos_ == kBufferSize && !Refill()) {
+        return false;
+      }
+      size_t count = _min(len, kBufferSize - pos_);
+      memcpy(out, buffer_ + pos_, count);
+      memset(buffer_ + pos_, 0, count);
+      pos_ += count;
+      out += count;
+      len -= count;
+    }
+    return true;
+  }
+
+ private:
+  static const size_t kBufferSize = 1024;
+  static const size_t kKeySize = 32;
+  static const int kReseedInterval = 1024 * 1024;
+
+  bool Refill();
+  void Reseed();
+  static void Block(const uint32 input[16], uint8 output[64]);
+
+  uint8 key_[kKeySize];
+  uint8 buffer_[kBufferSize];
+  size_t pos_;
+  int bytes_until_reseed_;
+  int generation_;
+  DISALLOW_COPY_AND_ASSIGN(ChaChaRandomGenerator);
+};
+
 // TODO: Use Base64::Base64Table instead.
 static const char BASE64[64] = {
   'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M',
@@ -204,24 +264,185 @@ static const char BASE64[64] = {
 namespace {
 
 // This round about way of creating a global RNG is to safe-guard against
-// indeterminant static initialization order.
+// indeterminant static initialization order.  The global RNG seeds the
+// per-thread generators; in test mode it produces all output itself.
 scoped_ptr<RandomGenerator>& GetGlobalRng() {
   static scoped_ptr<RandomGenerator> g_rng(new SecureRandomGenerator());
   return g_rng;
 }
 
-RandomGenerator& Rng() {
-  return *GetGlobalRng();
+CriticalSection& GlobalRngCrit() {
+  static CriticalSection* crit = new CriticalSection();
+  return *crit;
+}
+
+// Bumped whenever the global RNG changes, to make every thread's generator
+// reseed (and drop its buffered output) before using it again.
+volatile int g_rng_generation = 0;
+volatile bool g_rng_test_mode = false;
+
+void BumpRngGeneration() {
+  AtomicOps::Increment(const_cast<int*>(&g_rng_generation));
+}
+
+// Holds each thread's ChaChaRandomGenerator.
+class ThreadRngs {
+ public:
+  static ThreadRngs* Instance() {
+    static ThreadRngs* instance = new ThreadRngs();
+    return instance;
+  }
+
+#ifdef POSIX
+  ThreadRngs() {
+    pthread_key_create(&key_, &Delete);
+    // A forked child would otherwise repeat its parent's output.
+    pthread_atfork(NULL, NULL, &OnForkChild);
+  }
+  ChaChaRandomGenerator* Get() {
+    void* rng = pthread_getspecific(key_);
+    if (!rng) {
+      rng = new ChaChaRandomGenerator();
+      pthread_setspecific(key_, rng);
+    }
+    return static_cast<ChaChaRandomGenerator*>(rng);
+  }
+#endif
+
+#ifdef WIN32
+  // TLS slots have no destructor, so a thread's generator (about 1KB) is
+  // leaked when the thread exits.
+  ThreadRngs() : key_(TlsAlloc()) {}
+  ChaChaRandomGenerator* Get() {
+    void* rng = TlsGetValue(key_);
+    if (!rng) {
+      rng = new ChaChaRandomGenerator();
+      TlsSetValue(key_, rng);
+    }
+    return static_cast<ChaChaRandomGenerator*>(rng);
+  }
+#endif
+
+ private:
+#ifdef POSIX
+  // The child has only one thread, so this doesn't need to be atomic.
+  static void OnForkChild() {
+    ++g_rng_generation;
+  }
+  static void Delete(void* rng) {
+    delete static_cast<ChaChaRandomGenerator*>(rng);
+  }
+  pthread_key_t key_;
+#endif
+#ifdef WIN32
+  DWORD key_;
+#endif
+};
+
+// Make sure the key exists before any threads can race to create it.
+ThreadRngs* ignore = ThreadRngs::Instance();
+
+bool GenerateRandom(void* buf, size_t len) {
+  if (g_rng_test_mode) {
+    CritScope cs(&GlobalRngCrit());
+    if (g_rng_test_mode) {
+      return GetGlobalRng()->Generate(buf, len);
+    }
+  }
+  return ThreadRngs::Instance()->Get()->Generate(
+      buf, len, AtomicOps::AcquireLoad(&g_rng_generation));
 }
 
 }  // namespace
 
+bool ChaChaRandomGenerator::Refill() {
+  if (bytes_until_reseed_ <= 0) {
+    Reseed();
+    if (bytes_until_reseed_ <= 0) {
+      return false;
+    }
+  }
+  // "expand 32-byte k", the key, then a zero block counter and nonce.  The
+  // counter can start from zero each time because the key changes.
+  uint32 input[16] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574 };
+  for (int i = 0; i < 8; ++i) {
+    input[4 + i] = key_[i * 4] | (key_[i * 4 + 1] << 8) |
+        (key_[i * 4 + 2] << 16) | (static_cast<uint32>(key_[i * 4 + 3]) << 24);
+  }
+  for (size_t i = 0; i < kBufferSize; i += 64) {
+    Block(input, buffer_ + i);
+    ++input[12];
+  }
+  memset(input, 0, sizeof(input));
+  memcpy(key_, buffer_, kKeySize);
+  memset(buffer_, 0, kKeySize);
+  pos_ = kKeySize;
+  bytes_until_reseed_ -= static_cast<int>(kBufferSize);
+  return true;
+}
+
+void ChaChaRandomGenerator::Reseed() {
+  uint8 seed[kKeySize];
+  bool ok;
+  {
+    CritScope cs(&GlobalRngCrit());
+    ok = GetGlobalRng()->Generate(seed, sizeof(seed));
+  }
+  if (!ok) {
+    LOG(LS_ERROR) << "Failed to seed random generator!";
+    return;
+  }
+  // Mix the seed into the key rather than replacing it, so a weak seed can't
+  // make things worse.
+  for (size_t i = 0; i < kKeySize; ++i) {
+    key_[i] ^= seed[i];
+  }
+  memset(seed, 0, sizeof(seed));
+  bytes_until_reseed_ = kReseedInterval;
+}
+
+#define CHACHA_ROTL(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+#define CHACHA_QUARTERROUND(a, b, c, d) \
+  a += b; d ^= a; d = CHACHA_ROTL(d, 16); \
+  c += d; b ^= c; b = CHACHA_ROTL(b, 12); \
+  a += b; d ^= a; d = CHACHA_ROTL(d, 8); \
+  c += d; b ^= c; b = CHACHA_ROTL(b, 7)
+
+void ChaChaRandomGenerator::Block(const uint32 input[16], uint8 output[64]) {
+  uint32 x[16];
+  memcpy(x, input, sizeof(x));
+  for (int i = 0; i < 20; i += 2) {
+    CHACHA_QUARTERROUND(x[0], x[4], x[8], x[12]);
+    CHACHA_QUARTERROUND(x[1], x[5], x[9], x[13]);
+    CHACHA_QUARTERROUND(x[2], x[6], x[10], x[14]);
+    CHACHA_QUARTERROUND(x[3], x[7], x[11], x[15]);
+    CHACHA_QUARTERROUND(x[0], x[5], x[10], x[15]);
+    CHACHA_QUARTERROUND(x[1], x[6], x[11], x[12]);
+    CHACHA_QUARTERROUND(x[2], x[7], x[8], x[13]);
+    CHACHA_QUARTERROUND(x[3], x[4], x[9], x[14]);
+  }
+  for (int i = 0; i < 16; ++i) {
+    uint32 v = x[i] + input[i];
+    output[i * 4] = static_cast<uint8>(v);
+    output[i * 4 + 1] = static_cast<uint8>(v >> 8);
+    output[i * 4 + 2] = static_cast<uint8>(v >> 16);
+    output[i * 4 + 3] = static_cast<uint8>(v >> 24);
+  }
+  memset(x, 0, sizeof(x));
+}
+
+#undef CHACHA_QUARTERROUND
+#undef CHACHA_ROTL
+
 void SetRandomTestMode(bool test) {
+  CritScope cs(&GlobalRngCrit());
   if (!test) {
     GetGlobalRng().reset(new SecureRandomGenerator());
   } else {
     GetGlobalRng().reset(new TestRandomGenerator());
   }
+  g_rng_test_mode = test;
+  BumpRngGeneration();
 }
 
 bool InitRandom(int seed) {
@@ -229,10 +450,12 @@ bool InitRandom(int seed) {
 }
 
 bool InitRandom(const char* seed, size_t len) {
-  if (!Rng().Init(seed, len)) {
+  CritScope cs(&GlobalRngCrit());
+  if (!GetGlobalRng()->Init(seed, len)) {
     LOG(LS_ERROR) << "Failed to init random generator!";
     return false;
   }
+  BumpRngGeneration();
   return true;
 }
 
@@ -246,14 +469,17 @@ bool CreateRandomString(size_t len,
                         const char* table, int table_size,
                         std::string* str) {
   str->clear();
-  scoped_array<uint8> bytes(new uint8[len]);
-  if (!Rng().Generate(bytes.get(), len)) {
-    LOG(LS_ERROR) << "Failed to generate random string!";
-    return false;
-  }
   str->reserve(len);
-  for (size_t i = 0; i < len; ++i) {
-    str->push_back(table[bytes[i] % table_size]);
+  uint8 bytes[64];
+  while (str->size() < len) {
+    size_t count = _min(len - str->size(), sizeof(bytes));
+    if (!GenerateRandom(bytes, count)) {
+      LOG(LS_ERROR) << "Failed to generate random string!";
+      return false;
+    }
+    for (size_t i = 0; i < count; ++i) {
+      str->push_back(table[bytes[i] % table_size]);
+    }
   }
   return true;
 }
@@ -269,7 +495,7 @@ bool CreateRandomString(size_t len, const std::string& table,
 
 uint32 CreateRandomId() {
   uint32 id;
-  if (!Rng().Generate(&id, sizeof(id))) {
+  if (!GenerateRandom(&id, sizeof(id))) {
     LOG(LS_ERROR) << "Failed to generate random id!";
   }
   return id;
@@ -25,10 +25,15 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <set>
 #include <string>
+#include <vector>
 
 #include "talk/base/gunit.h"
 #include "talk/base/helpers.h"
+#include "talk/base/logging.h"
+#include "talk/base/thread.h"
+#include "talk/base/time.h"
 
 namespace talk_base {
 
@@ -80,4 +85,71 @@ TEST(RandomTest, TestCreateRandomForTest) {
   SetRandomTestMode(false);
 }
 
+// Creates ids on its own thread.
+class IdCreator : public Runnable {
+ public:
+  explicit IdCreator(int count) : count_(count) {}
+  virtual void Run(Thread* thread) {
+    ids_.reserve(count_);
+    for (int i = 0; i < count_; ++i) {
+      ids_.push_back(CreateRandomId());
+    }
+  }
+  const std::vector<uint32>& ids() const { return ids_; }
+
+ private:
+  int count_;
+  std::vector<uint32> ids_;
+};
+
+// Returns the ids/sec that 'num_threads' threads create between them.
+static int CreateIdsOnThreads(int num_threads, int ids_per_thread,
+                              std::set<uint32>* ids) {
+  std::vector<Thread*> threads;
+  std::vector<IdCreator*> creators;
+  int64 start = TimeMicros();
+  for (int i = 0; i < num_threads; ++i) {
+    threads.push_back(new Thread());
+    creators.push_back(new IdCreator(ids_per_thread));
+    threads.back()->Start(creators.back());
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    threads[i]->Stop();
+  }
+  int64 elapsed = TimeMicros() - start;
+  for (int i = 0; i < num_threads; ++i) {
+    if (ids) {
+      ids->insert(creators[i]->ids().begin(), creators[i]->ids().end());
+    }
+    delete threads[i];
+    delete creators[i];
+  }
+  return static_cast<int>(num_threads * ids_per_thread * kNumMicrosecsPerSec /
+                          (elapsed + 1));
+}
+
+TEST(RandomTest, TestThreadsCreateDistinctIds) {
+  // Each thread has its own generator; they must not share a seed.
+  std::set<uint32> ids;
+  CreateIdsOnThreads(4, 1000, &ids);
+  // 4000 random 32-bit ids collide with a probability of about 0.2%.
+  EXPECT_LE(3999U, ids.size());
+}
+
+TEST(RandomTest, TestReseedAfterInit) {
+  // Buffered output must not be reused after the RNG is reseeded.
+  std::string before = CreateRandomString(16);
+  EXPECT_TRUE(InitRandom(1234));
+  EXPECT_NE(before, CreateRandomString(16));
+}
+
+// Measures how fast ids can be made from one and from several threads.
+TEST(RandomTest, DISABLED_IdBenchmark) {
+  const int kIdsPerThread = 1000000;
+  int one = CreateIdsOnThreads(1, kIdsPerThread, NULL);
+  int four = CreateIdsOnThreads(4, kIdsPerThread, NULL);
+  LOG(LS_INFO) << "Random ids/sec: 1 thread " << one / 1000
+               << "k, 4 threads " << four / 1000 << "k";
+}
+
 }  // namespace talk_base
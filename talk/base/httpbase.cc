@@ -619,6 +619,20 @@ HttpBase::flush_data() {
       send_required = queue_headers();
     }
 
+    // A document that can be read in place is sent straight from its own
+    // buffer, together with what we have queued, rather than copied in.
+    // Chunked data still needs its framing, so it is always copied.
+    const void* doc_data = NULL;
+    size_t doc_len = 0;
+    if (!send_required && !chunk_data_ && (NULL != data_->document.get())) {
+      doc_data = data_->document->GetReadData(&doc_len);
+      if (doc_len > 0) {
+        send_required = true;
+      } else {
+        doc_data = NULL;
+      }
+    }
+
     if (!send_required && (NULL != data_->document.get())) {
       // Next, attempt to queue document data.
 
@@ -683,7 +697,7 @@ HttpBase::flush_data() {
       }
     }
 
-    if (0 == len_) {
+    if ((0 == len_) && (NULL == doc_data)) {
       // No data currently available to send.
       if (NULL == data_->document.get()) {
         // If there is no source document, that means we're done.
@@ -692,13 +706,20 @@ HttpBase::flush_data() {
       return;
     }
 
+    IoVec vecs[2] = { { buffer_, len_ },
+                      { const_cast<void*>(doc_data), doc_len } };
     size_t written;
     int error;
-    StreamResult result = http_stream_->Write(buffer_, len_, &written, &error);
+    StreamResult result = http_stream_->WriteV(vecs, doc_data ? 2 : 1,
+                                               &written, &error);
     if (result == SR_SUCCESS) {
-      ASSERT(written <= len_);
-      len_ -= written;
-      memmove(buffer_, buffer_ + written, len_);
+      ASSERT(written <= len_ + doc_len);
+      const size_t buffered = _min(written, len_);
+      len_ -= buffered;
+      memmove(buffer_, buffer_ + buffered, len_);
+      if (written > buffered) {
+        data_->document->ConsumeReadData(written - buffered);
+      }
       send_required = false;
     } else if (result == SR_BLOCK) {
       if (send_required) {
@@ -42,6 +42,15 @@ const char* const kHttpResponse =
   "Goodbye!\r\n"
   "0\r\n\r\n";
 
+const char* const kHttpLengthResponse =
+  "HTTP/1.1 200\r\n"
+  "Connection: Keep-Alive\r\n"
+  "Content-Length: 8\r\n"
+  "Content-Type: text/plain\r\n"
+  "Proxy-Authorization: 42\r\n"
+  "\r\n"
+  "Goodbye!";
+
 const char* const kHttpEmptyResponse =
   "HTTP/1.1 200\r\n"
   "Connection: Keep-Alive\r\n"
@@ -343,6 +352,26 @@ TEST_F(HttpBaseTest, SupportsSendNoDocument) {
   VerifySourceContents(kHttpEmptyResponse);
 }
 
+TEST_F(HttpBaseTest, SupportsSendFromDocumentBuffer) {
+  // Without chunking, a memory document is sent from its own buffer.
+  SetupDocument(NULL);
+  data.clearHeader(HH_CONTENT_LENGTH);
+  mem = new MemoryStream("Goodbye!");
+  data.set_success("text/plain", mem);
+
+  // Stop part way through the document, so the rest goes out later.
+  const size_t kInterruptedLength = strlen(kHttpLengthResponse) - 3;
+  src.SetWriteBlock(kInterruptedLength);
+  base.send(&data);
+  EXPECT_TRUE(events.empty());
+  VerifySourceContents(kHttpLengthResponse, kInterruptedLength);
+
+  src.SetWriteBlock(SIZE_UNKNOWN);
+  src.SignalEvent(&src, SE_WRITE, 0);
+  VerifyTransferComplete(HM_SEND, HE_NONE);
+  VerifySourceContents(kHttpLengthResponse + kInterruptedLength);
+}
+
 TEST_F(HttpBaseTest, SignalsCompleteOnInterruptedSend) {
   // This test is attempting to expose a bug that occurs when a particular
   // base objects is used for receiving, and then used for sending.  In
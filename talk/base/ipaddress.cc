@@ -0,0 +1,167 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef POSIX
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+#ifdef WIN32
+#include "talk/base/win32.h"
+#include <ws2tcpip.h>
+#endif
+
+#include "talk/base/byteorder.h"
+#include "talk/base/ipaddress.h"
+#include "talk/base/stringutils.h"
+
+#ifdef WIN32
+// Win32 doesn't provide inet_aton, so we add our own version here.
+// Since inet_addr returns 0xFFFFFFFF on error, if we get this value
+// we need to test the input to see if the address really was 255.255.255.255.
+// This is slightly fragile, but better than doing nothing.
+int inet_aton(const char* cp, struct in_addr* inp) {
+  inp->s_addr = inet_addr(cp);
+  return (inp->s_addr == INADDR_NONE &&
+          strcmp(cp, "255.255.255.255") != 0) ? 0 : 1;
+}
+#endif  // WIN32
+
+namespace talk_base {
+
+namespace {
+
+bool ParseIPv6(const std::string& str, in6_addr* addr) {
+#ifdef WIN32
+  // WSAStringToAddress is the only parser that Windows XP has.
+  sockaddr_in6 saddr;
+  int len = sizeof(saddr);
+  if (WSAStringToAddressA(const_cast<char*>(str.c_str()), AF_INET6, NULL,
+                          reinterpret_cast<sockaddr*>(&saddr), &len) != 0)
+    return false;
+  *addr = saddr.sin6_addr;
+  return true;
+#else
+  return inet_pton(AF_INET6, str.c_str(), addr) == 1;
+#endif
+}
+
+std::string FormatIPv6(const uint8* bytes) {
+  char buf[64];
+#ifdef WIN32
+  sockaddr_in6 saddr;
+  memset(&saddr, 0, sizeof(saddr));
+  saddr.sin6_family = AF_INET6;
+  memcpy(&saddr.sin6_addr, bytes, IPAddress::kIPv6Size);
+  DWORD len = sizeof(buf);
+  if (WSAAddressToStringA(reinterpret_cast<sockaddr*>(&saddr), sizeof(saddr),
+                          NULL, buf, &len) != 0)
+    return std::string();
+#else
+  if (!inet_ntop(AF_INET6, bytes, buf, sizeof(buf)))
+    return std::string();
+#endif
+  return buf;
+}
+
+}  // namespace
+
+IPAddress IPAddress::FromIPv6(const uint8* bytes) {
+  IPAddress ip;
+  ip.ipv6_ = true;
+  memcpy(ip.ip_.v6, bytes, kIPv6Size);
+  return ip;
+}
+
+bool IPAddress::FromString(const std::string& str, IPAddress* ip) {
+  in_addr addr;
+  if (inet_aton(str.c_str(), &addr) != 0) {
+    *ip = IPAddress(NetworkToHost32(addr.s_addr));
+    return true;
+  }
+  in6_addr addr6;
+  if (str.find(':') != std::string::npos && ParseIPv6(str, &addr6)) {
+    *ip = FromIPv6(reinterpret_cast<const uint8*>(&addr6));
+    return true;
+  }
+  return false;
+}
+
+int IPAddress::family() const {
+  return ipv6_ ? AF_INET6 : AF_INET;
+}
+
+bool IPAddress::IsAny() const {
+  if (!ipv6_)
+    return ip_.v4 == 0;
+  for (size_t i = 0; i < kIPv6Size; ++i) {
+    if (ip_.v6[i] != 0)
+      return false;
+  }
+  return true;
+}
+
+bool IPAddress::IsLoopback() const {
+  if (!ipv6_)
+    return (ip_.v4 >> 24) == 127;
+  for (size_t i = 0; i < kIPv6Size - 1; ++i) {
+    if (ip_.v6[i] != 0)
+      return false;
+  }
+  return ip_.v6[kIPv6Size - 1] == 1;
+}
+
+bool IPAddress::IsLinkLocal() const {
+  if (!ipv6_)
+    return (ip_.v4 >> 16) == ((169 << 8) | 254);
+  return ip_.v6[0] == 0xfe && (ip_.v6[1] & 0xc0) == 0x80;
+}
+
+bool IPAddress::IsPrivate() const {
+  if (IsLoopback() || IsLinkLocal())
+    return true;
+  if (!ipv6_) {
+    return ((ip_.v4 >> 24) == 10) ||
+           ((ip_.v4 >> 20) == ((172 << 4) | 1)) ||
+           ((ip_.v4 >> 16) == ((192 << 8) | 168));
+  }
+  return (ip_.v6[0] & 0xfe) == 0xfc;
+}
+
+std::string IPAddress::ToString() const {
+  if (ipv6_)
+    return FormatIPv6(ip_.v6);
+  char buf[16];
+  sprintfn(buf, sizeof(buf), "%u.%u.%u.%u",
+           (ip_.v4 >> 24) & 0xff, (ip_.v4 >> 16) & 0xff,
+           (ip_.v4 >> 8) & 0xff, ip_.v4 & 0xff);
+  return buf;
+}
+
+}  // namespace talk_base
@@ -0,0 +1,130 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TALK_BASE_IPADDRESS_H_
+#define TALK_BASE_IPADDRESS_H_
+
+#include <string.h>
+
+#include <string>
+
+#include "talk/base/basictypes.h"
+
+namespace talk_base {
+
+// Records an IPv4 or IPv6 address.  IPv4 addresses are kept as a 32 bit
+// integer in <b>host byte-order</b>, as elsewhere in this library; IPv6
+// addresses as their 16 bytes in network byte-order.
+class IPAddress {
+ public:
+  static const size_t kIPv6Size = 16;
+
+  // Creates the IPv4 any address, 0.0.0.0.
+  IPAddress() : ipv6_(false) {
+    ip_.v4 = 0;
+  }
+
+  // Creates the given IPv4 address.  Not explicit, so that code that passes
+  // IPv4 addresses around as integers keeps working.
+  IPAddress(uint32 ip) : ipv6_(false) {  // NOLINT
+    ip_.v4 = ip;
+  }
+
+  // Creates an IPv6 address from its kIPv6Size bytes.
+  static IPAddress FromIPv6(const uint8* bytes);
+
+  // Parses a dotted IPv4 address (A.B.C.D) or an IPv6 address in any of its
+  // textual forms.  Hostnames are not resolved.
+  static bool FromString(const std::string& str, IPAddress* ip);
+
+  bool IsIPv6() const { return ipv6_; }
+
+  // Returns AF_INET or AF_INET6.
+  int family() const;
+
+  // Returns the IPv4 address, or 0 for an IPv6 address.
+  uint32 ipv4() const { return ipv6_ ? 0 : ip_.v4; }
+
+  // Returns the bytes of an IPv6 address.
+  const uint8* ipv6() const { return ip_.v6; }
+
+  // Determines whether this is the any address, 0.0.0.0 or ::.
+  bool IsAny() const;
+
+  // Determines whether this is within 127.0.0.0/8, or is ::1.
+  bool IsLoopback() const;
+
+  // Determines whether this is within 169.254.0.0/16 or fe80::/10.  IPv6
+  // link-local addresses need an interface to be usable, which we don't
+  // record, so they are not used for connectivity.
+  bool IsLinkLocal() const;
+
+  // Determines whether this is a loopback or link-local address, or within
+  // 10.0.0.0/8, 172.16.0.0/12, 192.168.0.0/16 or fc00::/7.
+  bool IsPrivate() const;
+
+  // Returns the address in dotted form, or in the RFC 5952 form for IPv6.
+  std::string ToString() const;
+
+  bool operator ==(const IPAddress& ip) const {
+    if (ipv6_ != ip.ipv6_)
+      return false;
+    return ipv6_ ? (memcmp(ip_.v6, ip.ip_.v6, kIPv6Size) == 0)
+                 : (ip_.v4 == ip.ip_.v4);
+  }
+  bool operator !=(const IPAddress& ip) const {
+    return !this->operator ==(ip);
+  }
+
+  // Orders IPv4 addresses before IPv6 addresses.
+  bool operator <(const IPAddress& ip) const {
+    if (ipv6_ != ip.ipv6_)
+      return !ipv6_;
+    return ipv6_ ? (memcmp(ip_.v6, ip.ip_.v6, kIPv6Size) < 0)
+                 : (ip_.v4 < ip.ip_.v4);
+  }
+
+  // Folds the address into 32 bits; the same value as ipv4() for IPv4.
+  uint32 Hash() const {
+    if (!ipv6_)
+      return ip_.v4;
+    uint32 words[kIPv6Size / 4];
+    memcpy(words, ip_.v6, kIPv6Size);
+    return words[0] ^ words[1] ^ words[2] ^ words[3];
+  }
+
+ private:
+  union {
+    uint32 v4;
+    uint8 v6[kIPv6Size];
+  } ip_;
+  bool ipv6_;
+};
+
+}  // namespace talk_base
+
+#endif  // TALK_BASE_IPADDRESS_H_
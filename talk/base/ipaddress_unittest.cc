@@ -0,0 +1,112 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "talk/base/gunit.h"
+#include "talk/base/ipaddress.h"
+
+namespace talk_base {
+
+static const uint8 kIPv6Loopback[] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1
+};
+
+TEST(IPAddressTest, TestDefaultCtor) {
+  IPAddress ip;
+  EXPECT_FALSE(ip.IsIPv6());
+  EXPECT_TRUE(ip.IsAny());
+  EXPECT_EQ(0U, ip.ipv4());
+  EXPECT_EQ("0.0.0.0", ip.ToString());
+}
+
+TEST(IPAddressTest, TestIPv4) {
+  IPAddress ip(0x01020304);
+  EXPECT_FALSE(ip.IsIPv6());
+  EXPECT_FALSE(ip.IsAny());
+  EXPECT_EQ(0x01020304U, ip.ipv4());
+  EXPECT_EQ("1.2.3.4", ip.ToString());
+
+  IPAddress parsed;
+  EXPECT_TRUE(IPAddress::FromString("1.2.3.4", &parsed));
+  EXPECT_EQ(ip, parsed);
+  EXPECT_TRUE(IPAddress::FromString("255.255.255.255", &parsed));
+  EXPECT_EQ(0xFFFFFFFFU, parsed.ipv4());
+}
+
+TEST(IPAddressTest, TestIPv6) {
+  IPAddress ip;
+  EXPECT_TRUE(IPAddress::FromString("::1", &ip));
+  EXPECT_TRUE(ip.IsIPv6());
+  EXPECT_EQ(0U, ip.ipv4());
+  EXPECT_EQ(0, memcmp(kIPv6Loopback, ip.ipv6(), sizeof(kIPv6Loopback)));
+  EXPECT_EQ(IPAddress::FromIPv6(kIPv6Loopback), ip);
+  EXPECT_EQ("::1", ip.ToString());
+
+  EXPECT_TRUE(IPAddress::FromString("2001:DB8:0:0::1:0", &ip));
+  EXPECT_EQ("2001:db8::1:0", ip.ToString());
+  EXPECT_TRUE(IPAddress::FromString("::", &ip));
+  EXPECT_TRUE(ip.IsIPv6());
+  EXPECT_TRUE(ip.IsAny());
+  EXPECT_NE(IPAddress(), ip);
+}
+
+TEST(IPAddressTest, TestBadStrings) {
+  IPAddress ip;
+  EXPECT_FALSE(IPAddress::FromString("", &ip));
+  EXPECT_FALSE(IPAddress::FromString("a.b.com", &ip));
+  EXPECT_FALSE(IPAddress::FromString("1::2::3", &ip));
+  EXPECT_FALSE(IPAddress::FromString("[::1]", &ip));
+}
+
+TEST(IPAddressTest, TestClassify) {
+  IPAddress ip;
+  EXPECT_TRUE(IPAddress(0x7F000001).IsLoopback());
+  EXPECT_TRUE(IPAddress::FromString("::1", &ip) && ip.IsLoopback());
+  EXPECT_TRUE(IPAddress::FromString("fe80::1", &ip) && ip.IsLinkLocal());
+  EXPECT_TRUE(ip.IsPrivate());
+  EXPECT_TRUE(IPAddress::FromString("fd00::2", &ip) && ip.IsPrivate());
+  EXPECT_FALSE(ip.IsLinkLocal());
+  EXPECT_TRUE(IPAddress::FromString("2001:db8::1", &ip) && !ip.IsPrivate());
+  EXPECT_FALSE(ip.IsLoopback());
+  EXPECT_TRUE(IPAddress(0xC0A80001).IsPrivate());
+  EXPECT_TRUE(IPAddress(0xA9FE0001).IsLinkLocal());
+  EXPECT_FALSE(IPAddress(0x08080808).IsPrivate());
+}
+
+TEST(IPAddressTest, TestCompare) {
+  IPAddress v6a, v6b;
+  EXPECT_TRUE(IPAddress::FromString("::1", &v6a));
+  EXPECT_TRUE(IPAddress::FromString("::2", &v6b));
+  EXPECT_TRUE(v6a < v6b);
+  EXPECT_FALSE(v6b < v6a);
+  EXPECT_NE(v6a.Hash(), v6b.Hash());
+  // IPv4 addresses sort first, so "::1" is not confused with 0.0.0.1.
+  EXPECT_TRUE(IPAddress(0xFFFFFFFF) < v6a);
+  EXPECT_NE(IPAddress(1), v6a);
+  EXPECT_EQ(0x01020304U, IPAddress(0x01020304).Hash());
+}
+
+}  // namespace talk_base
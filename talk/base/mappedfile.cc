@@ -0,0 +1,139 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "talk/base/mappedfile.h"
+
+#ifdef POSIX
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "talk/base/logging.h"
+
+namespace talk_base {
+
+MappedFile::MappedFile()
+    : data_(NULL),
+      size_(0) {
+#ifdef WIN32
+  mapping_ = NULL;
+#endif
+}
+
+MappedFile::~MappedFile() {
+  Close();
+}
+
+#ifdef POSIX
+bool MappedFile::Open(const std::string& filename) {
+  Close();
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG_ERR(LS_ERROR) << "open(" << filename << ")";
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    LOG(LS_ERROR) << "Cannot map empty or unreadable file " << filename;
+    close(fd);
+    return false;
+  }
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping keeps the file referenced.
+  close(fd);
+  if (data == MAP_FAILED) {
+    LOG_ERR(LS_ERROR) << "mmap(" << filename << ")";
+    return false;
+  }
+  // Most users scan the file from start to end.
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+  data_ = static_cast<const uint8*>(data);
+  size_ = st.st_size;
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_) {
+    munmap(const_cast<uint8*>(data_), size_);
+    data_ = NULL;
+    size_ = 0;
+  }
+}
+#endif  // POSIX
+
+#ifdef WIN32
+bool MappedFile::Open(const std::string& filename) {
+  Close();
+  HANDLE file = ::CreateFile(ToUtf16(filename).c_str(), GENERIC_READ,
+                             FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                             FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    LOG_GLE(LS_ERROR) << "CreateFile(" << filename << ")";
+    return false;
+  }
+  LARGE_INTEGER size;
+  if (!::GetFileSizeEx(file, &size) || size.QuadPart <= 0) {
+    LOG(LS_ERROR) << "Cannot map empty or unreadable file " << filename;
+    ::CloseHandle(file);
+    return false;
+  }
+  mapping_ = ::CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  // The mapping keeps the file referenced.
+  ::CloseHandle(file);
+  if (!mapping_) {
+    LOG_GLE(LS_ERROR) << "CreateFileMapping(" << filename << ")";
+    return false;
+  }
+  data_ = static_cast<const uint8*>(
+      ::MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+  if (!data_) {
+    LOG_GLE(LS_ERROR) << "MapViewOfFile(" << filename << ")";
+    ::CloseHandle(mapping_);
+    mapping_ = NULL;
+    return false;
+  }
+  size_ = static_cast<size_t>(size.QuadPart);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_) {
+    ::UnmapViewOfFile(data_);
+    data_ = NULL;
+    size_ = 0;
+  }
+  if (mapping_) {
+    ::CloseHandle(mapping_);
+    mapping_ = NULL;
+  }
+}
+#endif  // WIN32
+
+}  // namespace talk_base
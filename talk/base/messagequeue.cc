@@ -107,7 +107,7 @@ void MessageQueueManager::Clear(MessageHandler *handler) {
 
 MessageQueue::MessageQueue(SocketServer* ss)
     : ss_(ss), fStop_(false), fPeekKeep_(false), active_(false),
-      dmsgq_next_num_(0) {
+      dmsgq_next_num_(0), loop_time_(Time()) {
   if (!ss_) {
     // Currently, MessageQueue holds a socket server, and is the base class for
     // Thread.  It seems like it makes more sense for Thread to hold the socket
@@ -181,6 +181,8 @@ bool MessageQueue::Get(Message *pmsg, int cmsWait, bool process_io) {
   uint32 msStart = Time();
   uint32 msCurrent = msStart;
   while (true) {
+    loop_time_ = msCurrent;
+
     // Check for sent messages
 
     ReceiveSends();
@@ -200,6 +200,13 @@ class MessageQueue {
   // Amount of time until the next message can be retrieved
   virtual int GetDelay();
 
+  // Returns the Time() at which Get() last checked the queues, i.e. roughly
+  // when the message now being dispatched was picked up.  Handlers that run
+  // from messages can use this instead of reading the clock themselves.
+  // Socket callbacks fire while Get() is waiting, so they should call Time().
+  // Only meaningful on the thread that processes this queue.
+  uint32 LoopTime() const { return loop_time_; }
+
   bool empty() const { return msgq_.empty() && dmsgq_.empty() && !fPeekKeep_; }
   size_t size() const { return msgq_.size() + dmsgq_.size() + fPeekKeep_; }
 
@@ -238,6 +245,7 @@ class MessageQueue {
   MessageList msgq_;
   PriorityQueue dmsgq_;
   uint32 dmsgq_next_num_;
+  uint32 loop_time_;
   CriticalSection crit_;
 
  private:
@@ -51,3 +51,18 @@ TEST(MessageQueue, DelayedPostsWithIdenticalTimesAreProcessedInFifoOrder) {
 
   EXPECT_FALSE(q.Get(&msg, 0));  // No more messages
 }
+
+TEST(MessageQueue, LoopTimeIsWhenMessageWasPickedUp) {
+  MessageQueue q;
+
+  uint32 posted = Time();
+  q.PostDelayed(50, NULL, 1);
+  Message msg;
+  EXPECT_TRUE(q.Get(&msg, 1000));
+  EXPECT_EQ(1U, msg.message_id);
+
+  // The message was due 50ms after it was posted, and Get() noted the time
+  // when it found it due.
+  EXPECT_LE(50, TimeDiff(q.LoopTime(), posted));
+  EXPECT_LE(0, TimeDiff(Time(), q.LoopTime()));
+}
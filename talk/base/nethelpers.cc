@@ -27,8 +27,17 @@
 
 #include "talk/base/nethelpers.h"
 
+#ifdef POSIX
+#include <netinet/in.h>
+#elif WIN32
+#include <ws2tcpip.h>  // NOLINT
+#endif
+
+#include <cstring>
+
 #include "talk/base/byteorder.h"
-#include "talk/base/signalthread.h"
+#include "talk/base/thread.h"
+#include "talk/base/time.h"
 
 namespace talk_base {
 
@@ -37,23 +46,268 @@ static const size_t kInitHostentLen = 1024;
 static const size_t kMaxHostentLen = kInitHostentLen * 8;
 #endif
 
+// ResolverService
+
+ResolverService::ResolverService(size_t max_threads)
+    : ttl_(kDefaultTtl),
+      negative_ttl_(kDefaultNegativeTtl),
+      max_cache_size_(kDefaultMaxCacheSize),
+      lookup_task_(this),
+      pool_("ResolverService", max_threads) {
+}
+
+ResolverService::~ResolverService() {
+  CritScope cs(&crit_);
+  queue_.clear();
+  requests_.clear();
+  // pool_ then waits for lookups in progress to finish.
+}
+
+ResolverService* ResolverService::Default() {
+  static ResolverService* service = new ResolverService();
+  return service;
+}
+
+void ResolverService::Resolve(const std::string& hostname,
+                              MessageHandler* handler, uint32 id) {
+  Request request = { Thread::Current(), handler, id };
+  ASSERT(request.thread != NULL);
+
+  CritScope cs(&crit_);
+  CacheMap::iterator cached = cache_.find(hostname);
+  if (cached != cache_.end()) {
+    if (TimeIsLater(Time(), cached->second.expires)) {
+      lru_.splice(lru_.begin(), lru_, cached->second.lru);
+      request.thread->Post(handler, id,
+                           new ResolveResultData(cached->second.result));
+      return;
+    }
+    EraseCacheEntry(cached);
+  }
+
+  std::vector<Request>& requests = requests_[hostname];
+  requests.push_back(request);
+  if (requests.size() > 1) {
+    // A lookup of this name is already queued or in progress.
+    return;
+  }
+
+  queue_.push_back(hostname);
+  pool_.Post(&lookup_task_);
+}
+
+void ResolverService::Cancel(MessageHandler* handler, uint32 id) {
+  Thread* thread = Thread::Current();
+  {
+    CritScope cs(&crit_);
+    RequestMap::iterator iter = requests_.begin();
+    while (iter != requests_.end()) {
+      std::vector<Request>& requests = iter->second;
+      for (size_t i = 0; i < requests.size(); ) {
+        if (requests[i].thread == thread && requests[i].handler == handler &&
+            requests[i].id == id) {
+          requests.erase(requests.begin() + i);
+        } else {
+          ++i;
+        }
+      }
+      if (requests.empty()) {
+        // The lookup still runs, but its result only goes to the cache.
+        requests_.erase(iter++);
+      } else {
+        ++iter;
+      }
+    }
+  }
+  // Results are posted with crit_ held, so none can show up after this.
+  thread->Clear(handler, id);
+}
+
+void ResolverService::set_max_cache_size(size_t size) {
+  CritScope cs(&crit_);
+  max_cache_size_ = size;
+  TrimCache(max_cache_size_);
+}
+
+size_t ResolverService::cache_size() {
+  CritScope cs(&crit_);
+  return cache_.size();
+}
+
+void ResolverService::ClearCache() {
+  CritScope cs(&crit_);
+  TrimCache(0);
+}
+
+void ResolverService::TrimCache(size_t size) {
+  while (cache_.size() > size) {
+    EraseCacheEntry(cache_.find(lru_.back()));
+  }
+}
+
+void ResolverService::EraseCacheEntry(CacheMap::iterator entry) {
+  lru_.erase(entry->second.lru);
+  cache_.erase(entry);
+}
+
+int ResolverService::DoResolve(const std::string& hostname,
+                               std::vector<IPAddress>* addresses, int* ttl) {
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  // Otherwise each address is listed once per socket type.
+  hints.ai_socktype = SOCK_DGRAM;
+  addrinfo* result = NULL;
+  int error = getaddrinfo(hostname.c_str(), NULL, &hints, &result);
+  if (error != 0) {
+    return error;
+  }
+
+  std::vector<IPAddress> ipv6_addresses;
+  for (addrinfo* info = result; info != NULL; info = info->ai_next) {
+    if (info->ai_family == AF_INET) {
+      const sockaddr_in* addr =
+          reinterpret_cast<const sockaddr_in*>(info->ai_addr);
+      addresses->push_back(IPAddress(NetworkToHost32(addr->sin_addr.s_addr)));
+    } else if (info->ai_family == AF_INET6) {
+      const sockaddr_in6* addr =
+          reinterpret_cast<const sockaddr_in6*>(info->ai_addr);
+      ipv6_addresses.push_back(IPAddress::FromIPv6(addr->sin6_addr.s6_addr));
+    }
+  }
+  freeaddrinfo(result);
+  // Callers that only use the first address keep getting an IPv4 one when
+  // the name has one.
+  addresses->insert(addresses->end(), ipv6_addresses.begin(),
+                    ipv6_addresses.end());
+  return 0;
+}
+
+void ResolverService::LookupNext() {
+  ResolveResult result;
+  {
+    CritScope cs(&crit_);
+    if (queue_.empty()) {
+      // The service is being destroyed.
+      return;
+    }
+    result.hostname = queue_.front();
+    queue_.pop_front();
+  }
+
+  int ttl = ttl_;
+  result.error = DoResolve(result.hostname, &result.addresses, &ttl);
+  if (result.error == 0 && result.addresses.empty()) {
+    result.error = HOST_NOT_FOUND;
+  }
+  if (result.error != 0) {
+    ttl = negative_ttl_;
+  }
+  Complete(result, ttl);
+}
+
+void ResolverService::Complete(const ResolveResult& result, int ttl) {
+  CritScope cs(&crit_);
+  if (ttl > 0 && max_cache_size_ > 0) {
+    CacheMap::iterator cached = cache_.find(result.hostname);
+    if (cached != cache_.end()) {
+      lru_.splice(lru_.begin(), lru_, cached->second.lru);
+    } else {
+      TrimCache(max_cache_size_ - 1);
+      lru_.push_front(result.hostname);
+      cached = cache_.insert(
+          std::make_pair(result.hostname, CacheEntry())).first;
+      cached->second.lru = lru_.begin();
+    }
+    cached->second.result = result;
+    cached->second.expires = TimeAfter(ttl);
+  }
+
+  RequestMap::iterator iter = requests_.find(result.hostname);
+  if (iter == requests_.end()) {
+    return;
+  }
+  const std::vector<Request>& requests = iter->second;
+  for (size_t i = 0; i < requests.size(); ++i) {
+    requests[i].thread->Post(requests[i].handler, requests[i].id,
+                             new ResolveResultData(result));
+  }
+  requests_.erase(iter);
+}
+
 // AsyncResolver
 
-AsyncResolver::AsyncResolver() : result_(NULL), error_(0) {
+enum { MSG_RESOLVED };
+
+AsyncResolver::AsyncResolver()
+    : service_(ResolverService::Default()), main_(NULL), state_(kInit),
+      error_(0), signaling_(false), delete_pending_(false) {
+}
+
+AsyncResolver::AsyncResolver(ResolverService* service)
+    : service_(service), main_(NULL), state_(kInit),
+      error_(0), signaling_(false), delete_pending_(false) {
 }
 
 AsyncResolver::~AsyncResolver() {
-  FreeHostEnt(result_);
 }
 
-void AsyncResolver::DoWork() {
-  result_ = SafeGetHostByName(addr_.hostname().c_str(), &error_);
+void AsyncResolver::Start() {
+  ASSERT(kInit == state_ || kComplete == state_);
+  main_ = Thread::Current();
+  state_ = kRunning;
+  error_ = 0;
+  service_->Resolve(addr_.hostname(), this, MSG_RESOLVED);
 }
 
-void AsyncResolver::OnWorkDone() {
-  if (result_) {
-    addr_.SetIP(NetworkToHost32(
-        *reinterpret_cast<uint32*>(result_->h_addr_list[0])));
+void AsyncResolver::Destroy(bool wait) {
+  ASSERT(NULL == main_ || main_->IsCurrent());
+  if (kRunning == state_ || kReleasing == state_) {
+    service_->Cancel(this, MSG_RESOLVED);
+    state_ = kComplete;
+  }
+  DeleteSoon();
+}
+
+void AsyncResolver::Release() {
+  ASSERT(main_->IsCurrent());
+  if (kComplete == state_) {
+    DeleteSoon();
+  } else if (kRunning == state_) {
+    state_ = kReleasing;
+  } else {
+    ASSERT(false);
+  }
+}
+
+void AsyncResolver::DeleteSoon() {
+  // The owner may let go of us from within SignalWorkDone.
+  if (signaling_) {
+    delete_pending_ = true;
+  } else {
+    delete this;
+  }
+}
+
+void AsyncResolver::OnMessage(Message* msg) {
+  ASSERT(MSG_RESOLVED == msg->message_id);
+  ASSERT(main_->IsCurrent());
+  ResolveResultData* data = static_cast<ResolveResultData*>(msg->pdata);
+  error_ = data->data().error;
+  if (0 == error_) {
+    addr_.SetIP(data->data().addresses[0]);
+  }
+  delete data;
+
+  if (kReleasing == state_) {
+    delete_pending_ = true;
+  }
+  state_ = kComplete;
+  signaling_ = true;
+  SignalWorkDone(this);
+  signaling_ = false;
+  if (delete_pending_) {
+    delete this;
   }
 }
 
@@ -35,34 +35,180 @@
 #include <winsock2.h>  // NOLINT
 #endif
 
+#include <deque>
 #include <list>
+#include <map>
+#include <string>
+#include <vector>
 
-#include "talk/base/signalthread.h"
+#include "talk/base/criticalsection.h"
+#include "talk/base/constructormagic.h"
+#include "talk/base/ipaddress.h"
+#include "talk/base/messagequeue.h"
 #include "talk/base/sigslot.h"
 #include "talk/base/socketaddress.h"
+#include "talk/base/threadpool.h"
 
 namespace talk_base {
 
-// AsyncResolver will perform async DNS resolution, signaling the result on
-// the inherited SignalWorkDone when the operation completes.
-class AsyncResolver : public SignalThread {
+class Thread;
+
+// The outcome of a host name lookup.  On success, error is 0 and addresses
+// holds at least one address, the IPv4 ones first.
+struct ResolveResult {
+  ResolveResult() : error(0) {}
+
+  std::string hostname;
+  int error;
+  std::vector<IPAddress> addresses;
+};
+typedef TypedMessageData<ResolveResult> ResolveResultData;
+
+// ResolverService performs host name lookups on a bounded pool of worker
+// threads, which are started as lookups come in.  Results are cached for
+// their TTL, failures for a shorter negative TTL, and concurrent lookups of
+// the same name share a single query.  The cache holds a bounded number of
+// names; the least recently used one makes room for a new one.  Results are
+// posted back to the thread that asked for them as a ResolveResultData.
+class ResolverService {
+ public:
+  static const size_t kDefaultMaxThreads = 4;
+  static const int kDefaultTtl = 5 * 60 * 1000;  // 5 minutes
+  static const int kDefaultNegativeTtl = 10 * 1000;  // 10 seconds
+  static const size_t kDefaultMaxCacheSize = 256;
+
+  explicit ResolverService(size_t max_threads = kDefaultMaxThreads);
+  virtual ~ResolverService();
+
+  // The process-wide service used by AsyncResolver.
+  static ResolverService* Default();
+
+  // Context: Any thread with a message queue.  Looks up hostname, and posts
+  // the result to handler with the given message id on the calling thread.
+  // Cached results are posted right away.
+  void Resolve(const std::string& hostname, MessageHandler* handler,
+               uint32 id);
+  // Context: The thread that called Resolve.  Stops the lookups started by
+  // handler with the given id, including results that are already posted.
+  void Cancel(MessageHandler* handler, uint32 id);
+
+  // How long results are cached when the lookup doesn't report a TTL, and
+  // how long failures are cached.  A TTL of 0 disables caching.
+  void set_ttl(int ttl) { ttl_ = ttl; }
+  void set_negative_ttl(int ttl) { negative_ttl_ = ttl; }
+  // The number of names whose results are cached.  A size of 0 disables
+  // caching.
+  void set_max_cache_size(size_t size);
+  size_t cache_size();
+  // Drops all cached results.
+  void ClearCache();
+
+  size_t max_threads() const { return pool_.max_threads(); }
+  size_t num_threads() { return pool_.num_threads(); }
+  size_t num_lookups() const { return pool_.num_runs(); }
+
+ protected:
+  // Context: Worker thread.  Does the actual blocking lookup; returns 0 or a
+  // getaddrinfo error code.  An implementation that knows the TTL of the
+  // answer may store it in ttl, which is preset to the default.
+  virtual int DoResolve(const std::string& hostname,
+                        std::vector<IPAddress>* addresses, int* ttl);
+
+ private:
+  // Posted to the pool once for each queued name.
+  class LookupTask : public ThreadPool::Task {
+   public:
+    explicit LookupTask(ResolverService* service) : service_(service) {}
+    virtual void Run() { service_->LookupNext(); }
+
+   private:
+    ResolverService* service_;
+
+    DISALLOW_IMPLICIT_CONSTRUCTORS(LookupTask);
+  };
+  struct Request {
+    Thread* thread;
+    MessageHandler* handler;
+    uint32 id;
+  };
+  struct CacheEntry {
+    ResolveResult result;
+    uint32 expires;
+    // The entry's position in lru_.
+    std::list<std::string>::iterator lru;
+  };
+  typedef std::map<std::string, std::vector<Request> > RequestMap;
+  typedef std::map<std::string, CacheEntry> CacheMap;
+
+  // Context: Pool thread.  Resolves the name at the front of the queue.
+  void LookupNext();
+  void Complete(const ResolveResult& result, int ttl);
+  // Context: crit_ held.  Evicts least recently used entries until the cache
+  // has no more than size of them.
+  void TrimCache(size_t size);
+  void EraseCacheEntry(CacheMap::iterator entry);
+
+  int ttl_;
+  int negative_ttl_;
+  CriticalSection crit_;
+  RequestMap requests_;
+  CacheMap cache_;
+  // Cached names, most recently used first.
+  std::list<std::string> lru_;
+  size_t max_cache_size_;
+  std::deque<std::string> queue_;
+  LookupTask lookup_task_;
+  // Declared last, so that its threads are gone before the members they use.
+  ThreadPool pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(ResolverService);
+};
+
+// AsyncResolver will perform async DNS resolution through a ResolverService,
+// signaling the result on SignalWorkDone when the operation completes.  It
+// follows the SignalThread lifetime model: the owner calls Start(), and then
+// either Release() or Destroy() once it no longer needs the result.
+class AsyncResolver : protected MessageHandler {
  public:
   AsyncResolver();
+  explicit AsyncResolver(ResolverService* service);
 
   const SocketAddress& address() const { return addr_; }
   void set_address(const SocketAddress& addr) { addr_ = addr; }
   int error() const { return error_; }
   void set_error(int error) { error_ = error; }
 
+  // Context: Main Thread.  Begins the lookup of address().
+  void Start();
+  // Context: Main Thread.  Cancels the lookup, if it is still running, and
+  // deletes the object.  SignalWorkDone will not be signalled.  The resolver
+  // never blocks its owner, so wait is ignored.
+  void Destroy(bool wait);
+  // Context: Main Thread.  Deletes the object once the lookup completes, or
+  // right away if it already has.  SignalWorkDone will be signalled.
+  void Release();
+
+  // Context: Main Thread.  Signalled when the lookup is complete.
+  sigslot::signal1<AsyncResolver*> SignalWorkDone;
+
  protected:
-  ~AsyncResolver();
-  virtual void DoWork();
-  virtual void OnWorkDone();
+  virtual ~AsyncResolver();
+  virtual void OnMessage(Message* msg);
 
  private:
+  enum State { kInit, kRunning, kReleasing, kComplete };
+
+  void DeleteSoon();
+
+  ResolverService* service_;
+  Thread* main_;
+  State state_;
   SocketAddress addr_;
-  hostent* result_;
   int error_;
+  bool signaling_;
+  bool delete_pending_;
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncResolver);
 };
 
 // SafeGetHostByName functions allocate and return their result, instead of
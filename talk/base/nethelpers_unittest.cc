@@ -0,0 +1,282 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "talk/base/gunit.h"
+#include "talk/base/logging.h"
+#include "talk/base/nethelpers.h"
+#include "talk/base/stringencode.h"
+#include "talk/base/thread.h"
+#include "talk/base/time.h"
+
+using namespace talk_base;
+
+static const int kTimeout = 5000;
+static const uint32 kStubIP = 0x01020304;
+
+// Answers every name except "unknown.test" with kStubIP, after a delay.
+class StubResolverService : public ResolverService {
+ public:
+  explicit StubResolverService(size_t max_threads)
+      : ResolverService(max_threads), delay_(0), stub_ttl_(-1) {
+  }
+
+  void set_delay(int delay) { delay_ = delay; }
+  void set_stub_ttl(int ttl) { stub_ttl_ = ttl; }
+
+ protected:
+  virtual int DoResolve(const std::string& hostname,
+                        std::vector<IPAddress>* addresses, int* ttl) {
+    if (delay_ > 0) {
+      Thread::SleepMs(delay_);
+    }
+    if (hostname == "unknown.test") {
+      return HOST_NOT_FOUND;
+    }
+    addresses->push_back(IPAddress(kStubIP));
+    if (stub_ttl_ >= 0) {
+      *ttl = stub_ttl_;
+    }
+    return 0;
+  }
+
+ private:
+  int delay_;
+  int stub_ttl_;
+};
+
+class ResolverServiceTest : public testing::Test,
+                            public MessageHandler,
+                            public sigslot::has_slots<> {
+ public:
+  ResolverServiceTest() : service_(2), resolver_done_(0) {
+  }
+
+  virtual void OnMessage(Message* msg) {
+    ResolveResultData* data = static_cast<ResolveResultData*>(msg->pdata);
+    results_.push_back(data->data());
+    delete data;
+  }
+
+  AsyncResolver* CreateResolver(const std::string& hostname) {
+    AsyncResolver* resolver = new AsyncResolver(&service_);
+    resolver->set_address(SocketAddress(hostname, 5000));
+    resolver->SignalWorkDone.connect(this,
+                                     &ResolverServiceTest::OnResolverDone);
+    return resolver;
+  }
+
+  void OnResolverDone(AsyncResolver* resolver) {
+    ++resolver_done_;
+    resolved_address_ = resolver->address();
+    resolver->Release();
+  }
+
+ protected:
+  StubResolverService service_;
+  std::vector<ResolveResult> results_;
+  int resolver_done_;
+  SocketAddress resolved_address_;
+};
+
+TEST_F(ResolverServiceTest, ResolvesAndCaches) {
+  service_.Resolve("a.test", this, 0);
+  EXPECT_EQ_WAIT(1U, results_.size(), kTimeout);
+  EXPECT_EQ("a.test", results_[0].hostname);
+  EXPECT_EQ(0, results_[0].error);
+  ASSERT_EQ(1U, results_[0].addresses.size());
+  EXPECT_EQ(IPAddress(kStubIP), results_[0].addresses[0]);
+
+  // The second lookup is answered from the cache.
+  service_.Resolve("a.test", this, 0);
+  EXPECT_EQ_WAIT(2U, results_.size(), kTimeout);
+  EXPECT_EQ(IPAddress(kStubIP), results_[1].addresses[0]);
+  EXPECT_EQ(1U, service_.num_lookups());
+}
+
+TEST_F(ResolverServiceTest, CachesFailures) {
+  service_.Resolve("unknown.test", this, 0);
+  service_.Resolve("unknown.test", this, 0);
+  EXPECT_EQ_WAIT(2U, results_.size(), kTimeout);
+  service_.Resolve("unknown.test", this, 0);
+  EXPECT_EQ_WAIT(3U, results_.size(), kTimeout);
+  for (size_t i = 0; i < results_.size(); ++i) {
+    EXPECT_NE(0, results_[i].error);
+    EXPECT_TRUE(results_[i].addresses.empty());
+  }
+  EXPECT_EQ(1U, service_.num_lookups());
+
+  service_.set_negative_ttl(0);
+  service_.ClearCache();
+  service_.Resolve("unknown.test", this, 0);
+  service_.Resolve("unknown.test", this, 0);
+  EXPECT_EQ_WAIT(5U, results_.size(), kTimeout);
+  service_.Resolve("unknown.test", this, 0);
+  EXPECT_EQ_WAIT(6U, results_.size(), kTimeout);
+  EXPECT_EQ(3U, service_.num_lookups());
+}
+
+TEST_F(ResolverServiceTest, RespectsTtl) {
+  service_.set_stub_ttl(50);
+  service_.Resolve("a.test", this, 0);
+  EXPECT_EQ_WAIT(1U, results_.size(), kTimeout);
+  service_.Resolve("a.test", this, 0);
+  EXPECT_EQ_WAIT(2U, results_.size(), kTimeout);
+  EXPECT_EQ(1U, service_.num_lookups());
+
+  Thread::SleepMs(100);
+  service_.Resolve("a.test", this, 0);
+  EXPECT_EQ_WAIT(3U, results_.size(), kTimeout);
+  EXPECT_EQ(2U, service_.num_lookups());
+}
+
+TEST_F(ResolverServiceTest, BoundsCache) {
+  service_.set_max_cache_size(2);
+  service_.Resolve("a.test", this, 0);
+  service_.Resolve("b.test", this, 0);
+  EXPECT_EQ_WAIT(2U, results_.size(), kTimeout);
+  // Makes "b.test" the least recently used name.
+  service_.Resolve("a.test", this, 0);
+  EXPECT_EQ_WAIT(3U, results_.size(), kTimeout);
+  EXPECT_EQ(2U, service_.num_lookups());
+
+  service_.Resolve("c.test", this, 0);
+  EXPECT_EQ_WAIT(4U, results_.size(), kTimeout);
+  EXPECT_EQ(2U, service_.cache_size());
+  service_.Resolve("a.test", this, 0);
+  EXPECT_EQ_WAIT(5U, results_.size(), kTimeout);
+  EXPECT_EQ(3U, service_.num_lookups());
+  service_.Resolve("b.test", this, 0);
+  EXPECT_EQ_WAIT(6U, results_.size(), kTimeout);
+  EXPECT_EQ(4U, service_.num_lookups());
+  EXPECT_EQ(2U, service_.cache_size());
+
+  service_.set_max_cache_size(0);
+  EXPECT_EQ(0U, service_.cache_size());
+}
+
+TEST_F(ResolverServiceTest, CoalescesConcurrentLookups) {
+  service_.set_delay(20);
+  for (int i = 0; i < 10; ++i) {
+    service_.Resolve("a.test", this, i);
+  }
+  EXPECT_EQ_WAIT(10U, results_.size(), kTimeout);
+  EXPECT_EQ(1U, service_.num_lookups());
+}
+
+TEST_F(ResolverServiceTest, BoundsThreads) {
+  service_.set_delay(5);
+  for (int i = 0; i < 20; ++i) {
+    service_.Resolve(ToString(i) + ".test", this, 0);
+  }
+  EXPECT_EQ_WAIT(20U, results_.size(), kTimeout);
+  EXPECT_EQ(20U, service_.num_lookups());
+  EXPECT_EQ(service_.max_threads(), service_.num_threads());
+}
+
+TEST_F(ResolverServiceTest, Cancel) {
+  service_.set_delay(20);
+  service_.Resolve("a.test", this, 0);
+  service_.Resolve("a.test", this, 1);
+  service_.Cancel(this, 0);
+  EXPECT_EQ_WAIT(1U, results_.size(), kTimeout);
+  // The cancelled lookup never shows up.
+  Thread::Current()->ProcessMessages(100);
+  EXPECT_EQ(1U, results_.size());
+}
+
+TEST_F(ResolverServiceTest, AsyncResolver) {
+  AsyncResolver* resolver = CreateResolver("a.test");
+  resolver->Start();
+  EXPECT_EQ_WAIT(1, resolver_done_, kTimeout);
+  EXPECT_EQ(kStubIP, resolved_address_.ip());
+  EXPECT_EQ(5000, resolved_address_.port());
+
+  // Destroying a resolver before it's done cancels it.
+  resolver = CreateResolver("b.test");
+  resolver->Start();
+  resolver->Destroy(false);
+  Thread::Current()->ProcessMessages(100);
+  EXPECT_EQ(1, resolver_done_);
+}
+
+TEST(ResolverServiceSystemTest, ResolvesLocalhost) {
+  ResolverService service;
+  AsyncResolver* resolver = new AsyncResolver(&service);
+  resolver->set_address(SocketAddress("localhost", 5000));
+  resolver->Start();
+  WAIT(resolver->address().ip() != 0, kTimeout);
+  EXPECT_EQ(0, resolver->error());
+  EXPECT_EQ(0x7F000001U, resolver->address().ip());
+  resolver->Destroy(false);
+}
+
+TEST_F(ResolverServiceTest, ResolvesIPv6) {
+  ResolverService service;
+  service.Resolve("::1", this, 0);
+  ASSERT_EQ_WAIT(1U, results_.size(), kTimeout);
+  EXPECT_EQ(0, results_[0].error);
+  IPAddress loopback;
+  ASSERT_TRUE(IPAddress::FromString("::1", &loopback));
+  ASSERT_EQ(1U, results_[0].addresses.size());
+  EXPECT_EQ(loopback, results_[0].addresses[0]);
+}
+
+// Measures lookups per second against a stub resolver that takes 1ms per
+// query, for distinct names and for names that are cached.
+TEST_F(ResolverServiceTest, DISABLED_LookupBenchmark) {
+  const int kNumLookups = 1000;
+  const int kDelayMs = 1;
+  StubResolverService service(ResolverService::kDefaultMaxThreads);
+  service.set_delay(kDelayMs);
+  service.set_max_cache_size(kNumLookups);
+
+  uint32 start = Time();
+  for (int i = 0; i < kNumLookups; ++i) {
+    service.Resolve(ToString(i) + ".test", this, 0);
+  }
+  EXPECT_EQ_WAIT(static_cast<size_t>(kNumLookups), results_.size(),
+                 kTimeout * 4);
+  int uncached_ms = std::max(1, TimeSince(start));
+
+  start = Time();
+  for (int i = 0; i < kNumLookups; ++i) {
+    service.Resolve(ToString(i) + ".test", this, 0);
+  }
+  EXPECT_EQ_WAIT(static_cast<size_t>(2 * kNumLookups), results_.size(),
+                 kTimeout * 4);
+  int cached_ms = std::max(1, TimeSince(start));
+
+  EXPECT_EQ(static_cast<size_t>(kNumLookups), service.num_lookups());
+  LOG(LS_INFO) << kNumLookups << " lookups on " << service.num_threads()
+               << " threads with " << kDelayMs << "ms stub: "
+               << kNumLookups * 1000 / uncached_ms << " lookups/sec uncached, "
+               << kNumLookups * 1000 / cached_ms << " lookups/sec cached";
+}
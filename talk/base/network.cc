@@ -36,6 +36,8 @@
 #include <sys/utsname.h>
 #include <sys/ioctl.h>
 #include <net/if.h>
+#include <netinet/in.h>
+#include <ifaddrs.h>
 #include <unistd.h>
 #include <errno.h>
 #endif  // POSIX
@@ -47,6 +49,7 @@
 
 #include <algorithm>
 #include <cstdio>
+#include <set>
 
 #include "talk/base/host.h"
 #include "talk/base/logging.h"
@@ -141,9 +144,9 @@ void NetworkManagerBase::MergeNetworkList(const NetworkList& new_networks,
       networks_map_[network->name()] = network;
     } else {
       network = iter->second;
-      if (network->ip() != list[i]->ip()) {
+      if (network->ipaddr() != list[i]->ipaddr()) {
         changed = true;
-        network->set_ip(list[i]->ip());
+        network->set_ip(list[i]->ipaddr());
       }
 
       if (network->gateway_ip() != list[i]->gateway_ip()) {
@@ -219,6 +222,39 @@ bool BasicNetworkManager::CreateNetworks(bool include_ignored,
 
   delete [] ifc.ifc_buf;
   close(fd);
+
+  // SIOCGIFCONF only reports IPv4 addresses, so IPv6 ones come from
+  // getifaddrs.  Each interface contributes its first usable address as a
+  // separate network named "<interface>/ipv6", so that it doesn't replace
+  // the IPv4 network of the same interface.  Link-local addresses are
+  // skipped, as they can't be used without a scope id.
+  struct ifaddrs* ifaddrs;
+  if (getifaddrs(&ifaddrs) != 0) {
+    LOG_ERR(LERROR) << "getifaddrs";
+    return true;
+  }
+
+  std::set<std::string> ipv6_interfaces;
+  for (struct ifaddrs* cur = ifaddrs; cur != NULL; cur = cur->ifa_next) {
+    if (!cur->ifa_addr || cur->ifa_addr->sa_family != AF_INET6)
+      continue;
+
+    struct sockaddr_in6* inaddr6 =
+        reinterpret_cast<struct sockaddr_in6*>(cur->ifa_addr);
+    IPAddress ip = IPAddress::FromIPv6(inaddr6->sin6_addr.s6_addr);
+    if (ip.IsAny() || ip.IsLinkLocal() ||
+        !ipv6_interfaces.insert(cur->ifa_name).second)
+      continue;
+
+    std::string name = std::string(cur->ifa_name) + "/ipv6";
+    scoped_ptr<Network> network(new Network(name, cur->ifa_name, ip, 0));
+    network->set_ignored(IsIgnoredNetwork(*network));
+    if (include_ignored || !network->ignored()) {
+      networks->push_back(network.release());
+    }
+  }
+
+  freeifaddrs(ifaddrs);
   return true;
 }
 #endif  // POSIX
@@ -291,6 +327,11 @@ bool BasicNetworkManager::IsIgnoredNetwork(const Network& network) {
   }
 #endif
 
+  // Ignore IPv6 networks without a routable address.
+  if (network.ipaddr().IsIPv6()) {
+    return network.ipaddr().IsAny() || network.ipaddr().IsLinkLocal();
+  }
+
   // Ignore any networks with a 0.x.y.z IP
   return (network.ip() < 0x01000000);
 }
@@ -350,7 +391,7 @@ void BasicNetworkManager::DumpNetworks(bool include_ignored) {
 }
 
 Network::Network(const std::string& name, const std::string& desc,
-                 uint32 ip, uint32 gateway_ip)
+                 const IPAddress& ip, uint32 gateway_ip)
     : name_(name), description_(desc), ip_(ip), gateway_ip_(gateway_ip),
       ignored_(false), uniform_numerator_(0), uniform_denominator_(0),
       exponential_numerator_(0), exponential_denominator_(0) {
@@ -361,7 +402,7 @@ std::string Network::ToString() const {
   // Print out the first space-terminated token of the network desc, plus
   // the IP address.
   ss << "Net[" << description_.substr(0, description_.find(' '))
-     << ":" << SocketAddress::IPToString(ip_) << "]";
+     << ":" << ip_.ToString() << "]";
   return ss.str();
 }
 
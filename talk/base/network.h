@@ -34,6 +34,7 @@
 #include <vector>
 
 #include "talk/base/basictypes.h"
+#include "talk/base/ipaddress.h"
 #include "talk/base/messagehandler.h"
 #include "talk/base/sigslot.h"
 
@@ -136,7 +137,7 @@ class BasicNetworkManager : public NetworkManagerBase,
 class Network {
  public:
   Network(const std::string& name, const std::string& description,
-          uint32 ip, uint32 gateway_ip);
+          const IPAddress& ip, uint32 gateway_ip);
 
   // Returns the index of this network.  This is considered the primary key
   // that identifies each network.
@@ -146,9 +147,11 @@ class Network {
   // debugging but should not be sent over the wire (for privacy reasons).
   const std::string& description() const { return description_; }
 
-  // Identifies the current IP address used by this network.
-  uint32 ip() const { return ip_; }
-  void set_ip(uint32 ip) { ip_ = ip; }
+  // Identifies the current IP address used by this network.  ip() is the
+  // IPv4 address, or 0 for an IPv6 network.
+  uint32 ip() const { return ip_.ipv4(); }
+  const IPAddress& ipaddr() const { return ip_; }
+  void set_ip(const IPAddress& ip) { ip_ = ip; }
 
   // Identifies the current gateway IP address used by this network.
   uint32 gateway_ip() const { return gateway_ip_; }
@@ -167,7 +170,7 @@ class Network {
 
   std::string name_;
   std::string description_;
-  uint32 ip_;
+  IPAddress ip_;
   uint32 gateway_ip_;
   bool ignored_;
   SessionList sessions_;
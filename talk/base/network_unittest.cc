@@ -63,6 +63,11 @@ class NetworkTest : public testing::Test, public sigslot::has_slots<>  {
     return BasicNetworkManager::IsIgnoredNetwork(network);
   }
 
+  bool CreateNetworks(bool include_ignored,
+                      NetworkManager::NetworkList* networks) {
+    return BasicNetworkManager::CreateNetworks(include_ignored, networks);
+  }
+
  protected:
   bool callback_called_;
 };
@@ -72,6 +77,7 @@ TEST_F(NetworkTest, TestNetworkConstruct) {
   EXPECT_EQ("test1", kNetwork1.name());
   EXPECT_EQ("Test Network Adapter 1", kNetwork1.description());
   EXPECT_EQ(0x12345678U, kNetwork1.ip());
+  EXPECT_EQ(IPAddress(0x12345678U), kNetwork1.ipaddr());
   EXPECT_EQ(0x12345601U, kNetwork1.gateway_ip());
   EXPECT_FALSE(kNetwork1.ignored());
 }
@@ -83,6 +89,32 @@ TEST_F(NetworkTest, TestNetworkIgnore) {
   EXPECT_FALSE(IsIgnoredNetwork(kNetwork3));
 }
 
+// Tests that IPv6 networks are only ignored without a routable address.
+TEST_F(NetworkTest, TestIPv6NetworkIgnore) {
+  IPAddress global, link_local, any;
+  EXPECT_TRUE(IPAddress::FromString("2001:db8::1", &global));
+  EXPECT_TRUE(IPAddress::FromString("fe80::1", &link_local));
+  EXPECT_TRUE(IPAddress::FromString("::", &any));
+  EXPECT_FALSE(IsIgnoredNetwork(Network("eth0/ipv6", "eth0", global, 0)));
+  EXPECT_TRUE(IsIgnoredNetwork(Network("eth0/ipv6", "eth0", link_local, 0)));
+  EXPECT_TRUE(IsIgnoredNetwork(Network("eth0/ipv6", "eth0", any, 0)));
+  EXPECT_TRUE(IsIgnoredNetwork(Network("lo/ipv6", "lo", global, 0)));
+}
+
+// Tests that IPv6 addresses get networks of their own.
+TEST_F(NetworkTest, TestCreateIPv6Networks) {
+  NetworkManager::NetworkList list;
+  EXPECT_TRUE(CreateNetworks(true, &list));
+  for (size_t i = 0; i < list.size(); ++i) {
+    if (list[i]->ipaddr().IsIPv6()) {
+      const std::string& name = list[i]->name();
+      EXPECT_EQ("/ipv6", name.substr(name.find('/')));
+      EXPECT_FALSE(list[i]->ipaddr().IsLinkLocal());
+    }
+    delete list[i];
+  }
+}
+
 // Test that UpdateNetworks succeeds.
 TEST_F(NetworkTest, TestUpdateNetworks) {
   BasicNetworkManager manager;
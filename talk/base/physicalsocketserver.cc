@@ -36,6 +36,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <signal.h>
 #endif
@@ -107,7 +108,7 @@ const uint32 ICMP_HEADER_SIZE = 8;
 class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
  public:
   PhysicalSocket(PhysicalSocketServer* ss, SOCKET s = INVALID_SOCKET)
-    : ss_(ss), s_(s), enabled_events_(0), error_(0),
+    : ss_(ss), s_(s), enabled_events_(0), family_(AF_INET), error_(0),
       state_((s == INVALID_SOCKET) ? CS_CLOSED : CS_CONNECTED),
       resolver_(NULL) {
 #ifdef WIN32
@@ -125,6 +126,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
       socklen_t len = sizeof(type);
       VERIFY(0 == getsockopt(s_, SOL_SOCKET, SO_TYPE, (SockOptArg)&type, &len));
       udp_ = (SOCK_DGRAM == type);
+      family_ = GetLocalAddress().family();
     }
   }
 
@@ -133,9 +135,10 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
   }
 
   // Creates the underlying OS socket (same as the "socket" function).
-  virtual bool Create(int type) {
+  virtual bool Create(int family, int type) {
     Close();
-    s_ = ::socket(AF_INET, type, 0);
+    s_ = ::socket(family, type, 0);
+    family_ = family;
     udp_ = (SOCK_DGRAM == type);
     UpdateLastError();
     if (udp_)
@@ -144,13 +147,13 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
   }
 
   SocketAddress GetLocalAddress() const {
-    sockaddr_in addr;
+    sockaddr_storage addr;
     socklen_t addrlen = sizeof(addr);
     int result = ::getsockname(s_, (sockaddr*)&addr, &addrlen);
     SocketAddress address;
     if (result >= 0) {
-      ASSERT(addrlen == sizeof(addr));
-      address.FromSockAddr(addr);
+      ASSERT(addrlen <= sizeof(addr));
+      address.FromSockAddrStorage(addr);
     } else {
       LOG(LS_WARNING) << "GetLocalAddress: unable to get local addr, socket="
                       << s_;
@@ -159,13 +162,13 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
   }
 
   SocketAddress GetRemoteAddress() const {
-    sockaddr_in addr;
+    sockaddr_storage addr;
     socklen_t addrlen = sizeof(addr);
     int result = ::getpeername(s_, (sockaddr*)&addr, &addrlen);
     SocketAddress address;
     if (result >= 0) {
-      ASSERT(addrlen == sizeof(addr));
-      address.FromSockAddr(addr);
+      ASSERT(addrlen <= sizeof(addr));
+      address.FromSockAddrStorage(addr);
     } else {
       LOG(LS_WARNING) << "GetRemoteAddress: unable to get remote addr, socket="
                       << s_;
@@ -174,9 +177,9 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
   }
 
   int Bind(const SocketAddress& addr) {
-    sockaddr_in saddr;
-    addr.ToSockAddr(&saddr);
-    int err = ::bind(s_, (sockaddr*)&saddr, sizeof(saddr));
+    sockaddr_storage saddr;
+    size_t len = addr.ToSockAddrStorage(&saddr);
+    int err = ::bind(s_, (sockaddr*)&saddr, static_cast<int>(len));
     UpdateLastError();
 #ifdef _DEBUG
     if (0 == err) {
@@ -190,7 +193,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
   int Connect(const SocketAddress& addr) {
     // TODO: Implicit creation is required to reconnect...
     // ...but should we make it more explicit?
-    if ((s_ == INVALID_SOCKET) && !Create(SOCK_STREAM))
+    if ((s_ == INVALID_SOCKET) && !Create(addr.family(), SOCK_STREAM))
       return SOCKET_ERROR;
     if (addr.IsUnresolved()) {
       if (state_ != CS_CLOSED) {
@@ -211,9 +214,9 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
   }
 
   int DoConnect(const SocketAddress& addr) {
-    sockaddr_in saddr;
-    addr.ToSockAddr(&saddr);
-    int err = ::connect(s_, (sockaddr*)&saddr, sizeof(saddr));
+    sockaddr_storage saddr;
+    size_t len = addr.ToSockAddrStorage(&saddr);
+    int err = ::connect(s_, (sockaddr*)&saddr, static_cast<int>(len));
     UpdateLastError();
     if (err == 0) {
       state_ = CS_CONNECTED;
@@ -243,7 +246,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
   int GetOption(Option opt, int* value) {
     int slevel;
     int sopt;
-    if (TranslateOption(opt, &slevel, &sopt) == -1)
+    if (TranslateOption(opt, family_, &slevel, &sopt) == -1)
       return -1;
     socklen_t optlen = sizeof(*value);
     int ret = ::getsockopt(s_, slevel, sopt, (SockOptArg)value, &optlen);
@@ -258,7 +261,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
   int SetOption(Option opt, int value) {
     int slevel;
     int sopt;
-    if (TranslateOption(opt, &slevel, &sopt) == -1)
+    if (TranslateOption(opt, family_, &slevel, &sopt) == -1)
       return -1;
     if (opt == OPT_DONTFRAGMENT) {
 #ifdef LINUX
@@ -290,9 +293,52 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     return sent;
   }
 
+  int SendV(const IoVec* vecs, size_t num_vecs) {
+    // Buffers past this many are left for the next call, as after a short
+    // send; it is well inside every platform's IOV_MAX.
+    const size_t kMaxVecs = 16;
+    num_vecs = _min(num_vecs, kMaxVecs);
+#ifdef WIN32
+    WSABUF bufs[kMaxVecs];
+    for (size_t i = 0; i < num_vecs; ++i) {
+      bufs[i].buf = static_cast<char*>(vecs[i].data);
+      bufs[i].len = static_cast<ULONG>(vecs[i].len);
+    }
+    DWORD bytes = 0;
+    int sent = ::WSASend(s_, bufs, static_cast<DWORD>(num_vecs), &bytes, 0,
+                         NULL, NULL);
+    if (sent == 0)
+      sent = static_cast<int>(bytes);
+#else
+    iovec iov[kMaxVecs];
+    for (size_t i = 0; i < num_vecs; ++i) {
+      iov[i].iov_base = vecs[i].data;
+      iov[i].iov_len = vecs[i].len;
+    }
+    // sendmsg rather than writev, so that SIGPIPE can be suppressed as in
+    // Send.
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = num_vecs;
+    int sent = ::sendmsg(s_, &msg,
+#ifdef LINUX
+        MSG_NOSIGNAL
+#else
+        0
+#endif
+        );
+#endif
+    UpdateLastError();
+    if ((sent < 0) && IsBlockingError(error_)) {
+      enabled_events_ |= DE_WRITE;
+    }
+    return sent;
+  }
+
   int SendTo(const void *pv, size_t cb, const SocketAddress& addr) {
-    sockaddr_in saddr;
-    addr.ToSockAddr(&saddr);
+    sockaddr_storage saddr;
+    size_t len = addr.ToSockAddrStorage(&saddr);
     int sent = ::sendto(
         s_, (const char *)pv, (int)cb,
 #ifdef LINUX
@@ -301,7 +347,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
 #else
         0,
 #endif
-        (sockaddr*)&saddr, sizeof(saddr));
+        (sockaddr*)&saddr, static_cast<int>(len));
     UpdateLastError();
     // We have seen minidumps where this may be false.
     ASSERT(sent <= static_cast<int>(cb));
@@ -336,13 +382,13 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
   }
 
   int RecvFrom(void *pv, size_t cb, SocketAddress *paddr) {
-    sockaddr_in saddr;
+    sockaddr_storage saddr;
     socklen_t cbAddr = sizeof(saddr);
     int received = ::recvfrom(s_, (char *)pv, (int)cb, 0, (sockaddr*)&saddr,
                               &cbAddr);
     UpdateLastError();
     if ((received >= 0) && (paddr != NULL))
-      paddr->FromSockAddr(saddr);
+      paddr->FromSockAddrStorage(saddr);
     bool success = (received >= 0) || IsBlockingError(error_);
     if (udp_ || success) {
       enabled_events_ |= DE_READ;
@@ -368,7 +414,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
   }
 
   AsyncSocket* Accept(SocketAddress *paddr) {
-    sockaddr_in saddr;
+    sockaddr_storage saddr;
     socklen_t cbAddr = sizeof(saddr);
     SOCKET s = ::accept(s_, (sockaddr*)&saddr, &cbAddr);
     UpdateLastError();
@@ -376,7 +422,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
       return NULL;
     enabled_events_ |= DE_ACCEPT;
     if (paddr != NULL)
-      paddr->FromSockAddr(saddr);
+      paddr->FromSockAddrStorage(saddr);
     return ss_->WrapSocket(s);
   }
 
@@ -403,6 +449,12 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     }
 
 #if defined(WIN32)
+    // WinPing only speaks ICMPv4.
+    if (addr.IsIPv6()) {
+      error_ = EINVAL;
+      return -1;
+    }
+
     // Gets the interface MTU (TTL=1) for the interface used to reach |addr|.
     WinPing ping;
     if (!ping.IsValid()) {
@@ -435,7 +487,9 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     // Gets the path MTU.
     int value;
     socklen_t vlen = sizeof(value);
-    int err = getsockopt(s_, IPPROTO_IP, IP_MTU, &value, &vlen);
+    int err = (family_ == AF_INET6) ?
+        getsockopt(s_, IPPROTO_IPV6, IPV6_MTU, &value, &vlen) :
+        getsockopt(s_, IPPROTO_IP, IP_MTU, &value, &vlen);
     if (err < 0) {
       UpdateLastError();
       return err;
@@ -450,8 +504,8 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
   SocketServer* socketserver() { return ss_; }
 
  protected:
-  void OnResolveResult(SignalThread* thread) {
-    if (thread != resolver_) {
+  void OnResolveResult(AsyncResolver* resolver) {
+    if (resolver != resolver_) {
       return;
     }
 
@@ -472,19 +526,31 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     error_ = LAST_SYSTEM_ERROR;
   }
 
-  static int TranslateOption(Option opt, int* slevel, int* sopt) {
+  static int TranslateOption(Option opt, int family, int* slevel,
+                             int* sopt) {
     switch (opt) {
       case OPT_DONTFRAGMENT:
 #ifdef WIN32
-        *slevel = IPPROTO_IP;
-        *sopt = IP_DONTFRAGMENT;
+        if (family == AF_INET6) {
+          *slevel = IPPROTO_IPV6;
+          *sopt = IPV6_DONTFRAG;
+        } else {
+          *slevel = IPPROTO_IP;
+          *sopt = IP_DONTFRAGMENT;
+        }
         break;
 #elif defined(IOS) || defined(OSX) || defined(BSD)
         LOG(LS_WARNING) << "Socket::OPT_DONTFRAGMENT not supported.";
         return -1;
 #elif defined(POSIX)
-        *slevel = IPPROTO_IP;
-        *sopt = IP_MTU_DISCOVER;
+        // IPV6_PMTUDISC_* have the same values as IP_PMTUDISC_*.
+        if (family == AF_INET6) {
+          *slevel = IPPROTO_IPV6;
+          *sopt = IPV6_MTU_DISCOVER;
+        } else {
+          *slevel = IPPROTO_IP;
+          *sopt = IP_MTU_DISCOVER;
+        }
         break;
 #endif
       case OPT_RCVBUF:
@@ -509,6 +575,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
   PhysicalSocketServer* ss_;
   SOCKET s_;
   uint8 enabled_events_;
+  int family_;
   bool udp_;
   int error_;
   ConnState state_;
@@ -785,9 +852,9 @@ class SocketDispatcher : public Dispatcher, public PhysicalSocket {
     return true;
   }
 
-  virtual bool Create(int type) {
+  virtual bool Create(int family, int type) {
     // Change the socket to be non-blocking.
-    if (!PhysicalSocket::Create(type))
+    if (!PhysicalSocket::Create(family, type))
       return false;
 
     return Initialize();
@@ -1038,9 +1105,9 @@ class SocketDispatcher : public Dispatcher, public PhysicalSocket {
     return true;
   }
 
-  virtual bool Create(int type) {
+  virtual bool Create(int family, int type) {
     // Create socket
-    if (!PhysicalSocket::Create(type))
+    if (!PhysicalSocket::Create(family, type))
       return false;
 
     if (!Initialize())
@@ -1170,8 +1237,12 @@ void PhysicalSocketServer::WakeUp() {
 }
 
 Socket* PhysicalSocketServer::CreateSocket(int type) {
+  return CreateSocket(AF_INET, type);
+}
+
+Socket* PhysicalSocketServer::CreateSocket(int family, int type) {
   PhysicalSocket* socket = new PhysicalSocket(this);
-  if (socket->Create(type)) {
+  if (socket->Create(family, type)) {
     return socket;
   } else {
     delete socket;
@@ -1180,8 +1251,12 @@ Socket* PhysicalSocketServer::CreateSocket(int type) {
 }
 
 AsyncSocket* PhysicalSocketServer::CreateAsyncSocket(int type) {
+  return CreateAsyncSocket(AF_INET, type);
+}
+
+AsyncSocket* PhysicalSocketServer::CreateAsyncSocket(int family, int type) {
   SocketDispatcher* dispatcher = new SocketDispatcher(this);
-  if (dispatcher->Create(type)) {
+  if (dispatcher->Create(family, type)) {
     return dispatcher;
   } else {
     delete dispatcher;
@@ -233,7 +233,9 @@ bool ProxyItemMatch(const Url<char>& url, char * item, size_t len) {
       m = 0;
     uint32 mask = (m == 0) ? 0 : (~0UL) << (32 - m);
     SocketAddress addr(url.host(), 0);
-    return !addr.IsUnresolved() && ((addr.ip() & mask) == (ip & mask));
+    // The pattern is IPv4, so it never matches an IPv6 host.
+    return !addr.IsUnresolved() && !addr.IsIPv6() &&
+        ((addr.ip() & mask) == (ip & mask));
   }
 
   // .foo.com
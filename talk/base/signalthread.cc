@@ -31,6 +31,8 @@
 
 namespace talk_base {
 
+static SignalThreadPool* g_default_pool = NULL;
+
 ///////////////////////////////////////////////////////////////////////////////
 // SignalThread
 ///////////////////////////////////////////////////////////////////////////////
@@ -38,6 +40,10 @@ namespace talk_base {
 SignalThread::SignalThread()
     : main_(Thread::Current()),
       worker_(this),
+      runs_on_main_thread_(false),
+      pool_(g_default_pool),
+      pool_task_(this),
+      pool_done_(true, false),
       state_(kInit),
       refcount_(1) {
   main_->SignalQueueDestroyed.connect(this,
@@ -63,13 +69,57 @@ bool SignalThread::SetPriority(ThreadPriority priority) {
   return worker_.SetPriority(priority);
 }
 
+bool SignalThread::SetThreadPool(SignalThreadPool* pool) {
+  EnterExit ee(this);
+  ASSERT(main_->IsCurrent());
+  ASSERT(kInit == state_ || kComplete == state_);
+  pool_ = pool;
+  return true;
+}
+
+void SignalThread::SetDefaultThreadPool(SignalThreadPool* pool) {
+  g_default_pool = pool;
+}
+
+void SignalThread::SetRunsOnMainThread() {
+  EnterExit ee(this);
+  ASSERT(main_->IsCurrent());
+  ASSERT(kInit == state_ || kComplete == state_);
+  runs_on_main_thread_ = true;
+}
+
+void SignalThread::FinishWork() {
+  EnterExit ee(this);
+  ASSERT(main_->IsCurrent());
+  ASSERT(runs_on_main_thread_);
+  // Once the work is stopped, Destroy has already taken care of this.
+  if (kRunning == state_ || kReleasing == state_) {
+    main_->Clear(this, ST_MSG_WORKER_DONE);
+    main_->Post(this, ST_MSG_WORKER_DONE);
+  }
+}
+
+bool SignalThread::UsePool() const {
+  return !runs_on_main_thread_ && (pool_ != NULL) &&
+      (worker_.priority() == PRIORITY_NORMAL);
+}
+
 void SignalThread::Start() {
   EnterExit ee(this);
   ASSERT(main_->IsCurrent());
   if (kInit == state_ || kComplete == state_) {
     state_ = kRunning;
     OnWorkStart();
-    worker_.Start();
+    if (runs_on_main_thread_) {
+      // The subclass calls FinishWork() once it is done.
+    } else if (UsePool()) {
+      // The worker quit at the end of the last run, if there was one.
+      worker_.Restart();
+      pool_done_.Reset();
+      pool_->pool_.Post(&pool_task_);
+    } else {
+      worker_.Start();
+    }
   } else {
     ASSERT(false);
   }
@@ -86,10 +136,23 @@ void SignalThread::Destroy(bool wait) {
     // OWS(), ContinueWork() will return false.
     worker_.Quit();
     OnWorkStop();
-    if (wait) {
+    if (runs_on_main_thread_ || (UsePool() && pool_->pool_.Cancel(&pool_task_))) {
+      // No thread is running the work, so finish up as if it had returned
+      // right away.
+      main_->Clear(this, ST_MSG_WORKER_DONE);
+      if (wait) {
+        refcount_--;
+      } else {
+        main_->Post(this, ST_MSG_WORKER_DONE);
+      }
+    } else if (wait) {
       // Release the thread's lock so that it can return from ::Run.
       cs_.Leave();
-      worker_.Stop();
+      if (UsePool()) {
+        pool_done_.Wait(kForever);
+      } else {
+        worker_.Stop();
+      }
       cs_.Enter();
       refcount_--;
     }
@@ -152,15 +215,36 @@ void SignalThread::Run() {
   DoWork();
   {
     EnterExit ee(this);
+    if (UsePool()) {
+      pool_done_.Set();
+    }
     if (main_) {
       main_->Post(this, ST_MSG_WORKER_DONE);
     }
   }
 }
 
+void SignalThread::RunOnPool() {
+  Thread* pool_thread = Thread::Current();
+  ThreadManager::SetCurrent(&worker_);
+  // Once Run() returns, this object may be gone.
+  Run();
+  ThreadManager::SetCurrent(pool_thread);
+}
+
 void SignalThread::OnMainThreadDestroyed() {
   EnterExit ee(this);
   main_ = NULL;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// SignalThreadPool
+///////////////////////////////////////////////////////////////////////////////
+
+SignalThreadPool* SignalThreadPool::Default() {
+  // Never deleted, so that work may still be running at exit.
+  static SignalThreadPool* pool = new SignalThreadPool();
+  return pool;
+}
+
 }  // namespace talk_base
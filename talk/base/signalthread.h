@@ -31,11 +31,15 @@
 #include <string>
 
 #include "talk/base/constructormagic.h"
+#include "talk/base/event.h"
 #include "talk/base/thread.h"
+#include "talk/base/threadpool.h"
 #include "talk/base/sigslot.h"
 
 namespace talk_base {
 
+class SignalThreadPool;
+
 ///////////////////////////////////////////////////////////////////////////////
 // SignalThread - Base class for worker threads.  The main thread should call
 //  Start() to begin work, and then follow one of these models:
@@ -51,6 +55,13 @@ namespace talk_base {
 //   periodically calling ContinueWork(), it can check for cancellation.
 //   OnWorkStart and OnWorkDone can be overridden to do pre- or post-work
 //   tasks in the context of the main thread.
+//  By default each Start() runs DoWork on a newly created OS thread.  With a
+//   SignalThreadPool, DoWork runs on one of the pool's threads instead, with
+//   worker() made current for its duration, so the subclass sees no
+//   difference apart from worker()->started() being false.
+//  Subclasses that do all of their work asynchronously on the main thread can
+//   call SetRunsOnMainThread(), and then FinishWork() when they are done, to
+//   keep this interface without using a thread at all.
 ///////////////////////////////////////////////////////////////////////////////
 
 class SignalThread : public sigslot::has_slots<>, protected MessageHandler {
@@ -61,8 +72,18 @@ class SignalThread : public sigslot::has_slots<>, protected MessageHandler {
   bool SetName(const std::string& name, const void* obj);
 
   // Context: Main Thread.  Call before Start to change the worker's priority.
+  // Work with a priority other than normal always gets a dedicated thread.
   bool SetPriority(ThreadPriority priority);
 
+  // Context: Main Thread.  Call before Start to run the work on the given
+  // pool, or on a dedicated thread if pool is NULL.  Defaults to the pool
+  // set with SetDefaultThreadPool.
+  bool SetThreadPool(SignalThreadPool* pool);
+
+  // Sets the pool used by SignalThreads created from now on.  NULL, the
+  // initial value, gives each of them a dedicated thread.
+  static void SetDefaultThreadPool(SignalThreadPool* pool);
+
   // Context: Main Thread.  Call to begin the worker thread.
   void Start();
 
@@ -88,6 +109,16 @@ class SignalThread : public sigslot::has_slots<>, protected MessageHandler {
 
   Thread* worker() { return &worker_; }
 
+  // Context: Main Thread.  Call before Start to do the work on the main
+  // thread.  Start() then only calls OnWorkStart, which should begin the
+  // work; DoWork is never called and no worker is started.
+  void SetRunsOnMainThread();
+
+  // Context: Main Thread.  With SetRunsOnMainThread, call when the work is
+  // complete.  OnWorkDone and SignalWorkDone follow asynchronously, just as
+  // when DoWork returns.
+  void FinishWork();
+
   // Context: Main Thread.  Subclass should override to do pre-work setup.
   virtual void OnWorkStart() { }
 
@@ -129,6 +160,17 @@ class SignalThread : public sigslot::has_slots<>, protected MessageHandler {
     DISALLOW_IMPLICIT_CONSTRUCTORS(Worker);
   };
 
+  class PoolTask : public ThreadPool::Task {
+   public:
+    explicit PoolTask(SignalThread* parent) : parent_(parent) {}
+    virtual void Run() { parent_->RunOnPool(); }
+
+   private:
+    SignalThread* parent_;
+
+    DISALLOW_IMPLICIT_CONSTRUCTORS(PoolTask);
+  };
+
   class EnterExit {
    public:
     explicit EnterExit(SignalThread* t) : t_(t) {
@@ -152,17 +194,63 @@ class SignalThread : public sigslot::has_slots<>, protected MessageHandler {
   };
 
   void Run();
+  // Context: Pool Thread.  Runs the work with worker_ as the current thread.
+  void RunOnPool();
+  bool UsePool() const;
   void OnMainThreadDestroyed();
 
   Thread* main_;
   Worker worker_;
+  bool runs_on_main_thread_;
+  SignalThreadPool* pool_;
+  PoolTask pool_task_;
+  Event pool_done_;
   CriticalSection cs_;
   State state_;
   int refcount_;
 
+  friend class SignalThreadPool;
   DISALLOW_COPY_AND_ASSIGN(SignalThread);
 };
 
+///////////////////////////////////////////////////////////////////////////////
+// SignalThreadPool - A fixed number of threads that run the work of
+//  SignalThreads, so that starting one doesn't create an OS thread.  Work is
+//  run in the order it was started; when all of the pool's threads are busy,
+//  it waits for one of them to finish.  Work that blocks for a long time
+//  holds on to a pool thread for as long, so the pool should be sized for
+//  the number of SignalThreads that are expected to run at once.
+///////////////////////////////////////////////////////////////////////////////
+
+class SignalThreadPool {
+ public:
+  static const size_t kDefaultSize = 8;
+
+  explicit SignalThreadPool(size_t size = kDefaultSize)
+      : pool_("SignalThreadPool", size) {
+  }
+  // Waits for the work that is running to finish.  Work that hasn't started
+  // yet must have been destroyed by then.
+  ~SignalThreadPool() {}
+
+  // The process-wide pool, created on first use, for SignalThreads that
+  // would otherwise start a thread of their own every time.
+  static SignalThreadPool* Default();
+
+  size_t size() const { return pool_.max_threads(); }
+  // The number of threads started so far.  Threads are started as work
+  // comes in, up to size().
+  size_t num_threads() { return pool_.num_threads(); }
+  // The number of SignalThreads whose work has been run.
+  size_t num_runs() const { return pool_.num_runs(); }
+
+ private:
+  ThreadPool pool_;
+
+  friend class SignalThread;
+  DISALLOW_COPY_AND_ASSIGN(SignalThreadPool);
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 
 }  // namespace talk_base
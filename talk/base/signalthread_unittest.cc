@@ -25,9 +25,12 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
+
 #include "talk/base/gunit.h"
 #include "talk/base/signalthread.h"
 #include "talk/base/thread.h"
+#include "talk/base/time.h"
 
 using namespace talk_base;
 
@@ -200,3 +203,179 @@ TEST_F(SignalThreadTest, DeferredDestroyedThreadCleansUp) {
   Thread::Current()->ProcessMessages(0);
   EXPECT_STATE(1, 1, 0, 1, 1);
 }
+
+class PooledSignalThreadTest : public testing::Test,
+                               public sigslot::has_slots<> {
+ public:
+  // Optionally sleeps in DoWork, and records where each step ran.
+  class CountingSignalThread : public SignalThread {
+   public:
+    CountingSignalThread(PooledSignalThreadTest* harness, int work_ms)
+        : harness_(harness), work_ms_(work_ms), start_time_(0) {
+    }
+
+    virtual ~CountingSignalThread() {
+      ++harness_->deleted_;
+    }
+
+   protected:
+    virtual void OnWorkStart() {
+      EXPECT_EQ(harness_->main_thread_, Thread::Current());
+      start_time_ = Time();
+    }
+
+    virtual void DoWork() {
+      EXPECT_NE(harness_->main_thread_, Thread::Current());
+      EXPECT_EQ(worker(), Thread::Current());
+      harness_->AddLatency(TimeSince(start_time_));
+      if (work_ms_ > 0) {
+        Thread::Current()->ProcessMessages(work_ms_);
+      }
+    }
+
+    virtual void OnWorkDone() {
+      EXPECT_EQ(harness_->main_thread_, Thread::Current());
+      ++harness_->done_;
+    }
+
+   private:
+    PooledSignalThreadTest* harness_;
+    int work_ms_;
+    uint32 start_time_;
+  };
+
+  PooledSignalThreadTest()
+      : main_thread_(Thread::Current()), pool_(2),
+        done_(0), completed_(0), deleted_(0), runs_(0), total_latency_(0) {
+  }
+
+  CountingSignalThread* CreateSignalThread(int work_ms,
+                                           SignalThreadPool* pool) {
+    CountingSignalThread* thread = new CountingSignalThread(this, work_ms);
+    thread->SetThreadPool(pool);
+    ConnectSignalThread(thread);
+    return thread;
+  }
+
+  void ConnectSignalThread(SignalThread* thread) {
+    thread->SignalWorkDone.connect(this,
+                                   &PooledSignalThreadTest::OnWorkComplete);
+  }
+
+  void OnWorkComplete(SignalThread* thread) {
+    EXPECT_EQ(main_thread_, Thread::Current());
+    ++completed_;
+    thread->Release();
+  }
+
+  void AddLatency(int latency) {
+    CritScope cs(&crit_);
+    ++runs_;
+    total_latency_ += latency;
+  }
+
+  int runs() {
+    CritScope cs(&crit_);
+    return runs_;
+  }
+
+ protected:
+  Thread* main_thread_;
+  SignalThreadPool pool_;
+  int done_;
+  int completed_;
+  int deleted_;
+  CriticalSection crit_;
+  int runs_;
+  int total_latency_;
+};
+
+TEST_F(PooledSignalThreadTest, RunsOnPoolThreads) {
+  for (int i = 0; i < 10; ++i) {
+    CreateSignalThread(20, &pool_)->Start();
+  }
+  EXPECT_EQ_WAIT(10, deleted_, 5000);
+  EXPECT_EQ(10, done_);
+  EXPECT_EQ(10, completed_);
+  EXPECT_EQ(2U, pool_.num_threads());
+  EXPECT_EQ(10U, pool_.num_runs());
+}
+
+TEST_F(PooledSignalThreadTest, DestroyRunningWork) {
+  CountingSignalThread* thread = CreateSignalThread(5000, &pool_);
+  thread->Start();
+  EXPECT_EQ_WAIT(1, runs(), 5000);
+  // Destroying quits the worker, which ends the work right away.
+  thread->Destroy(true);
+  EXPECT_EQ(1, deleted_);
+  Thread::Current()->ProcessMessages(0);
+  EXPECT_EQ(0, done_);
+
+  thread = CreateSignalThread(5000, &pool_);
+  thread->Start();
+  EXPECT_EQ_WAIT(2, runs(), 5000);
+  thread->Destroy(false);
+  EXPECT_EQ_WAIT(2, deleted_, 5000);
+  EXPECT_EQ(1, done_);
+  EXPECT_EQ(0, completed_);
+}
+
+TEST_F(PooledSignalThreadTest, DestroyQueuedWork) {
+  SignalThreadPool pool(1);
+  CreateSignalThread(100, &pool)->Start();
+  CountingSignalThread* queued = CreateSignalThread(0, &pool);
+  queued->Start();
+  queued->Destroy(true);
+  EXPECT_EQ(1, deleted_);
+
+  queued = CreateSignalThread(0, &pool);
+  queued->Start();
+  queued->Destroy(false);
+  EXPECT_EQ_WAIT(3, deleted_, 5000);
+  // Only the first one did any work.
+  EXPECT_EQ(1, runs());
+  EXPECT_EQ(1U, pool.num_runs());
+  EXPECT_EQ(2, done_);
+  EXPECT_EQ(1, completed_);
+}
+
+TEST_F(PooledSignalThreadTest, DefaultThreadPool) {
+  SignalThread::SetDefaultThreadPool(&pool_);
+  CountingSignalThread* thread = new CountingSignalThread(this, 0);
+  SignalThread::SetDefaultThreadPool(NULL);
+  ConnectSignalThread(thread);
+  thread->Start();
+  EXPECT_EQ_WAIT(1, deleted_, 5000);
+  EXPECT_EQ(1U, pool_.num_runs());
+}
+
+// Measures how long it takes from Start() until DoWork runs when tasks are
+// started one at a time, and how many short tasks per second get through
+// when they are started all at once, with and without a pool.
+TEST_F(PooledSignalThreadTest, DISABLED_DispatchBenchmark) {
+  const int kNumSerialTasks = 200;
+  const int kNumTasks = 1000;
+  SignalThreadPool pool(SignalThreadPool::kDefaultSize);
+  SignalThreadPool* pools[] = { NULL, &pool };
+  for (int i = 0; i < 2; ++i) {
+    runs_ = 0;
+    total_latency_ = 0;
+    deleted_ = 0;
+    for (int j = 0; j < kNumSerialTasks; ++j) {
+      CreateSignalThread(0, pools[i])->Start();
+      EXPECT_EQ_WAIT(j + 1, deleted_, 5000);
+    }
+    double latency = static_cast<double>(total_latency_) / kNumSerialTasks;
+
+    deleted_ = 0;
+    uint32 start = Time();
+    for (int j = 0; j < kNumTasks; ++j) {
+      CreateSignalThread(0, pools[i])->Start();
+    }
+    EXPECT_EQ_WAIT(kNumTasks, deleted_, 30000);
+    int elapsed = std::max(1, TimeSince(start));
+    LOG(LS_INFO) << (pools[i] ? "Pooled" : "Dedicated") << " SignalThreads: "
+                 << latency << "ms average dispatch latency, "
+                 << kNumTasks * 1000 / elapsed << " tasks/sec";
+  }
+}
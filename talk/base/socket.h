@@ -43,6 +43,7 @@
 #endif
 
 #include "talk/base/basictypes.h"
+#include "talk/base/iovec.h"
 #include "talk/base/socketaddress.h"
 
 // Rather than converting errors into a private namespace,
@@ -157,6 +158,24 @@ class Socket {
   virtual int Bind(const SocketAddress& addr) = 0;
   virtual int Connect(const SocketAddress& addr) = 0;
   virtual int Send(const void *pv, size_t cb) = 0;
+  // Sends the buffers in order as if they were one, like writev(), and
+  // returns the bytes sent, which may stop short in any buffer.  By default
+  // each buffer goes through Send(); sockets that can send them all with one
+  // system call override this.
+  virtual int SendV(const IoVec* vecs, size_t num_vecs) {
+    int total = 0;
+    for (size_t i = 0; i < num_vecs; ++i) {
+      if (vecs[i].len == 0)
+        continue;
+      int sent = Send(vecs[i].data, vecs[i].len);
+      if (sent < 0)
+        return (total > 0) ? total : sent;
+      total += sent;
+      if (static_cast<size_t>(sent) < vecs[i].len)
+        break;
+    }
+    return total;
+  }
   virtual int SendTo(const void *pv, size_t cb, const SocketAddress& addr) = 0;
   virtual int Recv(void *pv, size_t cb) = 0;
   virtual int RecvFrom(void *pv, size_t cb, SocketAddress *paddr) = 0;
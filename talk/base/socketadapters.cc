@@ -55,6 +55,18 @@
 
 namespace talk_base {
 
+// Writes the address type and address of a SOCKS5 request or reply.
+static void WriteSocksAddress(const IPAddress& ip, ByteBuffer* buf) {
+  if (ip.IsIPv6()) {
+    buf->WriteUInt8(4);  // IPV6
+    buf->WriteBytes(reinterpret_cast<const char*>(ip.ipv6()),
+                    IPAddress::kIPv6Size);
+  } else {
+    buf->WriteUInt8(1);  // IPV4
+    buf->WriteUInt32(ip.ipv4());
+  }
+}
+
 BufferedReadAdapter::BufferedReadAdapter(AsyncSocket* socket, size_t size)
     : AsyncSocketAdapter(socket), buffer_size_(size),
       data_len_(0), buffering_(false) {
@@ -692,8 +704,7 @@ void AsyncSocksProxySocket::SendConnect() {
     request.WriteUInt8(static_cast<uint8>(hostname.size()));
     request.WriteString(hostname);    // Destination Hostname
   } else {
-    request.WriteUInt8(1);            // IPV4
-    request.WriteUInt32(dest_.ip());  // Destination IP
+    WriteSocksAddress(dest_.ipaddr(), &request);  // Destination IP
   }
   request.WriteUInt16(dest_.port());  // Destination Port
   DirectSend(request.Data(), request.Length());
@@ -799,24 +810,43 @@ void AsyncSocksProxyServerSocket::SendAuthReply(int result) {
 
 void AsyncSocksProxyServerSocket::HandleConnect(ByteBuffer* request) {
   uint8 ver, command, reserved, addr_type;
-  uint32 ip;
-  uint16 port;
   if (!request->ReadUInt8(&ver) ||
       !request->ReadUInt8(&command) ||
       !request->ReadUInt8(&reserved) ||
-      !request->ReadUInt8(&addr_type) ||
-      !request->ReadUInt32(&ip) ||
-      !request->ReadUInt16(&port)) {
+      !request->ReadUInt8(&addr_type)) {
       Error(0);
       return;
   }
 
   if (ver != 5 || command != 1 ||
-      reserved != 0 || addr_type != 1) {
+      reserved != 0 || (addr_type != 1 && addr_type != 4)) {
       Error(0);
       return;
   }
 
+  IPAddress ip;
+  if (addr_type == 1) {
+    uint32 ipv4;
+    if (!request->ReadUInt32(&ipv4)) {
+      Error(0);
+      return;
+    }
+    ip = IPAddress(ipv4);
+  } else {
+    uint8 ipv6[IPAddress::kIPv6Size];
+    if (!request->ReadBytes(reinterpret_cast<char*>(ipv6), sizeof(ipv6))) {
+      Error(0);
+      return;
+    }
+    ip = IPAddress::FromIPv6(ipv6);
+  }
+
+  uint16 port;
+  if (!request->ReadUInt16(&port)) {
+    Error(0);
+    return;
+  }
+
   SignalConnectRequest(this, SocketAddress(ip, port));
   state_ = SS_CONNECT_PENDING;
 }
@@ -830,8 +860,7 @@ void AsyncSocksProxyServerSocket::SendConnectResult(int result,
   response.WriteUInt8(5);  // Socks version
   response.WriteUInt8((result != 0));  // 0x01 is generic error
   response.WriteUInt8(0);  // reserved
-  response.WriteUInt8(1);  // IPv4 address
-  response.WriteUInt32(addr.ip());
+  WriteSocksAddress(addr.ipaddr(), &response);
   response.WriteUInt16(addr.port());
   DirectSend(response);
   BufferInput(false);
@@ -39,74 +39,80 @@
 
 #include "talk/base/byteorder.h"
 #include "talk/base/common.h"
+#include "talk/base/criticalsection.h"
 #include "talk/base/logging.h"
 #include "talk/base/nethelpers.h"
 #include "talk/base/socketaddress.h"
 
 #ifdef WIN32
-// Win32 doesn't provide inet_aton, so we add our own version here.
-// Since inet_addr returns 0xFFFFFFFF on error, if we get this value
-// we need to test the input to see if the address really was 255.255.255.255.
-// This is slightly fragile, but better than doing nothing.
-int inet_aton(const char* cp, struct in_addr* inp) {
-  inp->s_addr = inet_addr(cp);
-  return (inp->s_addr == INADDR_NONE &&
-          strcmp(cp, "255.255.255.255") != 0) ? 0 : 1;
-}
-#endif  // WIN32
+#include "talk/base/win32.h"
+#include <ws2tcpip.h>
+#endif
 
 namespace talk_base {
 
-SocketAddress::SocketAddress() {
-  Clear();
-}
+// Hostnames are immutable once set, so copies of an address share one.
+struct SocketAddress::Hostname {
+  explicit Hostname(const std::string& name) : ref_count(1), name(name) {}
+
+  int ref_count;
+  const std::string name;
+};
 
-SocketAddress::SocketAddress(const std::string& hostname, int port) {
+SocketAddress::SocketAddress(const std::string& hostname, int port)
+    : ip_(0), port_(0), hostname_(NULL) {
   SetIP(hostname);
   SetPort(port);
 }
 
-SocketAddress::SocketAddress(uint32 ip, int port) {
-  SetIP(ip);
+SocketAddress::SocketAddress(uint32 ip, int port)
+    : ip_(ip), port_(0), hostname_(NULL) {
   SetPort(port);
 }
 
-SocketAddress::SocketAddress(const SocketAddress& addr) {
-  this->operator=(addr);
+SocketAddress::SocketAddress(const IPAddress& ip, int port)
+    : ip_(ip), port_(0), hostname_(NULL) {
+  SetPort(port);
 }
 
 void SocketAddress::Clear() {
-  hostname_.clear();
-  ip_ = 0;
+  ClearHostname();
+  ip_ = IPAddress();
   port_ = 0;
 }
 
 bool SocketAddress::IsNil() const {
-  return hostname_.empty() && (0 == ip_) && (0 == port_);
+  return !hostname_ && (ip_ == IPAddress()) && (0 == port_);
 }
 
 bool SocketAddress::IsComplete() const {
-  return (0 != ip_) && (0 != port_);
+  return !ip_.IsAny() && (0 != port_);
 }
 
 SocketAddress& SocketAddress::operator=(const SocketAddress& addr) {
-  hostname_ = addr.hostname_;
+  if (hostname_ != addr.hostname_) {
+    ClearHostname();
+    hostname_ = addr.hostname_;
+    if (hostname_)
+      AddRefHostname();
+  }
   ip_ = addr.ip_;
   port_ = addr.port_;
   return *this;
 }
 
-void SocketAddress::SetIP(uint32 ip) {
-  hostname_.clear();
+void SocketAddress::SetIP(const IPAddress& ip) {
+  ClearHostname();
   ip_ = ip;
 }
 
 void SocketAddress::SetIP(const std::string& hostname) {
-  hostname_ = hostname;
-  ip_ = StringToIP(hostname);
+  SetHostname(hostname);
+  if (!IPAddress::FromString(hostname, &ip_))
+    ip_ = IPAddress();
 }
 
-void SocketAddress::SetResolvedIP(uint32 ip) {
+void SocketAddress::SetResolvedIP(const IPAddress& ip) {
   ip_ = ip;
 }
 
@@ -115,18 +121,15 @@ void SocketAddress::SetPort(int port) {
   port_ = port;
 }
 
-uint32 SocketAddress::ip() const {
-  return ip_;
-}
-
-uint16 SocketAddress::port() const {
-  return port_;
+const std::string& SocketAddress::hostname() const {
+  static const std::string* empty = new std::string();
+  return hostname_ ? hostname_->name : *empty;
 }
 
 std::string SocketAddress::IPAsString() const {
-  if (!hostname_.empty())
-    return hostname_;
-  return IPToString(ip_);
+  if (hostname_)
+    return hostname_->name;
+  return ip_.ToString();
 }
 
 std::string SocketAddress::PortAsString() const {
@@ -137,35 +140,51 @@ std::string SocketAddress::PortAsString() const {
 
 std::string SocketAddress::ToString() const {
   std::ostringstream ost;
-  ost << IPAsString();
-  ost << ":";
-  ost << port();
+  ost << *this;
   return ost.str();
 }
 
 bool SocketAddress::FromString(const std::string& str) {
-  std::string::size_type pos = str.find(':');
-  if (std::string::npos == pos)
-    return false;
+  std::string::size_type pos;
+  std::string host;
+  if (!str.empty() && str[0] == '[') {
+    pos = str.find("]:");
+    if (std::string::npos == pos)
+      return false;
+    host = str.substr(1, pos - 1);
+    ++pos;
+  } else {
+    pos = str.find(':');
+    if (std::string::npos == pos)
+      return false;
+    host = str.substr(0, pos);
+  }
   SetPort(strtoul(str.substr(pos + 1).c_str(), NULL, 10));
-  SetIP(str.substr(0, pos));
+  SetIP(host);
   return true;
 }
 
 std::ostream& operator<<(std::ostream& os, const SocketAddress& addr) {
-  os << addr.IPAsString() << ":" << addr.port();
+  std::string host = addr.IPAsString();
+  // IPv6 addresses are bracketed, so that their colons aren't taken for the
+  // one that separates the port.
+  if (host.find(':') != std::string::npos) {
+    os << "[" << host << "]:" << addr.port();
+  } else {
+    os << host << ":" << addr.port();
+  }
   return os;
 }
 
 bool SocketAddress::IsAnyIP() const {
-  return (ip_ == 0);
+  return ip_.IsAny();
 }
 
 bool SocketAddress::IsLoopbackIP() const {
-  if (0 == ip_) {
-    return (0 == stricmp(hostname_.c_str(), "localhost"));
+  if (ip_.IsAny()) {
+    return (0 == stricmp(hostname().c_str(), "localhost"));
   } else {
-    return ((ip_ >> 24) == 127);
+    return ip_.IsLoopback();
   }
 }
 
@@ -174,14 +193,14 @@ bool SocketAddress::IsLocalIP() const {
     return true;
 
   std::vector<uint32> ips;
-  if (0 == ip_) {
-    if (!hostname_.empty()
-        && (0 == stricmp(hostname_.c_str(), GetHostname().c_str()))) {
+  if (ip_.IsAny()) {
+    if (hostname_
+        && (0 == stricmp(hostname_->name.c_str(), GetHostname().c_str()))) {
       return true;
     }
-  } else if (GetLocalIPs(ips)) {
+  } else if (!ip_.IsIPv6() && GetLocalIPs(ips)) {
     for (size_t i = 0; i < ips.size(); ++i) {
-      if (ips[i] == ip_) {
+      if (ips[i] == ip_.ipv4()) {
         return true;
       }
     }
@@ -190,87 +209,48 @@ bool SocketAddress::IsLocalIP() const {
 }
 
 bool SocketAddress::IsPrivateIP() const {
-  return ((ip_ >> 24) == 127) ||
-         ((ip_ >> 24) == 10) ||
-         ((ip_ >> 20) == ((172 << 4) | 1)) ||
-         ((ip_ >> 16) == ((192 << 8) | 168)) ||
-         ((ip_ >> 16) == ((169 << 8) | 254));
+  return ip_.IsPrivate();
 }
 
 bool SocketAddress::IsUnresolvedIP() const {
-  return IsAny() && !hostname_.empty();
+  return IsAny() && (hostname_ != NULL);
 }
 
 bool SocketAddress::ResolveIP(bool force, int* error) {
-  if (hostname_.empty()) {
+  if (!hostname_) {
     // nothing to resolve
   } else if (!force && !IsAny()) {
     // already resolved
   } else {
-    LOG_F(LS_VERBOSE) << "(" << hostname_ << ")";
+    const std::string& name = hostname_->name;
+    LOG_F(LS_VERBOSE) << "(" << name << ")";
     int errcode = 0;
-    if (hostent* pHost = SafeGetHostByName(hostname_.c_str(), &errcode)) {
+    if (hostent* pHost = SafeGetHostByName(name.c_str(), &errcode)) {
       ip_ = NetworkToHost32(*reinterpret_cast<uint32*>(pHost->h_addr_list[0]));
-      LOG_F(LS_VERBOSE) << "(" << hostname_ << ") resolved to: "
-                        << IPToString(ip_);
+      LOG_F(LS_VERBOSE) << "(" << name << ") resolved to: "
+                        << ip_.ToString();
       FreeHostEnt(pHost);
     } else {
-      LOG_F(LS_ERROR) << "(" << hostname_ << ") err: " << errcode;
+      LOG_F(LS_ERROR) << "(" << name << ") err: " << errcode;
     }
     if (error) {
       *error = errcode;
     }
   }
-  return (ip_ != 0);
-}
-
-bool SocketAddress::operator==(const SocketAddress& addr) const {
-  return EqualIPs(addr) && EqualPorts(addr);
-}
-
-bool SocketAddress::operator<(const SocketAddress& addr) const {
-  if (ip_ < addr.ip_)
-    return true;
-  else if (addr.ip_ < ip_)
-    return false;
-
-  // We only check hostnames if both IPs are zero.  This matches EqualIPs()
-  if (addr.ip_ == 0) {
-    if (hostname_ < addr.hostname_)
-      return true;
-    else if (addr.hostname_ < hostname_)
-      return false;
-  }
-
-  return port_ < addr.port_;
-}
-
-bool SocketAddress::EqualIPs(const SocketAddress& addr) const {
-  return (ip_ == addr.ip_) && ((ip_ != 0) || (hostname_ == addr.hostname_));
-}
-
-bool SocketAddress::EqualPorts(const SocketAddress& addr) const {
-  return (port_ == addr.port_);
-}
-
-size_t SocketAddress::Hash() const {
-  size_t h = 0;
-  h ^= ip_;
-  h ^= port_ | (port_ << 16);
-  return h;
+  return !ip_.IsAny();
 }
 
 size_t SocketAddress::Size_() const {
-  return sizeof(ip_) + sizeof(port_) + 2;
+  return sizeof(uint32) + sizeof(port_) + 2;
 }
 
 bool SocketAddress::Write_(char* buf, int len) const {
-  if (len < static_cast<int>(Size_()))
+  if (len < static_cast<int>(Size_()) || ip_.IsIPv6())
     return false;
   buf[0] = 0;
   buf[1] = AF_INET;
   SetBE16(buf + 2, port_);
-  SetBE32(buf + 4, ip_);
+  SetBE32(buf + 4, ip_.ipv4());
   return true;
 }
 
@@ -283,13 +263,14 @@ bool SocketAddress::Read_(const char* buf, int len) {
 }
 
 void SocketAddress::ToSockAddr(sockaddr_in* saddr) const {
+  ASSERT(!ip_.IsIPv6());
   memset(saddr, 0, sizeof(*saddr));
   saddr->sin_family = AF_INET;
   saddr->sin_port = HostToNetwork16(port_);
-  if (0 == ip_) {
+  if (ip_.IsAny()) {
     saddr->sin_addr.s_addr = INADDR_ANY;
   } else {
-    saddr->sin_addr.s_addr = HostToNetwork32(ip_);
+    saddr->sin_addr.s_addr = HostToNetwork32(ip_.ipv4());
   }
 }
 
@@ -301,23 +282,40 @@ bool SocketAddress::FromSockAddr(const sockaddr_in& saddr) {
   return true;
 }
 
+size_t SocketAddress::ToSockAddrStorage(sockaddr_storage* saddr) const {
+  if (!ip_.IsIPv6()) {
+    ToSockAddr(reinterpret_cast<sockaddr_in*>(saddr));
+    return sizeof(sockaddr_in);
+  }
+  sockaddr_in6* saddr6 = reinterpret_cast<sockaddr_in6*>(saddr);
+  memset(saddr6, 0, sizeof(*saddr6));
+  saddr6->sin6_family = AF_INET6;
+  saddr6->sin6_port = HostToNetwork16(port_);
+  memcpy(&saddr6->sin6_addr, ip_.ipv6(), IPAddress::kIPv6Size);
+  return sizeof(sockaddr_in6);
+}
+
+bool SocketAddress::FromSockAddrStorage(const sockaddr_storage& saddr) {
+  if (saddr.ss_family == AF_INET)
+    return FromSockAddr(reinterpret_cast<const sockaddr_in&>(saddr));
+  if (saddr.ss_family != AF_INET6)
+    return false;
+  const sockaddr_in6& saddr6 = reinterpret_cast<const sockaddr_in6&>(saddr);
+  SetIP(IPAddress::FromIPv6(
+      reinterpret_cast<const uint8*>(&saddr6.sin6_addr)));
+  SetPort(NetworkToHost16(saddr6.sin6_port));
+  return true;
+}
+
 std::string SocketAddress::IPToString(uint32 ip) {
-  std::ostringstream ost;
-  ost << ((ip >> 24) & 0xff);
-  ost << '.';
-  ost << ((ip >> 16) & 0xff);
-  ost << '.';
-  ost << ((ip >> 8) & 0xff);
-  ost << '.';
-  ost << ((ip >> 0) & 0xff);
-  return ost.str();
+  return IPAddress(ip).ToString();
 }
 
 bool SocketAddress::StringToIP(const std::string& hostname, uint32* ip) {
-  in_addr addr;
-  if (inet_aton(hostname.c_str(), &addr) == 0)
+  IPAddress addr;
+  if (!IPAddress::FromString(hostname, &addr) || addr.IsIPv6())
     return false;
-  *ip = NetworkToHost32(addr.s_addr);
+  *ip = addr.ipv4();
   return true;
 }
 
@@ -355,4 +353,29 @@ bool SocketAddress::GetLocalIPs(std::vector<uint32>& ips) {
   return false;
 }
 
+void SocketAddress::SetHostname(const std::string& hostname) {
+  ClearHostname();
+  if (!hostname.empty())
+    hostname_ = new Hostname(hostname);
+}
+
+void SocketAddress::ClearHostname() {
+  if (hostname_)
+    ReleaseHostname();
+}
+
+void SocketAddress::AddRefHostname() {
+  AtomicOps::Increment(&hostname_->ref_count);
+}
+
+void SocketAddress::ReleaseHostname() {
+  if (AtomicOps::Decrement(&hostname_->ref_count) == 0)
+    delete hostname_;
+  hostname_ = NULL;
+}
+
+int SocketAddress::CompareHostnames(const SocketAddress& addr) const {
+  return hostname().compare(addr.hostname());
+}
+
 }  // namespace talk_base
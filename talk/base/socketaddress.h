@@ -32,18 +32,23 @@
 #include <vector>
 #include <iosfwd>
 #include "talk/base/basictypes.h"
+#include "talk/base/ipaddress.h"
 #undef SetPort
 
 struct sockaddr_in;
+struct sockaddr_storage;
 
 namespace talk_base {
 
-// Records an IP address and port, which are 32 and 16 bit integers,
-// respectively, both in <b>host byte-order</b>.
+// Records an IP address and port.  The IP is an IPv4 or IPv6 IPAddress; IPv4
+// addresses and the port are integers in <b>host byte-order</b>.
+// An address that was given as a hostname keeps that name in a shared,
+// reference counted string; addresses taken from sockets have none, so
+// copying, comparing and hashing them never touches the heap.
 class SocketAddress {
  public:
   // Creates a nil address.
-  SocketAddress();
+  SocketAddress() : port_(0), hostname_(NULL) {}
 
   // Creates the address with the given host and port.  If use_dns is true,
   // the hostname will be immediately resolved to an IP (which may block for
@@ -54,9 +59,19 @@ class SocketAddress {
 
   // Creates the address with the given IP and port.
   SocketAddress(uint32 ip, int port);
+  SocketAddress(const IPAddress& ip, int port);
 
   // Creates a copy of the given address.
-  SocketAddress(const SocketAddress& addr);
+  SocketAddress(const SocketAddress& addr)
+      : ip_(addr.ip_), port_(addr.port_), hostname_(addr.hostname_) {
+    if (hostname_)
+      AddRefHostname();
+  }
+
+  ~SocketAddress() {
+    if (hostname_)
+      ReleaseHostname();
+  }
 
   // Resets to the nil address.
   void Clear();
@@ -71,7 +86,8 @@ class SocketAddress {
   SocketAddress& operator=(const SocketAddress& addr);
 
   // Changes the IP of this address to the given one, and clears the hostname.
-  void SetIP(uint32 ip);
+  void SetIP(uint32 ip) { SetIP(IPAddress(ip)); }
+  void SetIP(const IPAddress& ip);
 
   // Changes the hostname of this address to the given one.
   // Does not resolve the address; use Resolve to do so.
@@ -79,30 +95,40 @@ class SocketAddress {
 
   // Sets the IP address while retaining the hostname.  Useful for bypassing
   // DNS for a pre-resolved IP.
-  void SetResolvedIP(uint32 ip);
+  void SetResolvedIP(uint32 ip) { SetResolvedIP(IPAddress(ip)); }
+  void SetResolvedIP(const IPAddress& ip);
 
   // Changes the port of this address to the given one.
   void SetPort(int port);
 
   // Returns the hostname
-  const std::string& hostname() const { return hostname_; }
+  const std::string& hostname() const;
+
+  // Returns the IPv4 address, or 0 if the address is IPv6.
+  uint32 ip() const { return ip_.ipv4(); }
 
   // Returns the IP address.
-  uint32 ip() const;
+  const IPAddress& ipaddr() const { return ip_; }
+
+  // Returns AF_INET or AF_INET6.
+  int family() const { return ip_.family(); }
+
+  // Determines whether the IP address is an IPv6 one.
+  bool IsIPv6() const { return ip_.IsIPv6(); }
 
   // Returns the port part of this address.
-  uint16 port() const;
+  uint16 port() const { return port_; }
 
-  // Returns the IP address in dotted form.
+  // Returns the hostname, or the IP address in dotted (or IPv6) form.
   std::string IPAsString() const;
 
   // Returns the port as a string
   std::string PortAsString() const;
 
-  // Returns hostname:port
+  // Returns hostname:port, or [IPv6 address]:port
   std::string ToString() const;
 
-  // Parses hostname:port
+  // Parses hostname:port or [IPv6 address]:port
   bool FromString(const std::string& str);
 
   friend std::ostream& operator<<(std::ostream& os, const SocketAddress& addr);
@@ -113,7 +139,7 @@ class SocketAddress {
   inline bool IsAny() const { return IsAnyIP(); }  // deprecated
 
   // Determines whether the IP address refers to a loopback address, i.e. within
-  // the range 127.0.0.0/8.
+  // the range 127.0.0.0/8, or ::1.
   bool IsLoopbackIP() const;
 
   // Determines wither the IP address refers to any adapter on the local
@@ -121,7 +147,8 @@ class SocketAddress {
   bool IsLocalIP() const;
 
   // Determines whether the IP address is in one of the private ranges:
-  // 127.0.0.0/8 10.0.0.0/8 192.168.0.0/16 172.16.0.0/12.
+  // 127.0.0.0/8 10.0.0.0/8 192.168.0.0/16 172.16.0.0/12 169.254.0.0/16, or
+  // is an IPv6 loopback, link-local or unique local address.
   bool IsPrivateIP() const;
 
   // Determines whether the hostname has been resolved to an IP.
@@ -134,38 +161,69 @@ class SocketAddress {
   bool ResolveIP(bool force = false, int* error = NULL);
 
   // Determines whether this address is identical to the given one.
-  bool operator ==(const SocketAddress& addr) const;
+  bool operator ==(const SocketAddress& addr) const {
+    return EqualPorts(addr) && EqualIPs(addr);
+  }
   inline bool operator !=(const SocketAddress& addr) const {
     return !this->operator ==(addr);
   }
 
-  // Compares based on IP and then port.
-  bool operator <(const SocketAddress& addr) const;
+  // Compares based on IP and then port.  Hostnames are only compared when
+  // both IPs are unset, to match EqualIPs().
+  bool operator <(const SocketAddress& addr) const {
+    if (ip_ != addr.ip_)
+      return ip_ < addr.ip_;
+    if (ip_.IsAny() && hostname_ != addr.hostname_) {
+      int result = CompareHostnames(addr);
+      if (result != 0)
+        return result < 0;
+    }
+    return port_ < addr.port_;
+  }
 
   // Determines whether this address has the same IP as the one given.
-  bool EqualIPs(const SocketAddress& addr) const;
+  bool EqualIPs(const SocketAddress& addr) const {
+    return (ip_ == addr.ip_) &&
+        (!ip_.IsAny() || (hostname_ == addr.hostname_) ||
+         (CompareHostnames(addr) == 0));
+  }
 
   // Determines whether this address has the same port as the one given.
-  bool EqualPorts(const SocketAddress& addr) const;
+  bool EqualPorts(const SocketAddress& addr) const {
+    return (port_ == addr.port_);
+  }
 
-  // Hashes this address into a small number.
-  size_t Hash() const;
+  // Hashes this address into a small number.  The IP and port are mixed so
+  // that addresses differing only in their low bits still spread out.
+  size_t Hash() const {
+    uint32 h = (ip_.Hash() ^ (static_cast<uint32>(port_) << 16 | port_)) *
+        0x9E3779B1U;
+    return h ^ (h >> 16);
+  }
 
   // Returns the size of this address when written.
   size_t Size_() const;
 
-  // Writes this address into the given buffer, according to RFC 3489.
+  // Writes this address into the given buffer, according to RFC 3489.  Only
+  // IPv4 addresses can be written.
   bool Write_(char* buf, int len) const;
 
   // Reads this address from the given buffer, according to RFC 3489.
   bool Read_(const char* buf, int len);
 
-  // Write this address to a sockaddr_in.
+  // Write this address to a sockaddr_in.  Only valid for IPv4 addresses.
   void ToSockAddr(sockaddr_in* saddr) const;
 
   // Read this address from a sockaddr_in.
   bool FromSockAddr(const sockaddr_in& saddr);
 
+  // Writes this address to a sockaddr_in or sockaddr_in6, as its family
+  // requires, and returns the size of the one written.
+  size_t ToSockAddrStorage(sockaddr_storage* saddr) const;
+
+  // Reads this address from a sockaddr_in or sockaddr_in6.
+  bool FromSockAddrStorage(const sockaddr_storage& saddr);
+
   // Converts the IP address given in compact form into dotted form.
   static std::string IPToString(uint32 ip);
 
@@ -181,9 +239,17 @@ class SocketAddress {
   static bool GetLocalIPs(std::vector<uint32>& ips);
 
  private:
-  std::string hostname_;
-  uint32 ip_;
+  struct Hostname;
+
+  void SetHostname(const std::string& hostname);
+  void ClearHostname();
+  void AddRefHostname();
+  void ReleaseHostname();
+  int CompareHostnames(const SocketAddress& addr) const;
+
+  IPAddress ip_;
   uint16 port_;
+  Hostname* hostname_;  // NULL when the address has no hostname.
 };
 
 }  // namespace talk_base
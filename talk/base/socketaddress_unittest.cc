@@ -26,7 +26,7 @@
  */
 
 #ifdef POSIX
-#include <netinet/in.h>  // for sockaddr_in
+#include <netinet/in.h>  // for sockaddr_in and sockaddr_in6
 #endif
 
 #include "talk/base/gunit.h"
@@ -206,4 +206,115 @@ TEST(SocketAddressTest, TestBadResolve) {
   EXPECT_TRUE(addr.IsUnresolvedIP());
 }
 
+TEST(SocketAddressTest, TestIPv6StringPortCtor) {
+  SocketAddress addr("::1", 5678);
+  EXPECT_FALSE(addr.IsUnresolvedIP());
+  EXPECT_TRUE(addr.IsIPv6());
+  EXPECT_EQ(AF_INET6, addr.family());
+  EXPECT_TRUE(addr.IsLoopbackIP());
+  EXPECT_EQ(0U, addr.ip());
+  EXPECT_EQ(5678, addr.port());
+  EXPECT_EQ("::1", addr.hostname());
+  EXPECT_EQ("[::1]:5678", addr.ToString());
+}
+
+TEST(SocketAddressTest, TestFromIPv6String) {
+  SocketAddress addr;
+  EXPECT_TRUE(addr.FromString("[2001:db8::1]:5678"));
+  EXPECT_TRUE(addr.IsIPv6());
+  EXPECT_FALSE(addr.IsPrivateIP());
+  EXPECT_EQ(5678, addr.port());
+  EXPECT_EQ("2001:db8::1", addr.ipaddr().ToString());
+  EXPECT_EQ("[2001:db8::1]:5678", addr.ToString());
+  EXPECT_FALSE(addr.FromString("[2001:db8::1]"));
+}
+
+TEST(SocketAddressTest, TestToFromSockAddrStorage) {
+  IPAddress ip;
+  EXPECT_TRUE(IPAddress::FromString("::1", &ip));
+  SocketAddress from(ip, 5678), addr;
+  sockaddr_storage addr_storage;
+  EXPECT_EQ(sizeof(sockaddr_in6), from.ToSockAddrStorage(&addr_storage));
+  EXPECT_TRUE(addr.FromSockAddrStorage(addr_storage));
+  EXPECT_EQ(from, addr);
+  EXPECT_EQ("", addr.hostname());
+  EXPECT_EQ("[::1]:5678", addr.ToString());
+
+  from = SocketAddress(0x01020304, 5678);
+  EXPECT_EQ(sizeof(sockaddr_in), from.ToSockAddrStorage(&addr_storage));
+  EXPECT_TRUE(addr.FromSockAddrStorage(addr_storage));
+  EXPECT_EQ(from, addr);
+  EXPECT_FALSE(addr.IsIPv6());
+}
+
+TEST(SocketAddressTest, TestIPv6Compare) {
+  IPAddress ip;
+  EXPECT_TRUE(IPAddress::FromString("::1", &ip));
+  SocketAddress addr1(ip, 5678);
+  SocketAddress addr2("::1", 5678);
+  SocketAddress addr3(1, 5678);
+  EXPECT_EQ(addr1, addr2);
+  EXPECT_EQ(addr1.Hash(), addr2.Hash());
+  EXPECT_NE(addr1, addr3);
+  EXPECT_TRUE(addr3 < addr1);
+  EXPECT_FALSE(addr1 < addr2);
+}
+
+TEST(SocketAddressTest, TestCopiesShareHostname) {
+  SocketAddress addr("a.b.com", 5678);
+  SocketAddress copy(addr);
+  SocketAddress assigned;
+  assigned = copy;
+  EXPECT_EQ(&addr.hostname(), &copy.hostname());
+  EXPECT_EQ(&addr.hostname(), &assigned.hostname());
+  addr.SetIP("c.d.com");
+  assigned = assigned;
+  EXPECT_EQ("c.d.com", addr.hostname());
+  EXPECT_EQ("a.b.com", copy.hostname());
+  EXPECT_EQ("a.b.com", assigned.hostname());
+  copy.Clear();
+  EXPECT_TRUE(copy.IsNil());
+  EXPECT_EQ("a.b.com:5678", assigned.ToString());
+}
+
+TEST(SocketAddressTest, TestCompare) {
+  SocketAddress addr1("a.b.com", 5678);
+  SocketAddress addr2("a.b.com", 5678);
+  SocketAddress addr3("a.b.com", 5679);
+  SocketAddress addr4("c.d.com", 1);
+  EXPECT_EQ(addr1, addr2);
+  EXPECT_EQ(addr1.Hash(), addr2.Hash());
+  EXPECT_FALSE(addr1 < addr2);
+  EXPECT_FALSE(addr2 < addr1);
+  EXPECT_NE(addr1, addr3);
+  EXPECT_TRUE(addr1 < addr3);
+  EXPECT_NE(addr1, addr4);
+  EXPECT_TRUE(addr3 < addr4);
+
+  // Once resolved, the hostname no longer matters.
+  addr1.SetResolvedIP(0x01020304);
+  EXPECT_EQ(SocketAddress(0x01020304, 5678), addr1);
+  EXPECT_TRUE(addr4 < addr1);
+  EXPECT_TRUE(SocketAddress(0x01020304, 5677) < addr1);
+}
+
+TEST(SocketAddressTest, TestHashSpreadsNearbyAddresses) {
+  // Addresses on one subnet, and ports in one range, should not collide
+  // once reduced to a small table size.
+  const size_t kBuckets = 256;
+  int used[kBuckets] = { 0 };
+  for (uint32 i = 0; i < 16; ++i) {
+    for (int port = 5000; port < 5016; ++port) {
+      ++used[SocketAddress(0x0A000000 + i, port).Hash() % kBuckets];
+    }
+  }
+  size_t empty = 0;
+  for (size_t i = 0; i < kBuckets; ++i) {
+    if (used[i] == 0)
+      ++empty;
+  }
+  // A perfect spread leaves none empty, a random one about 37%.
+  EXPECT_GT(kBuckets / 2, empty);
+}
+
 }  // namespace talk_base
@@ -44,6 +44,15 @@ public:
   // Returns a new socket for nonblocking communication.  The type can be
   // SOCK_DGRAM and SOCK_STREAM.
   virtual AsyncSocket* CreateAsyncSocket(int type) = 0;
+
+  // As above, but for the given address family, AF_INET or AF_INET6.
+  // Factories that only support IPv4 need not override these.
+  virtual Socket* CreateSocket(int family, int type) {
+    return (family == AF_INET) ? CreateSocket(type) : NULL;
+  }
+  virtual AsyncSocket* CreateAsyncSocket(int family, int type) {
+    return (family == AF_INET) ? CreateAsyncSocket(type) : NULL;
+  }
 };
 
 } // namespace talk_base
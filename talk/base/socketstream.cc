@@ -109,6 +109,22 @@ StreamResult SocketStream::Write(const void* data, size_t data_len,
   return SR_SUCCESS;
 }
 
+StreamResult SocketStream::WriteV(const IoVec* vecs, size_t num_vecs,
+                                  size_t* written, int* error) {
+  ASSERT(socket_ != NULL);
+  int result = socket_->SendV(vecs, num_vecs);
+  if (result < 0) {
+    if (socket_->IsBlocking())
+      return SR_BLOCK;
+    if (error)
+      *error = socket_->GetError();
+    return SR_ERROR;
+  }
+  if (written)
+    *written = result;
+  return SR_SUCCESS;
+}
+
 void SocketStream::Close() {
   ASSERT(socket_ != NULL);
   socket_->Close();
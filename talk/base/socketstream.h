@@ -54,6 +54,9 @@ class SocketStream : public StreamInterface, public sigslot::has_slots<> {
   virtual StreamResult Write(const void* data, size_t data_len,
                              size_t* written, int* error);
 
+  virtual StreamResult WriteV(const IoVec* vecs, size_t num_vecs,
+                              size_t* written, int* error);
+
   virtual void Close();
 
  private:
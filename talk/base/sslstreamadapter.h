@@ -60,6 +60,17 @@ class SSLStreamAdapter : public StreamAdapterInterface {
   void set_ignore_bad_cert(bool ignore) { ignore_bad_cert_ = ignore; }
   bool ignore_bad_cert() const { return ignore_bad_cert_; }
 
+  // Data is encrypted and decrypted in Read and Write, so the vectored
+  // versions must go through them rather than to the wrapped stream.
+  virtual StreamResult ReadV(const IoVec* vecs, size_t num_vecs,
+                             size_t* read, int* error) {
+    return StreamInterface::ReadV(vecs, num_vecs, read, error);
+  }
+  virtual StreamResult WriteV(const IoVec* vecs, size_t num_vecs,
+                              size_t* written, int* error) {
+    return StreamInterface::WriteV(vecs, num_vecs, written, error);
+  }
+
   // Specify our SSL identity: key and certificate. Mostly this is
   // only used in the peer-to-peer mode (unless we actually want to
   // provide a client certificate to a server).
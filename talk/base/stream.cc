@@ -63,6 +63,49 @@ struct PostEventData : public MessageData {
   PostEventData(int ev, int er) : events(ev), error(er) { }
 };
 
+StreamResult StreamInterface::ReadV(const IoVec* vecs, size_t num_vecs,
+                                    size_t* read, int* error) {
+  StreamResult result = SR_SUCCESS;
+  size_t total_read = 0, current_read;
+  for (size_t i = 0; i < num_vecs; ++i) {
+    if (vecs[i].len == 0)
+      continue;
+    result = Read(vecs[i].data, vecs[i].len, &current_read, error);
+    if (result != SR_SUCCESS)
+      break;
+    total_read += current_read;
+    if (current_read < vecs[i].len)
+      break;
+  }
+  // Report what was read; any error will come back on the next call.
+  if (total_read > 0)
+    result = SR_SUCCESS;
+  if (result == SR_SUCCESS && read)
+    *read = total_read;
+  return result;
+}
+
+StreamResult StreamInterface::WriteV(const IoVec* vecs, size_t num_vecs,
+                                     size_t* written, int* error) {
+  StreamResult result = SR_SUCCESS;
+  size_t total_written = 0, current_written;
+  for (size_t i = 0; i < num_vecs; ++i) {
+    if (vecs[i].len == 0)
+      continue;
+    result = Write(vecs[i].data, vecs[i].len, &current_written, error);
+    if (result != SR_SUCCESS)
+      break;
+    total_written += current_written;
+    if (current_written < vecs[i].len)
+      break;
+  }
+  if (total_written > 0)
+    result = SR_SUCCESS;
+  if (result == SR_SUCCESS && written)
+    *written = total_written;
+  return result;
+}
+
 StreamResult StreamInterface::WriteAll(const void* data, size_t data_len,
                                        size_t* written, int* error) {
   StreamResult result = SR_SUCCESS;
@@ -223,6 +266,42 @@ StreamResult StreamTap::Write(const void* data, size_t data_len,
   return res;
 }
 
+StreamResult StreamTap::ReadV(const IoVec* vecs, size_t num_vecs,
+                              size_t* read, int* error) {
+  size_t backup_read;
+  if (!read) {
+    read = &backup_read;
+  }
+  StreamResult res = StreamAdapterInterface::ReadV(vecs, num_vecs,
+                                                   read, error);
+  if (res == SR_SUCCESS) {
+    TapVecs(vecs, *read);
+  }
+  return res;
+}
+
+StreamResult StreamTap::WriteV(const IoVec* vecs, size_t num_vecs,
+                               size_t* written, int* error) {
+  size_t backup_written;
+  if (!written) {
+    written = &backup_written;
+  }
+  StreamResult res = StreamAdapterInterface::WriteV(vecs, num_vecs,
+                                                    written, error);
+  if (res == SR_SUCCESS) {
+    TapVecs(vecs, *written);
+  }
+  return res;
+}
+
+void StreamTap::TapVecs(const IoVec* vecs, size_t len) {
+  for (size_t i = 0; len > 0 && tap_result_ == SR_SUCCESS; ++i) {
+    size_t count = _min(len, vecs[i].len);
+    tap_result_ = tap_->WriteAll(vecs[i].data, count, NULL, &tap_error_);
+    len -= count;
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // StreamSegment
 ///////////////////////////////////////////////////////////////////////////////
@@ -598,6 +677,16 @@ StreamResult MemoryStreamBase::Read(void* buffer, size_t bytes,
   return SR_SUCCESS;
 }
 
+const void* MemoryStreamBase::GetReadData(size_t* data_len) {
+  *data_len = data_length_ - _min(seek_position_, data_length_);
+  return &buffer_[seek_position_];
+}
+
+void MemoryStreamBase::ConsumeReadData(size_t used) {
+  ASSERT(seek_position_ + used <= data_length_);
+  seek_position_ += used;
+}
+
 StreamResult MemoryStreamBase::Write(const void* buffer, size_t bytes,
                                      size_t* bytes_written, int* error) {
   size_t available = buffer_length_ - seek_position_;
@@ -738,9 +827,34 @@ void ExternalMemoryStream::SetData(void* data, size_t length) {
 // FifoBuffer
 ///////////////////////////////////////////////////////////////////////////////
 
+// Like CritScope, but does nothing if there is no lock to take.
+class FifoScope {
+ public:
+  explicit FifoScope(CriticalSection* crit) : crit_(crit) {
+    if (crit_) {
+      crit_->Enter();
+    }
+  }
+  ~FifoScope() {
+    if (crit_) {
+      crit_->Leave();
+    }
+  }
+ private:
+  CriticalSection* crit_;
+};
+
 FifoBuffer::FifoBuffer(size_t size)
-    : state_(SS_OPEN), buffer_(new char[size]), buffer_length_(size),
-      data_length_(0), read_position_(0), owner_(Thread::Current()) {
+    : locked_(true), state_(SS_OPEN), buffer_(new char[size]),
+      buffer_length_(size), read_index_(0), write_index_(0),
+      owner_(Thread::Current()) {
+  // all events are done on the owner_ thread
+}
+
+FifoBuffer::FifoBuffer(size_t size, ThreadMode mode)
+    : locked_(mode == LOCKED), state_(SS_OPEN), buffer_(new char[size]),
+      buffer_length_(size), read_index_(0), write_index_(0),
+      owner_(Thread::Current()) {
   // all events are done on the owner_ thread
 }
 
@@ -748,25 +862,34 @@ FifoBuffer::~FifoBuffer() {
 }
 
 bool FifoBuffer::GetBuffered(size_t* size) const {
-  CritScope cs(&crit_);
-  *size = data_length_;
+  FifoScope cs(locked_ ? &crit_ : NULL);
+  const size_t read_index = LoadIndex(&read_index_);
+  *size = Distance(read_index, LoadIndex(&write_index_));
   return true;
 }
 
 bool FifoBuffer::SetCapacity(size_t size) {
+  if (!locked_) {
+    ASSERT(false);
+    return false;
+  }
+
   CritScope cs(&crit_);
-  if (data_length_ > size) {
+  const size_t data_length = Distance(read_index_, write_index_);
+  if (data_length > size) {
     return false;
   }
 
   if (size != buffer_length_) {
     char* buffer = new char[size];
-    const size_t copy = data_length_;
-    const size_t tail_copy = _min(copy, buffer_length_ - read_position_);
-    memcpy(buffer, &buffer_[read_position_], tail_copy);
+    const size_t read_position = Position(read_index_);
+    const size_t copy = data_length;
+    const size_t tail_copy = _min(copy, buffer_length_ - read_position);
+    memcpy(buffer, &buffer_[read_position], tail_copy);
     memcpy(buffer + tail_copy, &buffer_[0], copy - tail_copy);
     buffer_.reset(buffer);
-    read_position_ = 0;
+    read_index_ = 0;
+    write_index_ = data_length;
     buffer_length_ = size;
   }
   return true;
@@ -774,38 +897,60 @@ bool FifoBuffer::SetCapacity(size_t size) {
 
 StreamResult FifoBuffer::ReadOffset(void* buffer, size_t bytes,
                                     size_t offset, size_t* bytes_read) {
-  CritScope cs(&crit_);
+  FifoScope cs(locked_ ? &crit_ : NULL);
   return ReadOffsetLocked(buffer, bytes, offset, bytes_read);
 }
 
 StreamResult FifoBuffer::WriteOffset(const void* buffer, size_t bytes,
                                      size_t offset, size_t* bytes_written) {
-  CritScope cs(&crit_);
+  FifoScope cs(locked_ ? &crit_ : NULL);
   return WriteOffsetLocked(buffer, bytes, offset, bytes_written);
 }
 
+void FifoBuffer::GetReadSpans(const void** data1, size_t* len1,
+                              const void** data2, size_t* len2) {
+  FifoScope cs(locked_ ? &crit_ : NULL);
+  const size_t data_length = Distance(read_index_,
+                                      LoadIndex(&write_index_));
+  const size_t read_position = Position(read_index_);
+  *data1 = &buffer_[read_position];
+  *len1 = _min(data_length, buffer_length_ - read_position);
+  *data2 = &buffer_[0];
+  *len2 = data_length - *len1;
+}
+
+void FifoBuffer::GetWriteSpans(void** buf1, size_t* len1,
+                               void** buf2, size_t* len2) {
+  FifoScope cs(locked_ ? &crit_ : NULL);
+  const size_t free_length = buffer_length_ -
+      Distance(LoadIndex(&read_index_), write_index_);
+  const size_t write_position = Position(write_index_);
+  *buf1 = &buffer_[write_position];
+  *len1 = _min(free_length, buffer_length_ - write_position);
+  *buf2 = &buffer_[0];
+  *len2 = free_length - *len1;
+}
+
 StreamState FifoBuffer::GetState() const {
-  return state_;
+  return LoadState();
 }
 
 StreamResult FifoBuffer::Read(void* buffer, size_t bytes,
                               size_t* bytes_read, int* error) {
-  CritScope cs(&crit_);
-  const bool was_writable = data_length_ < buffer_length_;
+  FifoScope cs(locked_ ? &crit_ : NULL);
   size_t copy = 0;
   StreamResult result = ReadOffsetLocked(buffer, bytes, 0, &copy);
 
   if (result == SR_SUCCESS) {
     // If read was successful then adjust the read position and number of
     // bytes buffered.
-    read_position_ = (read_position_ + copy) % buffer_length_;
-    data_length_ -= copy;
+    const bool was_full = AdvanceReadIndex(copy);
     if (bytes_read) {
       *bytes_read = copy;
     }
 
     // if we were full before, and now we're not, post an event
-    if (!was_writable && copy > 0) {
+    if (was_full && copy > 0) {
       PostEvent(owner_, SE_WRITE, 0);
     }
   }
@@ -814,82 +959,147 @@ StreamResult FifoBuffer::Read(void* buffer, size_t bytes,
 
 StreamResult FifoBuffer::Write(const void* buffer, size_t bytes,
                                size_t* bytes_written, int* error) {
-  CritScope cs(&crit_);
+  FifoScope cs(locked_ ? &crit_ : NULL);
 
-  const bool was_readable = (data_length_ > 0);
   size_t copy = 0;
   StreamResult result = WriteOffsetLocked(buffer, bytes, 0, &copy);
 
   if (result == SR_SUCCESS) {
     // If write was successful then adjust the number of readable bytes.
-    data_length_ += copy;
+    const bool was_empty = AdvanceWriteIndex(copy);
     if (bytes_written) {
       *bytes_written = copy;
     }
 
     // if we didn't have any data to read before, and now we do, post an event
-    if (!was_readable && copy > 0) {
+    if (was_empty && copy > 0) {
       PostEvent(owner_, SE_READ, 0);
     }
   }
   return result;
 }
 
+StreamResult FifoBuffer::ReadV(const IoVec* vecs, size_t num_vecs,
+                               size_t* bytes_read, int* error) {
+  FifoScope cs(locked_ ? &crit_ : NULL);
+  size_t total = 0;
+  StreamResult result = SR_SUCCESS;
+  for (size_t i = 0; i < num_vecs; ++i) {
+    if (vecs[i].len == 0)
+      continue;
+    size_t copy = 0;
+    result = ReadOffsetLocked(vecs[i].data, vecs[i].len, total, &copy);
+    if (result != SR_SUCCESS)
+      break;
+    total += copy;
+    if (copy < vecs[i].len)
+      break;
+  }
+  if (total == 0 && result != SR_SUCCESS) {
+    return result;
+  }
+
+  // Move past everything at once, so there is at most one event.
+  const bool was_full = AdvanceReadIndex(total);
+  if (bytes_read) {
+    *bytes_read = total;
+  }
+  if (was_full && total > 0) {
+    PostEvent(owner_, SE_WRITE, 0);
+  }
+  return SR_SUCCESS;
+}
+
+StreamResult FifoBuffer::WriteV(const IoVec* vecs, size_t num_vecs,
+                                size_t* bytes_written, int* error) {
+  FifoScope cs(locked_ ? &crit_ : NULL);
+  size_t total = 0;
+  StreamResult result = SR_SUCCESS;
+  for (size_t i = 0; i < num_vecs; ++i) {
+    if (vecs[i].len == 0)
+      continue;
+    size_t copy = 0;
+    result = WriteOffsetLocked(vecs[i].data, vecs[i].len, total, &copy);
+    if (result != SR_SUCCESS)
+      break;
+    total += copy;
+    if (copy < vecs[i].len)
+      break;
+  }
+  if (total == 0 && result != SR_SUCCESS) {
+    return result;
+  }
+
+  const bool was_empty = AdvanceWriteIndex(total);
+  if (bytes_written) {
+    *bytes_written = total;
+  }
+  if (was_empty && total > 0) {
+    PostEvent(owner_, SE_READ, 0);
+  }
+  return SR_SUCCESS;
+}
+
 void FifoBuffer::Close() {
-  CritScope cs(&crit_);
-  state_ = SS_CLOSED;
+  FifoScope cs(locked_ ? &crit_ : NULL);
+  if (locked_) {
+    state_ = SS_CLOSED;
+  } else {
+    AtomicOps::ReleaseStore(&state_, SS_CLOSED);
+  }
 }
 
 const void* FifoBuffer::GetReadData(size_t* size) {
-  CritScope cs(&crit_);
-  *size = (read_position_ + data_length_ <= buffer_length_) ?
-      data_length_ : buffer_length_ - read_position_;
-  return &buffer_[read_position_];
+  FifoScope cs(locked_ ? &crit_ : NULL);
+  const size_t data_length = Distance(read_index_,
+                                      LoadIndex(&write_index_));
+  const size_t read_position = Position(read_index_);
+  *size = _min(data_length, buffer_length_ - read_position);
+  return &buffer_[read_position];
 }
 
 void FifoBuffer::ConsumeReadData(size_t size) {
-  CritScope cs(&crit_);
-  ASSERT(size <= data_length_);
-  const bool was_writable = data_length_ < buffer_length_;
-  read_position_ = (read_position_ + size) % buffer_length_;
-  data_length_ -= size;
-  if (!was_writable && size > 0) {
+  FifoScope cs(locked_ ? &crit_ : NULL);
+  ASSERT(size <= Distance(read_index_, LoadIndex(&write_index_)));
+  if (AdvanceReadIndex(size) && size > 0) {
     PostEvent(owner_, SE_WRITE, 0);
   }
 }
 
 void* FifoBuffer::GetWriteBuffer(size_t* size) {
-  CritScope cs(&crit_);
-  if (state_ == SS_CLOSED) {
+  FifoScope cs(locked_ ? &crit_ : NULL);
+  if (LoadState() == SS_CLOSED) {
     return NULL;
   }
 
   // if empty, reset the write position to the beginning, so we can get
-  // the biggest possible block
-  if (data_length_ == 0) {
-    read_position_ = 0;
+  // the biggest possible block.  Only the reader may move the read index
+  // without a lock, so this is skipped in SINGLE_PRODUCER_CONSUMER mode.
+  if (locked_ && read_index_ == write_index_) {
+    read_index_ = 0;
+    write_index_ = 0;
   }
 
-  const size_t write_position = (read_position_ + data_length_)
-      % buffer_length_;
-  *size = (write_position >= read_position_) ?
-      buffer_length_ - write_position : read_position_ - write_position;
+  const size_t free_length = buffer_length_ -
+      Distance(LoadIndex(&read_index_), write_index_);
+  const size_t write_position = Position(write_index_);
+  *size = _min(free_length, buffer_length_ - write_position);
   return &buffer_[write_position];
 }
 
 void FifoBuffer::ConsumeWriteBuffer(size_t size) {
-  CritScope cs(&crit_);
-  ASSERT(size <= buffer_length_ - data_length_);
-  const bool was_readable = (data_length_ > 0);
-  data_length_ += size;
-  if (!was_readable && size > 0) {
+  FifoScope cs(locked_ ? &crit_ : NULL);
+  ASSERT(size <= buffer_length_ -
+         Distance(LoadIndex(&read_index_), write_index_));
+  if (AdvanceWriteIndex(size) && size > 0) {
     PostEvent(owner_, SE_READ, 0);
   }
 }
 
 bool FifoBuffer::GetWriteRemaining(size_t* size) const {
-  CritScope cs(&crit_);
-  *size = buffer_length_ - data_length_;
+  FifoScope cs(locked_ ? &crit_ : NULL);
+  const size_t read_index = LoadIndex(&read_index_);
+  *size = buffer_length_ - Distance(read_index, LoadIndex(&write_index_));
   return true;
 }
 
@@ -897,12 +1107,22 @@ StreamResult FifoBuffer::ReadOffsetLocked(void* buffer,
                                           size_t bytes,
                                           size_t offset,
                                           size_t* bytes_read) {
-  if (offset >= data_length_) {
-    return (state_ != SS_CLOSED) ? SR_BLOCK : SR_EOS;
+  size_t data_length = Distance(read_index_, LoadIndex(&write_index_));
+  if (offset >= data_length) {
+    if (LoadState() != SS_CLOSED) {
+      return SR_BLOCK;
+    }
+    // The writer may have written its last bytes and closed since we loaded
+    // the write index.  Seeing the close means seeing those writes too, so
+    // look again before reporting the end of the stream.
+    data_length = Distance(read_index_, LoadIndex(&write_index_));
+    if (offset >= data_length) {
+      return SR_EOS;
+    }
   }
 
-  const size_t available = data_length_ - offset;
-  const size_t read_position = (read_position_ + offset) % buffer_length_;
+  const size_t available = data_length - offset;
+  const size_t read_position = Position(Wrap(read_index_ + offset));
   const size_t copy = _min(bytes, available);
   const size_t tail_copy = _min(copy, buffer_length_ - read_position);
   char* const p = static_cast<char*>(buffer);
@@ -919,17 +1139,18 @@ StreamResult FifoBuffer::WriteOffsetLocked(const void* buffer,
                                            size_t bytes,
                                            size_t offset,
                                            size_t* bytes_written) {
-  if (state_ == SS_CLOSED) {
+  if (LoadState() == SS_CLOSED) {
     return SR_EOS;
   }
 
-  if (data_length_ + offset >= buffer_length_) {
+  const size_t data_length = Distance(LoadIndex(&read_index_),
+                                      write_index_);
+  if (data_length + offset >= buffer_length_) {
     return SR_BLOCK;
   }
 
-  const size_t available = buffer_length_ - data_length_ - offset;
-  const size_t write_position = (read_position_ + data_length_ + offset)
-      % buffer_length_;
+  const size_t available = buffer_length_ - data_length - offset;
+  const size_t write_position = Position(Wrap(write_index_ + offset));
   const size_t copy = _min(bytes, available);
   const size_t tail_copy = _min(copy, buffer_length_ - write_position);
   const char* const p = static_cast<const char*>(buffer);
@@ -942,6 +1163,40 @@ StreamResult FifoBuffer::WriteOffsetLocked(const void* buffer,
   return SR_SUCCESS;
 }
 
+size_t FifoBuffer::LoadIndex(const volatile size_t* index) const {
+  return locked_ ? *index : AtomicOps::AcquireLoad(index);
+}
+
+StreamState FifoBuffer::LoadState() const {
+  return locked_ ? state_ : AtomicOps::AcquireLoad(&state_);
+}
+
+bool FifoBuffer::AdvanceReadIndex(size_t count) {
+  const size_t read_index = read_index_;
+  if (locked_) {
+    read_index_ = Wrap(read_index + count);
+  } else {
+    // Publish the new index before looking at the writer's, so that either
+    // the writer sees the space or we see that it had filled the buffer.
+    AtomicOps::ReleaseStore(&read_index_, Wrap(read_index + count));
+    AtomicOps::Barrier();
+  }
+  return Distance(read_index, LoadIndex(&write_index_)) >= buffer_length_;
+}
+
+bool FifoBuffer::AdvanceWriteIndex(size_t count) {
+  const size_t write_index = write_index_;
+  if (locked_) {
+    write_index_ = Wrap(write_index + count);
+  } else {
+    // As above: either the reader sees the data or we see that it had
+    // emptied the buffer.
+    AtomicOps::ReleaseStore(&write_index_, Wrap(write_index + count));
+    AtomicOps::Barrier();
+  }
+  return LoadIndex(&read_index_) == write_index;
+}
+
 
 
 ///////////////////////////////////////////////////////////////////////////////
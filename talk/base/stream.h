@@ -30,6 +30,7 @@
 
 #include "talk/base/basictypes.h"
 #include "talk/base/criticalsection.h"
+#include "talk/base/iovec.h"
 #include "talk/base/logging.h"
 #include "talk/base/messagehandler.h"
 #include "talk/base/scoped_ptr.h"
@@ -125,6 +126,17 @@ class StreamInterface : public MessageHandler {
   // latter operation but not the former.
   //
 
+  // ReadV and WriteV are like Read and Write, but fill or send several
+  // buffers in order with one call.  'read' and 'written' are the totals over
+  // all of them; a short count means the buffers after it were not touched.
+  // By default they call Read or Write once per buffer, and stop at the first
+  // one that comes up short.  Streams that can move several buffers at once,
+  // or that would otherwise make a system call per buffer, override them.
+  virtual StreamResult ReadV(const IoVec* vecs, size_t num_vecs,
+                             size_t* read, int* error);
+  virtual StreamResult WriteV(const IoVec* vecs, size_t num_vecs,
+                              size_t* written, int* error);
+
   // The following four methods are used to avoid coping data multiple times.
 
   // GetReadData returns a pointer to a buffer which is owned by the stream.
@@ -262,6 +274,17 @@ class StreamAdapterInterface : public StreamInterface,
   }
 
   // Optional Stream Interface
+  // Adapters which change the data in Read or Write must override these too,
+  // or the data will bypass them.  Usually forwarding to the
+  // StreamInterface versions, which call Read and Write, is enough.
+  virtual StreamResult ReadV(const IoVec* vecs, size_t num_vecs,
+                             size_t* read, int* error) {
+    return stream_->ReadV(vecs, num_vecs, read, error);
+  }
+  virtual StreamResult WriteV(const IoVec* vecs, size_t num_vecs,
+                              size_t* written, int* error) {
+    return stream_->WriteV(vecs, num_vecs, written, error);
+  }
   /*  Note: Many stream adapters were implemented prior to this Read/Write
       interface.  Therefore, a simple pass through of data in those cases may
       be broken.  At a later time, we should do a once-over pass of all
@@ -345,8 +368,15 @@ class StreamTap : public StreamAdapterInterface {
                             size_t* read, int* error);
   virtual StreamResult Write(const void* data, size_t data_len,
                              size_t* written, int* error);
+  virtual StreamResult ReadV(const IoVec* vecs, size_t num_vecs,
+                             size_t* read, int* error);
+  virtual StreamResult WriteV(const IoVec* vecs, size_t num_vecs,
+                              size_t* written, int* error);
 
  private:
+  // Copies the first 'len' bytes of 'vecs' to the tap.
+  void TapVecs(const IoVec* vecs, size_t len);
+
   scoped_ptr<StreamInterface> tap_;
   StreamResult tap_result_;
   int tap_error_;
@@ -371,6 +401,10 @@ class StreamSegment : public StreamAdapterInterface {
   // StreamAdapterInterface Interface
   virtual StreamResult Read(void* buffer, size_t buffer_len,
                             size_t* read, int* error);
+  virtual StreamResult ReadV(const IoVec* vecs, size_t num_vecs,
+                             size_t* read, int* error) {
+    return StreamInterface::ReadV(vecs, num_vecs, read, error);
+  }
   virtual bool SetPosition(size_t position);
   virtual bool GetPosition(size_t* position) const;
   virtual bool GetSize(size_t* size) const;
@@ -499,6 +533,8 @@ class MemoryStreamBase : public StreamInterface {
   virtual bool GetSize(size_t* size) const;
   virtual bool GetAvailable(size_t* size) const;
   virtual bool ReserveSize(size_t size);
+  virtual const void* GetReadData(size_t* data_len);
+  virtual void ConsumeReadData(size_t used);
 
   char* GetBuffer() { return buffer_; }
   const char* GetBuffer() const { return buffer_; }
@@ -554,8 +590,22 @@ class ExternalMemoryStream : public MemoryStreamBase {
 
 class FifoBuffer : public StreamInterface {
  public:
+  // How the buffer may be shared between threads.
+  enum ThreadMode {
+    // Any thread may call any method; every call takes a lock.
+    LOCKED,
+    // One thread writes and one thread reads, and neither takes a lock.  The
+    // writer may only call Write, WriteV, WriteOffset, GetWriteBuffer,
+    // GetWriteSpans, ConsumeWriteBuffer, GetWriteRemaining and Close; the
+    // reader may only call Read, ReadV, ReadOffset, GetReadData,
+    // GetReadSpans and ConsumeReadData.  GetBuffered may be called from
+    // either.  SetCapacity is not supported.
+    SINGLE_PRODUCER_CONSUMER
+  };
+
   // Creates a FIFO buffer with the specified capacity.
   explicit FifoBuffer(size_t length);
+  FifoBuffer(size_t length, ThreadMode mode);
   virtual ~FifoBuffer();
   // Gets the amount of data currently readable from the buffer.
   bool GetBuffered(size_t* data_len) const;
@@ -576,12 +626,26 @@ class FifoBuffer : public StreamInterface {
   StreamResult WriteOffset(const void* buffer, size_t bytes, size_t offset,
                            size_t* bytes_written);
 
+  // Gets all of the readable data in place, as the span up to the end of the
+  // buffer and the span that wrapped around to its start.  |len2| is 0 if the
+  // data doesn't wrap.  Call ConsumeReadData() once the data has been used.
+  void GetReadSpans(const void** data1, size_t* len1,
+                    const void** data2, size_t* len2);
+
+  // Gets all of the free space in place, split like GetReadSpans.  Call
+  // ConsumeWriteBuffer() once data has been written to it.
+  void GetWriteSpans(void** buf1, size_t* len1, void** buf2, size_t* len2);
+
   // StreamInterface methods
   virtual StreamState GetState() const;
   virtual StreamResult Read(void* buffer, size_t bytes,
                             size_t* bytes_read, int* error);
   virtual StreamResult Write(const void* buffer, size_t bytes,
                              size_t* bytes_written, int* error);
+  virtual StreamResult ReadV(const IoVec* vecs, size_t num_vecs,
+                             size_t* bytes_read, int* error);
+  virtual StreamResult WriteV(const IoVec* vecs, size_t num_vecs,
+                              size_t* bytes_written, int* error);
   virtual void Close();
   virtual const void* GetReadData(size_t* data_len);
   virtual void ConsumeReadData(size_t used);
@@ -591,20 +655,46 @@ class FifoBuffer : public StreamInterface {
 
  private:
   // Helper method that implements ReadOffset. Caller must acquire a lock
-  // when calling this method.
+  // when calling this method, or be the reader in SINGLE_PRODUCER_CONSUMER
+  // mode.
   StreamResult ReadOffsetLocked(void* buffer, size_t bytes, size_t offset,
                                 size_t* bytes_read);
 
   // Helper method that implements WriteOffset. Caller must acquire a lock
-  // when calling this method.
+  // when calling this method, or be the writer in SINGLE_PRODUCER_CONSUMER
+  // mode.
   StreamResult WriteOffsetLocked(const void* buffer, size_t bytes,
                                  size_t offset, size_t* bytes_written);
 
-  StreamState state_;  // keeps the opened/closed state of the stream
+  // The read and write indices run from 0 to twice the buffer length, so
+  // that a full buffer can be told apart from an empty one.  Each is only
+  // changed by its own side, so in SINGLE_PRODUCER_CONSUMER mode the other
+  // side only ever needs to load it.
+  size_t LoadIndex(const volatile size_t* index) const;
+  // The state is published like the indices, as either side may close.
+  StreamState LoadState() const;
+  size_t Wrap(size_t index) const {
+    return (index < 2 * buffer_length_) ? index : index - 2 * buffer_length_;
+  }
+  size_t Position(size_t index) const {
+    return (index < buffer_length_) ? index : index - buffer_length_;
+  }
+  size_t Distance(size_t from, size_t to) const {
+    return (to >= from) ? to - from : to + 2 * buffer_length_ - from;
+  }
+
+  // Move the read or write index on by |count|.  They return whether the
+  // other side may be waiting for an event: the buffer was full before the
+  // read, or empty before the write.
+  bool AdvanceReadIndex(size_t count);
+  bool AdvanceWriteIndex(size_t count);
+
+  const bool locked_;  // false in SINGLE_PRODUCER_CONSUMER mode
+  volatile StreamState state_;  // keeps the opened/closed state of the stream
   scoped_array<char> buffer_;  // the allocated buffer
   size_t buffer_length_;  // size of the allocated buffer
-  size_t data_length_;  // amount of readable data in the buffer
-  size_t read_position_;  // offset to the readable data
+  volatile size_t read_index_;  // offset to the readable data
+  volatile size_t write_index_;  // offset to the free space
   Thread* owner_;  // stream callbacks are dispatched on this thread
   mutable CriticalSection crit_;  // object lock
   DISALLOW_EVIL_CONSTRUCTORS(FifoBuffer);
@@ -623,6 +713,14 @@ class LoggingAdapter : public StreamAdapterInterface {
                             size_t* read, int* error);
   virtual StreamResult Write(const void* data, size_t data_len,
                              size_t* written, int* error);
+  virtual StreamResult ReadV(const IoVec* vecs, size_t num_vecs,
+                             size_t* read, int* error) {
+    return StreamInterface::ReadV(vecs, num_vecs, read, error);
+  }
+  virtual StreamResult WriteV(const IoVec* vecs, size_t num_vecs,
+                              size_t* written, int* error) {
+    return StreamInterface::WriteV(vecs, num_vecs, written, error);
+  }
   virtual void Close();
 
  protected:
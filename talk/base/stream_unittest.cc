@@ -26,7 +26,10 @@
  */
 
 #include "talk/base/gunit.h"
+#include "talk/base/logging.h"
 #include "talk/base/stream.h"
+#include "talk/base/thread.h"
+#include "talk/base/time.h"
 
 namespace talk_base {
 
@@ -442,4 +445,221 @@ TEST(FifoBufferTest, WriteOffsetAndReadOffset) {
   EXPECT_EQ(SR_BLOCK, buf.ReadOffset(out, 10, 16, NULL));
 }
 
+TEST(FifoBufferTest, Spans) {
+  const size_t kSize = 16;
+  const char in[kSize + 1] = "0123456789ABCDEF";
+  FifoBuffer buf(kSize, FifoBuffer::SINGLE_PRODUCER_CONSUMER);
+  const void* data1;
+  const void* data2;
+  void* buf1;
+  void* buf2;
+  size_t len1, len2;
+
+  // Leave 12 bytes at offset 10, wrapping around the end.
+  EXPECT_EQ(SR_SUCCESS, buf.Write(in, 10, NULL, NULL));
+  buf.ConsumeReadData(10);
+  EXPECT_EQ(SR_SUCCESS, buf.Write(in, 12, NULL, NULL));
+
+  buf.GetReadSpans(&data1, &len1, &data2, &len2);
+  EXPECT_EQ(6u, len1);
+  EXPECT_EQ(0, memcmp(data1, in, 6));
+  EXPECT_EQ(6u, len2);
+  EXPECT_EQ(0, memcmp(data2, in + 6, 6));
+
+  buf.GetWriteSpans(&buf1, &len1, &buf2, &len2);
+  EXPECT_EQ(4u, len1);
+  EXPECT_EQ(data2, buf2);
+  EXPECT_EQ(0u, len2);
+  EXPECT_EQ(static_cast<const char*>(data2) + 6, buf1);
+
+  // Fill it up; nothing is left to write to.
+  memcpy(buf1, in, len1);
+  buf.ConsumeWriteBuffer(len1);
+  buf.GetWriteSpans(&buf1, &len1, &buf2, &len2);
+  EXPECT_EQ(0u, len1);
+  EXPECT_EQ(0u, len2);
+  size_t bytes;
+  buf.GetWriteBuffer(&bytes);
+  EXPECT_EQ(0u, bytes);
+  EXPECT_EQ(SR_BLOCK, buf.Write(in, 1, NULL, NULL));
+
+  // And read it all back, without wrapping this time.
+  buf.ConsumeReadData(6);
+  buf.GetReadSpans(&data1, &len1, &data2, &len2);
+  EXPECT_EQ(10u, len1);
+  EXPECT_EQ(0u, len2);
+  buf.ConsumeReadData(10);
+  EXPECT_EQ(SR_BLOCK, buf.Read(&bytes, 1, NULL, NULL));
+}
+
+TEST(FifoBufferTest, ReadVAndWriteV) {
+  const size_t kSize = 16;
+  const char in[kSize + 1] = "0123456789ABCDEF";
+  char out1[5], out2[20];
+  FifoBuffer buf(kSize);
+  size_t bytes;
+
+  // Move the read position along so the data wraps.
+  EXPECT_EQ(SR_SUCCESS, buf.Write(in, 10, NULL, NULL));
+  buf.ConsumeReadData(10);
+
+  IoVec write_vecs[] = { { const_cast<char*>(in), 3 },
+                         { NULL, 0 },
+                         { const_cast<char*>(in + 3), 10 },
+                         { const_cast<char*>(in + 13), 3 } };
+  EXPECT_EQ(SR_SUCCESS, buf.WriteV(write_vecs, 4, &bytes, NULL));
+  EXPECT_EQ(kSize, bytes);
+  EXPECT_EQ(SR_BLOCK, buf.WriteV(write_vecs, 4, &bytes, NULL));
+
+  IoVec read_vecs[] = { { out1, sizeof(out1) }, { out2, sizeof(out2) } };
+  EXPECT_EQ(SR_SUCCESS, buf.ReadV(read_vecs, 2, &bytes, NULL));
+  EXPECT_EQ(kSize, bytes);
+  EXPECT_EQ(0, memcmp(out1, in, 5));
+  EXPECT_EQ(0, memcmp(out2, in + 5, kSize - 5));
+  EXPECT_EQ(SR_BLOCK, buf.ReadV(read_vecs, 2, &bytes, NULL));
+}
+
+TEST(StreamTest, DefaultReadVAndWriteV) {
+  const char in[] = "0123456789";
+  char out[3][4];
+  MemoryStream stream;
+  size_t bytes;
+
+  // MemoryStream has no ReadV or WriteV of its own.
+  IoVec write_vecs[] = { { const_cast<char*>(in), 4 },
+                         { const_cast<char*>(in + 4), 6 } };
+  EXPECT_EQ(SR_SUCCESS, stream.WriteV(write_vecs, 2, &bytes, NULL));
+  EXPECT_EQ(10u, bytes);
+
+  // The last read comes up short, so the last buffer is only partly filled.
+  EXPECT_TRUE(stream.Rewind());
+  IoVec read_vecs[] = { { out[0], 4 }, { out[1], 4 }, { out[2], 4 } };
+  EXPECT_EQ(SR_SUCCESS, stream.ReadV(read_vecs, 3, &bytes, NULL));
+  EXPECT_EQ(10u, bytes);
+  EXPECT_EQ(0, memcmp(out[0], in, 4));
+  EXPECT_EQ(0, memcmp(out[1], in + 4, 4));
+  EXPECT_EQ(0, memcmp(out[2], in + 8, 2));
+  EXPECT_EQ(SR_EOS, stream.ReadV(read_vecs, 3, &bytes, NULL));
+}
+
+TEST(StreamTest, MemoryStreamReadsInPlace) {
+  MemoryStream stream("0123456789");
+  size_t bytes;
+  const void* data = stream.GetReadData(&bytes);
+  EXPECT_EQ(10u, bytes);
+  EXPECT_EQ(0, memcmp(data, "0123456789", 10));
+
+  stream.ConsumeReadData(4);
+  data = stream.GetReadData(&bytes);
+  EXPECT_EQ(6u, bytes);
+  EXPECT_EQ(0, memcmp(data, "456789", 6));
+
+  stream.ConsumeReadData(6);
+  stream.GetReadData(&bytes);
+  EXPECT_EQ(0u, bytes);
+  char out[4];
+  EXPECT_EQ(SR_EOS, stream.Read(out, sizeof(out), &bytes, NULL));
+}
+
+TEST(StreamTest, TapSeesWriteV) {
+  const char in[] = "0123456789";
+  MemoryStream* tap = new MemoryStream();
+  StreamTap stream(new MemoryStream(), tap);
+  size_t bytes;
+
+  IoVec vecs[] = { { const_cast<char*>(in), 4 },
+                   { const_cast<char*>(in + 4), 6 } };
+  EXPECT_EQ(SR_SUCCESS, stream.WriteV(vecs, 2, &bytes, NULL));
+  EXPECT_EQ(10u, bytes);
+  size_t size;
+  EXPECT_TRUE(tap->GetSize(&size));
+  EXPECT_EQ(10u, size);
+  EXPECT_EQ(0, memcmp(tap->GetBuffer(), in, 10));
+}
+
+// Writes a known pattern into a FifoBuffer from its own thread.
+class FifoWriter : public Runnable {
+ public:
+  FifoWriter(FifoBuffer* buf, size_t total) : buf_(buf), total_(total) {}
+  virtual void Run(Thread* thread) {
+    char chunk[4096];
+    size_t sent = 0;
+    while (sent < total_) {
+      size_t len = _min(sizeof(chunk), total_ - sent);
+      for (size_t i = 0; i < len; ++i) {
+        chunk[i] = static_cast<char>((sent + i) % 251);
+      }
+      size_t written = 0;
+      while (written < len) {
+        size_t count;
+        if (buf_->Write(chunk + written, len - written, &count, NULL) ==
+            SR_SUCCESS) {
+          written += count;
+        } else {
+          Thread::SleepMs(0);
+        }
+      }
+      sent += len;
+    }
+    buf_->Close();
+  }
+
+ private:
+  FifoBuffer* buf_;
+  size_t total_;
+};
+
+// Streams |total| bytes between two threads through a FifoBuffer, checks
+// them, and returns the bytes per second.
+static int64 StreamAcrossThreads(FifoBuffer::ThreadMode mode, size_t total) {
+  FifoBuffer buf(64 * 1024, mode);
+  FifoWriter writer(&buf, total);
+  Thread thread;
+  int64 start = TimeMicros();
+  thread.Start(&writer);
+
+  size_t received = 0;
+  bool ok = true;
+  char chunk[4096];
+  while (true) {
+    // Read reports the end of the stream only once it has returned every
+    // byte written before the close.
+    size_t count;
+    StreamResult result = buf.Read(chunk, sizeof(chunk), &count, NULL);
+    if (result == SR_EOS)
+      break;
+    if (result == SR_BLOCK) {
+      Thread::SleepMs(0);
+      continue;
+    }
+    for (size_t i = 0; i < count; ++i) {
+      ok &= (chunk[i] == static_cast<char>((received + i) % 251));
+    }
+    received += count;
+  }
+  int64 elapsed = TimeMicros() - start;
+  thread.Stop();
+
+  EXPECT_EQ(total, received);
+  EXPECT_TRUE(ok);
+  return total * kNumMicrosecsPerSec / (elapsed + 1);
+}
+
+// Checks that the bytes arrive intact and in order in either mode.
+TEST(FifoBufferTest, CrossThreadSequence) {
+  StreamAcrossThreads(FifoBuffer::LOCKED, 256 * 1024);
+  StreamAcrossThreads(FifoBuffer::SINGLE_PRODUCER_CONSUMER, 256 * 1024);
+}
+
+// Compares cross-thread throughput with and without locking.
+TEST(FifoBufferTest, DISABLED_CrossThreadBenchmark) {
+  const size_t kTotal = 64 * 1024 * 1024;
+  int64 locked = StreamAcrossThreads(FifoBuffer::LOCKED, kTotal);
+  int64 spsc = StreamAcrossThreads(FifoBuffer::SINGLE_PRODUCER_CONSUMER,
+                                   kTotal);
+  LOG(LS_INFO) << "FifoBuffer MB/sec across threads: locked "
+               << locked / (1024 * 1024) << ", single producer/consumer "
+               << spsc / (1024 * 1024);
+}
+
 } // namespace talk_base
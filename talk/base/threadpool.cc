@@ -0,0 +1,125 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "talk/base/threadpool.h"
+
+#include "talk/base/common.h"
+#include "talk/base/thread.h"
+
+namespace talk_base {
+
+class ThreadPool::PoolThread : public MessageHandler {
+ public:
+  explicit PoolThread(ThreadPool* pool) : pool_(pool) {
+    thread_.SetName(pool_->name_, this);
+    thread_.Start();
+  }
+  virtual ~PoolThread() {
+    thread_.Stop();
+  }
+
+  // Context: Any Thread.  Must only be called while the thread is idle.
+  void Wake() {
+    thread_.Post(this);
+  }
+
+  virtual void OnMessage(Message* msg) {
+    pool_->ProcessQueue(this);
+  }
+
+ private:
+  ThreadPool* pool_;
+  Thread thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(PoolThread);
+};
+
+ThreadPool::ThreadPool(const std::string& name, size_t max_threads)
+    : name_(name), max_threads_(max_threads), num_runs_(0) {
+  ASSERT(max_threads_ > 0);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    CritScope cs(&crit_);
+    queue_.clear();
+  }
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    delete threads_[i];
+  }
+}
+
+void ThreadPool::Post(Task* task) {
+  CritScope cs(&crit_);
+  queue_.push_back(task);
+  if (!idle_threads_.empty()) {
+    PoolThread* thread = idle_threads_.back();
+    idle_threads_.pop_back();
+    thread->Wake();
+  } else if (threads_.size() < max_threads_) {
+    PoolThread* thread = new PoolThread(this);
+    threads_.push_back(thread);
+    thread->Wake();
+  }
+  // Otherwise, all threads are busy and one of them will get to it.
+}
+
+bool ThreadPool::Cancel(Task* task) {
+  CritScope cs(&crit_);
+  for (std::deque<Task*>::iterator it = queue_.begin(); it != queue_.end();
+       ++it) {
+    if (*it == task) {
+      queue_.erase(it);
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t ThreadPool::num_threads() {
+  CritScope cs(&crit_);
+  return threads_.size();
+}
+
+void ThreadPool::ProcessQueue(PoolThread* thread) {
+  while (true) {
+    Task* task;
+    {
+      CritScope cs(&crit_);
+      if (queue_.empty()) {
+        idle_threads_.push_back(thread);
+        return;
+      }
+      task = queue_.front();
+      queue_.pop_front();
+      ++num_runs_;
+    }
+    task->Run();
+  }
+}
+
+}  // namespace talk_base
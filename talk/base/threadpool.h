@@ -0,0 +1,92 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TALK_BASE_THREADPOOL_H_
+#define TALK_BASE_THREADPOOL_H_
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "talk/base/constructormagic.h"
+#include "talk/base/criticalsection.h"
+
+namespace talk_base {
+
+// ThreadPool runs tasks on a bounded number of threads, in the order they
+// were posted.  Threads are started as tasks come in, up to max_threads(),
+// and then stay around, idle or not, until the pool is deleted.  When all of
+// them are busy, tasks wait for one of them to finish.
+class ThreadPool {
+ public:
+  class Task {
+   public:
+    virtual ~Task() {}
+    // Context: Pool Thread.
+    virtual void Run() = 0;
+  };
+
+  // Threads are named after name.
+  ThreadPool(const std::string& name, size_t max_threads);
+  // Drops the tasks that haven't started, and waits for the running ones to
+  // finish.
+  ~ThreadPool();
+
+  // Context: Any Thread.  Queues task, which the pool doesn't take ownership
+  // of.  A task may be posted again before it has run; it is then run once
+  // for each time, possibly on several threads at once.
+  void Post(Task* task);
+  // Context: Any Thread.  Takes one posting of task off the queue if it
+  // hasn't started yet, and returns whether it did.
+  bool Cancel(Task* task);
+
+  size_t max_threads() const { return max_threads_; }
+  // The number of threads started so far.
+  size_t num_threads();
+  // The number of tasks that have been started.
+  size_t num_runs() const { return num_runs_; }
+
+ private:
+  class PoolThread;
+
+  // Context: Pool Thread.  Runs queued tasks until there are none left.
+  void ProcessQueue(PoolThread* thread);
+
+  const std::string name_;
+  const size_t max_threads_;
+  CriticalSection crit_;
+  std::deque<Task*> queue_;
+  std::vector<PoolThread*> threads_;
+  std::vector<PoolThread*> idle_threads_;
+  size_t num_runs_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+};
+
+}  // namespace talk_base
+
+#endif  // TALK_BASE_THREADPOOL_H_
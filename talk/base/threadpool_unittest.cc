@@ -0,0 +1,133 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <vector>
+
+#include "talk/base/event.h"
+#include "talk/base/gunit.h"
+#include "talk/base/thread.h"
+#include "talk/base/threadpool.h"
+
+namespace talk_base {
+
+static const int kTimeout = 5000;
+
+// Records the order tasks run in, and optionally blocks until released.
+class RecordingTask : public ThreadPool::Task {
+ public:
+  RecordingTask(int id, CriticalSection* crit, std::vector<int>* runs)
+      : id_(id), crit_(crit), runs_(runs), released_(true, true),
+        started_(true, false) {
+  }
+
+  void Block() { released_.Reset(); }
+  void Release() { released_.Set(); }
+  bool WaitStarted() { return started_.Wait(kTimeout); }
+
+  virtual void Run() {
+    {
+      CritScope cs(crit_);
+      runs_->push_back(id_);
+    }
+    started_.Set();
+    released_.Wait(kForever);
+  }
+
+ private:
+  int id_;
+  CriticalSection* crit_;
+  std::vector<int>* runs_;
+  Event released_;
+  Event started_;
+};
+
+class ThreadPoolTest : public testing::Test {
+ protected:
+  size_t NumRuns() {
+    CritScope cs(&crit_);
+    return runs_.size();
+  }
+
+  CriticalSection crit_;
+  std::vector<int> runs_;
+};
+
+TEST_F(ThreadPoolTest, RunsTasksInOrderOnBoundedThreads) {
+  ThreadPool pool("ThreadPoolTest", 2);
+  RecordingTask first(0, &crit_, &runs_);
+  RecordingTask second(1, &crit_, &runs_);
+  RecordingTask third(2, &crit_, &runs_);
+  first.Block();
+  second.Block();
+  pool.Post(&first);
+  pool.Post(&second);
+  pool.Post(&third);
+  ASSERT_TRUE(first.WaitStarted());
+  ASSERT_TRUE(second.WaitStarted());
+  EXPECT_EQ(2U, pool.num_threads());
+
+  // Both threads are busy, so the third task waits for one of them.
+  Thread::SleepMs(10);
+  EXPECT_EQ(2U, NumRuns());
+  first.Release();
+  EXPECT_EQ_WAIT(3U, NumRuns(), kTimeout);
+  EXPECT_EQ(2, runs_[2]);
+  second.Release();
+  EXPECT_EQ(2U, pool.num_threads());
+  EXPECT_EQ(3U, pool.num_runs());
+}
+
+TEST_F(ThreadPoolTest, RunsTaskOncePerPost) {
+  ThreadPool pool("ThreadPoolTest", 2);
+  RecordingTask task(0, &crit_, &runs_);
+  for (int i = 0; i < 5; ++i) {
+    pool.Post(&task);
+  }
+  EXPECT_EQ_WAIT(5U, NumRuns(), kTimeout);
+  EXPECT_EQ(5U, pool.num_runs());
+}
+
+TEST_F(ThreadPoolTest, CancelQueuedTask) {
+  ThreadPool pool("ThreadPoolTest", 1);
+  RecordingTask blocker(0, &crit_, &runs_);
+  RecordingTask queued(1, &crit_, &runs_);
+  blocker.Block();
+  pool.Post(&blocker);
+  ASSERT_TRUE(blocker.WaitStarted());
+  pool.Post(&queued);
+
+  // A running task can't be cancelled, a queued one can.
+  EXPECT_FALSE(pool.Cancel(&blocker));
+  EXPECT_TRUE(pool.Cancel(&queued));
+  EXPECT_FALSE(pool.Cancel(&queued));
+  blocker.Release();
+  EXPECT_EQ_WAIT(1U, pool.num_runs(), kTimeout);
+  Thread::SleepMs(10);
+  EXPECT_EQ(1U, NumRuns());
+}
+
+}  // namespace talk_base
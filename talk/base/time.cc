@@ -29,6 +29,10 @@
 #include <sys/time.h>
 #endif
 
+#ifdef OSX
+#include <mach/mach_time.h>
+#endif
+
 #ifdef WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -44,19 +48,50 @@ namespace talk_base {
 const uint32 LAST = 0xFFFFFFFF;
 const uint32 HALF = 0x80000000;
 
-#ifdef POSIX
-uint32 Time() {
-  struct timeval tv;
-  gettimeofday(&tv, 0);
-  return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+#if defined(OSX)
+int64 TimeNanos() {
+  static mach_timebase_info_data_t timebase;
+  if (timebase.denom == 0) {
+    // Racing threads all store the same values, so no lock is needed.
+    mach_timebase_info(&timebase);
+  }
+  return static_cast<int64>(mach_absolute_time() * timebase.numer /
+                            timebase.denom);
+}
+#elif defined(POSIX)
+int64 TimeNanos() {
+  // CLOCK_MONOTONIC is served from the vDSO on Linux, so this does not enter
+  // the kernel.
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64>(ts.tv_sec) * kNumNanosecsPerSec + ts.tv_nsec;
+}
+#elif defined(WIN32)
+int64 TimeNanos() {
+  static LARGE_INTEGER freq;
+  if (freq.QuadPart == 0) {
+    QueryPerformanceFrequency(&freq);
+  }
+  LARGE_INTEGER count;
+  QueryPerformanceCounter(&count);
+  // Split the conversion so that the multiplication can't overflow.
+  int64 secs = count.QuadPart / freq.QuadPart;
+  int64 rem = count.QuadPart % freq.QuadPart;
+  return secs * kNumNanosecsPerSec + rem * kNumNanosecsPerSec / freq.QuadPart;
 }
 #endif
 
-#ifdef WIN32
+int64 TimeMicros() {
+  return TimeNanos() / kNumNanosecsPerMicrosec;
+}
+
+int64 TimeMillis() {
+  return TimeNanos() / kNumNanosecsPerMillisec;
+}
+
 uint32 Time() {
-  return GetTickCount();
+  return static_cast<uint32>(TimeMillis());
 }
-#endif
 
 uint32 StartTime() {
   // Close to program execution time
@@ -38,9 +38,29 @@ namespace talk_base {
 
 typedef uint32 TimeStamp;
 
-// Returns the current time in milliseconds.
+static const int64 kNumMillisecsPerSec = 1000;
+static const int64 kNumMicrosecsPerSec = 1000000;
+static const int64 kNumNanosecsPerSec = 1000000000;
+static const int64 kNumMicrosecsPerMillisec = kNumMicrosecsPerSec /
+    kNumMillisecsPerSec;
+static const int64 kNumNanosecsPerMillisec = kNumNanosecsPerSec /
+    kNumMillisecsPerSec;
+static const int64 kNumNanosecsPerMicrosec = kNumNanosecsPerSec /
+    kNumMicrosecsPerSec;
+
+// Returns the current time in milliseconds.  The clock is monotonic (it does
+// not follow changes to the wall clock) and has an arbitrary epoch, so the
+// value is only meaningful relative to other calls.  It wraps around every
+// 49.7 days; use the Time* helpers below to compare values.
 uint32 Time();
 
+// Returns the same monotonic clock as Time() as a 64-bit count of
+// milliseconds, microseconds or nanoseconds.  These never wrap around, so
+// they can be compared and subtracted directly.
+int64 TimeMillis();
+int64 TimeMicros();
+int64 TimeNanos();
+
 // Approximate time when the program started.
 uint32 StartTime();
 
@@ -27,6 +27,7 @@
 
 #include "talk/base/common.h"
 #include "talk/base/gunit.h"
+#include "talk/base/logging.h"
 #include "talk/base/thread.h"
 #include "talk/base/time.h"
 
@@ -133,4 +134,63 @@ TEST(TimeTest, BoundaryComparison) {
   EXPECT_EQ(-100, TimeDiff(ts_earlier, ts_later));
 }
 
+TEST(TimeTest, HighResolutionClocks) {
+  int64 ms_before = TimeMillis();
+  int64 us_before = TimeMicros();
+  int64 ns_before = TimeNanos();
+  Thread::SleepMs(50);
+  int64 ns_after = TimeNanos();
+  int64 us_after = TimeMicros();
+  int64 ms_after = TimeMillis();
+
+  // All three read the same clock, so the intervals must agree.
+  EXPECT_LE(50, ms_after - ms_before);
+  EXPECT_LE(50 * kNumMicrosecsPerMillisec, us_after - us_before);
+  EXPECT_LE(50 * kNumNanosecsPerMillisec, ns_after - ns_before);
+  EXPECT_LE(ns_before / kNumNanosecsPerMicrosec, us_before);
+  EXPECT_LE(us_after, ns_after / kNumNanosecsPerMicrosec + 1);
+
+  // Time() is the low 32 bits of TimeMillis().
+  uint32 ts = Time();
+  int64 ms = TimeMillis();
+  EXPECT_LE(0, TimeDiff(static_cast<uint32>(ms), ts));
+  EXPECT_GE(1, TimeDiff(static_cast<uint32>(ms), ts));
+}
+
+TEST(TimeTest, Monotonic) {
+  int64 last = TimeNanos();
+  for (int i = 0; i < 100000; ++i) {
+    int64 now = TimeNanos();
+    ASSERT_LE(last, now);
+    last = now;
+  }
+}
+
+// Compares the cost of the various ways of getting the time.
+TEST(TimeTest, DISABLED_ClockBenchmark) {
+  const int kNumCalls = 1000000;
+  int64 sum = 0;
+
+  int64 start = TimeNanos();
+  for (int i = 0; i < kNumCalls; ++i)
+    sum += Time();
+  int64 time_ns = TimeNanos() - start;
+
+  start = TimeNanos();
+  for (int i = 0; i < kNumCalls; ++i)
+    sum += TimeNanos();
+  int64 nanos_ns = TimeNanos() - start;
+
+  Thread* thread = Thread::Current();
+  start = TimeNanos();
+  for (int i = 0; i < kNumCalls; ++i)
+    sum += thread->LoopTime();
+  int64 loop_ns = TimeNanos() - start;
+
+  LOG(LS_INFO) << "Calls/sec: Time() " << kNumCalls * 1000 / (time_ns + 1)
+               << "M, TimeNanos() " << kNumCalls * 1000 / (nanos_ns + 1)
+               << "M, LoopTime() " << kNumCalls * 1000 / (loop_ns + 1)
+               << "M (checksum " << sum << ")";
+}
+
 } // namespace talk_base
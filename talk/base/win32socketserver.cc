@@ -508,6 +508,12 @@ int Win32Socket::EstimateMTU(uint16* mtu) {
     return -1;
   }
 
+  // WinPing only speaks ICMPv4.
+  if (addr.IsIPv6()) {
+    error_ = EINVAL;
+    return -1;
+  }
+
   WinPing ping;
   if (!ping.IsValid()) {
     error_ = EINVAL;  // can't think of a better error ID
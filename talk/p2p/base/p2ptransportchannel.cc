@@ -31,12 +31,12 @@
 #include "talk/base/common.h"
 #include "talk/base/logging.h"
 #include "talk/p2p/base/common.h"
+#include "talk/p2p/base/relayport.h"
 
 namespace {
 
 // messages for queuing up work for ourselves
 const uint32 MSG_SORT = 1;
-const uint32 MSG_PING = 2;
 const uint32 MSG_ALLOCATE = 3;
 
 // When the socket is unwritable, we will use 10 Kbps (ignoring IP+UDP headers)
@@ -52,6 +52,11 @@ static const uint32 UNWRITABLE_DELAY = 1000 * PING_PACKET_SIZE / 10000;  // 50ms
 // make sure it is pinged at this rate.
 static const uint32 MAX_CURRENT_WRITABLE_DELAY = 900;  // 2*WRITABLE_DELAY - bit
 
+// Until the channel first becomes writable, we check this many connections at
+// a time so that a working one is found sooner.  The scheduler's rate budget
+// keeps this from getting out of hand when many channels start together.
+static const int kMaxStartupPings = 3;
+
 // The minimum improvement in RTT that justifies a switch.
 static const double kMinImprovement = 10;
 
@@ -176,12 +181,18 @@ P2PTransportChannel::P2PTransportChannel(const std::string &name,
     pinging_started_(false),
     sort_dirty_(false),
     was_writable_(false),
-    was_timed_out_(true) {
+    was_timed_out_(true),
+    starting_up_(true),
+    ping_scheduler_(NULL),
+    next_ping_time_(0) {
 }
 
 P2PTransportChannel::~P2PTransportChannel() {
   ASSERT(worker_thread_ == talk_base::Thread::Current());
 
+  if (ping_scheduler_)
+    ping_scheduler_->RemoveClient(this);
+
   for (uint32 i = 0; i < allocator_sessions_.size(); ++i)
     delete allocator_sessions_[i];
 }
@@ -213,7 +224,7 @@ void P2PTransportChannel::Connect() {
   Allocate();
 
   // Start pinging as the ports come in.
-  thread()->Post(this, MSG_PING);
+  StartPinging();
 }
 
 // Reset the socket, clear up any previous allocations and start over
@@ -242,6 +253,7 @@ void P2PTransportChannel::Reset() {
   sort_dirty_ = false;
   was_writable_ = false;
   was_timed_out_ = true;
+  starting_up_ = true;
 
   // If we allocated before, start a new one now.
   if (transport_->connect_requested())
@@ -249,7 +261,7 @@ void P2PTransportChannel::Reset() {
 
   // Start pinging as the ports come in.
   thread()->Clear(this);
-  thread()->Post(this, MSG_PING);
+  StartPinging();
 }
 
 // A new port is available, attempt to make connections for it
@@ -427,6 +439,13 @@ bool P2PTransportChannel::CreateConnection(Port* port,
     if (origin == cricket::Port::ORIGIN_MESSAGE && incoming_only_)
       return false;
 
+    // Other than relay ports, which send through their server, ports can
+    // only reach candidates of their own IP family.
+    if (port->type() != RELAY_PORT_TYPE &&
+        !remote_candidate.address().IsUnresolved() &&
+        remote_candidate.address().family() != port->ip().family())
+      return false;
+
     connection = port->CreateConnection(remote_candidate, origin);
     if (!connection)
       return false;
@@ -692,6 +711,7 @@ void P2PTransportChannel::HandleWritable() {
   // We're writable, obviously we aren't timed out
   was_writable_ = true;
   was_timed_out_ = false;
+  starting_up_ = false;
   set_writable(true);
 }
 
@@ -755,8 +775,6 @@ Connection* P2PTransportChannel::GetBestConnectionOnNetwork(
 void P2PTransportChannel::OnMessage(talk_base::Message *pmsg) {
   if (pmsg->message_id == MSG_SORT)
     OnSort();
-  else if (pmsg->message_id == MSG_PING)
-    OnPing();
   else if (pmsg->message_id == MSG_ALLOCATE)
     Allocate();
   else
@@ -769,20 +787,38 @@ void P2PTransportChannel::OnSort() {
   SortConnections();
 }
 
-// Handle queued up ping request
-void P2PTransportChannel::OnPing() {
+// Registers with the thread's ping scheduler and asks to be pinged right away.
+void P2PTransportChannel::StartPinging() {
+  if (!ping_scheduler_) {
+    ping_scheduler_ = PingScheduler::ForThread(thread());
+    ping_scheduler_->AddClient(this);
+  }
+  next_ping_time_ = talk_base::Time();
+  ping_scheduler_->Wake();
+}
+
+// Called by the ping scheduler when our next ping is due.
+int P2PTransportChannel::SendPings(uint32 now, int max_pings) {
   // Make sure the states of the connections are up-to-date (since this affects
   // which ones are pingable).
   UpdateConnectionStates();
 
-  // Find the oldest pingable connection and have it do a ping.
-  Connection* conn = FindNextPingableConnection();
-  if (conn)
-    conn->Ping(talk_base::Time());
+  // Find the oldest pingable connections and have them do a ping.  While
+  // starting up, several checks may be outstanding at once.
+  int limit = talk_base::_min(max_pings, starting_up_ ? kMaxStartupPings : 1);
+  int sent = 0;
+  while (sent < limit) {
+    Connection* conn = FindNextPingableConnection();
+    if (!conn || conn->last_ping_sent() == now)
+      break;
+    conn->Ping(now);
+    ++sent;
+  }
 
-  // Post ourselves a message to perform the next ping.
+  // Tell the scheduler when to perform the next ping.
   uint32 delay = writable() ? WRITABLE_DELAY : UNWRITABLE_DELAY;
-  thread()->PostDelayed(delay, this, MSG_PING);
+  next_ping_time_ = now + delay;
+  return sent;
 }
 
 // Is the connection in a state for us to even consider pinging the other side?
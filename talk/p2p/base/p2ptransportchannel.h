@@ -42,6 +42,7 @@
 #include <string>
 #include "talk/base/sigslot.h"
 #include "talk/p2p/base/candidate.h"
+#include "talk/p2p/base/pingscheduler.h"
 #include "talk/p2p/base/port.h"
 #include "talk/p2p/base/portallocator.h"
 #include "talk/p2p/base/transport.h"
@@ -63,9 +64,10 @@ class RemoteCandidate : public Candidate {
 };
 
 // P2PTransportChannel manages the candidates and connection process to keep
-// two P2P clients connected to each other.
+// two P2P clients connected to each other.  Its connectivity checks are sent
+// by the PingScheduler of its thread.
 class P2PTransportChannel : public TransportChannelImpl,
-    public talk_base::MessageHandler {
+    public talk_base::MessageHandler, public PingSchedulerClient {
  public:
   P2PTransportChannel(const std::string &name,
                       const std::string &content_type,
@@ -100,6 +102,10 @@ class P2PTransportChannel : public TransportChannelImpl,
 
   virtual void OnCandidate(const Candidate& candidate);
 
+  // From PingSchedulerClient:
+  virtual uint32 NextPingTime() { return next_ping_time_; }
+  virtual int SendPings(uint32 now, int max_pings);
+
  private:
   void Allocate();
   void CancelPendingAllocate();
@@ -129,7 +135,7 @@ class P2PTransportChannel : public TransportChannelImpl,
   void OnPortDestroyed(Port* port);
   void OnReadPacket(Connection *connection, const char *data, size_t len);
   void OnSort();
-  void OnPing();
+  void StartPinging();
   bool IsPingable(Connection* conn);
   Connection* FindNextPingableConnection();
   uint32 NumPingableConnections();
@@ -156,6 +162,10 @@ class P2PTransportChannel : public TransportChannelImpl,
   bool sort_dirty_;  // indicates whether another sort is needed right now
   bool was_writable_;
   bool was_timed_out_;
+  // true until the channel first becomes writable after Connect or Reset
+  bool starting_up_;
+  PingScheduler* ping_scheduler_;
+  uint32 next_ping_time_;
   typedef std::map<talk_base::Socket::Option, int> OptionMap;
   OptionMap options_;
 
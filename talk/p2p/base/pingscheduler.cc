@@ -0,0 +1,237 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "talk/p2p/base/pingscheduler.h"
+
+#include <algorithm>
+#include <map>
+
+#include "talk/base/common.h"
+#include "talk/base/criticalsection.h"
+#include "talk/base/thread.h"
+#include "talk/base/time.h"
+
+namespace cricket {
+
+namespace {
+
+typedef std::map<talk_base::Thread*, PingScheduler*> SchedulerMap;
+
+talk_base::CriticalSection* SchedulersCrit() {
+  static talk_base::CriticalSection* crit = new talk_base::CriticalSection();
+  return crit;
+}
+
+SchedulerMap* Schedulers() {
+  static SchedulerMap* schedulers = new SchedulerMap();
+  return schedulers;
+}
+
+}  // namespace
+
+const int PingScheduler::kDefaultMaxPingsPerSecond;
+const int PingScheduler::kDefaultMaxBurst;
+
+PingScheduler* PingScheduler::ForThread(talk_base::Thread* thread) {
+  ASSERT(thread == talk_base::Thread::Current());
+  talk_base::CritScope cs(SchedulersCrit());
+  PingScheduler*& scheduler = (*Schedulers())[thread];
+  if (!scheduler)
+    scheduler = new PingScheduler(thread);
+  return scheduler;
+}
+
+PingScheduler::PingScheduler(talk_base::Thread* thread)
+    : thread_(thread),
+      clock_(NULL),
+      next_client_(0),
+      num_clients_(0),
+      max_pings_per_second_(kDefaultMaxPingsPerSecond),
+      max_burst_(kDefaultMaxBurst),
+      budget_(kDefaultMaxBurst),
+      last_refill_(talk_base::Time()),
+      next_wakeup_(last_refill_),
+      sending_(false),
+      pings_sent_(0),
+      wakeups_(0) {
+}
+
+PingScheduler::~PingScheduler() {
+  ASSERT(num_clients_ == 0);
+  thread_->Clear(this);
+}
+
+void PingScheduler::AddClient(PingSchedulerClient* client) {
+  ASSERT(thread_ == talk_base::Thread::Current());
+  ASSERT(std::find(clients_.begin(), clients_.end(), client) ==
+         clients_.end());
+  clients_.push_back(client);
+  ++num_clients_;
+  Wake();
+}
+
+void PingScheduler::RemoveClient(PingSchedulerClient* client) {
+  ASSERT(thread_ == talk_base::Thread::Current());
+  std::vector<PingSchedulerClient*>::iterator it =
+      std::find(clients_.begin(), clients_.end(), client);
+  ASSERT(it != clients_.end());
+  if (it == clients_.end())
+    return;
+
+  // While pings are being sent, leave a hole so the loop's indices stay
+  // valid; it is closed up once the loop is done.
+  if (sending_) {
+    *it = NULL;
+  } else {
+    if (static_cast<size_t>(it - clients_.begin()) < next_client_)
+      --next_client_;
+    clients_.erase(it);
+  }
+
+  if (--num_clients_ > 0)
+    return;
+
+  // Nobody is left on this thread. A later client gets a new scheduler.
+  {
+    talk_base::CritScope cs(SchedulersCrit());
+    Schedulers()->erase(thread_);
+  }
+  thread_->Clear(this);
+  if (!sending_)
+    delete this;
+}
+
+void PingScheduler::set_clock(Clock clock) {
+  clock_ = clock;
+  last_refill_ = Now();
+}
+
+uint32 PingScheduler::Now() const {
+  return clock_ ? clock_() : talk_base::Time();
+}
+
+void PingScheduler::set_max_pings_per_second(int rate) {
+  max_pings_per_second_ = talk_base::_max(rate, 0);
+}
+
+void PingScheduler::set_max_burst(int burst) {
+  // With no room for a single ping, due clients would never be served.
+  max_burst_ = talk_base::_max(burst, 1);
+  if (budget_ > max_burst_)
+    budget_ = max_burst_;
+}
+
+void PingScheduler::Wake() {
+  next_wakeup_ = Now();
+  thread_->Clear(this, MSG_WAKEUP);
+  thread_->Post(this, MSG_WAKEUP);
+}
+
+void PingScheduler::OnMessage(talk_base::Message* pmsg) {
+  ASSERT(pmsg->message_id == MSG_WAKEUP);
+  ++wakeups_;
+
+  uint32 now = Now();
+  RefillBudget(now);
+  sending_ = true;
+  SendPings(now);
+  sending_ = false;
+
+  if (num_clients_ == 0) {
+    // The last client went away while we were sending.
+    delete this;
+    return;
+  }
+
+  std::vector<PingSchedulerClient*>::iterator it =
+      std::remove(clients_.begin(), clients_.end(),
+                  static_cast<PingSchedulerClient*>(NULL));
+  clients_.erase(it, clients_.end());
+  if (next_client_ >= clients_.size())
+    next_client_ = 0;
+
+  ScheduleNextWakeup(now);
+}
+
+void PingScheduler::RefillBudget(uint32 now) {
+  if (max_pings_per_second_ == 0) {
+    budget_ = max_burst_;
+    last_refill_ = now;
+    return;
+  }
+  int32 elapsed = talk_base::TimeDiff(now, last_refill_);
+  if (elapsed <= 0)
+    return;
+  budget_ += static_cast<double>(elapsed) * max_pings_per_second_ / 1000;
+  if (budget_ > max_burst_)
+    budget_ = max_burst_;
+  last_refill_ = now;
+}
+
+void PingScheduler::SendPings(uint32 now) {
+  // Go round the clients starting where we last ran out of budget, so that a
+  // tight budget is shared fairly instead of always favoring the first ones.
+  size_t count = clients_.size();
+  for (size_t i = 0; i < count; ++i) {
+    size_t index = (next_client_ + i) % count;
+    PingSchedulerClient* client = clients_[index];
+    if (!client || talk_base::TimeIsLater(now, client->NextPingTime()))
+      continue;
+    if (budget_ < 1) {
+      next_client_ = index;
+      return;
+    }
+    int sent = client->SendPings(now, static_cast<int>(budget_));
+    ASSERT(sent <= budget_);
+    budget_ -= sent;
+    pings_sent_ += sent;
+  }
+}
+
+void PingScheduler::ScheduleNextWakeup(uint32 now) {
+  if (clients_.empty())
+    return;
+
+  uint32 next = clients_[0]->NextPingTime();
+  for (size_t i = 1; i < clients_.size(); ++i)
+    next = talk_base::TimeMin(next, clients_[i]->NextPingTime());
+
+  // If the budget is spent, there is no point waking before it has refilled
+  // enough for one ping.
+  if (budget_ < 1 && max_pings_per_second_ > 0) {
+    uint32 refilled = now + static_cast<uint32>(
+        (1 - budget_) * 1000 / max_pings_per_second_ + 1);
+    next = talk_base::TimeMax(next, refilled);
+  }
+
+  int32 delay = talk_base::_max(talk_base::TimeDiff(next, now), 0);
+  next_wakeup_ = now + delay;
+  thread_->Clear(this, MSG_WAKEUP);
+  thread_->PostDelayed(delay, this, MSG_WAKEUP);
+}
+
+}  // namespace cricket
@@ -0,0 +1,135 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TALK_P2P_BASE_PINGSCHEDULER_H_
+#define TALK_P2P_BASE_PINGSCHEDULER_H_
+
+#include <vector>
+
+#include "talk/base/basictypes.h"
+#include "talk/base/constructormagic.h"
+#include "talk/base/messagehandler.h"
+
+namespace talk_base {
+class Thread;
+}
+
+namespace cricket {
+
+// Implemented by channels whose connectivity checks are paced by a
+// PingScheduler.
+class PingSchedulerClient {
+ public:
+  virtual ~PingSchedulerClient() {}
+
+  // Returns the time at which the client next wants to send a ping.
+  virtual uint32 NextPingTime() = 0;
+
+  // Sends at most |max_pings| pings and returns how many were sent. The
+  // client must move its NextPingTime() past |now| even if it sent nothing.
+  virtual int SendPings(uint32 now, int max_pings) = 0;
+};
+
+// Sends the pings of all the channels on one thread from a single timer,
+// rather than each channel keeping a delayed message of its own, and holds
+// them to a shared rate budget so that many channels starting at once do not
+// flood the network with STUN checks.
+// A scheduler is created for a thread when its first client is added and
+// deletes itself once its last client is removed.
+class PingScheduler : public talk_base::MessageHandler {
+ public:
+  static const int kDefaultMaxPingsPerSecond = 2000;
+  static const int kDefaultMaxBurst = 100;
+
+  // The message that runs a wakeup.
+  enum { MSG_WAKEUP = 1 };
+
+  // Returns the current time in milliseconds, like talk_base::Time().
+  typedef uint32 (*Clock)();
+
+  // Returns the scheduler for the given thread, creating it if necessary.
+  // Must be called on that thread.
+  static PingScheduler* ForThread(talk_base::Thread* thread);
+
+  talk_base::Thread* thread() const { return thread_; }
+
+  void AddClient(PingSchedulerClient* client);
+  void RemoveClient(PingSchedulerClient* client);
+
+  // Tells the scheduler that the client's next ping time has moved earlier.
+  void Wake();
+
+  // The rate budget shared by all clients. Up to |max_burst| pings may be
+  // sent at once after a quiet period. A rate of 0 lifts the limit, so that
+  // every wakeup may send a full burst.
+  void set_max_pings_per_second(int rate);
+  int max_pings_per_second() const { return max_pings_per_second_; }
+  void set_max_burst(int burst);
+  int max_burst() const { return max_burst_; }
+
+  // Replaces talk_base::Time() as the source of the current time, so that
+  // tests can run wakeups on a clock of their own.  NULL restores it.
+  void set_clock(Clock clock);
+  // The time at which the next wakeup is due.
+  uint32 next_wakeup() const { return next_wakeup_; }
+
+  int num_clients() const { return num_clients_; }
+  // Totals since creation, for monitoring.
+  int pings_sent() const { return pings_sent_; }
+  int wakeups() const { return wakeups_; }
+
+  virtual void OnMessage(talk_base::Message* pmsg);
+
+ private:
+  explicit PingScheduler(talk_base::Thread* thread);
+  virtual ~PingScheduler();
+
+  uint32 Now() const;
+  void RefillBudget(uint32 now);
+  void SendPings(uint32 now);
+  void ScheduleNextWakeup(uint32 now);
+
+  talk_base::Thread* thread_;
+  Clock clock_;
+  std::vector<PingSchedulerClient*> clients_;
+  size_t next_client_;
+  int num_clients_;
+  int max_pings_per_second_;
+  int max_burst_;
+  double budget_;
+  uint32 last_refill_;
+  uint32 next_wakeup_;
+  bool sending_;
+  int pings_sent_;
+  int wakeups_;
+
+  DISALLOW_COPY_AND_ASSIGN(PingScheduler);
+};
+
+}  // namespace cricket
+
+#endif  // TALK_P2P_BASE_PINGSCHEDULER_H_
@@ -0,0 +1,345 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <vector>
+
+#include "talk/base/gunit.h"
+#include "talk/base/logging.h"
+#include "talk/base/thread.h"
+#include "talk/base/time.h"
+#include "talk/p2p/base/pingscheduler.h"
+
+namespace cricket {
+
+static const int kTimeout = 5000;
+
+static uint32 fake_now = 0;
+
+static uint32 FakeClock() {
+  return fake_now;
+}
+
+// Runs the scheduler's wakeups on FakeClock until |duration| ms have passed,
+// instead of waiting for its timer.  Gives up after |max_wakeups|, so that a
+// scheduler that keeps waking up without time passing cannot hang the test.
+static void RunFakeClock(PingScheduler* scheduler, uint32 duration,
+                         int max_wakeups) {
+  uint32 end = fake_now + duration;
+  for (int i = 0; i < max_wakeups; ++i) {
+    uint32 next = scheduler->next_wakeup();
+    if (talk_base::TimeIsLater(end, next))
+      break;
+    fake_now = talk_base::TimeMax(fake_now, next);
+    scheduler->thread()->Send(scheduler, PingScheduler::MSG_WAKEUP);
+  }
+  fake_now = end;
+}
+
+// Pings at a fixed interval and counts the pings it was allowed to send.
+class FakePingClient : public PingSchedulerClient {
+ public:
+  FakePingClient(uint32 interval, int pings_per_interval)
+      : interval_(interval),
+        pings_per_interval_(pings_per_interval),
+        next_ping_time_(talk_base::Time()),
+        pings_(0),
+        calls_(0),
+        scheduler_(NULL),
+        remove_on_ping_(NULL) {
+  }
+
+  int pings() const { return pings_; }
+  int calls() const { return calls_; }
+
+  // Removes |client| from |scheduler| the next time we are asked to ping.
+  void RemoveOnPing(PingScheduler* scheduler, PingSchedulerClient* client) {
+    scheduler_ = scheduler;
+    remove_on_ping_ = client;
+  }
+
+  virtual uint32 NextPingTime() { return next_ping_time_; }
+  virtual int SendPings(uint32 now, int max_pings) {
+    ++calls_;
+    if (remove_on_ping_) {
+      scheduler_->RemoveClient(remove_on_ping_);
+      remove_on_ping_ = NULL;
+    }
+    int sent = talk_base::_min(max_pings, pings_per_interval_);
+    pings_ += sent;
+    next_ping_time_ = now + interval_;
+    return sent;
+  }
+
+ private:
+  uint32 interval_;
+  int pings_per_interval_;
+  uint32 next_ping_time_;
+  int pings_;
+  int calls_;
+  PingScheduler* scheduler_;
+  PingSchedulerClient* remove_on_ping_;
+};
+
+// Simulates a channel with a number of candidate pairs, only one of which
+// works.  A ping on that pair is answered after a fixed round trip, which
+// makes the channel writable.
+class FakeCheckingChannel : public PingSchedulerClient {
+ public:
+  FakeCheckingChannel(int num_pairs, int working_pair, int startup_pings,
+                      uint32 rtt)
+      : num_pairs_(num_pairs),
+        working_pair_(working_pair),
+        startup_pings_(startup_pings),
+        rtt_(rtt),
+        start_time_(talk_base::Time()),
+        next_ping_time_(start_time_),
+        next_pair_(0),
+        writable_time_(0),
+        calls_(0),
+        answer_pending_(false),
+        writable_(false) {
+  }
+
+  bool writable() const { return writable_; }
+  int calls() const { return calls_; }
+  int convergence_time() const {
+    return talk_base::TimeDiff(writable_time_, start_time_);
+  }
+
+  virtual uint32 NextPingTime() { return next_ping_time_; }
+  virtual int SendPings(uint32 now, int max_pings) {
+    ++calls_;
+    if (!writable_ && answer_pending_ &&
+        talk_base::TimeIsLaterOrEqual(writable_time_, now)) {
+      writable_ = true;
+    }
+    int limit = talk_base::_min(max_pings, writable_ ? 1 : startup_pings_);
+    for (int i = 0; i < limit; ++i) {
+      if (!writable_ && !answer_pending_ && next_pair_ == working_pair_) {
+        answer_pending_ = true;
+        writable_time_ = now + rtt_;
+      }
+      next_pair_ = (next_pair_ + 1) % num_pairs_;
+    }
+    next_ping_time_ = now + (writable_ ? 480 : 50);
+    if (answer_pending_ && !writable_)
+      next_ping_time_ = talk_base::TimeMin(next_ping_time_, writable_time_);
+    return limit;
+  }
+
+ private:
+  int num_pairs_;
+  int working_pair_;
+  int startup_pings_;
+  uint32 rtt_;
+  uint32 start_time_;
+  uint32 next_ping_time_;
+  int next_pair_;
+  uint32 writable_time_;
+  int calls_;
+  bool answer_pending_;
+  bool writable_;
+};
+
+TEST(PingSchedulerTest, SharedPerThread) {
+  talk_base::Thread* thread = talk_base::Thread::Current();
+  PingScheduler* scheduler = PingScheduler::ForThread(thread);
+  EXPECT_EQ(scheduler, PingScheduler::ForThread(thread));
+  EXPECT_EQ(thread, scheduler->thread());
+
+  FakePingClient client(100, 1);
+  scheduler->AddClient(&client);
+  EXPECT_EQ(1, scheduler->num_clients());
+  EXPECT_EQ(scheduler, PingScheduler::ForThread(thread));
+  scheduler->RemoveClient(&client);
+}
+
+TEST(PingSchedulerTest, PingsEachClientWhenDue) {
+  PingScheduler* scheduler =
+      PingScheduler::ForThread(talk_base::Thread::Current());
+  FakePingClient fast(20, 1);
+  FakePingClient slow(100, 1);
+  scheduler->AddClient(&fast);
+  scheduler->AddClient(&slow);
+
+  EXPECT_TRUE_WAIT(slow.pings() >= 3, kTimeout);
+  EXPECT_GE(fast.pings(), 3 * slow.pings());
+  // One wakeup serves both clients when they are due together.
+  EXPECT_LE(scheduler->wakeups(), fast.calls() + slow.calls());
+
+  scheduler->RemoveClient(&fast);
+  scheduler->RemoveClient(&slow);
+}
+
+TEST(PingSchedulerTest, KeepsToRateBudget) {
+  PingScheduler* scheduler =
+      PingScheduler::ForThread(talk_base::Thread::Current());
+  scheduler->set_max_pings_per_second(100);
+  scheduler->set_max_burst(5);
+
+  // Together these would like to send 20 * 3 pings every 10ms.
+  const int kNumClients = 20;
+  std::vector<FakePingClient*> clients;
+  for (int i = 0; i < kNumClients; ++i)
+    clients.push_back(new FakePingClient(10, 3));
+  fake_now = talk_base::Time();
+  scheduler->set_clock(&FakeClock);
+  for (int i = 0; i < kNumClients; ++i)
+    scheduler->AddClient(clients[i]);
+
+  // The burst plus 500ms worth of budget.
+  RunFakeClock(scheduler, 500, 1000);
+  int total = 0;
+  for (int i = 0; i < kNumClients; ++i) {
+    // Every client gets its share, even though the budget is tight.
+    EXPECT_GT(clients[i]->pings(), 0);
+    total += clients[i]->pings();
+  }
+  EXPECT_EQ(total, scheduler->pings_sent());
+  EXPECT_LE(total, 5 + 50);
+  EXPECT_GE(total, 5 + 50 - 1);
+
+  for (int i = 0; i < kNumClients; ++i) {
+    scheduler->RemoveClient(clients[i]);
+    delete clients[i];
+  }
+}
+
+// Test that a rate of 0 means no limit rather than no budget, which used to
+// leave due clients unserved and the scheduler waking up in a tight loop.
+TEST(PingSchedulerTest, ZeroRateIsUnlimited) {
+  PingScheduler* scheduler =
+      PingScheduler::ForThread(talk_base::Thread::Current());
+  scheduler->set_max_pings_per_second(0);
+  scheduler->set_max_burst(5);
+
+  // Together these would like to send 20 * 3 pings every 50ms.
+  const int kNumClients = 20;
+  std::vector<FakePingClient*> clients;
+  for (int i = 0; i < kNumClients; ++i)
+    clients.push_back(new FakePingClient(50, 3));
+  fake_now = talk_base::Time();
+  scheduler->set_clock(&FakeClock);
+  for (int i = 0; i < kNumClients; ++i)
+    scheduler->AddClient(clients[i]);
+
+  RunFakeClock(scheduler, 200, 1000);
+  for (int i = 0; i < kNumClients; ++i) {
+    // Served in each of the five rounds, at 0, 50, 100, 150 and 200ms.
+    EXPECT_EQ(5, clients[i]->calls());
+    EXPECT_GE(clients[i]->pings(), 5 * 2);
+  }
+  // Each round needs 60 / 5 wakeups; a busy loop would use them all up
+  // without the clock moving.
+  EXPECT_LE(scheduler->wakeups(), 5 * 60 / 5);
+
+  for (int i = 0; i < kNumClients; ++i) {
+    scheduler->RemoveClient(clients[i]);
+    delete clients[i];
+  }
+}
+
+TEST(PingSchedulerTest, RemoveClientsWhilePinging) {
+  PingScheduler* scheduler =
+      PingScheduler::ForThread(talk_base::Thread::Current());
+  FakePingClient first(10, 1);
+  FakePingClient second(10, 1);
+  scheduler->AddClient(&first);
+  scheduler->AddClient(&second);
+
+  // The first client removes the second, then itself, which leaves the
+  // scheduler without clients in the middle of a wakeup.
+  first.RemoveOnPing(scheduler, &second);
+  EXPECT_EQ_WAIT(1, scheduler->num_clients(), kTimeout);
+  int second_pings = second.pings();
+  first.RemoveOnPing(scheduler, &first);
+  WAIT(false, 100);
+  EXPECT_LE(second.pings(), second_pings + 1);
+
+  // A new scheduler takes over for later clients.
+  PingScheduler* next = PingScheduler::ForThread(talk_base::Thread::Current());
+  FakePingClient third(10, 1);
+  next->AddClient(&third);
+  EXPECT_TRUE_WAIT(third.pings() > 0, kTimeout);
+  int first_pings = first.pings();
+  WAIT(false, 50);
+  EXPECT_EQ(first_pings, first.pings());
+  next->RemoveClient(&third);
+}
+
+// Measures how long a batch of channels takes to find their working
+// candidate pair when checking one or several pairs at a time.
+TEST(PingSchedulerTest, DISABLED_ConvergenceBenchmark) {
+  const int kNumChannels = 50;
+  const int kNumPairs = 8;
+  const uint32 kRtt = 20;
+  const int kStartupPings[] = { 1, 3 };
+
+  int average_ms[2];
+  for (int run = 0; run < 2; ++run) {
+    PingScheduler* scheduler =
+        PingScheduler::ForThread(talk_base::Thread::Current());
+    std::vector<FakeCheckingChannel*> channels;
+    for (int i = 0; i < kNumChannels; ++i) {
+      channels.push_back(new FakeCheckingChannel(
+          kNumPairs, (i * 7) % kNumPairs, kStartupPings[run], kRtt));
+      scheduler->AddClient(channels.back());
+    }
+
+    int converged = 0;
+    uint32 start = talk_base::Time();
+    while (converged < kNumChannels && talk_base::TimeSince(start) < kTimeout) {
+      talk_base::Thread::Current()->ProcessMessages(10);
+      converged = 0;
+      for (int i = 0; i < kNumChannels; ++i)
+        converged += channels[i]->writable() ? 1 : 0;
+    }
+    EXPECT_EQ(kNumChannels, converged);
+
+    int total_ms = 0, max_ms = 0, calls = 0;
+    for (int i = 0; i < kNumChannels; ++i) {
+      calls += channels[i]->calls();
+      total_ms += channels[i]->convergence_time();
+      max_ms = talk_base::_max(max_ms, channels[i]->convergence_time());
+    }
+    average_ms[run] = total_ms / kNumChannels;
+    LOG(LS_INFO) << kNumChannels << " channels, " << kStartupPings[run]
+                 << " checks at a time: " << average_ms[run]
+                 << "ms average convergence, " << max_ms << "ms worst, "
+                 << scheduler->pings_sent() << " pings in "
+                 << scheduler->wakeups() << " wakeups (" << calls
+                 << " with a timer per channel)";
+
+    for (int i = 0; i < kNumChannels; ++i) {
+      scheduler->RemoveClient(channels[i]);
+      delete channels[i];
+    }
+  }
+  EXPECT_LT(average_ms[1], average_ms[0]);
+}
+
+}  // namespace cricket
@@ -126,7 +126,7 @@ bool StringToProto(const char* value, ProtocolType* proto) {
 
 Port::Port(talk_base::Thread* thread, const std::string& type,
            talk_base::PacketSocketFactory* factory, talk_base::Network* network,
-           uint32 ip, int min_port, int max_port)
+           const talk_base::IPAddress& ip, int min_port, int max_port)
     : thread_(thread),
       factory_(factory),
       type_(type),
@@ -241,7 +241,7 @@ bool Port::GetStunMessage(const char* data, size_t size,
   // Parse the request message.  If the packet is not a complete and correct
   // STUN message, then ignore it.
   talk_base::scoped_ptr<StunMessage> stun_msg(new StunMessage());
-  talk_base::ByteBuffer buf(data, size);
+  talk_base::ByteBuffer buf(data, size, talk_base::ByteBuffer::NO_COPY);
   if (!stun_msg->Read(&buf) || (buf.Length() > 0)) {
     return false;
   }
@@ -350,8 +350,7 @@ void Port::SendBindingResponse(StunMessage* request,
 
   StunAddressAttribute* addr_attr =
       StunAttribute::CreateAddress(STUN_ATTR_MAPPED_ADDRESS);
-  addr_attr->SetPort(addr.port());
-  addr_attr->SetIP(addr.ip());
+  addr_attr->SetAddress(addr);
   response.AddAttribute(addr_attr);
 
   // Send the response message.
@@ -77,7 +77,7 @@ class Port : public talk_base::MessageHandler, public sigslot::has_slots<> {
  public:
   Port(talk_base::Thread* thread, const std::string& type,
        talk_base::PacketSocketFactory* factory, talk_base::Network* network,
-       uint32 ip, int min_port, int max_port);
+       const talk_base::IPAddress& ip, int min_port, int max_port);
   virtual ~Port();
 
   // The thread on which this port performs its I/O.
@@ -119,6 +119,9 @@ class Port : public talk_base::MessageHandler, public sigslot::has_slots<> {
   // Identifies network that this port was allocated on.
   talk_base::Network* network() { return network_; }
 
+  // Identifies the local IP address that this port was allocated on.
+  const talk_base::IPAddress& ip() const { return ip_; }
+
   // Identifies the generation that this port was created in.
   uint32 generation() { return generation_; }
   void set_generation(uint32 generation) { generation_ = generation; }
@@ -241,7 +244,7 @@ class Port : public talk_base::MessageHandler, public sigslot::has_slots<> {
   talk_base::PacketSocketFactory* factory_;
   std::string type_;
   talk_base::Network* network_;
-  uint32 ip_;
+  talk_base::IPAddress ip_;
   int min_port_;
   int max_port_;
   uint32 generation_;
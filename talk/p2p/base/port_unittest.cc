@@ -0,0 +1,303 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef POSIX
+#include <netinet/in.h>  // for sockaddr_in
+#endif
+
+#include <string>
+
+#include "talk/base/asyncpacketsocket.h"
+#include "talk/base/asyncudpsocket.h"
+#include "talk/base/basicpacketsocketfactory.h"
+#include "talk/base/byteorder.h"
+#include "talk/base/gunit.h"
+#include "talk/base/logging.h"
+#include "talk/base/network.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/base/thread.h"
+#include "talk/base/time.h"
+#include "talk/p2p/base/candidate.h"
+#include "talk/p2p/base/relayport.h"
+#include "talk/p2p/base/relayserver.h"
+#include "talk/p2p/base/stun.h"
+#include "talk/p2p/base/stunport.h"
+#include "talk/p2p/base/stunserver.h"
+#include "talk/p2p/base/tcpport.h"
+#include "talk/p2p/base/udpport.h"
+
+using talk_base::IPAddress;
+using talk_base::SocketAddress;
+
+static const uint32 kLoopbackIp = 0x7F000001;
+static const int kTimeout = 5000;
+
+static IPAddress IPv6Loopback() {
+  IPAddress ip;
+  IPAddress::FromString("::1", &ip);
+  return ip;
+}
+
+namespace cricket {
+
+// Remembers the UDP socket it creates, so that the test can hand the port
+// packets as if that socket had just received them.
+class RecordingSocketFactory : public talk_base::BasicPacketSocketFactory {
+ public:
+  RecordingSocketFactory()
+      : talk_base::BasicPacketSocketFactory(talk_base::Thread::Current()),
+        udp_socket_(NULL) {
+  }
+
+  virtual talk_base::AsyncPacketSocket* CreateUdpSocket(
+      const SocketAddress& address, int min_port, int max_port) {
+    udp_socket_ = talk_base::BasicPacketSocketFactory::CreateUdpSocket(
+        address, min_port, max_port);
+    return udp_socket_;
+  }
+
+  talk_base::AsyncPacketSocket* udp_socket() { return udp_socket_; }
+
+ private:
+  talk_base::AsyncPacketSocket* udp_socket_;
+};
+
+class PortTest : public testing::Test, public sigslot::has_slots<> {
+ public:
+  PortTest()
+      : network_("lo", "loopback", kLoopbackIp, 0),
+        port_(UDPPort::Create(talk_base::Thread::Current(), &factory_,
+                              &network_, kLoopbackIp, 0, 0)),
+        packets_(0) {
+  }
+
+  virtual void SetUp() {
+    ASSERT_TRUE(port_.get() != NULL);
+    port_->PrepareAddress();
+    ASSERT_EQ(1U, port_->candidates().size());
+    port_->EnablePortPackets();
+    port_->SignalReadPacket.connect(this, &PortTest::OnReadPacket);
+  }
+
+  void OnReadPacket(Port* port, const char* data, size_t size,
+                    const SocketAddress& addr) {
+    ++packets_;
+  }
+
+ protected:
+  RecordingSocketFactory factory_;
+  talk_base::Network network_;
+  talk_base::scoped_ptr<UDPPort> port_;
+  int packets_;
+};
+
+// Measures what each received packet costs the port, from the socket
+// decoding the sender's address through to the port handing the packet up,
+// with the port holding enough connections that looking the sender up is
+// not free.
+TEST_F(PortTest, DISABLED_ReadPacketBenchmark) {
+  const int kNumConnections = 100;
+  const int kNumPackets = 1000000;
+  for (int i = 0; i < kNumConnections; ++i) {
+    Candidate remote("rtp", "udp", SocketAddress(0x0A000001 + i, 5000), 1,
+                     "", "", "local", "lo", 0);
+    port_->CreateConnection(remote, Port::ORIGIN_MESSAGE);
+  }
+
+  sockaddr_in saddr;
+  SocketAddress(0x0B000001, 6000).ToSockAddr(&saddr);
+  char packet[172] = { 0 };  // A typical audio RTP packet.
+  talk_base::AsyncPacketSocket* socket = factory_.udp_socket();
+
+  int64 start = talk_base::TimeMicros();
+  for (int i = 0; i < kNumPackets; ++i) {
+    SocketAddress remote_addr;
+    remote_addr.FromSockAddr(saddr);
+    socket->SignalReadPacket(socket, packet, sizeof(packet), remote_addr);
+  }
+  int64 elapsed_us = talk_base::TimeMicros() - start;
+  EXPECT_EQ(kNumPackets, packets_);
+
+  LOG(LS_INFO) << "Per packet: " << elapsed_us * 1000 / kNumPackets << "ns";
+}
+
+// Runs ports on the IPv6 loopback address, connecting them to each other or
+// to STUN and relay servers on it.
+class IPv6PortTest : public testing::Test, public sigslot::has_slots<> {
+ public:
+  IPv6PortTest()
+      : factory_(talk_base::Thread::Current()),
+        network_("lo/ipv6", "loopback", IPv6Loopback(), 0),
+        remote_(NULL),
+        rconn_(NULL),
+        packets_(0) {
+  }
+
+  // Pings from |lport| to |rport| until the connection is writable, and then
+  // sends a packet over it.  |rport| answers the ping the way the transport
+  // channel does, by creating a connection for the unknown address.
+  void TestConnectivity(Port* lport, Port* rport) {
+    ASSERT_EQ(1U, lport->candidates().size());
+    ASSERT_EQ(1U, rport->candidates().size());
+    EXPECT_TRUE(lport->candidates()[0].address().IsIPv6());
+    EXPECT_TRUE(rport->candidates()[0].address().IsIPv6());
+
+    remote_ = &lport->candidates()[0];
+    rport->SignalUnknownAddress.connect(this, &IPv6PortTest::OnUnknownAddress);
+    Connection* lconn = lport->CreateConnection(rport->candidates()[0],
+                                                Port::ORIGIN_MESSAGE);
+    ASSERT_TRUE(lconn != NULL);
+    EXPECT_TRUE_WAIT(lconn->connected(), kTimeout);
+
+    lconn->Ping(talk_base::Time());
+    EXPECT_EQ_WAIT(Connection::STATE_WRITABLE, lconn->write_state(), kTimeout);
+    ASSERT_TRUE(rconn_ != NULL);
+    EXPECT_TRUE(rconn_->remote_candidate().address().IsIPv6());
+
+    rconn_->SignalReadPacket.connect(this, &IPv6PortTest::OnReadPacket);
+    const char kData[] = "ipv6";
+    EXPECT_EQ(static_cast<int>(sizeof(kData)), lconn->Send(kData,
+                                                           sizeof(kData)));
+    EXPECT_EQ_WAIT(1, packets_, kTimeout);
+  }
+
+  void OnUnknownAddress(Port* port, const SocketAddress& addr,
+                        StunMessage* msg, const std::string& remote_username) {
+    Candidate remote(*remote_);
+    remote.set_address(addr);
+    rconn_ = port->CreateConnection(remote, Port::ORIGIN_THIS_PORT);
+    ASSERT_TRUE(rconn_ != NULL);
+    rconn_->ReceivedPing();
+    port->SendBindingResponse(msg, addr);
+    delete msg;
+  }
+
+  void OnReadPacket(Connection* conn, const char* data, size_t size) {
+    ++packets_;
+  }
+
+ protected:
+  SocketAddress BindUdp(talk_base::AsyncUDPSocket** socket) {
+    *socket = talk_base::AsyncUDPSocket::Create(
+        talk_base::Thread::Current()->socketserver(),
+        SocketAddress(IPv6Loopback(), 0));
+    return *socket ? (*socket)->GetLocalAddress() : SocketAddress();
+  }
+
+  talk_base::BasicPacketSocketFactory factory_;
+  talk_base::Network network_;
+  const Candidate* remote_;
+  Connection* rconn_;
+  int packets_;
+};
+
+TEST_F(IPv6PortTest, TestUDPConnectivity) {
+  talk_base::scoped_ptr<UDPPort> lport(UDPPort::Create(
+      talk_base::Thread::Current(), &factory_, &network_, IPv6Loopback(),
+      0, 0));
+  talk_base::scoped_ptr<UDPPort> rport(UDPPort::Create(
+      talk_base::Thread::Current(), &factory_, &network_, IPv6Loopback(),
+      0, 0));
+  ASSERT_TRUE(lport.get() != NULL);
+  ASSERT_TRUE(rport.get() != NULL);
+  lport->PrepareAddress();
+  rport->PrepareAddress();
+  TestConnectivity(lport.get(), rport.get());
+}
+
+// Tests that ports given a port range bind to the IPv6 address.
+TEST_F(IPv6PortTest, TestUDPConnectivityInPortRange) {
+  talk_base::scoped_ptr<UDPPort> lport(UDPPort::Create(
+      talk_base::Thread::Current(), &factory_, &network_, IPv6Loopback(),
+      40000, 41000));
+  talk_base::scoped_ptr<UDPPort> rport(UDPPort::Create(
+      talk_base::Thread::Current(), &factory_, &network_, IPv6Loopback(),
+      40000, 41000));
+  ASSERT_TRUE(lport.get() != NULL);
+  ASSERT_TRUE(rport.get() != NULL);
+  lport->PrepareAddress();
+  rport->PrepareAddress();
+  TestConnectivity(lport.get(), rport.get());
+}
+
+TEST_F(IPv6PortTest, TestTCPConnectivity) {
+  talk_base::scoped_ptr<TCPPort> lport(TCPPort::Create(
+      talk_base::Thread::Current(), &factory_, &network_, IPv6Loopback(),
+      0, 0, false));
+  talk_base::scoped_ptr<TCPPort> rport(TCPPort::Create(
+      talk_base::Thread::Current(), &factory_, &network_, IPv6Loopback(),
+      0, 0, true));
+  ASSERT_TRUE(lport.get() != NULL);
+  ASSERT_TRUE(rport.get() != NULL);
+  lport->PrepareAddress();
+  rport->PrepareAddress();
+  TestConnectivity(lport.get(), rport.get());
+}
+
+// Tests that a STUN server reports an IPv6 mapped address, which the port
+// turns into its candidate.
+TEST_F(IPv6PortTest, TestStunPort) {
+  talk_base::AsyncUDPSocket* socket;
+  SocketAddress server_addr = BindUdp(&socket);
+  ASSERT_TRUE(socket != NULL);
+  StunServer server(socket);
+
+  talk_base::scoped_ptr<StunPort> port(StunPort::Create(
+      talk_base::Thread::Current(), &factory_, &network_, IPv6Loopback(),
+      0, 0, server_addr));
+  ASSERT_TRUE(port.get() != NULL);
+  port->PrepareAddress();
+  ASSERT_EQ_WAIT(1U, port->candidates().size(), kTimeout);
+  const SocketAddress& addr = port->candidates()[0].address();
+  EXPECT_TRUE(addr.IsIPv6());
+  EXPECT_EQ(IPv6Loopback(), addr.ipaddr());
+  EXPECT_NE(0, addr.port());
+}
+
+// Tests that a relay server allocates an IPv6 external address.
+TEST_F(IPv6PortTest, TestRelayPort) {
+  talk_base::AsyncUDPSocket* int_socket;
+  talk_base::AsyncUDPSocket* ext_socket;
+  SocketAddress int_addr = BindUdp(&int_socket);
+  SocketAddress ext_addr = BindUdp(&ext_socket);
+  ASSERT_TRUE(int_socket != NULL);
+  ASSERT_TRUE(ext_socket != NULL);
+  RelayServer server(talk_base::Thread::Current());
+  server.AddInternalSocket(int_socket);
+  server.AddExternalSocket(ext_socket);
+
+  talk_base::scoped_ptr<RelayPort> port(RelayPort::Create(
+      talk_base::Thread::Current(), &factory_, &network_, IPv6Loopback(),
+      0, 0, "username", "password", ""));
+  ASSERT_TRUE(port.get() != NULL);
+  port->AddServerAddress(ProtocolAddress(int_addr, PROTO_UDP));
+  port->PrepareAddress();
+  ASSERT_EQ_WAIT(1U, port->candidates().size(), kTimeout);
+  EXPECT_EQ(ext_addr, port->candidates()[0].address());
+}
+
+}  // namespace cricket
@@ -47,6 +47,13 @@ const uint32 PORTALLOCATOR_DISABLE_STUN = 0x02;
 const uint32 PORTALLOCATOR_DISABLE_RELAY = 0x04;
 const uint32 PORTALLOCATOR_DISABLE_TCP = 0x08;
 const uint32 PORTALLOCATOR_ENABLE_SHAKER = 0x10;
+// Runs all allocation phases at once instead of one per step, and cancels
+// the ports of worse phases that are still gathering once a connection has
+// become writable.
+const uint32 PORTALLOCATOR_ENABLE_PARALLEL_PHASES = 0x20;
+// Lets the UDP and STUN ports of all sessions on a network share one socket
+// and one STUN binding, instead of each creating their own.
+const uint32 PORTALLOCATOR_ENABLE_SHARED_SOCKET = 0x40;
 
 const uint32 kDefaultPortAllocatorFlags = 0;
 
@@ -187,7 +187,8 @@ const char RELAY_PORT_TYPE[] = "relay";
 
 RelayPort::RelayPort(
     talk_base::Thread* thread, talk_base::PacketSocketFactory* factory,
-    talk_base::Network* network, uint32 ip, int min_port, int max_port,
+    talk_base::Network* network,
+    const talk_base::IPAddress& ip, int min_port, int max_port,
     const std::string& username, const std::string& password,
     const std::string& magic_cookie)
     : Port(thread, RELAY_PORT_TYPE, factory, network, ip, min_port, max_port),
@@ -554,8 +555,7 @@ int RelayEntry::SendTo(const void* data, size_t size,
 
   StunAddressAttribute* addr_attr =
       StunAttribute::CreateAddress(STUN_ATTR_DESTINATION_ADDRESS);
-  addr_attr->SetIP(addr.ip());
-  addr_attr->SetPort(addr.port());
+  addr_attr->SetAddress(addr);
   request.AddAttribute(addr_attr);
 
   // Attempt to lock
@@ -666,7 +666,7 @@ void RelayEntry::OnReadPacket(talk_base::AsyncPacketSocket* socket,
     return;
   }
 
-  talk_base::ByteBuffer buf(data, size);
+  talk_base::ByteBuffer buf(data, size, talk_base::ByteBuffer::NO_COPY);
   StunMessage msg;
   if (!msg.Read(&buf)) {
     LOG(INFO) << "Incoming packet was not STUN";
@@ -697,12 +697,9 @@ void RelayEntry::OnReadPacket(talk_base::AsyncPacketSocket* socket,
   if (!addr_attr) {
     LOG(INFO) << "Data indication has no source address";
     return;
-  } else if (addr_attr->family() != 1) {
-    LOG(INFO) << "Source address has bad family";
-    return;
   }
 
-  talk_base::SocketAddress remote_addr2(addr_attr->ip(), addr_attr->port());
+  talk_base::SocketAddress remote_addr2(addr_attr->GetAddress());
 
   const StunByteStringAttribute* data_attr = msg.GetByteString(STUN_ATTR_DATA);
   if (!data_attr) {
@@ -761,11 +758,8 @@ void AllocateRequest::OnResponse(StunMessage* response) {
       response->GetAddress(STUN_ATTR_MAPPED_ADDRESS);
   if (!addr_attr) {
     LOG(INFO) << "Allocate response missing mapped address.";
-  } else if (addr_attr->family() != 1) {
-    LOG(INFO) << "Mapped address has bad family";
   } else {
-    talk_base::SocketAddress addr(addr_attr->ip(), addr_attr->port());
-    entry_->OnConnect(addr, connection_);
+    entry_->OnConnect(addr_attr->GetAddress(), connection_);
   }
 
   // We will do a keep-alive regardless of whether this request suceeds.
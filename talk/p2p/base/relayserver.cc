@@ -262,7 +262,7 @@ void RelayServer::OnExternalPacket(
   // The first packet should always be a STUN / TURN packet.  If it isn't, then
   // we should just ignore this packet.
   StunMessage msg;
-  talk_base::ByteBuffer buf(bytes, size);
+  talk_base::ByteBuffer buf(bytes, size, talk_base::ByteBuffer::NO_COPY);
   if (!msg.Read(&buf)) {
     LOG(LS_WARNING) << "Dropping packet: first packet not STUN";
     return;
@@ -311,7 +311,7 @@ bool RelayServer::HandleStun(
     StunMessage* msg) {
 
   // Parse this into a stun message.
-  talk_base::ByteBuffer buf(bytes, size);
+  talk_base::ByteBuffer buf(bytes, size, talk_base::ByteBuffer::NO_COPY);
   if (!msg->Read(&buf)) {
     SendStunError(*msg, socket, remote_addr, 400, "Bad Request", "");
     return false;
@@ -444,8 +444,7 @@ void RelayServer::HandleStunAllocate(
 
   StunAddressAttribute* addr_attr =
       StunAttribute::CreateAddress(STUN_ATTR_MAPPED_ADDRESS);
-  addr_attr->SetIP(ext_addr.ip());
-  addr_attr->SetPort(ext_addr.port());
+  addr_attr->SetAddress(ext_addr);
   response.AddAttribute(addr_attr);
 
   StunUInt32Attribute* res_lifetime_attr =
@@ -478,7 +477,7 @@ void RelayServer::HandleStunSend(
     return;
   }
 
-  talk_base::SocketAddress ext_addr(addr_attr->ip(), addr_attr->port());
+  talk_base::SocketAddress ext_addr(addr_attr->GetAddress());
   RelayServerConnection* ext_conn =
       int_conn->binding()->GetExternalConnection(ext_addr);
   if (!ext_conn) {
@@ -620,8 +619,7 @@ void RelayServerConnection::Send(
 
   StunAddressAttribute* addr_attr =
       StunAttribute::CreateAddress(STUN_ATTR_SOURCE_ADDRESS2);
-  addr_attr->SetIP(from_addr.ip());
-  addr_attr->SetPort(from_addr.port());
+  addr_attr->SetAddress(from_addr);
   msg.AddAttribute(addr_attr);
 
   StunByteStringAttribute* data_attr =
@@ -0,0 +1,454 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "talk/p2p/base/sharedudpport.h"
+
+#include "talk/base/byteorder.h"
+#include "talk/base/common.h"
+#include "talk/base/logging.h"
+#include "talk/base/nethelpers.h"
+#include "talk/p2p/base/common.h"
+#include "talk/p2p/base/stun.h"
+#include "talk/p2p/base/stunport.h"
+#include "talk/p2p/base/udpport.h"
+
+namespace cricket {
+
+// Same as for StunPort.
+static const int kKeepAliveDelay = 10 * 1000;  // 10 seconds
+static const int kRetryDelay = 50;             // 50ms, from ICE spec
+static const int kRetryTimeout = 50 * 1000;    // ICE says 50 secs
+
+static const size_t kStunHeaderSize = 20;
+
+// Handles a binding request sent to the STUN server on behalf of all ports
+// of a SharedUDPSocket.
+class SharedStunBindingRequest : public StunRequest {
+ public:
+  explicit SharedStunBindingRequest(SharedUDPSocket* socket)
+      : socket_(socket), start_time_(talk_base::Time()) {
+  }
+
+  virtual void Prepare(StunMessage* request) {
+    request->SetType(STUN_BINDING_REQUEST);
+  }
+
+  virtual void OnResponse(StunMessage* response) {
+    const StunAddressAttribute* addr_attr =
+        response->GetAddress(STUN_ATTR_MAPPED_ADDRESS);
+    if (!addr_attr) {
+      LOG(LS_ERROR) << "Binding response missing mapped address.";
+    } else {
+      socket_->OnMappedAddress(addr_attr->GetAddress());
+    }
+
+    // Keep the NAT binding alive for as long as the socket is in use.
+    socket_->requests_.SendDelayed(new SharedStunBindingRequest(socket_),
+                                   kKeepAliveDelay);
+  }
+
+  virtual void OnErrorResponse(StunMessage* response) {
+    const StunErrorCodeAttribute* attr = response->GetErrorCode();
+    if (!attr) {
+      LOG(LS_ERROR) << "Bad allocate response error code";
+    } else {
+      LOG(LS_ERROR) << "Binding error response:"
+                    << " class=" << attr->error_class()
+                    << " number=" << attr->number()
+                    << " reason='" << attr->reason() << "'";
+    }
+    socket_->OnMappedAddressError();
+    if (talk_base::TimeSince(start_time_) <= kRetryTimeout) {
+      socket_->requests_.SendDelayed(new SharedStunBindingRequest(socket_),
+                                     kKeepAliveDelay);
+    }
+  }
+
+  virtual void OnTimeout() {
+    LOG(LS_ERROR) << "Binding request timed out from "
+                  << socket_->local_address().ToString();
+    socket_->OnMappedAddressError();
+    if (talk_base::TimeSince(start_time_) <= kRetryTimeout) {
+      socket_->requests_.SendDelayed(new SharedStunBindingRequest(socket_),
+                                     kRetryDelay);
+    }
+  }
+
+ private:
+  SharedUDPSocket* socket_;
+  uint32 start_time_;
+};
+
+// SharedUDPSocket
+
+SharedUDPSocket* SharedUDPSocket::Create(
+    talk_base::Thread* thread, talk_base::PacketSocketFactory* factory,
+    const talk_base::IPAddress& ip, int min_port, int max_port,
+    const talk_base::SocketAddress& stun_server) {
+  talk_base::AsyncPacketSocket* socket = factory->CreateUdpSocket(
+      talk_base::SocketAddress(ip, 0), min_port, max_port);
+  if (!socket) {
+    LOG(LS_WARNING) << "Shared UDP socket creation failed";
+    return NULL;
+  }
+  return new SharedUDPSocket(thread, socket, stun_server);
+}
+
+SharedUDPSocket::SharedUDPSocket(talk_base::Thread* thread,
+                                 talk_base::AsyncPacketSocket* socket,
+                                 const talk_base::SocketAddress& stun_server)
+    : socket_(socket),
+      stun_server_(stun_server),
+      mapped_address_requested_(false),
+      requests_(thread),
+      resolver_(NULL),
+      error_(0) {
+  socket_->SignalAddressReady.connect(this, &SharedUDPSocket::OnAddressReady);
+  socket_->SignalReadPacket.connect(this, &SharedUDPSocket::OnReadPacket);
+  requests_.SignalSendPacket.connect(this,
+                                     &SharedUDPSocket::OnSendStunPacket);
+}
+
+SharedUDPSocket::~SharedUDPSocket() {
+  ASSERT(ports_.empty());
+  SignalDestroyed(this);
+  if (resolver_) {
+    resolver_->Destroy(false);
+  }
+  delete socket_;
+}
+
+void SharedUDPSocket::RequestMappedAddress() {
+  if (mapped_address_requested_)
+    return;
+  mapped_address_requested_ = true;
+
+  if (stun_server_.IsUnresolved()) {
+    resolver_ = new talk_base::AsyncResolver();
+    resolver_->SignalWorkDone.connect(this, &SharedUDPSocket::OnResolveResult);
+    resolver_->set_address(stun_server_);
+    resolver_->Start();
+  } else {
+    requests_.Send(new SharedStunBindingRequest(this));
+  }
+}
+
+int SharedUDPSocket::SendTo(const void* data, size_t size,
+                            const talk_base::SocketAddress& addr) {
+  int sent = socket_->SendTo(data, size, addr);
+  if (sent < 0) {
+    error_ = socket_->GetError();
+    LOG(LS_ERROR) << "Shared UDP send of " << size
+                  << " bytes failed with error " << error_;
+  }
+  return sent;
+}
+
+int SharedUDPSocket::SetOption(talk_base::Socket::Option opt, int value) {
+  return socket_->SetOption(opt, value);
+}
+
+int SharedUDPSocket::GetError() const {
+  return error_;
+}
+
+void SharedUDPSocket::AddPort(SharedUDPPort* port) {
+  ports_.insert(port);
+  const std::string& username = port->username_fragment();
+  ASSERT(ports_by_username_.find(username) == ports_by_username_.end());
+  ports_by_username_[username] = port;
+  username_lengths_.insert(username.size());
+}
+
+void SharedUDPSocket::RemovePort(SharedUDPPort* port) {
+  ports_by_username_.erase(port->username_fragment());
+  ports_.erase(port);
+  if (ports_.empty()) {
+    delete this;
+  }
+}
+
+bool SharedUDPSocket::AddRemoteAddress(const talk_base::SocketAddress& addr,
+                                       SharedUDPPort* port) {
+  if (IsClaimedByOtherSession(addr, port)) {
+    LOG(LS_WARNING) << "Ports of another session on "
+                    << local_address().ToString() << " connect to "
+                    << addr.ToString() << "; not sharing it";
+    return false;
+  }
+  std::pair<RemoteMap::iterator, RemoteMap::iterator> range =
+      ports_by_remote_address_.equal_range(addr);
+  for (RemoteMap::iterator it = range.first; it != range.second; ++it) {
+    if (it->second == port)
+      return true;
+  }
+  // Goes after any equal keys, so the earliest port keeps getting the data.
+  ports_by_remote_address_.insert(std::make_pair(addr, port));
+  return true;
+}
+
+bool SharedUDPSocket::IsClaimedByOtherSession(
+    const talk_base::SocketAddress& addr, const SharedUDPPort* port) const {
+  // All ports registered for an address belong to the same session.
+  RemoteMap::const_iterator it = ports_by_remote_address_.find(addr);
+  return it != ports_by_remote_address_.end() &&
+      it->second->session() != port->session();
+}
+
+void SharedUDPSocket::RemoveRemoteAddress(const talk_base::SocketAddress& addr,
+                                          SharedUDPPort* port) {
+  std::pair<RemoteMap::iterator, RemoteMap::iterator> range =
+      ports_by_remote_address_.equal_range(addr);
+  for (RemoteMap::iterator it = range.first; it != range.second; ++it) {
+    if (it->second == port) {
+      ports_by_remote_address_.erase(it);
+      return;
+    }
+  }
+}
+
+SharedUDPPort* SharedUDPSocket::FindStunTarget(const char* data,
+                                               size_t size) const {
+  // Cheap checks first, so that media packets are not parsed: a STUN
+  // message starts with two zero bits and its length excludes the header.
+  if (size < kStunHeaderSize || (data[0] & 0xC0) != 0 ||
+      talk_base::GetBE16(data + 2) + kStunHeaderSize != size) {
+    return NULL;
+  }
+
+  StunMessage msg;
+  talk_base::ByteBuffer buf(data, size, talk_base::ByteBuffer::NO_COPY);
+  if (!msg.Read(&buf)) {
+    return NULL;
+  }
+  const StunByteStringAttribute* username_attr =
+      msg.GetByteString(STUN_ATTR_USERNAME);
+  if (!username_attr) {
+    return NULL;
+  }
+
+  // See Port::GetStunMessage: requests start with the fragment of the port
+  // they are addressed to, and responses end with it.
+  if (msg.type() == STUN_BINDING_REQUEST) {
+    return FindPortByUsername(username_attr->bytes(), username_attr->length(),
+                              true);
+  } else if (msg.type() == STUN_BINDING_RESPONSE ||
+             msg.type() == STUN_BINDING_ERROR_RESPONSE) {
+    return FindPortByUsername(username_attr->bytes(), username_attr->length(),
+                              false);
+  }
+  return NULL;
+}
+
+SharedUDPPort* SharedUDPSocket::FindPortByUsername(const char* username,
+                                                   size_t len,
+                                                   bool prefix) const {
+  for (std::set<size_t>::const_iterator it = username_lengths_.begin();
+       it != username_lengths_.end(); ++it) {
+    if (*it > len)
+      continue;
+    std::string fragment(prefix ? username : username + len - *it, *it);
+    UsernameMap::const_iterator port = ports_by_username_.find(fragment);
+    if (port != ports_by_username_.end())
+      return port->second;
+  }
+  return NULL;
+}
+
+void SharedUDPSocket::OnAddressReady(talk_base::AsyncPacketSocket* socket,
+                                     const talk_base::SocketAddress& address) {
+  SignalAddressReady(this);
+}
+
+void SharedUDPSocket::OnReadPacket(
+    talk_base::AsyncPacketSocket* socket, const char* data, size_t size,
+    const talk_base::SocketAddress& remote_addr) {
+  ASSERT(socket == socket_);
+
+  // Responses from the STUN server are ours. As in StunPort, we eat them even
+  // if they don't match an outstanding request.
+  if (!stun_server_.IsUnresolved() && remote_addr == stun_server_) {
+    requests_.CheckResponse(data, size);
+    return;
+  }
+
+  SharedUDPPort* port = FindStunTarget(data, size);
+  if (!port) {
+    RemoteMap::iterator it = ports_by_remote_address_.lower_bound(
+        remote_addr);
+    if (it != ports_by_remote_address_.end() && it->first == remote_addr)
+      port = it->second;
+  }
+  if (port) {
+    port->OnSocketReadPacket(data, size, remote_addr);
+  } else {
+    LOG(LS_VERBOSE) << "Shared UDP socket " << local_address().ToString()
+                    << " dropped packet from " << remote_addr.ToString()
+                    << " for unknown port";
+  }
+}
+
+void SharedUDPSocket::OnResolveResult(talk_base::AsyncResolver* resolver) {
+  ASSERT(resolver == resolver_);
+  if (resolver_->error() != 0) {
+    LOG(LS_WARNING) << "SharedUDPSocket: stun host lookup received error "
+                    << resolver_->error();
+    OnMappedAddressError();
+    return;
+  }
+
+  stun_server_ = resolver_->address();
+  requests_.Send(new SharedStunBindingRequest(this));
+}
+
+void SharedUDPSocket::OnSendStunPacket(const void* data, size_t size,
+                                       StunRequest* req) {
+  if (socket_->SendTo(data, size, stun_server_) < 0)
+    PLOG(LERROR, socket_->GetError()) << "sendto";
+}
+
+void SharedUDPSocket::OnMappedAddress(const talk_base::SocketAddress& addr) {
+  bool changed = (addr != mapped_address_);
+  mapped_address_ = addr;
+  if (changed)
+    SignalMappedAddressReady(this);
+}
+
+void SharedUDPSocket::OnMappedAddressError() {
+  SignalMappedAddressError(this);
+}
+
+// SharedUDPPort
+
+SharedUDPPort::SharedUDPPort(talk_base::Thread* thread,
+                             talk_base::PacketSocketFactory* factory,
+                             talk_base::Network* network,
+                             const talk_base::IPAddress& ip,
+                             SharedUDPSocket* socket,
+                             const PortAllocatorSession* session,
+                             const std::string& type)
+    : Port(thread, type, factory, network, ip, 0, 0),
+      socket_(socket),
+      session_(session),
+      address_ready_(false) {
+  ASSERT(type == LOCAL_PORT_TYPE || type == STUN_PORT_TYPE);
+  socket_->AddPort(this);
+}
+
+SharedUDPPort::~SharedUDPPort() {
+  for (AddressMap::const_iterator it = connections_.begin();
+       it != connections_.end(); ++it) {
+    socket_->RemoveRemoteAddress(it->first, this);
+  }
+  socket_->RemovePort(this);
+}
+
+void SharedUDPPort::PrepareAddress() {
+  if (type_ == LOCAL_PORT_TYPE) {
+    if (socket_->bound()) {
+      OnSocketAddressReady(socket_);
+    } else {
+      socket_->SignalAddressReady.connect(
+          this, &SharedUDPPort::OnSocketAddressReady);
+    }
+  } else {
+    socket_->SignalMappedAddressReady.connect(
+        this, &SharedUDPPort::OnMappedAddressReady);
+    socket_->SignalMappedAddressError.connect(
+        this, &SharedUDPPort::OnMappedAddressError);
+    if (socket_->has_mapped_address()) {
+      OnMappedAddressReady(socket_);
+    } else {
+      socket_->RequestMappedAddress();
+    }
+  }
+}
+
+Connection* SharedUDPPort::CreateConnection(const Candidate& address,
+                                            CandidateOrigin origin) {
+  if (address.protocol() != "udp")
+    return NULL;
+  if (!socket_->AddRemoteAddress(address.address(), this))
+    return NULL;
+
+  Connection* conn = new ProxyConnection(this, 0, address);
+  AddConnection(conn);
+  conn->SignalDestroyed.connect(this, &SharedUDPPort::OnConnectionRemoved);
+  return conn;
+}
+
+int SharedUDPPort::SendTo(const void* data, size_t size,
+                          const talk_base::SocketAddress& addr, bool payload) {
+  return socket_->SendTo(data, size, addr);
+}
+
+int SharedUDPPort::SetOption(talk_base::Socket::Option opt, int value) {
+  // Options apply to all ports on the socket; the last one set wins.
+  return socket_->SetOption(opt, value);
+}
+
+int SharedUDPPort::GetError() {
+  return socket_->GetError();
+}
+
+void SharedUDPPort::OnSocketReadPacket(
+    const char* data, size_t size,
+    const talk_base::SocketAddress& remote_addr) {
+  if (Connection* conn = GetConnection(remote_addr)) {
+    conn->OnReadPacket(data, size);
+  } else if (socket_->IsClaimedByOtherSession(remote_addr, this)) {
+    // We could not create a connection for it; let the remote's checks for
+    // this candidate pair time out.
+    LOG_J(LS_WARNING, this) << "Ignoring packet from "
+                            << remote_addr.ToString()
+                            << ", which another session connects to";
+  } else {
+    Port::OnReadPacket(data, size, remote_addr);
+  }
+}
+
+void SharedUDPPort::OnSocketAddressReady(SharedUDPSocket* socket) {
+  if (address_ready_)
+    return;
+  address_ready_ = true;
+  AddAddress(socket_->local_address(), "udp", true);
+}
+
+void SharedUDPPort::OnMappedAddressReady(SharedUDPSocket* socket) {
+  // Like StunPort, we add another candidate if the mapped address changes.
+  AddAddress(socket_->mapped_address(), "udp", true);
+}
+
+void SharedUDPPort::OnMappedAddressError(SharedUDPSocket* socket) {
+  SignalAddressError(this);
+}
+
+void SharedUDPPort::OnConnectionRemoved(Connection* conn) {
+  socket_->RemoveRemoteAddress(conn->remote_candidate().address(), this);
+}
+
+}  // namespace cricket
@@ -0,0 +1,207 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TALK_P2P_BASE_SHAREDUDPPORT_H_
+#define TALK_P2P_BASE_SHAREDUDPPORT_H_
+
+#include <map>
+#include <set>
+#include <string>
+
+#include "talk/base/asyncpacketsocket.h"
+#include "talk/base/socketaddress.h"
+#include "talk/p2p/base/port.h"
+#include "talk/p2p/base/stunrequest.h"
+
+namespace talk_base {
+class AsyncResolver;
+}
+
+namespace cricket {
+
+class PortAllocatorSession;
+class SharedUDPPort;
+
+// A UDP socket that is shared by the ports of many sessions, so that they
+// need neither a socket of their own nor a STUN binding discovery each.
+// Incoming STUN messages are handed to the port whose username fragment is
+// in their USERNAME; everything else is handed to a port that has a
+// connection to the sender. Several ports of one session (e.g. its LOCAL
+// and STUN ports) may connect to the same remote address; the earliest of
+// them that still has its connection then gets the data. Media carries
+// nothing that tells sessions apart, so a remote address is never shared by
+// ports of different sessions: the later one does not connect to it.
+// The socket deletes itself once its last port is gone.
+class SharedUDPSocket : public sigslot::has_slots<> {
+ public:
+  // The STUN server may be nil if no mapped address is needed.
+  static SharedUDPSocket* Create(talk_base::Thread* thread,
+                                 talk_base::PacketSocketFactory* factory,
+                                 const talk_base::IPAddress& ip,
+                                 int min_port, int max_port,
+                                 const talk_base::SocketAddress& stun_server);
+
+  bool bound() const {
+    return socket_->GetState() == talk_base::AsyncPacketSocket::STATE_BOUND;
+  }
+  talk_base::SocketAddress local_address() const {
+    return socket_->GetLocalAddress();
+  }
+
+  // The address of the socket as seen by the STUN server. Once it has been
+  // found, it is kept up to date by a single keep-alive for all ports.
+  bool has_mapped_address() const { return !mapped_address_.IsNil(); }
+  const talk_base::SocketAddress& mapped_address() const {
+    return mapped_address_;
+  }
+  // Starts looking for the mapped address, unless that is already under way.
+  void RequestMappedAddress();
+
+  size_t port_count() const { return ports_.size(); }
+
+  int SendTo(const void* data, size_t size,
+             const talk_base::SocketAddress& addr);
+  int SetOption(talk_base::Socket::Option opt, int value);
+  int GetError() const;
+
+  sigslot::signal1<SharedUDPSocket*> SignalAddressReady;
+  sigslot::signal1<SharedUDPSocket*> SignalMappedAddressReady;
+  sigslot::signal1<SharedUDPSocket*> SignalMappedAddressError;
+  sigslot::signal1<SharedUDPSocket*> SignalDestroyed;
+
+ private:
+  SharedUDPSocket(talk_base::Thread* thread,
+                  talk_base::AsyncPacketSocket* socket,
+                  const talk_base::SocketAddress& stun_server);
+  ~SharedUDPSocket();
+
+  // Called by SharedUDPPort.
+  void AddPort(SharedUDPPort* port);
+  void RemovePort(SharedUDPPort* port);
+  // Returns false, without adding the address, if a port of another
+  // session already connects to it.
+  bool AddRemoteAddress(const talk_base::SocketAddress& addr,
+                        SharedUDPPort* port);
+  // Returns true if a port of another session connects to the address.
+  bool IsClaimedByOtherSession(const talk_base::SocketAddress& addr,
+                               const SharedUDPPort* port) const;
+  void RemoveRemoteAddress(const talk_base::SocketAddress& addr,
+                           SharedUDPPort* port);
+
+  // Returns the port that a STUN message in the packet is addressed to.
+  SharedUDPPort* FindStunTarget(const char* data, size_t size) const;
+  SharedUDPPort* FindPortByUsername(const char* username, size_t len,
+                                    bool prefix) const;
+
+  void OnAddressReady(talk_base::AsyncPacketSocket* socket,
+                      const talk_base::SocketAddress& address);
+  void OnReadPacket(talk_base::AsyncPacketSocket* socket,
+                    const char* data, size_t size,
+                    const talk_base::SocketAddress& remote_addr);
+  void OnResolveResult(talk_base::AsyncResolver* resolver);
+  void OnSendStunPacket(const void* data, size_t size, StunRequest* req);
+  void OnMappedAddress(const talk_base::SocketAddress& addr);
+  void OnMappedAddressError();
+
+  typedef std::map<std::string, SharedUDPPort*> UsernameMap;
+  typedef std::multimap<talk_base::SocketAddress, SharedUDPPort*> RemoteMap;
+
+  talk_base::AsyncPacketSocket* socket_;
+  talk_base::SocketAddress stun_server_;
+  talk_base::SocketAddress mapped_address_;
+  bool mapped_address_requested_;
+  StunRequestManager requests_;
+  talk_base::AsyncResolver* resolver_;
+  std::set<SharedUDPPort*> ports_;
+  UsernameMap ports_by_username_;
+  std::set<size_t> username_lengths_;
+  RemoteMap ports_by_remote_address_;
+  int error_;
+
+  friend class SharedUDPPort;
+  friend class SharedStunBindingRequest;
+  DISALLOW_COPY_AND_ASSIGN(SharedUDPSocket);
+};
+
+// A port on a SharedUDPSocket. Depending on its type, it provides either the
+// local address of the socket (LOCAL_PORT_TYPE) or its STUN mapped address
+// (STUN_PORT_TYPE) as its candidate.
+// The session identifies the ports that may connect to the same remote
+// address; it is not used otherwise.
+class SharedUDPPort : public Port {
+ public:
+  static SharedUDPPort* Create(talk_base::Thread* thread,
+                               talk_base::PacketSocketFactory* factory,
+                               talk_base::Network* network,
+                               const talk_base::IPAddress& ip,
+                               SharedUDPSocket* socket,
+                               const PortAllocatorSession* session,
+                               const std::string& type) {
+    return new SharedUDPPort(thread, factory, network, ip, socket, session,
+                             type);
+  }
+  virtual ~SharedUDPPort();
+
+  SharedUDPSocket* shared_socket() { return socket_; }
+  const PortAllocatorSession* session() const { return session_; }
+
+  virtual void PrepareAddress();
+  virtual Connection* CreateConnection(const Candidate& address,
+                                       CandidateOrigin origin);
+
+  virtual int SetOption(talk_base::Socket::Option opt, int value);
+  virtual int GetError();
+
+ protected:
+  SharedUDPPort(talk_base::Thread* thread,
+                talk_base::PacketSocketFactory* factory,
+                talk_base::Network* network, const talk_base::IPAddress& ip,
+                SharedUDPSocket* socket, const PortAllocatorSession* session,
+                const std::string& type);
+
+  virtual int SendTo(const void* data, size_t size,
+                     const talk_base::SocketAddress& remote_addr, bool payload);
+
+ private:
+  // Dispatches a packet that the shared socket has found to be ours.
+  void OnSocketReadPacket(const char* data, size_t size,
+                          const talk_base::SocketAddress& remote_addr);
+  void OnSocketAddressReady(SharedUDPSocket* socket);
+  void OnMappedAddressReady(SharedUDPSocket* socket);
+  void OnMappedAddressError(SharedUDPSocket* socket);
+  void OnConnectionRemoved(Connection* conn);
+
+  SharedUDPSocket* socket_;
+  const PortAllocatorSession* session_;
+  bool address_ready_;
+
+  friend class SharedUDPSocket;
+};
+
+}  // namespace cricket
+
+#endif  // TALK_P2P_BASE_SHAREDUDPPORT_H_
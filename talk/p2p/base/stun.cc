@@ -69,6 +69,7 @@ void StunMessage::SetTransactionID(const std::string& str) {
 }
 
 void StunMessage::AddAttribute(StunAttribute* attr) {
+  attr->SetOwner(this);
   attrs_->push_back(attr);
   length_ += attr->length() + 4;
 }
@@ -195,8 +196,11 @@ bool StunMessage::Read(ByteBuffer* buf) {
       if (!buf->Consume(attr_length))
         return false;
     } else {
-      if (!attr->Read(buf))
+      attr->SetOwner(this);
+      if (!attr->Read(buf)) {
+        delete attr;
         return false;
+      }
       attrs_->push_back(attr);
     }
   }
@@ -234,12 +238,10 @@ StunAttribute* StunAttribute::Create(uint16 type, uint16 length) {
     case STUN_ATTR_MAPPED_ADDRESS:
     case STUN_ATTR_DESTINATION_ADDRESS:
     case STUN_ATTR_SOURCE_ADDRESS2:
-      // TODO: Addresses may be different size for IPv6
-      // addresses, but we don't support IPv6 yet. Fix address parsing
-      // when IPv6 support is implemented.
-      if (length != StunAddressAttribute::SIZE)
+      if (length != StunAddressAttribute::SIZE &&
+          length != StunAddressAttribute::SIZE_IPV6)
         return NULL;
-      return new StunAddressAttribute(type);
+      return new StunAddressAttribute(type, length);
 
     case STUN_ATTR_LIFETIME:
     case STUN_ATTR_BANDWIDTH:
@@ -267,12 +269,10 @@ StunAttribute* StunAttribute::Create(uint16 type, uint16 length) {
       return (length % 2 == 0) ? new StunUInt16ListAttribute(type, length) : 0;
 
     case STUN_ATTR_XOR_MAPPED_ADDRESS:
-      // TODO: Addresses may be different size for IPv6
-      // addresses, but we don't support IPv6 yet. Fix address parsing
-      // when IPv6 support is implemented.
-      if (length != StunAddressAttribute::SIZE)
+      if (length != StunAddressAttribute::SIZE &&
+          length != StunAddressAttribute::SIZE_IPV6)
         return NULL;
-      return new StunXorAddressAttribute(type);
+      return new StunXorAddressAttribute(type, length);
 
     default:
       return NULL;
@@ -284,10 +284,10 @@ StunAddressAttribute* StunAttribute::CreateAddress(uint16 type) {
     case STUN_ATTR_MAPPED_ADDRESS:
     case STUN_ATTR_DESTINATION_ADDRESS:
     case STUN_ATTR_SOURCE_ADDRESS2:
-      return new StunAddressAttribute(type);
+      return new StunAddressAttribute(type, StunAddressAttribute::SIZE);
 
     case STUN_ATTR_XOR_MAPPED_ADDRESS:
-      return new StunXorAddressAttribute(type);
+      return new StunXorAddressAttribute(type, StunAddressAttribute::SIZE);
 
   default:
     ASSERT(false);
@@ -331,12 +331,18 @@ StunUInt16ListAttribute* StunAttribute::CreateUnknownAttributes() {
   return new StunUInt16ListAttribute(STUN_ATTR_UNKNOWN_ATTRIBUTES, 0);
 }
 
-StunAddressAttribute::StunAddressAttribute(uint16 type)
-    : StunAttribute(type, SIZE), family_(STUN_ADDRESS_IPV4), port_(0), ip_(0) {
+StunAddressAttribute::StunAddressAttribute(uint16 type, uint16 length)
+    : StunAttribute(type, length), port_(0) {
 }
 
-void StunAddressAttribute::SetFamily(StunAddressFamily family) {
-  family_ = family;
+void StunAddressAttribute::SetIP(const talk_base::IPAddress& ip) {
+  ip_ = ip;
+  SetLength(ip.IsIPv6() ? SIZE_IPV6 : SIZE);
+}
+
+void StunAddressAttribute::SetAddress(const talk_base::SocketAddress& addr) {
+  SetIP(addr.ipaddr());
+  SetPort(addr.port());
 }
 
 bool StunAddressAttribute::Read(ByteBuffer* buf) {
@@ -344,35 +350,77 @@ bool StunAddressAttribute::Read(ByteBuffer* buf) {
   if (!buf->ReadUInt8(&dummy))
     return false;
 
+  // The family has to agree with the length that StunAttribute::Create()
+  // accepted.
   uint8 family;
-  // We don't expect IPv6 address here because IPv6 addresses would
-  // not pass the attribute size check in StunAttribute::Create().
-  if (!buf->ReadUInt8(&family) || family != STUN_ADDRESS_IPV4) {
+  if (!buf->ReadUInt8(&family))
     return false;
-  }
-  family_ = static_cast<StunAddressFamily>(family);
 
   if (!buf->ReadUInt16(&port_))
     return false;
 
-  if (!buf->ReadUInt32(&ip_))
+  if (family == STUN_ADDRESS_IPV4 && length() == SIZE) {
+    uint32 ip;
+    if (!buf->ReadUInt32(&ip))
+      return false;
+    ip_ = talk_base::IPAddress(ip);
+  } else if (family == STUN_ADDRESS_IPV6 && length() == SIZE_IPV6) {
+    uint8 ip[talk_base::IPAddress::kIPv6Size];
+    if (!buf->ReadBytes(reinterpret_cast<char*>(ip), sizeof(ip)))
+      return false;
+    ip_ = talk_base::IPAddress::FromIPv6(ip);
+  } else {
     return false;
+  }
 
   return true;
 }
 
 void StunAddressAttribute::Write(ByteBuffer* buf) const {
-  // Only IPv4 address family is currently supported.
-  ASSERT(family_ == STUN_ADDRESS_IPV4);
+  WriteAddress(buf, port_, ip_);
+}
+
+void StunAddressAttribute::WriteAddress(ByteBuffer* buf, uint16 port,
+                                        const talk_base::IPAddress& ip) const {
+  ASSERT(length() == (ip.IsIPv6() ? SIZE_IPV6 : SIZE));
 
   buf->WriteUInt8(0);
-  buf->WriteUInt8(family_);
-  buf->WriteUInt16(port_);
-  buf->WriteUInt32(ip_);
+  buf->WriteUInt8(ip.IsIPv6() ? STUN_ADDRESS_IPV6 : STUN_ADDRESS_IPV4);
+  buf->WriteUInt16(port);
+  if (ip.IsIPv6()) {
+    buf->WriteBytes(reinterpret_cast<const char*>(ip.ipv6()),
+                    talk_base::IPAddress::kIPv6Size);
+  } else {
+    buf->WriteUInt32(ip.ipv4());
+  }
+}
+
+StunXorAddressAttribute::StunXorAddressAttribute(uint16 type, uint16 length)
+    : StunAddressAttribute(type, length), owner_(NULL) {
 }
 
-StunXorAddressAttribute::StunXorAddressAttribute(uint16 type)
-    : StunAddressAttribute(type) {
+// IPv4 addresses are XORed with the magic cookie.  IPv6 addresses are XORed
+// with the magic cookie followed by the 12-byte transaction id; legacy
+// messages, whose 16-byte id already starts where the cookie would be,
+// contribute their last 12 bytes.
+talk_base::IPAddress StunXorAddressAttribute::GetXoredIP() const {
+  if (!ipaddr().IsIPv6())
+    return talk_base::IPAddress(ipaddr().ipv4() ^ kStunMagicCookie);
+
+  uint8 key[talk_base::IPAddress::kIPv6Size] = { 0 };
+  talk_base::SetBE32(key, kStunMagicCookie);
+  if (owner_) {
+    const std::string& id = owner_->transaction_id();
+    ASSERT(id.size() >= kStunTransactionIdLength);
+    memcpy(key + kStunMagicCookieLength,
+           id.data() + id.size() - kStunTransactionIdLength,
+           kStunTransactionIdLength);
+  }
+
+  uint8 ip[talk_base::IPAddress::kIPv6Size];
+  for (size_t i = 0; i < sizeof(ip); ++i)
+    ip[i] = ipaddr().ipv6()[i] ^ key[i];
+  return talk_base::IPAddress::FromIPv6(ip);
 }
 
 bool StunXorAddressAttribute::Read(ByteBuffer* buf) {
@@ -380,19 +428,13 @@ bool StunXorAddressAttribute::Read(ByteBuffer* buf) {
     return false;
 
   SetPort(port() ^ (kStunMagicCookie >> 16));
-  SetIP(ip() ^ kStunMagicCookie);
+  SetIP(GetXoredIP());
 
   return true;
 }
 
 void StunXorAddressAttribute::Write(ByteBuffer* buf) const {
-  // Only IPv4 address family is currently supported.
-  ASSERT(family() == STUN_ADDRESS_IPV4);
-
-  buf->WriteUInt8(0);
-  buf->WriteUInt8(family());
-  buf->WriteUInt16(port() ^ (kStunMagicCookie >> 16));
-  buf->WriteUInt32(ip() ^ kStunMagicCookie);
+  WriteAddress(buf, port() ^ (kStunMagicCookie >> 16), GetXoredIP());
 }
 
 StunUInt32Attribute::StunUInt32Attribute(uint16 type)
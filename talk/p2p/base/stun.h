@@ -36,6 +36,7 @@
 
 #include "talk/base/basictypes.h"
 #include "talk/base/bytebuffer.h"
+#include "talk/base/socketaddress.h"
 
 namespace cricket {
 
@@ -184,6 +185,10 @@ public:
   // value is true if successful.
   virtual void Write(talk_base::ByteBuffer* buf) const = 0;
 
+  // Tells the attribute which message it belongs to.  Called before the
+  // attribute is read, and when it is added to a message.
+  virtual void SetOwner(StunMessage* owner) {}
+
   // Creates an attribute object with the given type and len.
   static StunAttribute* Create(uint16 type, uint16 length);
 
@@ -205,37 +210,57 @@ private:
   uint16 length_;
 };
 
-// Implements STUN/TURN attributes that record an Internet address.
+// Implements STUN/TURN attributes that record an Internet address.  The
+// address may be IPv4 or IPv6; the length of the attribute follows it.
 class StunAddressAttribute : public StunAttribute {
 public:
-  explicit StunAddressAttribute(uint16 type);
+  StunAddressAttribute(uint16 type, uint16 length);
 
   static const uint16 SIZE = 8;
+  static const uint16 SIZE_IPV6 = 20;
 
-  StunAddressFamily family() const { return family_; }
+  StunAddressFamily family() const {
+    return ip_.IsIPv6() ? STUN_ADDRESS_IPV6 : STUN_ADDRESS_IPV4;
+  }
   uint16 port() const { return port_; }
-  uint32 ip() const { return ip_; }
+  uint32 ip() const { return ip_.ipv4(); }
+  const talk_base::IPAddress& ipaddr() const { return ip_; }
+  talk_base::SocketAddress GetAddress() const {
+    return talk_base::SocketAddress(ip_, port_);
+  }
 
-  void SetFamily(StunAddressFamily family);
-  void SetIP(uint32 ip) { ip_ = ip; }
+  // Changing the IP changes the length of the attribute, so the address
+  // should be set before the attribute is added to a message.
+  void SetIP(const talk_base::IPAddress& ip);
   void SetPort(uint16 port) { port_ = port; }
+  void SetAddress(const talk_base::SocketAddress& addr);
 
   virtual bool Read(talk_base::ByteBuffer* buf);
   virtual void Write(talk_base::ByteBuffer* buf) const;
 
+protected:
+  void WriteAddress(talk_base::ByteBuffer* buf, uint16 port,
+                    const talk_base::IPAddress& ip) const;
+
 private:
-  StunAddressFamily family_;
   uint16 port_;
-  uint32 ip_;
+  talk_base::IPAddress ip_;
 };
 
-// Implements STUN/TURN attributes that record an Internet address.
+// Implements STUN/TURN attributes that record an Internet address XORed with
+// the magic cookie, and for IPv6 also with the transaction id of the message.
 class StunXorAddressAttribute : public StunAddressAttribute {
 public:
-  explicit StunXorAddressAttribute(uint16 type);
+  StunXorAddressAttribute(uint16 type, uint16 length);
 
   virtual bool Read(talk_base::ByteBuffer* buf);
   virtual void Write(talk_base::ByteBuffer* buf) const;
+  virtual void SetOwner(StunMessage* owner) { owner_ = owner; }
+
+private:
+  talk_base::IPAddress GetXoredIP() const;
+
+  StunMessage* owner_;
 };
 
 // Implements STUN/TURN attributs that record a 32-bit integer.
@@ -0,0 +1,151 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string>
+
+#include "talk/base/bytebuffer.h"
+#include "talk/base/gunit.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/p2p/base/stun.h"
+
+using talk_base::ByteBuffer;
+using talk_base::IPAddress;
+using talk_base::SocketAddress;
+
+namespace cricket {
+
+// The IPv6 binding response from RFC 5769, section 2.2, without its
+// SOFTWARE, MESSAGE-INTEGRITY and FINGERPRINT attributes.
+static const unsigned char kRfc5769XorMappedIPv6[] = {
+  0x01, 0x01, 0x00, 0x18,  // Binding response, length 24
+  0x21, 0x12, 0xa4, 0x42,  // Magic cookie
+  0xb7, 0xe7, 0xa7, 0x01,  // Transaction id
+  0xbc, 0x34, 0xd6, 0x86,
+  0xfa, 0x87, 0xdf, 0xae,
+  0x00, 0x20, 0x00, 0x14,  // XOR-MAPPED-ADDRESS, length 20
+  0x00, 0x02, 0xa1, 0x47,  // IPv6, XORed port
+  0x01, 0x13, 0xa9, 0xfa,  // XORed address
+  0xa5, 0xd3, 0xf1, 0x79,
+  0xbc, 0x25, 0xf4, 0xb5,
+  0xbe, 0xd2, 0xb9, 0xd9,
+};
+static const char kRfc5769IPv6[] = "2001:db8:1234:5678:11:2233:4455:6677";
+static const int kRfc5769Port = 32853;
+
+static SocketAddress MakeAddress(const char* ip, int port) {
+  IPAddress addr;
+  EXPECT_TRUE(IPAddress::FromString(ip, &addr));
+  return SocketAddress(addr, port);
+}
+
+// Writes a message holding one address attribute and reads it back.
+static void RoundTrip(StunAttributeType type, const SocketAddress& addr,
+                      const std::string& transaction_id) {
+  StunMessage msg;
+  msg.SetType(STUN_BINDING_RESPONSE);
+  msg.SetTransactionID(transaction_id);
+  StunAddressAttribute* attr = StunAttribute::CreateAddress(type);
+  attr->SetAddress(addr);
+  msg.AddAttribute(attr);
+
+  ByteBuffer buf;
+  msg.Write(&buf);
+
+  StunMessage read_msg;
+  ASSERT_TRUE(read_msg.Read(&buf));
+  const StunAddressAttribute* read_attr = read_msg.GetAddress(type);
+  ASSERT_TRUE(read_attr != NULL);
+  EXPECT_EQ(addr.IsIPv6() ? STUN_ADDRESS_IPV6 : STUN_ADDRESS_IPV4,
+            read_attr->family());
+  EXPECT_EQ(addr, read_attr->GetAddress());
+}
+
+TEST(StunTest, TestReadXorMappedIPv6) {
+  ByteBuffer buf(reinterpret_cast<const char*>(kRfc5769XorMappedIPv6),
+                 sizeof(kRfc5769XorMappedIPv6));
+  StunMessage msg;
+  ASSERT_TRUE(msg.Read(&buf));
+  const StunAddressAttribute* attr =
+      msg.GetAddress(STUN_ATTR_XOR_MAPPED_ADDRESS);
+  ASSERT_TRUE(attr != NULL);
+  EXPECT_EQ(STUN_ADDRESS_IPV6, attr->family());
+  EXPECT_TRUE(StunAddressAttribute::SIZE_IPV6 == attr->length());
+  EXPECT_EQ(MakeAddress(kRfc5769IPv6, kRfc5769Port), attr->GetAddress());
+}
+
+TEST(StunTest, TestWriteXorMappedIPv6) {
+  StunMessage msg;
+  msg.SetType(STUN_BINDING_RESPONSE);
+  msg.SetTransactionID(std::string(
+      reinterpret_cast<const char*>(kRfc5769XorMappedIPv6) + 8,
+      kStunTransactionIdLength));
+  StunAddressAttribute* attr =
+      StunAttribute::CreateAddress(STUN_ATTR_XOR_MAPPED_ADDRESS);
+  attr->SetAddress(MakeAddress(kRfc5769IPv6, kRfc5769Port));
+  msg.AddAttribute(attr);
+
+  ByteBuffer buf;
+  msg.Write(&buf);
+  ASSERT_EQ(sizeof(kRfc5769XorMappedIPv6), buf.Length());
+  EXPECT_EQ(0, memcmp(kRfc5769XorMappedIPv6, buf.Data(), buf.Length()));
+}
+
+TEST(StunTest, TestAddressRoundTrip) {
+  const std::string kId("0123456789ab");
+  const std::string kLegacyId("0123456789abcdef");
+  SocketAddress ipv4(0x01020304, 5000);
+  SocketAddress ipv6 = MakeAddress("2001:db8::1", 5000);
+  RoundTrip(STUN_ATTR_MAPPED_ADDRESS, ipv4, kId);
+  RoundTrip(STUN_ATTR_MAPPED_ADDRESS, ipv6, kId);
+  RoundTrip(STUN_ATTR_DESTINATION_ADDRESS, ipv6, kLegacyId);
+  RoundTrip(STUN_ATTR_SOURCE_ADDRESS2, ipv6, kId);
+  RoundTrip(STUN_ATTR_XOR_MAPPED_ADDRESS, ipv4, kId);
+  RoundTrip(STUN_ATTR_XOR_MAPPED_ADDRESS, ipv6, kId);
+  RoundTrip(STUN_ATTR_XOR_MAPPED_ADDRESS, ipv6, kLegacyId);
+}
+
+TEST(StunTest, TestSetAddressUpdatesLength) {
+  talk_base::scoped_ptr<StunAddressAttribute> attr(
+      StunAttribute::CreateAddress(STUN_ATTR_MAPPED_ADDRESS));
+  EXPECT_TRUE(StunAddressAttribute::SIZE == attr->length());
+  attr->SetAddress(MakeAddress("::1", 1));
+  EXPECT_TRUE(StunAddressAttribute::SIZE_IPV6 == attr->length());
+  attr->SetAddress(SocketAddress(0x7F000001, 1));
+  EXPECT_TRUE(StunAddressAttribute::SIZE == attr->length());
+}
+
+// An address whose family doesn't match its length is rejected.
+TEST(StunTest, TestRejectMismatchedFamily) {
+  unsigned char packet[sizeof(kRfc5769XorMappedIPv6)];
+  memcpy(packet, kRfc5769XorMappedIPv6, sizeof(packet));
+  packet[25] = STUN_ADDRESS_IPV4;
+  ByteBuffer buf(reinterpret_cast<const char*>(packet), sizeof(packet));
+  StunMessage msg;
+  EXPECT_FALSE(msg.Read(&buf));
+}
+
+}  // namespace cricket
@@ -63,11 +63,8 @@ class StunPortBindingRequest : public StunRequest {
         response->GetAddress(STUN_ATTR_MAPPED_ADDRESS);
     if (!addr_attr) {
       LOG(LS_ERROR) << "Binding response missing mapped address.";
-    } else if (addr_attr->family() != 1) {
-      LOG(LS_ERROR) << "Binding address has bad family";
     } else {
-      talk_base::SocketAddress addr(addr_attr->ip(), addr_attr->port());
-      port_->AddAddress(addr, "udp", true);
+      port_->AddAddress(addr_attr->GetAddress(), "udp", true);
     }
 
     // We will do a keep-alive regardless of whether this request suceeds.
@@ -127,7 +124,7 @@ const char STUN_PORT_TYPE[] = "stun";
 StunPort::StunPort(talk_base::Thread* thread,
                    talk_base::PacketSocketFactory* factory,
                    talk_base::Network* network,
-                   uint32 ip, int min_port, int max_port,
+                   const talk_base::IPAddress& ip, int min_port, int max_port,
                    const talk_base::SocketAddress& server_addr)
     : Port(thread, STUN_PORT_TYPE, factory, network, ip, min_port, max_port),
       server_addr_(server_addr),
@@ -233,8 +230,8 @@ void StunPort::ResolveStunAddress() {
   resolver_->Start();
 }
 
-void StunPort::OnResolveResult(talk_base::SignalThread* t) {
-  ASSERT(t == resolver_);
+void StunPort::OnResolveResult(talk_base::AsyncResolver* resolver) {
+  ASSERT(resolver == resolver_);
   if (resolver_->error() != 0) {
     LOG_J(LS_WARNING, this) << "StunPort: stun host lookup received error "
                             << resolver_->error();
@@ -36,7 +36,6 @@
 
 namespace talk_base {
 class AsyncResolver;
-class SignalThread;
 }
 
 namespace cricket {
@@ -49,7 +48,8 @@ class StunPort : public Port {
   static StunPort* Create(talk_base::Thread* thread,
                           talk_base::PacketSocketFactory* factory,
                           talk_base::Network* network,
-                          uint32 ip, int min_port, int max_port,
+                          const talk_base::IPAddress& ip,
+                          int min_port, int max_port,
                           const talk_base::SocketAddress& server_addr) {
     StunPort* port = new StunPort(thread, factory, network,
                                   ip, min_port, max_port, server_addr);
@@ -88,7 +88,8 @@ class StunPort : public Port {
 
  protected:
   StunPort(talk_base::Thread* thread, talk_base::PacketSocketFactory* factory,
-           talk_base::Network* network, uint32 ip, int min_port, int max_port,
+           talk_base::Network* network,
+           const talk_base::IPAddress& ip, int min_port, int max_port,
            const talk_base::SocketAddress& server_addr);
   bool Init();
 
@@ -102,7 +103,7 @@ class StunPort : public Port {
  private:
   // DNS resolution of the STUN server.
   void ResolveStunAddress();
-  void OnResolveResult(talk_base::SignalThread* thread);
+  void OnResolveResult(talk_base::AsyncResolver* resolver);
   // Sends STUN requests to the server.
   void OnSendPacket(const void* data, size_t size, StunRequest* req);
 
@@ -121,7 +121,7 @@ bool StunRequestManager::CheckResponse(const char* data, size_t size) {
 
   // Parse the STUN message and continue processing as usual.
 
-  talk_base::ByteBuffer buf(data, size);
+  talk_base::ByteBuffer buf(data, size, talk_base::ByteBuffer::NO_COPY);
   StunMessage msg;
   if (!msg.Read(&buf))
     return false;
@@ -50,7 +50,7 @@ void StunServer::OnPacket(
   // TODO: If appropriate, look for the magic cookie before parsing.
 
   // Parse the STUN message.
-  talk_base::ByteBuffer bbuf(buf, size);
+  talk_base::ByteBuffer bbuf(buf, size, talk_base::ByteBuffer::NO_COPY);
   StunMessage msg;
   if (!msg.Read(&bbuf)) {
     SendErrorResponse(msg, remote_addr, 400, "Bad Request");
@@ -95,8 +95,7 @@ void StunServer::OnBindingRequest(
   } else {
     mapped_addr = StunAttribute::CreateAddress(STUN_ATTR_XOR_MAPPED_ADDRESS);
   }
-  mapped_addr->SetPort(remote_addr.port());
-  mapped_addr->SetIP(remote_addr.ip());
+  mapped_addr->SetAddress(remote_addr);
   response.AddAttribute(mapped_addr);
 
   // TODO: Add username and message-integrity.
@@ -63,6 +63,7 @@ struct ChannelParams {
 };
 // TODO: Merge ChannelParams and ChannelMessage.
 typedef talk_base::ScopedMessageData<ChannelParams> ChannelMessage;
+typedef talk_base::TypedMessageData<std::vector<Candidate> > CandidatesMessage;
 
 enum {
   MSG_CREATECHANNEL = 1,
@@ -71,13 +72,17 @@ enum {
   MSG_CONNECTCHANNELS = 4,
   MSG_RESETCHANNELS = 5,
   MSG_ONSIGNALINGREADY = 6,
-  MSG_ONREMOTECANDIDATE = 7,
+  MSG_ONREMOTECANDIDATES = 7,
   MSG_READSTATE = 8,
   MSG_WRITESTATE = 9,
   MSG_REQUESTSIGNALING = 10,
   MSG_CANDIDATEREADY = 11,
   MSG_ROUTECHANGE = 12,
   MSG_CONNECTING = 13,
+  MSG_CREATECHANNELASYNC = 14,
+  MSG_DESTROYCHANNELASYNC = 15,
+  MSG_CHANNELCREATED = 16,
+  MSG_CHANNELDESTROYED = 17,
 };
 
 Transport::Transport(talk_base::Thread* signaling_thread,
@@ -99,6 +104,7 @@ TransportChannelImpl* Transport::CreateChannel(
     const std::string& name, const std::string& content_type) {
   ChannelMessage msg(new ChannelParams(name, content_type));
   worker_thread()->Send(this, MSG_CREATECHANNEL, &msg);
+  destroyed_ = false;
   return msg.data()->channel;
 }
 
@@ -117,7 +123,6 @@ TransportChannelImpl* Transport::CreateChannel_w(
   talk_base::CritScope cs(&crit_);
   ASSERT(channels_.find(name) == channels_.end());
   channels_[name] = impl;
-  destroyed_ = false;
   if (connect_requested_) {
     impl->Connect();
     if (channels_.size() == 1) {
@@ -129,6 +134,16 @@ TransportChannelImpl* Transport::CreateChannel_w(
   return impl;
 }
 
+void Transport::CreateChannelAsync(const std::string& name,
+                                   const std::string& content_type) {
+  ASSERT(signaling_thread()->IsCurrent());
+  destroyed_ = false;
+  pending_channels_.insert(name);
+  worker_thread()->Post(this, MSG_CREATECHANNELASYNC,
+                        new ChannelMessage(new ChannelParams(name,
+                                                             content_type)));
+}
+
 TransportChannelImpl* Transport::GetChannel(const std::string& name) {
   talk_base::CritScope cs(&crit_);
   ChannelMap::iterator iter = channels_.find(name);
@@ -145,6 +160,12 @@ void Transport::DestroyChannel(const std::string& name) {
   worker_thread()->Send(this, MSG_DESTROYCHANNEL, &msg);
 }
 
+void Transport::DestroyChannelAsync(const std::string& name) {
+  ASSERT(signaling_thread()->IsCurrent());
+  worker_thread()->Post(this, MSG_DESTROYCHANNELASYNC,
+                        new ChannelMessage(new ChannelParams(name)));
+}
+
 void Transport::DestroyChannel_w(const std::string& name) {
   ASSERT(worker_thread()->IsCurrent());
 
@@ -196,13 +217,19 @@ void Transport::OnConnecting_s() {
 void Transport::DestroyAllChannels() {
   ASSERT(signaling_thread()->IsCurrent());
   worker_thread()->Send(this, MSG_DESTROYALLCHANNELS, NULL);
-  worker_thread()->Clear(this);
   signaling_thread()->Clear(this);
+  pending_channels_.clear();
   destroyed_ = true;
 }
 
 void Transport::DestroyAllChannels_w() {
   ASSERT(worker_thread()->IsCurrent());
+  // Drop the work that is still queued, such as a CreateChannelAsync, so
+  // that no channel comes back after this.  This has to happen here rather
+  // than on the signaling thread, or the worker could pick up a message in
+  // between.
+  worker_thread()->Clear(this);
+
   std::vector<TransportChannelImpl*> impls;
   {
     talk_base::CritScope cs(&crit_);
@@ -282,33 +309,40 @@ bool Transport::VerifyCandidate(const Candidate& cand, ParseError* error) {
 }
 
 void Transport::OnRemoteCandidates(const std::vector<Candidate>& candidates) {
+  ASSERT(signaling_thread()->IsCurrent());
+  if (destroyed_) return;
+
+  std::vector<Candidate> valid_candidates;
   for (std::vector<Candidate>::const_iterator iter = candidates.begin();
        iter != candidates.end();
        ++iter) {
-    OnRemoteCandidate(*iter);
+    // A channel that is still being created gets its candidates after it
+    // is, since both messages go through the worker's queue in order.
+    if (!HasChannel(iter->name()) &&
+        pending_channels_.find(iter->name()) == pending_channels_.end()) {
+      LOG(LS_WARNING) << "Ignoring candidate for unknown channel "
+                      << iter->name();
+      continue;
+    }
+    valid_candidates.push_back(*iter);
   }
-}
-
-void Transport::OnRemoteCandidate(const Candidate& candidate) {
-  ASSERT(signaling_thread()->IsCurrent());
-  if (destroyed_) return;
-  if (!HasChannel(candidate.name())) {
-    LOG(LS_WARNING) << "Ignoring candidate for unknown channel "
-                    << candidate.name();
+  if (valid_candidates.empty())
     return;
-  }
 
-  ChannelMessage* msg = new ChannelMessage(
-      new ChannelParams(new Candidate(candidate)));
-  worker_thread()->Post(this, MSG_ONREMOTECANDIDATE, msg);
+  worker_thread()->Post(this, MSG_ONREMOTECANDIDATES,
+                        new CandidatesMessage(valid_candidates));
 }
 
-void Transport::OnRemoteCandidate_w(const Candidate& candidate) {
+void Transport::OnRemoteCandidates_w(const std::vector<Candidate>& candidates) {
   ASSERT(worker_thread()->IsCurrent());
-  ChannelMap::iterator iter = channels_.find(candidate.name());
-  // It's ok for a channel to go away while this message is in transit.
-  if (iter != channels_.end()) {
-    iter->second->OnCandidate(candidate);
+  for (std::vector<Candidate>::const_iterator iter = candidates.begin();
+       iter != candidates.end();
+       ++iter) {
+    ChannelMap::iterator channel = channels_.find(iter->name());
+    // It's ok for a channel to go away while this message is in transit.
+    if (channel != channels_.end()) {
+      channel->second->OnCandidate(*iter);
+    }
   }
 }
 
@@ -369,8 +403,10 @@ void Transport::OnChannelCandidateReady(TransportChannelImpl* channel,
   talk_base::CritScope cs(&crit_);
   ready_candidates_.push_back(candidate);
 
-  // We hold any messages until the client lets us connect.
-  if (connect_requested_) {
+  // We hold any messages until the client lets us connect.  After that, one
+  // message delivers all candidates that are ready by the time it is handled,
+  // so we only post when the first one of a batch comes in.
+  if (connect_requested_ && ready_candidates_.size() == 1) {
     signaling_thread()->Post(
         this, MSG_CANDIDATEREADY, NULL);
   }
@@ -434,13 +470,45 @@ void Transport::OnMessage(talk_base::Message* msg) {
   case MSG_ONSIGNALINGREADY:
     CallChannels_w(&TransportChannelImpl::OnSignalingReady);
     break;
-  case MSG_ONREMOTECANDIDATE:
+  case MSG_CREATECHANNELASYNC:
     {
       ChannelMessage* channel_msg = static_cast<ChannelMessage*>(msg->pdata);
-      OnRemoteCandidate_w(*(channel_msg->data()->candidate));
+      ChannelParams* params = channel_msg->data().get();
+      CreateChannel_w(params->name, params->content_type);
+      // Hand the message back for the completion.
+      signaling_thread()->Post(this, MSG_CHANNELCREATED, channel_msg);
+    }
+    break;
+  case MSG_DESTROYCHANNELASYNC:
+    {
+      ChannelMessage* channel_msg = static_cast<ChannelMessage*>(msg->pdata);
+      DestroyChannel_w(channel_msg->data()->name);
+      signaling_thread()->Post(this, MSG_CHANNELDESTROYED, channel_msg);
+    }
+    break;
+  case MSG_CHANNELCREATED:
+    {
+      ChannelMessage* channel_msg = static_cast<ChannelMessage*>(msg->pdata);
+      pending_channels_.erase(channel_msg->data()->name);
+      SignalChannelCreated(this, channel_msg->data()->name);
+      delete channel_msg;
+    }
+    break;
+  case MSG_CHANNELDESTROYED:
+    {
+      ChannelMessage* channel_msg = static_cast<ChannelMessage*>(msg->pdata);
+      SignalChannelDestroyed(this, channel_msg->data()->name);
       delete channel_msg;
     }
     break;
+  case MSG_ONREMOTECANDIDATES:
+    {
+      CandidatesMessage* candidates_msg =
+          static_cast<CandidatesMessage*>(msg->pdata);
+      OnRemoteCandidates_w(candidates_msg->data());
+      delete candidates_msg;
+    }
+    break;
   case MSG_CONNECTING:
     OnConnecting_s();
     break;
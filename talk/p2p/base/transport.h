@@ -48,6 +48,7 @@
 
 #include <string>
 #include <map>
+#include <set>
 #include <vector>
 #include "talk/base/criticalsection.h"
 #include "talk/base/messagequeue.h"
@@ -148,6 +149,18 @@ class Transport : public talk_base::MessageHandler,
   bool HasChannels();
   void DestroyChannel(const std::string& name);
 
+  // Versions of CreateChannel and DestroyChannel that do not block the
+  // signaling thread on the worker thread.  The work is posted to the worker,
+  // and the corresponding signal below is raised on the signaling thread once
+  // it is done.  Note that blocking calls overtake posted ones, so don't mix
+  // the two kinds for the same channel name.  Remote candidates for a channel
+  // that is still being created are delivered once it exists.
+  void CreateChannelAsync(const std::string& name,
+                          const std::string& content_type);
+  void DestroyChannelAsync(const std::string& name);
+  sigslot::signal2<Transport*, const std::string&> SignalChannelCreated;
+  sigslot::signal2<Transport*, const std::string&> SignalChannelDestroyed;
+
   // Tells all current and future channels to start connecting.  When the first
   // channel begins connecting, the following signal is raised.
   void ConnectChannels();
@@ -169,6 +182,8 @@ class Transport : public talk_base::MessageHandler,
   void OnSignalingReady();
 
   // Handles sending of ready candidates and receiving of remote candidates.
+  // Candidates are passed between the threads in batches, one message per
+  // call to OnRemoteCandidates or per burst of ready candidates.
   sigslot::signal2<Transport*,
                    const std::vector<Candidate>&> SignalCandidatesReady;
   void OnRemoteCandidates(const std::vector<Candidate>& candidates);
@@ -222,8 +237,6 @@ class Transport : public talk_base::MessageHandler,
   // Called when a channel requests signaling.
   void OnChannelRequestSignaling();
 
-  // Called when a candidate is ready from remote peer.
-  void OnRemoteCandidate(const Candidate& candidate);
   // Called when a candidate is ready from channel.
   void OnChannelCandidateReady(TransportChannelImpl* channel,
                                const Candidate& candidate);
@@ -242,7 +255,7 @@ class Transport : public talk_base::MessageHandler,
   void ConnectChannels_w();
   void ResetChannels_w();
   void DestroyAllChannels_w();
-  void OnRemoteCandidate_w(const Candidate& candidate);
+  void OnRemoteCandidates_w(const std::vector<Candidate>& candidates);
   void OnChannelReadableState_s();
   void OnChannelWritableState_s();
   void OnChannelRequestSignaling_s();
@@ -268,6 +281,9 @@ class Transport : public talk_base::MessageHandler,
   bool writable_;
   bool connect_requested_;
   ChannelMap channels_;
+  // Channels whose CreateChannelAsync has not completed yet.  Only used on
+  // the signaling thread.
+  std::set<std::string> pending_channels_;
   // Buffers the ready_candidates so that SignalCanidatesReady can
   // provide them in multiples.
   std::vector<Candidate> ready_candidates_;
@@ -0,0 +1,355 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string>
+#include <vector>
+
+#include "talk/base/event.h"
+#include "talk/base/gunit.h"
+#include "talk/base/logging.h"
+#include "talk/base/stringencode.h"
+#include "talk/base/thread.h"
+#include "talk/base/time.h"
+#include "talk/p2p/base/candidate.h"
+#include "talk/p2p/base/transport.h"
+#include "talk/p2p/base/transportchannelimpl.h"
+
+namespace cricket {
+
+static const int kTimeout = 5000;
+static const char kContentType[] = "test";
+
+class FakeTransportChannel : public TransportChannelImpl {
+ public:
+  FakeTransportChannel(Transport* transport, const std::string& name)
+      : TransportChannelImpl(name, kContentType),
+        transport_(transport),
+        connecting_(false) {
+  }
+
+  bool connecting() const { return connecting_; }
+  const std::vector<Candidate>& remote_candidates() const {
+    return remote_candidates_;
+  }
+
+  // Reports the given number of local candidates at once.
+  void ReportCandidates(int count) {
+    for (int i = 0; i < count; ++i) {
+      Candidate candidate;
+      candidate.set_name(name());
+      candidate.set_address(talk_base::SocketAddress("1.2.3.4", 1000 + i));
+      SignalCandidateReady(this, candidate);
+    }
+  }
+
+  virtual int SendPacket(const char* data, size_t len) { return -1; }
+  virtual int SetOption(talk_base::Socket::Option opt, int value) {
+    return -1;
+  }
+  virtual int GetError() { return 0; }
+
+  virtual Transport* GetTransport() { return transport_; }
+  virtual void Connect() { connecting_ = true; }
+  virtual void Reset() { connecting_ = false; }
+  virtual void OnSignalingReady() {}
+  virtual void OnCandidate(const Candidate& candidate) {
+    remote_candidates_.push_back(candidate);
+  }
+
+ private:
+  Transport* transport_;
+  bool connecting_;
+  std::vector<Candidate> remote_candidates_;
+};
+
+class FakeTransport : public Transport {
+ public:
+  FakeTransport(talk_base::Thread* signaling_thread,
+                talk_base::Thread* worker_thread)
+      : Transport(signaling_thread, worker_thread, "fake", NULL) {
+  }
+  ~FakeTransport() {
+    DestroyAllChannels();
+  }
+
+ protected:
+  virtual TransportChannelImpl* CreateTransportChannel(
+      const std::string& name, const std::string& content_type) {
+    return new FakeTransportChannel(this, name);
+  }
+  virtual void DestroyTransportChannel(TransportChannelImpl* channel) {
+    delete channel;
+  }
+};
+
+// Keeps the worker thread busy, like a worker forwarding media would.
+class BusyWorker : public talk_base::MessageHandler {
+ public:
+  BusyWorker(talk_base::Thread* thread, int busy_ms)
+      : thread_(thread), busy_ms_(busy_ms) {
+    thread_->Post(this, MSG_BUSY);
+  }
+  ~BusyWorker() {
+    thread_->Send(this, MSG_STOP);
+  }
+
+  virtual void OnMessage(talk_base::Message* msg) {
+    if (msg->message_id == MSG_STOP) {
+      thread_->Clear(this);
+      return;
+    }
+    uint32 end = talk_base::TimeAfter(busy_ms_);
+    while (talk_base::TimeUntil(end) > 0) {
+    }
+    thread_->Post(this, MSG_BUSY);
+  }
+
+ private:
+  enum { MSG_BUSY, MSG_STOP };
+
+  talk_base::Thread* thread_;
+  int busy_ms_;
+};
+
+// Holds up the worker thread until released.
+class WorkerBlocker : public talk_base::MessageHandler {
+ public:
+  explicit WorkerBlocker(talk_base::Thread* thread)
+      : released_(false, false) {
+    thread->Post(this);
+  }
+
+  void Release() { released_.Set(); }
+
+  virtual void OnMessage(talk_base::Message* msg) {
+    released_.Wait(talk_base::kForever);
+  }
+
+ private:
+  talk_base::Event released_;
+};
+
+// Lets the test wait until the worker thread has handled everything that
+// was posted to it before.
+class WorkerFlusher : public talk_base::MessageHandler {
+ public:
+  explicit WorkerFlusher(talk_base::Thread* thread)
+      : thread_(thread), done_(false, false) {
+  }
+
+  bool Flush() {
+    thread_->Post(this);
+    return done_.Wait(kTimeout);
+  }
+
+  virtual void OnMessage(talk_base::Message* msg) {
+    done_.Set();
+  }
+
+ private:
+  talk_base::Thread* thread_;
+  talk_base::Event done_;
+};
+
+// Makes a channel report candidates when run on the worker thread.
+class CandidateReporter : public talk_base::MessageHandler {
+ public:
+  CandidateReporter(FakeTransportChannel* channel, int count)
+      : channel_(channel), count_(count) {
+  }
+
+  virtual void OnMessage(talk_base::Message* msg) {
+    channel_->ReportCandidates(count_);
+  }
+
+ private:
+  FakeTransportChannel* channel_;
+  int count_;
+};
+
+class TransportTest : public testing::Test,
+                      public sigslot::has_slots<> {
+ public:
+  TransportTest()
+      : transport_(talk_base::Thread::Current(), &worker_thread_),
+        candidates_signals_(0) {
+    worker_thread_.Start();
+    transport_.SignalChannelCreated.connect(
+        this, &TransportTest::OnChannelCreated);
+    transport_.SignalChannelDestroyed.connect(
+        this, &TransportTest::OnChannelDestroyed);
+    transport_.SignalCandidatesReady.connect(
+        this, &TransportTest::OnCandidatesReady);
+  }
+ protected:
+  void OnChannelCreated(Transport* transport, const std::string& name) {
+    created_.push_back(name);
+  }
+  void OnChannelDestroyed(Transport* transport, const std::string& name) {
+    destroyed_.push_back(name);
+  }
+  void OnCandidatesReady(Transport* transport,
+                         const std::vector<Candidate>& candidates) {
+    ++candidates_signals_;
+    ready_candidates_.insert(ready_candidates_.end(),
+                             candidates.begin(), candidates.end());
+  }
+
+  FakeTransportChannel* GetChannel(const std::string& name) {
+    return static_cast<FakeTransportChannel*>(transport_.GetChannel(name));
+  }
+
+  talk_base::Thread worker_thread_;
+  FakeTransport transport_;
+  std::vector<std::string> created_;
+  std::vector<std::string> destroyed_;
+  std::vector<Candidate> ready_candidates_;
+  int candidates_signals_;
+};
+
+TEST_F(TransportTest, CreateAndDestroyChannelAsync) {
+  transport_.CreateChannelAsync("rtp", kContentType);
+  transport_.CreateChannelAsync("rtcp", kContentType);
+  EXPECT_EQ_WAIT(2U, created_.size(), kTimeout);
+  EXPECT_EQ("rtp", created_[0]);
+  EXPECT_EQ("rtcp", created_[1]);
+  EXPECT_TRUE(transport_.HasChannel("rtp"));
+  EXPECT_TRUE(transport_.HasChannel("rtcp"));
+
+  transport_.DestroyChannelAsync("rtp");
+  EXPECT_EQ_WAIT(1U, destroyed_.size(), kTimeout);
+  EXPECT_EQ("rtp", destroyed_[0]);
+  EXPECT_FALSE(transport_.HasChannel("rtp"));
+  EXPECT_TRUE(transport_.HasChannel("rtcp"));
+}
+
+TEST_F(TransportTest, ConnectAndResetChannels) {
+  transport_.CreateChannel("rtp", kContentType);
+  transport_.ConnectChannels();
+  EXPECT_TRUE_WAIT(GetChannel("rtp")->connecting(), kTimeout);
+  // Channels created later connect right away.
+  transport_.CreateChannelAsync("rtcp", kContentType);
+  EXPECT_EQ_WAIT(1U, created_.size(), kTimeout);
+  EXPECT_TRUE(GetChannel("rtcp")->connecting());
+
+  transport_.ResetChannels();
+  EXPECT_TRUE_WAIT(!GetChannel("rtp")->connecting() &&
+                   !GetChannel("rtcp")->connecting(), kTimeout);
+}
+
+TEST_F(TransportTest, RemoteCandidatesAreBatched) {
+  transport_.CreateChannel("rtp", kContentType);
+  std::vector<Candidate> candidates;
+  for (int i = 0; i < 10; ++i) {
+    Candidate candidate;
+    candidate.set_name(i < 9 ? "rtp" : "unknown");
+    candidate.set_address(talk_base::SocketAddress("1.2.3.4", 1000 + i));
+    candidates.push_back(candidate);
+  }
+  transport_.OnRemoteCandidates(candidates);
+  EXPECT_EQ_WAIT(9U, GetChannel("rtp")->remote_candidates().size(), kTimeout);
+  EXPECT_EQ(1000, GetChannel("rtp")->remote_candidates()[0].address().port());
+}
+
+// Test that candidates for a channel that is still being created are not
+// dropped.
+TEST_F(TransportTest, RemoteCandidatesForPendingChannel) {
+  WorkerBlocker blocker(&worker_thread_);
+  transport_.CreateChannelAsync("rtp", kContentType);
+  EXPECT_FALSE(transport_.HasChannel("rtp"));
+  std::vector<Candidate> candidates(1);
+  candidates[0].set_name("rtp");
+  candidates[0].set_address(talk_base::SocketAddress("1.2.3.4", 1000));
+  transport_.OnRemoteCandidates(candidates);
+  blocker.Release();
+
+  EXPECT_EQ_WAIT(1U, created_.size(), kTimeout);
+  EXPECT_EQ_WAIT(1U, GetChannel("rtp")->remote_candidates().size(), kTimeout);
+}
+
+// Test that a channel whose creation is queued on the worker does not come
+// back after all channels were destroyed.
+TEST_F(TransportTest, DestroyAllChannelsDropsPendingCreate) {
+  WorkerBlocker blocker(&worker_thread_);
+  transport_.CreateChannelAsync("rtp", kContentType);
+  blocker.Release();
+  transport_.DestroyAllChannels();
+
+  WorkerFlusher flusher(&worker_thread_);
+  ASSERT_TRUE(flusher.Flush());
+  EXPECT_FALSE(transport_.HasChannels());
+}
+
+TEST_F(TransportTest, ReadyCandidatesAreBatched) {
+  transport_.CreateChannel("rtp", kContentType);
+  transport_.ConnectChannels();
+  EXPECT_TRUE_WAIT(GetChannel("rtp")->connecting(), kTimeout);
+
+  // A burst of candidates from the worker reaches the signaling thread as a
+  // single batch.
+  CandidateReporter reporter(GetChannel("rtp"), 10);
+  worker_thread_.Send(&reporter);
+  EXPECT_EQ_WAIT(10U, ready_candidates_.size(), kTimeout);
+  EXPECT_EQ(1, candidates_signals_);
+}
+
+// Measures how long the signaling thread is held up creating and destroying
+// channels while the worker thread is busy.
+TEST_F(TransportTest, DISABLED_AsyncChannelBenchmark) {
+  const int kNumChannels = 50;
+  const int kBusyMs = 4;
+  BusyWorker busy(&worker_thread_, kBusyMs);
+
+  uint32 start = talk_base::Time();
+  for (int i = 0; i < kNumChannels; ++i) {
+    transport_.CreateChannel(talk_base::ToString(i), kContentType);
+  }
+  for (int i = 0; i < kNumChannels; ++i) {
+    transport_.DestroyChannel(talk_base::ToString(i));
+  }
+  uint32 sync_ms = talk_base::TimeSince(start);
+
+  start = talk_base::Time();
+  for (int i = 0; i < kNumChannels; ++i) {
+    transport_.CreateChannelAsync(talk_base::ToString(i), kContentType);
+  }
+  for (int i = 0; i < kNumChannels; ++i) {
+    transport_.DestroyChannelAsync(talk_base::ToString(i));
+  }
+  uint32 async_ms = talk_base::TimeSince(start);
+
+  EXPECT_EQ_WAIT(static_cast<size_t>(kNumChannels), destroyed_.size(),
+                 kTimeout);
+  EXPECT_EQ(static_cast<size_t>(kNumChannels), created_.size());
+  EXPECT_FALSE(transport_.HasChannels());
+  LOG(LS_INFO) << kNumChannels << " channels created and destroyed with "
+               << kBusyMs << "ms worker tasks: sync " << sync_ms
+               << "ms, async " << async_ms << "ms";
+  EXPECT_LT(async_ms, sync_ms);
+}
+
+}  // namespace cricket
@@ -37,6 +37,7 @@
 #include "talk/p2p/base/common.h"
 #include "talk/p2p/base/port.h"
 #include "talk/p2p/base/relayport.h"
+#include "talk/p2p/base/sharedudpport.h"
 #include "talk/p2p/base/stunport.h"
 #include "talk/p2p/base/tcpport.h"
 #include "talk/p2p/base/udpport.h"
@@ -103,6 +104,14 @@ int LocalCandidateToPhase(const cricket::Candidate& candidate) {
 const int SHAKE_MIN_DELAY = 45 * 1000;  // 45 seconds
 const int SHAKE_MAX_DELAY = 90 * 1000;  // 90 seconds
 
+// Determines whether a server can be reached from a local address, i.e.
+// whether they are of the same IP family.  Servers still given as hostnames
+// are assumed to be reachable, as they may resolve to either family.
+bool IsReachable(const talk_base::IPAddress& ip,
+                 const talk_base::SocketAddress& server) {
+  return server.IsUnresolved() || server.family() == ip.family();
+}
+
 int ShakeDelay() {
   int range = SHAKE_MAX_DELAY - SHAKE_MIN_DELAY + 1;
   return SHAKE_MIN_DELAY + CreateRandomId() % range;
@@ -145,16 +154,21 @@ class AllocationSequence : public talk_base::MessageHandler {
   bool ProtocolEnabled(ProtocolType proto) const;
 
  private:
+  // Returns true if some phase has not been performed yet.
+  bool HasPendingPhases() const;
+
   typedef std::vector<ProtocolType> ProtocolList;
 
   void CreateUDPPorts();
   void CreateTCPPorts();
+  // Creates a port of the given type on the shared socket for this network.
+  Port* CreateSharedUDPPort(const std::string& type);
   void CreateStunPorts();
   void CreateRelayPorts();
 
   BasicPortAllocatorSession* session_;
   talk_base::Network* network_;
-  uint32 ip_;
+  talk_base::IPAddress ip_;
   PortConfiguration* config_;
   bool running_;
   int step_;
@@ -199,6 +213,7 @@ BasicPortAllocator::BasicPortAllocator(
 void BasicPortAllocator::Construct() {
   best_writable_phase_ = -1;
   allow_tcp_listen_ = true;
+  step_delay_ = ALLOCATION_STEP_DELAY;
 }
 
 BasicPortAllocator::~BasicPortAllocator() {
@@ -219,6 +234,35 @@ PortAllocatorSession *BasicPortAllocator::CreateSession(
   return new BasicPortAllocatorSession(this, name, session_type);
 }
 
+SharedUDPSocket* BasicPortAllocator::GetSharedSocket(
+    talk_base::Thread* thread, talk_base::PacketSocketFactory* factory,
+    const talk_base::IPAddress& ip,
+    const talk_base::SocketAddress& stun_address) {
+  SharedSocketKey key(ip, stun_address);
+  SharedSocketMap::iterator it = shared_sockets_.find(key);
+  if (it != shared_sockets_.end())
+    return it->second;
+
+  SharedUDPSocket* socket = SharedUDPSocket::Create(
+      thread, factory, ip, min_port(), max_port(), stun_address);
+  if (socket) {
+    socket->SignalDestroyed.connect(
+        this, &BasicPortAllocator::OnSharedSocketDestroyed);
+    shared_sockets_[key] = socket;
+  }
+  return socket;
+}
+
+void BasicPortAllocator::OnSharedSocketDestroyed(SharedUDPSocket* socket) {
+  for (SharedSocketMap::iterator it = shared_sockets_.begin();
+       it != shared_sockets_.end(); ++it) {
+    if (it->second == socket) {
+      shared_sockets_.erase(it);
+      break;
+    }
+  }
+}
+
 void BasicPortAllocator::AddWritablePhase(int phase) {
   if ((best_writable_phase_ == -1) || (phase < best_writable_phase_))
     best_writable_phase_ = phase;
@@ -420,6 +464,7 @@ void BasicPortAllocatorSession::DisableEquivalentPhases(
 
 void BasicPortAllocatorSession::AddAllocatedPort(Port* port,
                                                  AllocationSequence * seq,
+                                                 int phase,
                                                  float pref,
                                                  bool prepare_address) {
   if (!port)
@@ -434,6 +479,7 @@ void BasicPortAllocatorSession::AddAllocatedPort(Port* port,
   PortData data;
   data.port = port;
   data.sequence = seq;
+  data.phase = phase;
   data.ready = false;
   ports_.push_back(data);
 
@@ -518,9 +564,34 @@ void BasicPortAllocatorSession::OnConnectionCreated(Port* port,
 }
 
 void BasicPortAllocatorSession::OnConnectionStateChange(Connection* conn) {
-  if (conn->write_state() == Connection::STATE_WRITABLE)
-    allocator_->AddWritablePhase(
-      LocalCandidateToPhase(conn->local_candidate()));
+  if (conn->write_state() == Connection::STATE_WRITABLE) {
+    int phase = LocalCandidateToPhase(conn->local_candidate());
+    allocator_->AddWritablePhase(phase);
+    if (flags() & PORTALLOCATOR_ENABLE_PARALLEL_PHASES)
+      CancelPhasesAfter(phase);
+  }
+}
+
+// Destroys the ports of phases worse than the given one which have not
+// produced their candidates yet; we already have a writable connection that
+// they could not improve upon. Ports that are ready are left alone, since
+// the remote side may be using their candidates.
+void BasicPortAllocatorSession::CancelPhasesAfter(int phase) {
+  std::vector<Port*> cancelled;
+  for (size_t i = 0; i < ports_.size(); ++i) {
+    if (!ports_[i].ready && (ports_[i].phase > phase) &&
+        ports_[i].port->connections().empty())
+      cancelled.push_back(ports_[i].port);
+  }
+
+  if (!cancelled.empty()) {
+    LOG(LS_INFO) << "Writable connection in phase " << phase
+                 << "; cancelling " << cancelled.size()
+                 << " ports still gathering";
+  }
+  // Destroy() removes the port from ports_ via OnPortDestroyed.
+  for (size_t i = 0; i < cancelled.size(); ++i)
+    cancelled[i]->Destroy();
 }
 
 void BasicPortAllocatorSession::OnShake() {
@@ -559,13 +630,16 @@ AllocationSequence::AllocationSequence(BasicPortAllocatorSession* session,
                                        talk_base::Network* network,
                                        PortConfiguration* config,
                                        uint32 flags)
-  : session_(session), network_(network), ip_(network->ip()), config_(config),
-    running_(false), step_(0), flags_(flags) {
+  : session_(session), network_(network), ip_(network->ipaddr()),
+    config_(config), running_(false), step_(0), flags_(flags) {
   // All of the phases up until the best-writable phase so far run in step 0.
   // The other phases follow sequentially in the steps after that.  If there is
-  // no best-writable so far, then only phase 0 occurs in step 0.
+  // no best-writable so far, then only phase 0 occurs in step 0.  In parallel
+  // mode, all phases run in step 0.
   int last_phase_in_step_zero =
       talk_base::_max(0, session->allocator()->best_writable_phase());
+  if (flags_ & PORTALLOCATOR_ENABLE_PARALLEL_PHASES)
+    last_phase_in_step_zero = kNumPhases - 1;
   for (int phase = 0; phase < kNumPhases; ++phase)
     step_of_phase_[phase] = talk_base::_max(0, phase - last_phase_in_step_zero);
 
@@ -579,7 +653,7 @@ AllocationSequence::~AllocationSequence() {
 
 void AllocationSequence::DisableEquivalentPhases(talk_base::Network* network,
     PortConfiguration* config, uint32* flags) {
-  if (!((network == network_) && (ip_ == network->ip()))) {
+  if (!((network == network_) && (ip_ == network->ipaddr()))) {
     // Different network setup; nothing is equivalent.
     return;
   }
@@ -608,9 +682,10 @@ void AllocationSequence::DisableEquivalentPhases(talk_base::Network* network,
 
 void AllocationSequence::Start() {
   running_ = true;
-  session_->network_thread()->PostDelayed(ALLOCATION_STEP_DELAY,
-                                          this,
-                                          MSG_ALLOCATION_PHASE);
+  if (HasPendingPhases()) {
+    session_->network_thread()->PostDelayed(
+        session_->allocator()->step_delay(), this, MSG_ALLOCATION_PHASE);
+  }
 }
 
 void AllocationSequence::Stop() {
@@ -662,10 +737,9 @@ void AllocationSequence::OnMessage(talk_base::Message* msg) {
 
   // TODO: use different delays for each stage
   step_ += 1;
-  if (running_) {
-    session_->network_thread()->PostDelayed(ALLOCATION_STEP_DELAY,
-                                            this,
-                                            MSG_ALLOCATION_PHASE);
+  if (running_ && HasPendingPhases()) {
+    session_->network_thread()->PostDelayed(
+        session_->allocator()->step_delay(), this, MSG_ALLOCATION_PHASE);
   }
 }
 
@@ -676,6 +750,14 @@ void AllocationSequence::EnableProtocol(ProtocolType proto) {
   }
 }
 
+bool AllocationSequence::HasPendingPhases() const {
+  for (int phase = 0; phase < kNumPhases; ++phase) {
+    if (step_of_phase_[phase] >= step_)
+      return true;
+  }
+  return false;
+}
+
 bool AllocationSequence::ProtocolEnabled(ProtocolType proto) const {
   for (ProtocolList::const_iterator it = protocols_.begin();
        it != protocols_.end(); ++it) {
@@ -691,13 +773,18 @@ void AllocationSequence::CreateUDPPorts() {
     return;
   }
 
-  Port* port = UDPPort::Create(session_->network_thread(),
-                               session_->socket_factory(),
-                               network_, ip_,
-                               session_->allocator()->min_port(),
-                               session_->allocator()->max_port());
+  Port* port;
+  if (flags_ & PORTALLOCATOR_ENABLE_SHARED_SOCKET) {
+    port = CreateSharedUDPPort(LOCAL_PORT_TYPE);
+  } else {
+    port = UDPPort::Create(session_->network_thread(),
+                           session_->socket_factory(),
+                           network_, ip_,
+                           session_->allocator()->min_port(),
+                           session_->allocator()->max_port());
+  }
   if (port)
-    session_->AddAllocatedPort(port, this, PREF_LOCAL_UDP);
+    session_->AddAllocatedPort(port, this, PHASE_UDP, PREF_LOCAL_UDP);
 }
 
 void AllocationSequence::CreateTCPPorts() {
@@ -713,7 +800,7 @@ void AllocationSequence::CreateTCPPorts() {
                                session_->allocator()->max_port(),
                                session_->allocator()->allow_tcp_listen());
   if (port)
-    session_->AddAllocatedPort(port, this, PREF_LOCAL_TCP);
+    session_->AddAllocatedPort(port, this, PHASE_TCP, PREF_LOCAL_TCP);
 }
 
 void AllocationSequence::CreateStunPorts() {
@@ -731,14 +818,42 @@ void AllocationSequence::CreateStunPorts() {
     return;
   }
 
-  Port* port = StunPort::Create(session_->network_thread(),
-                                session_->socket_factory(),
-                                network_, ip_,
-                                session_->allocator()->min_port(),
-                                session_->allocator()->max_port(),
-                                config_->stun_address);
+  if (!IsReachable(ip_, config_->stun_address)) {
+    LOG(LS_VERBOSE) << "AllocationSequence: STUN server "
+                    << config_->stun_address.ToString()
+                    << " can't be reached from " << ip_.ToString()
+                    << ", skipping.";
+    return;
+  }
+
+  Port* port;
+  if (flags_ & PORTALLOCATOR_ENABLE_SHARED_SOCKET) {
+    port = CreateSharedUDPPort(STUN_PORT_TYPE);
+  } else {
+    port = StunPort::Create(session_->network_thread(),
+                            session_->socket_factory(),
+                            network_, ip_,
+                            session_->allocator()->min_port(),
+                            session_->allocator()->max_port(),
+                            config_->stun_address);
+  }
   if (port)
-    session_->AddAllocatedPort(port, this, PREF_LOCAL_STUN);
+    session_->AddAllocatedPort(port, this, PHASE_UDP, PREF_LOCAL_STUN);
+}
+
+Port* AllocationSequence::CreateSharedUDPPort(const std::string& type) {
+  talk_base::SocketAddress stun_address;
+  if (config_ && !(flags_ & PORTALLOCATOR_DISABLE_STUN) &&
+      IsReachable(ip_, config_->stun_address))
+    stun_address = config_->stun_address;
+  SharedUDPSocket* socket = session_->allocator()->GetSharedSocket(
+      session_->network_thread(), session_->socket_factory(), ip_,
+      stun_address);
+  if (!socket)
+    return NULL;
+  return SharedUDPPort::Create(session_->network_thread(),
+                               session_->socket_factory(),
+                               network_, ip_, socket, session_, type);
 }
 
 void AllocationSequence::CreateRelayPorts() {
@@ -772,14 +887,16 @@ void AllocationSequence::CreateRelayPorts() {
       //       settings.  However, we also can't prepare the address (normally
       //       done by AddAllocatedPort) until we have these addresses.  So we
       //       wait to do that until below.
-      session_->AddAllocatedPort(port, this, PREF_RELAY + relay->pref_modifier,
-                                 false);
+      session_->AddAllocatedPort(port, this, PHASE_RELAY,
+                                 PREF_RELAY + relay->pref_modifier, false);
 
       // Add the addresses of this protocol.
       PortConfiguration::PortList::const_iterator relay_port;
       for (relay_port = relay->ports.begin();
             relay_port != relay->ports.end();
             ++relay_port) {
+        if (!IsReachable(ip_, relay_port->address))
+          continue;
         port->AddServerAddress(*relay_port);
         port->AddExternalAddress(*relay_port);
       }
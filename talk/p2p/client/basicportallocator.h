@@ -28,7 +28,9 @@
 #ifndef TALK_P2P_CLIENT_BASICPORTALLOCATOR_H_
 #define TALK_P2P_CLIENT_BASICPORTALLOCATOR_H_
 
+#include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "talk/base/messagequeue.h"
@@ -39,7 +41,10 @@
 
 namespace cricket {
 
-class BasicPortAllocator : public PortAllocator {
+class SharedUDPSocket;
+
+class BasicPortAllocator : public PortAllocator,
+    public sigslot::has_slots<> {
  public:
   BasicPortAllocator(talk_base::NetworkManager* network_manager,
                      talk_base::PacketSocketFactory* socket_factory);
@@ -89,8 +94,26 @@ class BasicPortAllocator : public PortAllocator {
     allow_tcp_listen_ = allow_tcp_listen;
   }
 
+  // Delay, in milliseconds, between starting one allocation phase and the
+  // next when phases run sequentially.
+  uint32 step_delay() const { return step_delay_; }
+  void set_step_delay(uint32 delay) { step_delay_ = delay; }
+
+  // Returns the socket shared by all sessions for the given local IP and STUN
+  // server, creating it if needed. Used with
+  // PORTALLOCATOR_ENABLE_SHARED_SOCKET.
+  SharedUDPSocket* GetSharedSocket(
+      talk_base::Thread* thread, talk_base::PacketSocketFactory* factory,
+      const talk_base::IPAddress& ip,
+      const talk_base::SocketAddress& stun_address);
+
  private:
+  typedef std::pair<talk_base::IPAddress, talk_base::SocketAddress>
+      SharedSocketKey;
+  typedef std::map<SharedSocketKey, SharedUDPSocket*> SharedSocketMap;
+
   void Construct();
+  void OnSharedSocketDestroyed(SharedUDPSocket* socket);
 
   talk_base::NetworkManager* network_manager_;
   talk_base::PacketSocketFactory* socket_factory_;
@@ -100,6 +123,8 @@ class BasicPortAllocator : public PortAllocator {
   const talk_base::SocketAddress relay_address_ssl_;
   int best_writable_phase_;
   bool allow_tcp_listen_;
+  uint32 step_delay_;
+  SharedSocketMap shared_sockets_;
 };
 
 struct PortConfiguration;
@@ -124,6 +149,9 @@ class BasicPortAllocatorSession : public PortAllocatorSession,
   virtual void StopGetAllPorts();
   virtual bool IsGettingAllPorts() { return running_; }
 
+  // Number of ports allocated and not yet destroyed, ready or not.
+  size_t port_count() const { return ports_.size(); }
+
  protected:
   // Starts the process of getting the port configurations.
   virtual void GetPortConfigurations();
@@ -144,13 +172,14 @@ class BasicPortAllocatorSession : public PortAllocatorSession,
   void OnNetworksChanged();
   void DisableEquivalentPhases(talk_base::Network* network,
       PortConfiguration* config, uint32* flags);
-  void AddAllocatedPort(Port* port, AllocationSequence* seq, float pref,
-      bool prepare_address = true);
+  void AddAllocatedPort(Port* port, AllocationSequence* seq, int phase,
+      float pref, bool prepare_address = true);
   void OnAddressReady(Port* port);
   void OnProtocolEnabled(AllocationSequence* seq, ProtocolType proto);
   void OnPortDestroyed(Port* port);
   void OnConnectionCreated(Port* port, Connection* conn);
   void OnConnectionStateChange(Connection* conn);
+  void CancelPhasesAfter(int phase);
   void OnShake();
 
   BasicPortAllocator* allocator_;
@@ -169,6 +198,7 @@ class BasicPortAllocatorSession : public PortAllocatorSession,
   struct PortData {
     Port* port;
     AllocationSequence* sequence;
+    int phase;
     bool ready;
 
     bool operator==(Port* rhs) const { return (port == rhs); }
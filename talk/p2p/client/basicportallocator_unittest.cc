@@ -0,0 +1,498 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string>
+#include <vector>
+
+#include "talk/base/asyncudpsocket.h"
+#include "talk/base/basicpacketsocketfactory.h"
+#include "talk/base/gunit.h"
+#include "talk/base/logging.h"
+#include "talk/base/network.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/base/thread.h"
+#include "talk/base/time.h"
+#include "talk/p2p/base/port.h"
+#include "talk/p2p/base/relayport.h"
+#include "talk/p2p/base/relayserver.h"
+#include "talk/p2p/base/sharedudpport.h"
+#include "talk/p2p/base/stunport.h"
+#include "talk/p2p/base/stunserver.h"
+#include "talk/p2p/base/udpport.h"
+#include "talk/p2p/client/basicportallocator.h"
+
+using talk_base::AsyncUDPSocket;
+using talk_base::SocketAddress;
+using talk_base::Thread;
+
+static const SocketAddress kLoopbackAddr("127.0.0.1", 0);
+static const uint32 kLoopbackIp = 0x7F000001;
+static const int kTimeout = 5000;
+// Step delay that keeps later allocation phases from ever starting.
+static const uint32 kNeverDelay = 60 * 60 * 1000;
+
+namespace cricket {
+
+// A NetworkManager that only reports the loopback network, so that the
+// tests talk to the local STUN and relay stand-ins below.
+class LoopbackNetworkManager : public talk_base::NetworkManagerBase {
+ public:
+  virtual void StartUpdating() {
+    NetworkList list;
+    list.push_back(new talk_base::Network("lo", "loopback", kLoopbackIp, 0));
+    MergeNetworkList(list, true);
+  }
+  virtual void StopUpdating() {}
+};
+
+class BasicPortAllocatorTest : public testing::Test,
+                               public sigslot::has_slots<> {
+ public:
+  BasicPortAllocatorTest()
+      : thread_(Thread::Current()),
+        socket_factory_(thread_),
+        loopback_network_("lo", "loopback", kLoopbackIp, 0),
+        stun_socket_(AsyncUDPSocket::Create(thread_->socketserver(),
+                                            kLoopbackAddr)),
+        stun_server_(stun_socket_),
+        relay_server_(thread_),
+        // Never answers; stands in for a relay that is slow to respond.
+        dead_relay_socket_(AsyncUDPSocket::Create(thread_->socketserver(),
+                                                  kLoopbackAddr)),
+        dead_relay_requests_(0),
+        packets_read_(0) {
+    dead_relay_socket_->SignalReadPacket.connect(
+        this, &BasicPortAllocatorTest::OnDeadRelayPacket);
+    relay_internal_ = AsyncUDPSocket::Create(thread_->socketserver(),
+                                             kLoopbackAddr);
+    relay_server_.AddInternalSocket(relay_internal_);
+    relay_server_.AddExternalSocket(AsyncUDPSocket::Create(
+        thread_->socketserver(), kLoopbackAddr));
+  }
+
+ protected:
+  BasicPortAllocator* CreateAllocator(const SocketAddress& relay_address,
+                                      uint32 flags) {
+    BasicPortAllocator* allocator = new BasicPortAllocator(
+        &network_manager_, stun_socket_->GetLocalAddress(),
+        relay_address, SocketAddress(), SocketAddress());
+    allocator->set_flags(flags | PORTALLOCATOR_DISABLE_TCP);
+    return allocator;
+  }
+
+  BasicPortAllocatorSession* CreateSession(BasicPortAllocator* allocator) {
+    PortAllocatorSession* session =
+        allocator->CreateSession("test", "http://www.google.com/talk/p2p");
+    session->SignalCandidatesReady.connect(
+        this, &BasicPortAllocatorTest::OnCandidatesReady);
+    session->SignalPortReady.connect(
+        this, &BasicPortAllocatorTest::OnPortReady);
+    return static_cast<BasicPortAllocatorSession*>(session);
+  }
+
+  void OnCandidatesReady(PortAllocatorSession* session,
+                         const std::vector<Candidate>& candidates) {
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      LOG(LS_INFO) << "Candidate " << candidates[i].type() << " "
+                   << candidates[i].address().ToString() << " after "
+                   << talk_base::TimeSince(start_time_) << " ms";
+      candidates_.push_back(candidates[i]);
+    }
+  }
+
+  void OnDeadRelayPacket(talk_base::AsyncPacketSocket* socket,
+                         const char* data, size_t size,
+                         const SocketAddress& remote_addr) {
+    ++dead_relay_requests_;
+  }
+
+  void OnPortReady(PortAllocatorSession* session, Port* port) {
+    ports_.push_back(port);
+  }
+
+  // Counts the data packets that arrive on the connection in packets_read_.
+  void CountPacketsRead(Connection* conn) {
+    conn->SignalReadPacket.connect(
+        this, &BasicPortAllocatorTest::OnConnectionReadPacket);
+  }
+
+  void OnConnectionReadPacket(Connection* conn, const char* data,
+                              size_t size) {
+    ++packets_read_;
+  }
+
+  int CountCandidates(const std::string& type) const {
+    int count = 0;
+    for (size_t i = 0; i < candidates_.size(); ++i) {
+      if (candidates_[i].type() == type)
+        ++count;
+    }
+    return count;
+  }
+
+  // Connects the two ports to each other and pings until both connections
+  // are writable.
+  void ConnectPorts(Port* port1, Port* port2) {
+    Connection* conn1 = port1->CreateConnection(port2->candidates()[0],
+                                                Port::ORIGIN_MESSAGE);
+    Connection* conn2 = port2->CreateConnection(port1->candidates()[0],
+                                                Port::ORIGIN_MESSAGE);
+    ASSERT_TRUE(conn1 != NULL);
+    ASSERT_TRUE(conn2 != NULL);
+    for (uint32 start = talk_base::Time();
+         (conn1->write_state() != Connection::STATE_WRITABLE ||
+          conn2->write_state() != Connection::STATE_WRITABLE) &&
+         talk_base::TimeSince(start) < kTimeout;) {
+      conn1->Ping(talk_base::Time());
+      conn2->Ping(talk_base::Time());
+      thread_->ProcessMessages(10);
+    }
+    EXPECT_EQ(Connection::STATE_WRITABLE, conn1->write_state());
+    EXPECT_EQ(Connection::STATE_WRITABLE, conn2->write_state());
+  }
+
+  // Returns the time it takes for the given number of sessions to gather
+  // their local and STUN candidates.
+  int GatherManySessions(int num_sessions, uint32 flags) {
+    talk_base::scoped_ptr<BasicPortAllocator> allocator(CreateAllocator(
+        SocketAddress(), flags | PORTALLOCATOR_ENABLE_PARALLEL_PHASES));
+    std::vector<PortAllocatorSession*> sessions;
+    candidates_.clear();
+    ports_.clear();
+    start_time_ = talk_base::Time();
+    for (int i = 0; i < num_sessions; ++i) {
+      sessions.push_back(CreateSession(allocator.get()));
+      sessions.back()->GetInitialPorts();
+      sessions.back()->StartGetAllPorts();
+    }
+    EXPECT_EQ_WAIT(num_sessions, CountCandidates(STUN_PORT_TYPE), kTimeout);
+    EXPECT_EQ(num_sessions, CountCandidates(LOCAL_PORT_TYPE));
+    int elapsed = talk_base::TimeSince(start_time_);
+    for (size_t i = 0; i < sessions.size(); ++i)
+      delete sessions[i];
+    return elapsed;
+  }
+
+  // Returns a plain UDP port on loopback with its candidate ready, to stand
+  // in for the remote side of a connection.
+  UDPPort* CreateRemotePort() {
+    UDPPort* port = UDPPort::Create(thread_, &socket_factory_,
+                                    &loopback_network_,
+                                    talk_base::IPAddress(kLoopbackIp), 0, 0);
+    if (!port)
+      return NULL;
+    port->PrepareAddress();
+    EXPECT_EQ_WAIT(1U, port->candidates().size(), kTimeout);
+    return port;
+  }
+
+  bool HasCandidate(const std::string& type) const {
+    for (size_t i = 0; i < candidates_.size(); ++i) {
+      if (candidates_[i].type() == type)
+        return true;
+    }
+    return false;
+  }
+
+  // Returns the time it takes for a session to gather local, STUN and relay
+  // candidates.
+  int GatherAllCandidates(uint32 flags) {
+    talk_base::scoped_ptr<BasicPortAllocator> allocator(
+        CreateAllocator(relay_internal_->GetLocalAddress(), flags));
+    talk_base::scoped_ptr<BasicPortAllocatorSession> session(
+        CreateSession(allocator.get()));
+    candidates_.clear();
+    ports_.clear();
+    start_time_ = talk_base::Time();
+    session->GetInitialPorts();
+    session->StartGetAllPorts();
+    EXPECT_TRUE_WAIT(HasCandidate(LOCAL_PORT_TYPE) &&
+                     HasCandidate(STUN_PORT_TYPE) &&
+                     HasCandidate(RELAY_PORT_TYPE), kTimeout);
+    return talk_base::TimeSince(start_time_);
+  }
+
+  Thread* thread_;
+  LoopbackNetworkManager network_manager_;
+  talk_base::BasicPacketSocketFactory socket_factory_;
+  talk_base::Network loopback_network_;
+  AsyncUDPSocket* stun_socket_;  // Owned by stun_server_.
+  StunServer stun_server_;
+  RelayServer relay_server_;
+  AsyncUDPSocket* relay_internal_;
+  talk_base::scoped_ptr<AsyncUDPSocket> dead_relay_socket_;
+  int dead_relay_requests_;
+  int packets_read_;
+  std::vector<Candidate> candidates_;
+  std::vector<Port*> ports_;
+  uint32 start_time_;
+};
+
+// Test that with sequential phases the relay phase waits for the step
+// delay to pass after the UDP phase.
+TEST_F(BasicPortAllocatorTest, SequentialPhases) {
+  talk_base::scoped_ptr<BasicPortAllocator> allocator(
+      CreateAllocator(relay_internal_->GetLocalAddress(), 0));
+  allocator->set_step_delay(kNeverDelay);
+  talk_base::scoped_ptr<BasicPortAllocatorSession> session(
+      CreateSession(allocator.get()));
+  session->GetInitialPorts();
+  session->StartGetAllPorts();
+  ASSERT_TRUE_WAIT(HasCandidate(LOCAL_PORT_TYPE) &&
+                   HasCandidate(STUN_PORT_TYPE), kTimeout);
+  // Only the LOCAL and STUN ports of the UDP phase exist.
+  EXPECT_FALSE(HasCandidate(RELAY_PORT_TYPE));
+  EXPECT_EQ(2U, session->port_count());
+}
+
+// Test that parallel phases do not wait for the step delay.
+TEST_F(BasicPortAllocatorTest, ParallelPhases) {
+  talk_base::scoped_ptr<BasicPortAllocator> allocator(CreateAllocator(
+      relay_internal_->GetLocalAddress(),
+      PORTALLOCATOR_ENABLE_PARALLEL_PHASES));
+  allocator->set_step_delay(kNeverDelay);
+  talk_base::scoped_ptr<BasicPortAllocatorSession> session(
+      CreateSession(allocator.get()));
+  session->GetInitialPorts();
+  session->StartGetAllPorts();
+  EXPECT_TRUE_WAIT(HasCandidate(LOCAL_PORT_TYPE) &&
+                   HasCandidate(STUN_PORT_TYPE) &&
+                   HasCandidate(RELAY_PORT_TYPE), kTimeout);
+}
+
+// Measures the time to gather all candidates with sequential and parallel
+// phases at the default step delay.
+TEST_F(BasicPortAllocatorTest, DISABLED_PhasesBenchmark) {
+  int sequential_ms = GatherAllCandidates(0);
+  int parallel_ms = GatherAllCandidates(PORTALLOCATOR_ENABLE_PARALLEL_PHASES);
+  LOG(LS_INFO) << "All candidates after " << sequential_ms
+               << " ms sequential, " << parallel_ms << " ms parallel";
+  EXPECT_LT(parallel_ms, sequential_ms);
+}
+
+// Test that a writable connection in the UDP phase cancels the relay port
+// that is still waiting for its server.
+TEST_F(BasicPortAllocatorTest, WritableCancelsSlowerPhases) {
+  talk_base::scoped_ptr<BasicPortAllocator> allocator(CreateAllocator(
+      dead_relay_socket_->GetLocalAddress(),
+      PORTALLOCATOR_ENABLE_PARALLEL_PHASES | PORTALLOCATOR_DISABLE_STUN));
+  talk_base::scoped_ptr<BasicPortAllocatorSession> session1(
+      CreateSession(allocator.get()));
+  talk_base::scoped_ptr<BasicPortAllocatorSession> session2(
+      CreateSession(allocator.get()));
+  session1->GetInitialPorts();
+  session1->StartGetAllPorts();
+  session2->GetInitialPorts();
+  session2->StartGetAllPorts();
+  ASSERT_EQ_WAIT(2U, ports_.size(), kTimeout);
+  // Both relay ports are trying to reach their server.
+  EXPECT_TRUE_WAIT(dead_relay_requests_ >= 2, kTimeout);
+  EXPECT_EQ(2U, session1->port_count());
+  EXPECT_EQ(2U, session2->port_count());
+
+  ASSERT_EQ(LOCAL_PORT_TYPE, ports_[0]->type());
+  ASSERT_EQ(LOCAL_PORT_TYPE, ports_[1]->type());
+  ConnectPorts(ports_[0], ports_[1]);
+  if (HasFatalFailure() || HasNonfatalFailure())
+    return;
+
+  // The relay ports were destroyed as soon as the connections became
+  // writable, leaving only the LOCAL ports.
+  EXPECT_EQ(1U, session1->port_count());
+  EXPECT_EQ(1U, session2->port_count());
+  EXPECT_FALSE(HasCandidate(RELAY_PORT_TYPE));
+  EXPECT_EQ(2U, ports_.size());
+}
+
+// Test that sessions share one socket and STUN binding per network, and
+// that STUN responses to the ports on that socket reach the right port.
+TEST_F(BasicPortAllocatorTest, SharedSocket) {
+  talk_base::scoped_ptr<BasicPortAllocator> allocator(CreateAllocator(
+      SocketAddress(), PORTALLOCATOR_ENABLE_SHARED_SOCKET));
+  talk_base::scoped_ptr<BasicPortAllocatorSession> session1(
+      CreateSession(allocator.get()));
+  talk_base::scoped_ptr<BasicPortAllocatorSession> session2(
+      CreateSession(allocator.get()));
+  session1->GetInitialPorts();
+  session1->StartGetAllPorts();
+  session2->GetInitialPorts();
+  session2->StartGetAllPorts();
+  ASSERT_EQ_WAIT(2, CountCandidates(STUN_PORT_TYPE), kTimeout);
+  ASSERT_EQ(2, CountCandidates(LOCAL_PORT_TYPE));
+
+  // All candidates are on the same socket, and seen as such by the STUN
+  // server on loopback.
+  for (size_t i = 1; i < candidates_.size(); ++i)
+    EXPECT_EQ(candidates_[0].address(), candidates_[i].address());
+
+  std::vector<Port*> local_ports;
+  for (size_t i = 0; i < ports_.size(); ++i) {
+    ASSERT_TRUE(static_cast<SharedUDPPort*>(ports_[i])->shared_socket() ==
+                static_cast<SharedUDPPort*>(ports_[0])->shared_socket());
+    if (ports_[i]->type() == LOCAL_PORT_TYPE)
+      local_ports.push_back(ports_[i]);
+  }
+  EXPECT_EQ(4U, static_cast<SharedUDPPort*>(ports_[0])->shared_socket()->
+            port_count());
+  ASSERT_EQ(2U, local_ports.size());
+  talk_base::scoped_ptr<UDPPort> remote_port1(CreateRemotePort());
+  talk_base::scoped_ptr<UDPPort> remote_port2(CreateRemotePort());
+  ASSERT_TRUE(remote_port1.get() != NULL);
+  ASSERT_TRUE(remote_port2.get() != NULL);
+  ConnectPorts(local_ports[0], remote_port1.get());
+  ConnectPorts(local_ports[1], remote_port2.get());
+}
+
+// Test that ports of two sessions on a shared socket do not both connect to
+// the same remote address, since its media could reach either of them.
+TEST_F(BasicPortAllocatorTest, SharedSocketTwoSessionsSameRemoteAddress) {
+  talk_base::scoped_ptr<BasicPortAllocator> allocator(CreateAllocator(
+      SocketAddress(),
+      PORTALLOCATOR_ENABLE_SHARED_SOCKET | PORTALLOCATOR_DISABLE_STUN));
+  talk_base::scoped_ptr<BasicPortAllocatorSession> session1(
+      CreateSession(allocator.get()));
+  talk_base::scoped_ptr<BasicPortAllocatorSession> session2(
+      CreateSession(allocator.get()));
+  session1->GetInitialPorts();
+  session1->StartGetAllPorts();
+  ASSERT_EQ_WAIT(1U, ports_.size(), kTimeout);
+  session2->GetInitialPorts();
+  session2->StartGetAllPorts();
+  ASSERT_EQ_WAIT(2U, ports_.size(), kTimeout);
+  Port* port1 = ports_[0];
+  Port* port2 = ports_[1];
+  talk_base::scoped_ptr<UDPPort> remote_port(CreateRemotePort());
+  ASSERT_TRUE(remote_port.get() != NULL);
+  const Candidate& remote_candidate = remote_port->candidates()[0];
+
+  Connection* conn1 = port1->CreateConnection(remote_candidate,
+                                              Port::ORIGIN_MESSAGE);
+  ASSERT_TRUE(conn1 != NULL);
+  EXPECT_TRUE(port2->CreateConnection(remote_candidate,
+                                      Port::ORIGIN_MESSAGE) == NULL);
+  CountPacketsRead(conn1);
+
+  // The remote's media reaches the session that connected.
+  Connection* remote_conn = remote_port->CreateConnection(
+      port1->candidates()[0], Port::ORIGIN_MESSAGE);
+  for (uint32 start = talk_base::Time();
+       (conn1->read_state() != Connection::STATE_READABLE ||
+        remote_conn->write_state() != Connection::STATE_WRITABLE) &&
+       talk_base::TimeSince(start) < kTimeout;) {
+    remote_conn->Ping(talk_base::Time());
+    thread_->ProcessMessages(10);
+  }
+  ASSERT_EQ(Connection::STATE_WRITABLE, remote_conn->write_state());
+  static const char kData[] = "media";
+  ASSERT_LT(0, remote_conn->Send(kData, sizeof(kData)));
+  EXPECT_EQ_WAIT(1, packets_read_, kTimeout);
+
+  // Once it is gone, the other session may connect.
+  conn1->Destroy();
+  EXPECT_TRUE_WAIT(port1->GetConnection(remote_candidate.address()) == NULL,
+                   kTimeout);
+  EXPECT_TRUE(port2->CreateConnection(remote_candidate,
+                                      Port::ORIGIN_MESSAGE) != NULL);
+}
+
+// Test that when the LOCAL and STUN ports on a shared socket both connect
+// to the same remote address, its data keeps flowing to the remaining port
+// once either connection is gone.
+TEST_F(BasicPortAllocatorTest, SharedSocketSameRemoteAddress) {
+  talk_base::scoped_ptr<BasicPortAllocator> allocator(CreateAllocator(
+      SocketAddress(), PORTALLOCATOR_ENABLE_SHARED_SOCKET));
+  talk_base::scoped_ptr<BasicPortAllocatorSession> session(
+      CreateSession(allocator.get()));
+  session->GetInitialPorts();
+  session->StartGetAllPorts();
+  ASSERT_EQ_WAIT(1, CountCandidates(STUN_PORT_TYPE), kTimeout);
+  ASSERT_EQ(2U, ports_.size());
+  Port* local_port = ports_[0]->type() == LOCAL_PORT_TYPE ?
+      ports_[0] : ports_[1];
+  Port* stun_port = ports_[0]->type() == LOCAL_PORT_TYPE ?
+      ports_[1] : ports_[0];
+
+  talk_base::scoped_ptr<UDPPort> remote_port(CreateRemotePort());
+  ASSERT_TRUE(remote_port.get() != NULL);
+
+  Connection* local_conn = local_port->CreateConnection(
+      remote_port->candidates()[0], Port::ORIGIN_MESSAGE);
+  Connection* stun_conn = stun_port->CreateConnection(
+      remote_port->candidates()[0], Port::ORIGIN_MESSAGE);
+  ASSERT_TRUE(local_conn != NULL);
+  ASSERT_TRUE(stun_conn != NULL);
+  CountPacketsRead(local_conn);
+  // On loopback both candidates have the same address, so the remote port
+  // only keeps the second of these; it is the one that becomes writable.
+  Connection* remote_to_local = remote_port->CreateConnection(
+      local_port->candidates()[0], Port::ORIGIN_MESSAGE);
+  Connection* remote_to_stun = remote_port->CreateConnection(
+      stun_port->candidates()[0], Port::ORIGIN_MESSAGE);
+  for (uint32 start = talk_base::Time();
+       (local_conn->read_state() != Connection::STATE_READABLE ||
+        stun_conn->read_state() != Connection::STATE_READABLE ||
+        remote_to_stun->write_state() != Connection::STATE_WRITABLE) &&
+       talk_base::TimeSince(start) < kTimeout;) {
+    remote_to_local->Ping(talk_base::Time());
+    remote_to_stun->Ping(talk_base::Time());
+    thread_->ProcessMessages(10);
+  }
+  ASSERT_EQ(Connection::STATE_READABLE, local_conn->read_state());
+  ASSERT_EQ(Connection::STATE_READABLE, stun_conn->read_state());
+  ASSERT_EQ(Connection::STATE_WRITABLE, remote_to_stun->write_state());
+
+  // The port that connected first gets the data, also after the other one
+  // went away.
+  static const char kData[] = "media";
+  ASSERT_LT(0, remote_to_stun->Send(kData, sizeof(kData)));
+  EXPECT_EQ_WAIT(1, packets_read_, kTimeout);
+  stun_conn->Destroy();
+  EXPECT_TRUE_WAIT(stun_port->GetConnection(
+      remote_port->candidates()[0].address()) == NULL, kTimeout);
+  ASSERT_LT(0, remote_to_stun->Send(kData, sizeof(kData)));
+  EXPECT_EQ_WAIT(2, packets_read_, kTimeout);
+}
+
+// Compares the cost of setting up many sessions with and without shared
+// sockets. Without sharing, each session needs two sockets, which limits how
+// many sessions a select()-based socket server can take. Disabled by
+// default; run with --gtest_also_run_disabled_tests.
+TEST_F(BasicPortAllocatorTest, DISABLED_SharedSocketBenchmark) {
+  static const int kSharedSessions = 1000;
+  static const int kUnsharedSessions = 200;
+  int shared_ms = GatherManySessions(kSharedSessions,
+                                     PORTALLOCATOR_ENABLE_SHARED_SOCKET);
+  int unshared_ms = GatherManySessions(kUnsharedSessions, 0);
+  LOG(LS_INFO) << kSharedSessions << " sessions with shared sockets: "
+               << shared_ms << " ms ("
+               << shared_ms * 1000 / kSharedSessions << " us/session)";
+  LOG(LS_INFO) << kUnsharedSessions << " sessions with own sockets: "
+               << unshared_ms << " ms ("
+               << unshared_ms * 1000 / kUnsharedSessions << " us/session)";
+}
+
+}  // namespace cricket
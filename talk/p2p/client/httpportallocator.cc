@@ -36,6 +36,7 @@
 #include "talk/base/logging.h"
 #include "talk/base/nethelpers.h"
 #include "talk/base/signalthread.h"
+#include "talk/base/thread.h"
 
 namespace {
 
@@ -53,6 +54,20 @@ void Trim(std::string& str) {
   ASSERT(str.find_last_not_of(" \t\r\n") != std::string::npos);
 }
 
+// Deletes an HttpConnectionPool in the context of the thread it is sent to.
+class ConnectionPoolDeleter : public talk_base::MessageHandler {
+ public:
+  explicit ConnectionPoolDeleter(talk_base::HttpConnectionPool* pool)
+      : pool_(pool) {
+  }
+  virtual void OnMessage(talk_base::Message* msg) {
+    delete pool_;
+  }
+
+ private:
+  talk_base::HttpConnectionPool* pool_;
+};
+
 // Parses the lines in the result of the HTTP request that are of the form
 // 'a=b' and returns them in a map.
 typedef std::map<std::string, std::string> StringMap;
@@ -116,6 +131,22 @@ HttpPortAllocator::HttpPortAllocator(
 }
 
 HttpPortAllocator::~HttpPortAllocator() {
+  if (connection_pool_.get()) {
+    // The sessions, and with them their requests, are gone by now.  The
+    // pool's sockets belong to the thread that ran them, so it is deleted
+    // there.  If that thread has already stopped, the pool is leaked rather
+    // than deleted on the wrong one.
+    talk_base::Thread* thread = connection_pool_->thread();
+    ConnectionPoolDeleter deleter(connection_pool_.release());
+    thread->Send(&deleter);
+  }
+}
+
+talk_base::HttpConnectionPool* HttpPortAllocator::connection_pool() {
+  if (!connection_pool_.get()) {
+    connection_pool_.reset(new talk_base::HttpConnectionPool(agent_));
+  }
+  return connection_pool_.get();
 }
 
 PortAllocatorSession *HttpPortAllocator::CreateSession(
@@ -138,6 +169,14 @@ HttpPortAllocatorSession::HttpPortAllocatorSession(
       relay_token_(relay_token), agent_(user_agent), attempts_(0) {
 }
 
+HttpPortAllocatorSession::~HttpPortAllocatorSession() {
+  // Requests in flight hold connections from the allocator's pool.
+  for (std::list<talk_base::AsyncHttpRequest*>::iterator it =
+           requests_.begin(); it != requests_.end(); ++it) {
+    (*it)->Destroy(true);
+  }
+}
+
 void HttpPortAllocatorSession::GetPortConfigurations() {
   // Creating relay sessions can take time and is done asynchronously.
   // Creating stun sessions could also take time and could be done aysnc also,
@@ -186,6 +225,7 @@ void HttpPortAllocatorSession::SendSessionRequest(const std::string& host,
       &HttpPortAllocatorSession::OnRequestDone);
 
   request->set_proxy(allocator()->proxy());
+  request->set_connection_pool(allocator()->connection_pool());
   request->response().document.reset(new talk_base::MemoryStream);
   request->request().verb = talk_base::HV_GET;
   request->request().path = HttpPortAllocator::kCreateSessionURL;
@@ -197,11 +237,14 @@ void HttpPortAllocatorSession::SendSessionRequest(const std::string& host,
   request->set_port(port);
   request->Start();
   request->Release();
+  requests_.push_back(request);
 }
 
 void HttpPortAllocatorSession::OnRequestDone(talk_base::SignalThread* data) {
   talk_base::AsyncHttpRequest* request =
       static_cast<talk_base::AsyncHttpRequest*>(data);
+  // The request deletes itself once we return.
+  requests_.remove(request);
   if (request->response().scode != 200) {
     LOG(LS_WARNING) << "HTTPPortAllocator: request "
                     << " received error " << request->response().scode;
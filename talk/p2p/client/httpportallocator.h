@@ -28,11 +28,15 @@
 #ifndef TALK_P2P_CLIENT_HTTPPORTALLOCATOR_H_
 #define TALK_P2P_CLIENT_HTTPPORTALLOCATOR_H_
 
+#include <list>
 #include <string>
 #include <vector>
+#include "talk/base/scoped_ptr.h"
 #include "talk/p2p/client/basicportallocator.h"
 
 namespace talk_base {
+class AsyncHttpRequest;
+class HttpConnectionPool;
 class SignalThread;
 }
 
@@ -86,11 +90,17 @@ class HttpPortAllocator : public BasicPortAllocator {
     return agent_;
   }
 
+  // The connections to the relay hosts, shared by all sessions so that
+  // their requests reuse them.  Created on first use, on the thread that
+  // runs the sessions.
+  talk_base::HttpConnectionPool* connection_pool();
+
  private:
   std::vector<talk_base::SocketAddress> stun_hosts_;
   std::vector<std::string> relay_hosts_;
   std::string relay_token_;
   std::string agent_;
+  talk_base::scoped_ptr<talk_base::HttpConnectionPool> connection_pool_;
 };
 
 class RequestData;
@@ -105,7 +115,7 @@ class HttpPortAllocatorSession : public BasicPortAllocatorSession {
       const std::vector<std::string>& relay_hosts,
       const std::string& relay,
       const std::string& agent);
-  virtual ~HttpPortAllocatorSession() {}
+  virtual ~HttpPortAllocatorSession();
 
   const std::string& relay_token() const {
     return relay_token_;
@@ -130,6 +140,7 @@ class HttpPortAllocatorSession : public BasicPortAllocatorSession {
   std::string relay_token_;
   std::string agent_;
   int attempts_;
+  std::list<talk_base::AsyncHttpRequest*> requests_;
 };
 
 }  // namespace cricket
@@ -31,6 +31,7 @@
 #include "talk/base/byteorder.h"
 #include "talk/base/common.h"
 #include "talk/base/logging.h"
+#include "talk/base/time.h"
 #include "talk/p2p/base/transportchannel.h"
 #include "talk/session/phone/channelmanager.h"
 #include "talk/session/phone/mediasessionclient.h"
@@ -84,6 +85,7 @@ BaseChannel::BaseChannel(talk_base::Thread* thread,
       rtcp_(rtcp),
       transport_channel_(NULL),
       rtcp_transport_channel_(NULL),
+      pacer_(NULL),
       enabled_(false),
       writable_(false),
       was_ever_writable_(false),
@@ -91,6 +93,7 @@ BaseChannel::BaseChannel(talk_base::Thread* thread,
       has_remote_content_(false),
       muted_(false) {
   ASSERT(worker_thread_ == talk_base::Thread::Current());
+  rtp_demuxer_.set_default_sink(this);
   LOG(LS_INFO) << "Created channel";
 }
 
@@ -99,6 +102,8 @@ BaseChannel::~BaseChannel() {
   StopConnectionMonitor();
   FlushRtcpMessages();  // Send any outstanding RTCP packets.
   Clear();  // eats any outstanding messages or packets
+  if (pacer_)
+    pacer_->RemoveClient(this);  // drops any packets still being paced
   // We must destroy the media channel before the transport channel, otherwise
   // the media channel may try to send on the dead transport channel. NULLing
   // is not an effective strategy since the sends will come on another thread.
@@ -118,6 +123,8 @@ bool BaseChannel::Init(TransportChannel* transport_channel,
     return false;
   }
   transport_channel_ = transport_channel;
+  pacer_ = PacedSender::ForSession(worker_thread_, session_);
+  pacer_->AddClient(this);
   media_channel_->SetInterface(this);
   transport_channel_->SignalWritableState.connect(
       this, &BaseChannel::OnWritableState);
@@ -177,6 +184,29 @@ bool BaseChannel::SetMaxSendBandwidth(int max_bandwidth) {
   return data.result;
 }
 
+bool BaseChannel::SetJitterBufferDelay(int delay_ms) {
+  JitterBufferDelayData data(delay_ms);
+  Send(MSG_SETJITTERBUFFERDELAY, &data);
+  return true;
+}
+
+bool BaseChannel::GetJitterBufferStats(RtpJitterBufferStats* stats) {
+  JitterBufferStatsData data;
+  Send(MSG_GETJITTERBUFFERSTATS, &data);
+  *stats = data.stats;
+  return data.result;
+}
+
+void BaseChannel::AddRtpSink(uint32 ssrc, RtpDemuxerSink* sink) {
+  RtpSinkData data(ssrc, sink);
+  Send(MSG_ADDRTPSINK, &data);
+}
+
+void BaseChannel::RemoveRtpSink(uint32 ssrc) {
+  RtpSinkData data(ssrc, NULL);
+  Send(MSG_REMOVERTPSINK, &data);
+}
+
 void BaseChannel::StartConnectionMonitor(int cms) {
   socket_monitor_.reset(new SocketMonitor(transport_channel_,
                                           worker_thread(),
@@ -293,6 +323,31 @@ bool BaseChannel::SendPacket(bool rtcp, talk_base::Buffer* packet) {
     return false;
   }
 
+  // Let the pacer decide when the packet goes out. Like the post to the
+  // worker above, this means a failure to send can't be reported.
+  if (pacer_) {
+    pacer_->SendPacket(this, rtcp ? PacedSender::PRIORITY_HIGH :
+                       media_priority(), rtcp, packet);
+    return true;
+  }
+  return SendPacketNow(rtcp, packet);
+}
+
+void BaseChannel::SendPacedPacket(bool rtcp, talk_base::Buffer* packet) {
+  SendPacketNow(rtcp, packet);
+}
+
+bool BaseChannel::SendPacketNow(bool rtcp, talk_base::Buffer* packet) {
+  ASSERT(worker_thread_ == talk_base::Thread::Current());
+
+  // The packet may have been held back by the pacer, so check again that we
+  // can still send it.
+  TransportChannel* channel = (!rtcp || rtcp_mux_filter_.IsActive()) ?
+      transport_channel_ : rtcp_transport_channel_;
+  if (!channel || !channel->writable()) {
+    return false;
+  }
+
   // Protect if needed.
   if (srtp_filter_.IsActive()) {
     bool res;
@@ -384,9 +439,11 @@ void BaseChannel::HandlePacket(bool rtcp, talk_base::Buffer* packet) {
     packet->SetLength(len);
   }
 
-  // Push it down to the media channel.
+  // Push it down to the sink for its SSRC, which is usually ourselves.
+  // Anything the demuxer can't parse goes to the media channel as is.
   if (!rtcp) {
-    media_channel_->OnPacketReceived(packet);
+    if (!rtp_demuxer_.Demux(packet))
+      media_channel_->OnPacketReceived(packet);
   } else {
     media_channel_->OnRtcpReceived(packet);
   }
@@ -506,9 +563,55 @@ void BaseChannel::ChannelNotWritable_w() {
 
 // Sets the maximum video bandwidth for automatic bandwidth adjustment.
 bool BaseChannel::SetMaxSendBandwidth_w(int max_bandwidth) {
+  // Until the media engine comes up with an estimate, pace to the limit.
+  if (pacer_ && pacer_->bandwidth() == 0 && max_bandwidth > 0)
+    pacer_->SetBandwidth(max_bandwidth);
   return media_channel()->SetSendBandwidth(true, max_bandwidth);
 }
 
+void BaseChannel::SetJitterBufferDelay_w(int delay_ms) {
+  if (delay_ms <= 0) {
+    if (jitter_buffer_.get()) {
+      // Hand on whatever is still held before going back to arrival order.
+      jitter_buffer_->Flush();
+      jitter_buffer_.reset();
+    }
+  } else if (jitter_buffer_.get()) {
+    jitter_buffer_->set_target_delay(delay_ms);
+  } else {
+    jitter_buffer_.reset(new RtpJitterBuffer(worker_thread_, delay_ms));
+    jitter_buffer_->SignalPacketReady.connect(
+        this, &BaseChannel::OnJitterBufferPacket);
+  }
+}
+
+bool BaseChannel::GetJitterBufferStats_w(RtpJitterBufferStats* stats) {
+  if (!jitter_buffer_.get())
+    return false;
+  *stats = jitter_buffer_->stats();
+  return true;
+}
+
+void BaseChannel::OnRtpPacket(const RtpHeader& header,
+                              talk_base::Buffer* packet) {
+  // Send it on to the media channel, through the jitter buffer if we have
+  // one.
+  if (jitter_buffer_.get()) {
+    jitter_buffer_->InsertPacket(header, packet, talk_base::Time());
+  } else {
+    media_channel_->OnPacketReceived(packet);
+  }
+}
+
+void BaseChannel::OnJitterBufferPacket(talk_base::Buffer* packet) {
+  media_channel_->OnPacketReceived(packet);
+}
+
+void BaseChannel::GetPacerInfo(PacerInfo* info) {
+  if (pacer_)
+    pacer_->GetInfo(this, info);
+}
+
 bool BaseChannel::SetRtcpCName_w(const std::string& cname) {
   return media_channel()->SetRtcpCName(cname);
 }
@@ -594,6 +697,30 @@ void BaseChannel::OnMessage(talk_base::Message *pmsg) {
       break;
     }
 
+    case MSG_SETJITTERBUFFERDELAY: {
+      JitterBufferDelayData* data =
+          static_cast<JitterBufferDelayData*>(pmsg->pdata);
+      SetJitterBufferDelay_w(data->delay_ms);
+      break;
+    }
+    case MSG_GETJITTERBUFFERSTATS: {
+      JitterBufferStatsData* data =
+          static_cast<JitterBufferStatsData*>(pmsg->pdata);
+      data->result = GetJitterBufferStats_w(&data->stats);
+      break;
+    }
+
+    case MSG_ADDRTPSINK: {
+      RtpSinkData* data = static_cast<RtpSinkData*>(pmsg->pdata);
+      rtp_demuxer_.AddSink(data->ssrc, data->sink);
+      break;
+    }
+    case MSG_REMOVERTPSINK: {
+      RtpSinkData* data = static_cast<RtpSinkData*>(pmsg->pdata);
+      rtp_demuxer_.RemoveSink(data->ssrc);
+      break;
+    }
+
     case MSG_RTPPACKET:
     case MSG_RTCPPACKET: {
       PacketMessageData* data = static_cast<PacketMessageData*>(pmsg->pdata);
@@ -978,7 +1105,9 @@ void VoiceChannel::OnConnectionMonitorUpdate(
 void VoiceChannel::OnMediaMonitorUpdate(
     VoiceMediaChannel* media_channel, const VoiceMediaInfo& info) {
   ASSERT(media_channel == this->media_channel());
-  SignalMediaMonitor(this, info);
+  VoiceMediaInfo stats(info);
+  GetPacerInfo(&stats.pacer);
+  SignalMediaMonitor(this, stats);
 }
 
 void VoiceChannel::OnAudioMonitorUpdate(AudioMonitor* monitor,
@@ -1262,7 +1391,14 @@ void VideoChannel::OnConnectionMonitorUpdate(
 void VideoChannel::OnMediaMonitorUpdate(
     VideoMediaChannel* media_channel, const VideoMediaInfo &info) {
   ASSERT(media_channel == this->media_channel());
-  SignalMediaMonitor(this, info);
+  // Pace the whole session to what the engine estimates the path can take.
+  if (pacer() && !info.bw_estimations.empty() &&
+      info.bw_estimations[0].available_send_bandwidth > 0) {
+    pacer()->SetBandwidth(info.bw_estimations[0].available_send_bandwidth);
+  }
+  VideoMediaInfo stats(info);
+  GetPacerInfo(&stats.pacer);
+  SignalMediaMonitor(this, stats);
 }
 
 
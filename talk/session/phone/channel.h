@@ -41,7 +41,10 @@
 #include "talk/session/phone/mediachannel.h"
 #include "talk/session/phone/mediaengine.h"
 #include "talk/session/phone/mediamonitor.h"
+#include "talk/session/phone/pacedsender.h"
 #include "talk/session/phone/rtcpmuxfilter.h"
+#include "talk/session/phone/rtpdemuxer.h"
+#include "talk/session/phone/rtpjitterbuffer.h"
 #include "talk/session/phone/srtpfilter.h"
 
 namespace cricket {
@@ -72,15 +75,20 @@ enum {
   MSG_CHANNEL_ERROR = 24,
   MSG_ENABLECPUADAPTATION = 25,
   MSG_DISABLECPUADAPTATION = 26,
-  MSG_SCALEVOLUME = 27
+  MSG_SCALEVOLUME = 27,
+  MSG_SETJITTERBUFFERDELAY = 28,
+  MSG_GETJITTERBUFFERSTATS = 29,
+  MSG_ADDRTPSINK = 30,
+  MSG_REMOVERTPSINK = 31
 };
 
 // BaseChannel contains logic common to voice and video, including
-// enable/mute, marshaling calls to a worker thread, and
+// enable/mute, marshaling calls to a worker thread, send pacing, and
 // connection and media monitors.
 class BaseChannel
     : public talk_base::MessageHandler, public sigslot::has_slots<>,
-      public MediaChannel::NetworkInterface {
+      public MediaChannel::NetworkInterface, public PacedSenderClient,
+      public RtpDemuxerSink {
  public:
   BaseChannel(talk_base::Thread* thread, MediaEngineInterface* media_engine,
               MediaChannel* channel, BaseSession* session,
@@ -109,6 +117,18 @@ class BaseChannel
                         ContentAction action);
   bool SetMaxSendBandwidth(int max_bandwidth);
 
+  // Puts incoming RTP packets back in order before the media channel gets
+  // them, waiting up to the given delay for missing ones. 0 turns this off,
+  // which is the default.
+  bool SetJitterBufferDelay(int delay_ms);
+  // Returns false if there is no jitter buffer.
+  bool GetJitterBufferStats(RtpJitterBufferStats* stats);
+
+  // Hands the incoming RTP packets of the SSRC to |sink|, on the worker
+  // thread, instead of to the media channel.
+  void AddRtpSink(uint32 ssrc, RtpDemuxerSink* sink);
+  void RemoveRtpSink(uint32 ssrc);
+
   bool Enable(bool enable);
   bool Mute(bool mute);
 
@@ -197,6 +217,22 @@ class BaseChannel
   bool SendPacket(bool rtcp, talk_base::Buffer* packet);
   void HandlePacket(bool rtcp, talk_base::Buffer* packet);
 
+  // From RtpDemuxerSink, for the SSRCs that have no sink of their own.
+  virtual void OnRtpPacket(const RtpHeader& header,
+                           talk_base::Buffer* packet);
+
+  // From PacedSenderClient
+  virtual void SendPacedPacket(bool rtcp, talk_base::Buffer* packet);
+  bool SendPacketNow(bool rtcp, talk_base::Buffer* packet);
+
+  // The pacer shared by the channels of our session, and how our media
+  // packets rank in it. RTCP is always high priority.
+  PacedSender* pacer() const { return pacer_; }
+  virtual PacedSender::Priority media_priority() const {
+    return PacedSender::PRIORITY_NORMAL;
+  }
+  void GetPacerInfo(PacerInfo* info);
+
   // Setting the send codec based on the remote description.
   void OnSessionState(BaseSession* session, BaseSession::State state);
   void OnRemoteDescriptionUpdate(BaseSession* session);
@@ -253,6 +289,24 @@ class BaseChannel
   };
   bool SetMaxSendBandwidth_w(int max_bandwidth);
 
+  struct JitterBufferDelayData : public talk_base::MessageData {
+    explicit JitterBufferDelayData(int delay) : delay_ms(delay) {}
+    int delay_ms;
+  };
+  struct JitterBufferStatsData : public talk_base::MessageData {
+    JitterBufferStatsData() : result(false) {}
+    RtpJitterBufferStats stats;
+    bool result;
+  };
+  struct RtpSinkData : public talk_base::MessageData {
+    RtpSinkData(uint32 s, RtpDemuxerSink* k) : ssrc(s), sink(k) {}
+    uint32 ssrc;
+    RtpDemuxerSink* sink;
+  };
+  void SetJitterBufferDelay_w(int delay_ms);
+  bool GetJitterBufferStats_w(RtpJitterBufferStats* stats);
+  void OnJitterBufferPacket(talk_base::Buffer* packet);
+
   // From MessageHandler
   virtual void OnMessage(talk_base::Message *pmsg);
 
@@ -278,6 +332,9 @@ class BaseChannel
   SrtpFilter srtp_filter_;
   RtcpMuxFilter rtcp_mux_filter_;
   talk_base::scoped_ptr<SocketMonitor> socket_monitor_;
+  PacedSender* pacer_;
+  talk_base::scoped_ptr<RtpJitterBuffer> jitter_buffer_;
+  RtpDemuxer rtp_demuxer_;
   bool enabled_;
   bool writable_;
   bool was_ever_writable_;
@@ -387,6 +444,9 @@ class VoiceChannel : public BaseChannel {
   virtual void OnChannelRead(TransportChannel* channel,
                              const char *data, size_t len);
   virtual void ChangeState();
+  virtual PacedSender::Priority media_priority() const {
+    return PacedSender::PRIORITY_HIGH;
+  }
   virtual const MediaContentDescription* GetFirstContent(
       const SessionDescription* sdesc);
   virtual bool SetLocalContent_w(const MediaContentDescription* content,
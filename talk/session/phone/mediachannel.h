@@ -196,6 +196,11 @@ struct VideoReceiverInfo {
   int framerate_rcvd;
   int framerate_decoded;
   int framerate_output;
+  // Decoded frames that the renderer fell too far behind to draw, and the
+  // time from decoding to the renderer being done with a frame.
+  int frames_dropped;
+  int render_latency_ms;
+  int max_render_latency_ms;
 };
 
 struct BandwidthEstimationInfo {
@@ -208,13 +213,24 @@ struct BandwidthEstimationInfo {
   int bucket_delay;
 };
 
+// Send-side pacing statistics of a channel, since the previous report.
+struct PacerInfo {
+  int bandwidth;  // estimated send bandwidth being paced to, 0 if unknown
+  int packets_sent;
+  int packets_queued;
+  int avg_queue_delay_ms;
+  int max_queue_delay_ms;
+};
+
 struct VoiceMediaInfo {
   void Clear() {
     senders.clear();
     receivers.clear();
+    pacer = PacerInfo();
   }
   std::vector<VoiceSenderInfo> senders;
   std::vector<VoiceReceiverInfo> receivers;
+  PacerInfo pacer;
 };
 
 struct VideoMediaInfo {
@@ -222,10 +238,12 @@ struct VideoMediaInfo {
     senders.clear();
     receivers.clear();
     bw_estimations.clear();
+    pacer = PacerInfo();
   }
   std::vector<VideoSenderInfo> senders;
   std::vector<VideoReceiverInfo> receivers;
   std::vector<BandwidthEstimationInfo> bw_estimations;
+  PacerInfo pacer;
 };
 
 class VoiceMediaChannel : public MediaChannel {
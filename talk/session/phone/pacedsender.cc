@@ -0,0 +1,277 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "talk/session/phone/pacedsender.h"
+
+#include "talk/base/buffer.h"
+#include "talk/base/common.h"
+#include "talk/base/thread.h"
+#include "talk/base/time.h"
+#include "talk/session/phone/mediachannel.h"
+#include "talk/session/phone/rtputils.h"
+
+namespace cricket {
+
+namespace {
+
+const uint32 MSG_PROCESS = 1;
+
+// How often the queue is looked at while it is not empty.
+const int kProcessIntervalMs = 5;
+// The budget may build up to this many milliseconds' worth of sending.
+const int kMaxBurstMs = 10;
+
+typedef std::map<BaseSession*, PacedSender*> PacerMap;
+
+talk_base::CriticalSection* PacersCrit() {
+  static talk_base::CriticalSection* crit = new talk_base::CriticalSection();
+  return crit;
+}
+
+PacerMap* Pacers() {
+  static PacerMap* pacers = new PacerMap();
+  return pacers;
+}
+
+}  // namespace
+
+const double PacedSender::kPacingFactor = 2.5;
+const int PacedSender::kMaxQueueDelayMs;
+
+PacedSender* PacedSender::ForSession(talk_base::Thread* worker_thread,
+                                     BaseSession* session) {
+  ASSERT(worker_thread == talk_base::Thread::Current());
+  talk_base::CritScope cs(PacersCrit());
+  PacedSender*& pacer = (*Pacers())[session];
+  if (!pacer)
+    pacer = new PacedSender(worker_thread, session);
+  ASSERT(pacer->worker_thread() == worker_thread);
+  return pacer;
+}
+
+PacedSender::PacedSender(talk_base::Thread* worker_thread,
+                         BaseSession* session)
+    : worker_thread_(worker_thread),
+      session_(session),
+      num_clients_(0),
+      budget_(0),
+      last_refill_(talk_base::Time()),
+      process_pending_(false),
+      sending_(false),
+      bandwidth_(0) {
+}
+
+PacedSender::~PacedSender() {
+  ASSERT(num_clients_ == 0);
+  ASSERT(queue_.empty());
+  worker_thread_->Clear(this);
+}
+
+void PacedSender::AddClient(PacedSenderClient* client) {
+  ASSERT(worker_thread_ == talk_base::Thread::Current());
+  talk_base::CritScope cs(&crit_);
+  ASSERT(stats_.find(client) == stats_.end());
+  stats_[client] = ClientStats();
+  ++num_clients_;
+}
+
+void PacedSender::RemoveClient(PacedSenderClient* client) {
+  ASSERT(worker_thread_ == talk_base::Thread::Current());
+  std::deque<QueuedPacket>::iterator it = queue_.begin();
+  while (it != queue_.end()) {
+    if (it->client == client) {
+      delete it->packet;
+      it = queue_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  {
+    talk_base::CritScope cs(&crit_);
+    stats_.erase(client);
+  }
+
+  if (--num_clients_ > 0)
+    return;
+
+  // The session has no channels left. A later one gets a new pacer.
+  {
+    talk_base::CritScope cs(PacersCrit());
+    Pacers()->erase(session_);
+  }
+  worker_thread_->Clear(this);
+  if (!sending_)
+    delete this;
+}
+
+void PacedSender::SendPacket(PacedSenderClient* client, Priority priority,
+                             bool rtcp, talk_base::Buffer* packet) {
+  SendPacket(client, priority, rtcp, packet, talk_base::Time());
+}
+
+void PacedSender::SendPacket(PacedSenderClient* client, Priority priority,
+                             bool rtcp, talk_base::Buffer* packet,
+                             uint32 now) {
+  ASSERT(worker_thread_ == talk_base::Thread::Current());
+  RefillBudget(now);
+
+  // Audio and RTCP go out at once, but still use up the budget so that the
+  // queued packets make room for them.
+  int bandwidth = this->bandwidth();
+  if (priority == PRIORITY_HIGH ||
+      (queue_.empty() && (bandwidth == 0 || budget_ >= 0))) {
+    if (bandwidth > 0)
+      budget_ -= packet->length();
+    // Nothing may touch our members after this, as the client is allowed
+    // to remove itself (and so maybe delete us) while sending.
+    SendNow(client, rtcp, packet, 0);
+    return;
+  }
+
+  QueuedPacket queued;
+  queued.client = client;
+  queued.rtcp = rtcp;
+  queued.queued_time = now;
+  queued.packet = new talk_base::Buffer();
+  packet->TransferTo(queued.packet);
+  queue_.push_back(queued);
+  {
+    talk_base::CritScope cs(&crit_);
+    ++stats_[client].queued;
+  }
+
+  if (!process_pending_) {
+    process_pending_ = true;
+    worker_thread_->PostDelayed(bandwidth > 0 ? kProcessIntervalMs : 0,
+                                this, MSG_PROCESS);
+  }
+}
+
+void PacedSender::SetBandwidth(int bps) {
+  talk_base::CritScope cs(&crit_);
+  bandwidth_ = bps;
+}
+
+int PacedSender::bandwidth() const {
+  talk_base::CritScope cs(&crit_);
+  return bandwidth_;
+}
+
+void PacedSender::GetInfo(PacedSenderClient* client, PacerInfo* info) {
+  talk_base::CritScope cs(&crit_);
+  std::map<PacedSenderClient*, ClientStats>::iterator it =
+      stats_.find(client);
+  if (it == stats_.end())
+    return;
+  ClientStats& stats = it->second;
+  info->bandwidth = bandwidth_;
+  info->packets_sent = stats.packets;
+  info->packets_queued = stats.queued;
+  info->avg_queue_delay_ms =
+      (stats.packets > 0) ? stats.total_delay / stats.packets : 0;
+  info->max_queue_delay_ms = stats.max_delay;
+  stats.packets = 0;
+  stats.total_delay = 0;
+  stats.max_delay = 0;
+}
+
+void PacedSender::OnMessage(talk_base::Message* pmsg) {
+  ASSERT(pmsg->message_id == MSG_PROCESS);
+  process_pending_ = false;
+  ProcessQueue(worker_thread_->LoopTime());
+}
+
+void PacedSender::ProcessQueue(uint32 now) {
+  ASSERT(worker_thread_ == talk_base::Thread::Current());
+  RefillBudget(now);
+
+  sending_ = true;
+  SendQueuedPackets(now);
+  sending_ = false;
+
+  if (num_clients_ == 0) {
+    // The last channel went away while we were sending.
+    delete this;
+    return;
+  }
+
+  if (!queue_.empty() && !process_pending_) {
+    process_pending_ = true;
+    worker_thread_->PostDelayed(kProcessIntervalMs, this, MSG_PROCESS);
+  }
+}
+
+void PacedSender::RefillBudget(uint32 now) {
+  int32 elapsed = talk_base::TimeDiff(now, last_refill_);
+  if (elapsed <= 0)
+    return;
+  last_refill_ = now;
+
+  int bandwidth = this->bandwidth();
+  if (bandwidth == 0) {
+    budget_ = 0;
+    return;
+  }
+  double bytes_per_ms = bandwidth * kPacingFactor / 8 / 1000;
+  double max_budget = talk_base::_max(bytes_per_ms * kMaxBurstMs,
+                                      static_cast<double>(kMaxRtpPacketLen));
+  budget_ = talk_base::_min(budget_ + bytes_per_ms * elapsed, max_budget);
+}
+
+void PacedSender::SendQueuedPackets(uint32 now) {
+  bool paced = (bandwidth() > 0);
+  while (!queue_.empty()) {
+    QueuedPacket queued = queue_.front();
+    int delay = talk_base::TimeDiff(now, queued.queued_time);
+    if (paced && budget_ < 0 && delay < kMaxQueueDelayMs)
+      break;
+
+    queue_.pop_front();
+    {
+      talk_base::CritScope cs(&crit_);
+      --stats_[queued.client].queued;
+    }
+    if (paced)
+      budget_ -= queued.packet->length();
+    SendNow(queued.client, queued.rtcp, queued.packet, delay);
+    delete queued.packet;
+  }
+}
+
+void PacedSender::SendNow(PacedSenderClient* client, bool rtcp,
+                          talk_base::Buffer* packet, int delay) {
+  {
+    talk_base::CritScope cs(&crit_);
+    ClientStats& stats = stats_[client];
+    ++stats.packets;
+    stats.total_delay += delay;
+    stats.max_delay = talk_base::_max(stats.max_delay, delay);
+  }
+  client->SendPacedPacket(rtcp, packet);
+}
+
+}  // namespace cricket
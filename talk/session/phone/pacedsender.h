@@ -0,0 +1,156 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TALK_SESSION_PHONE_PACEDSENDER_H_
+#define TALK_SESSION_PHONE_PACEDSENDER_H_
+
+#include <deque>
+#include <map>
+
+#include "talk/base/basictypes.h"
+#include "talk/base/constructormagic.h"
+#include "talk/base/criticalsection.h"
+#include "talk/base/messagehandler.h"
+
+namespace talk_base {
+class Buffer;
+class Thread;
+}
+
+namespace cricket {
+
+class BaseSession;
+struct PacerInfo;
+
+// Implemented by the channels whose packets go through a PacedSender.
+class PacedSenderClient {
+ public:
+  virtual ~PacedSenderClient() {}
+
+  // Sends a packet that has left the queue.
+  virtual void SendPacedPacket(bool rtcp, talk_base::Buffer* packet) = 0;
+};
+
+// Smooths the media packets of all the channels of a session onto the wire,
+// so that a burst such as a video key frame does not overflow the socket and
+// relay buffers on the path. Packets are let out at a multiple of the
+// estimated available bandwidth; high-priority packets (audio and RTCP) skip
+// the queue. Until an estimate is known, packets are sent right away.
+// A pacer lives on the worker thread of its channels. It is created with the
+// first channel of its session and deletes itself once the last is removed.
+class PacedSender : public talk_base::MessageHandler {
+ public:
+  enum Priority {
+    PRIORITY_HIGH,
+    PRIORITY_NORMAL
+  };
+
+  // Packets are let out this much faster than the estimated bandwidth, so
+  // that the pacer only smooths bursts and does not itself limit the rate.
+  static const double kPacingFactor;
+  // A packet is never held back for longer than this.
+  static const int kMaxQueueDelayMs = 1000;
+
+  // Returns the pacer for the session, creating it if necessary. Must be
+  // called on the worker thread.
+  static PacedSender* ForSession(talk_base::Thread* worker_thread,
+                                 BaseSession* session);
+
+  talk_base::Thread* worker_thread() const { return worker_thread_; }
+
+  void AddClient(PacedSenderClient* client);
+  // Removes the client and drops the packets it still has in the queue.
+  void RemoveClient(PacedSenderClient* client);
+
+  // Sends the packet now or queues it for later, taking over its data.
+  void SendPacket(PacedSenderClient* client, Priority priority, bool rtcp,
+                  talk_base::Buffer* packet);
+  // As above, with the current time given by the caller.
+  void SendPacket(PacedSenderClient* client, Priority priority, bool rtcp,
+                  talk_base::Buffer* packet, uint32 now);
+
+  // Lets out the queued packets whose turn has come by |now|. The pacer's
+  // timer calls this with the time of the worker thread's loop; tests may
+  // call it directly to run the pacer on a simulated clock.
+  void ProcessQueue(uint32 now);
+
+  // The estimated available send bandwidth in bits per second, or 0 if it
+  // is not known. May be called on any thread.
+  void SetBandwidth(int bps);
+  int bandwidth() const;
+
+  // Fills in the queue statistics of the client since the previous call.
+  // May be called on any thread.
+  void GetInfo(PacedSenderClient* client, PacerInfo* info);
+
+  size_t queued_packets() const { return queue_.size(); }
+
+  virtual void OnMessage(talk_base::Message* pmsg);
+
+ private:
+  struct QueuedPacket {
+    PacedSenderClient* client;
+    bool rtcp;
+    uint32 queued_time;
+    talk_base::Buffer* packet;
+  };
+  struct ClientStats {
+    ClientStats() : queued(0), packets(0), total_delay(0), max_delay(0) {}
+    int queued;
+    int packets;
+    int total_delay;
+    int max_delay;
+  };
+
+  PacedSender(talk_base::Thread* worker_thread, BaseSession* session);
+  virtual ~PacedSender();
+
+  void RefillBudget(uint32 now);
+  void SendQueuedPackets(uint32 now);
+  void SendNow(PacedSenderClient* client, bool rtcp,
+               talk_base::Buffer* packet, int delay);
+
+  talk_base::Thread* worker_thread_;
+  BaseSession* session_;
+  int num_clients_;
+  std::deque<QueuedPacket> queue_;
+  double budget_;  // bytes that may be sent right now
+  uint32 last_refill_;
+  bool process_pending_;
+  bool sending_;
+
+  // Guards the members below, which are also used on other threads.
+  mutable talk_base::CriticalSection crit_;
+  int bandwidth_;
+  std::map<PacedSenderClient*, ClientStats> stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(PacedSender);
+};
+
+}  // namespace cricket
+
+#endif  // TALK_SESSION_PHONE_PACEDSENDER_H_
@@ -0,0 +1,334 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <vector>
+
+#include "talk/base/buffer.h"
+#include "talk/base/gunit.h"
+#include "talk/base/logging.h"
+#include "talk/base/thread.h"
+#include "talk/base/time.h"
+#include "talk/session/phone/mediachannel.h"
+#include "talk/session/phone/pacedsender.h"
+
+namespace cricket {
+
+static const int kTimeout = 5000;
+static const size_t kVideoPacketSize = 1200;
+static const size_t kAudioPacketSize = 200;
+
+// Records when each of its packets made it out of the pacer.
+class FakePacedClient : public PacedSenderClient {
+ public:
+  struct SentPacket {
+    uint32 time;
+    size_t size;
+    bool rtcp;
+  };
+
+  // Times are read from |clock| if it is given, or else from Time().
+  explicit FakePacedClient(const uint32* clock)
+      : clock_(clock), remove_from_(NULL) {
+  }
+
+  const std::vector<SentPacket>& sent() const { return sent_; }
+  int num_sent() const { return static_cast<int>(sent_.size()); }
+
+  // Removes ourselves from |pacer| while sending the next packet.
+  void RemoveOnSend(PacedSender* pacer) { remove_from_ = pacer; }
+
+  virtual void SendPacedPacket(bool rtcp, talk_base::Buffer* packet) {
+    SentPacket sent;
+    sent.time = clock_ ? *clock_ : talk_base::Time();
+    sent.size = packet->length();
+    sent.rtcp = rtcp;
+    sent_.push_back(sent);
+    if (remove_from_) {
+      PacedSender* pacer = remove_from_;
+      remove_from_ = NULL;
+      pacer->RemoveClient(this);
+    }
+  }
+
+ private:
+  const uint32* clock_;
+  std::vector<SentPacket> sent_;
+  PacedSender* remove_from_;
+};
+
+// Unless noted otherwise, the tests run the pacer on a simulated clock, now_,
+// which only moves in AdvanceTime().
+class PacedSenderTest : public testing::Test {
+ protected:
+  PacedSenderTest()
+      : session_(reinterpret_cast<BaseSession*>(&session_)),
+        pacer_(PacedSender::ForSession(talk_base::Thread::Current(),
+                                       session_)),
+        now_(talk_base::Time()),
+        audio_(&now_),
+        video_(&now_) {
+    pacer_->AddClient(&audio_);
+    pacer_->AddClient(&video_);
+  }
+  ~PacedSenderTest() {
+    pacer_->RemoveClient(&audio_);
+    pacer_->RemoveClient(&video_);
+  }
+
+  void Send(FakePacedClient* client, PacedSender::Priority priority,
+            bool rtcp, size_t size) {
+    std::vector<char> data(size);
+    talk_base::Buffer packet(&data[0], size);
+    pacer_->SendPacket(client, priority, rtcp, &packet, now_);
+  }
+  void SendVideo(int count) {
+    for (int i = 0; i < count; ++i)
+      Send(&video_, PacedSender::PRIORITY_NORMAL, false, kVideoPacketSize);
+  }
+  void SendAudio() {
+    Send(&audio_, PacedSender::PRIORITY_HIGH, false, kAudioPacketSize);
+  }
+
+  // Moves the simulated clock forward, letting the pacer look at its queue
+  // every millisecond.
+  void AdvanceTime(int ms) {
+    for (int i = 0; i < ms; ++i) {
+      ++now_;
+      pacer_->ProcessQueue(now_);
+    }
+  }
+
+  // The largest number of bytes sent by the client in any window of the
+  // given length.
+  static size_t PeakBytes(const FakePacedClient& client, int32 window) {
+    const std::vector<FakePacedClient::SentPacket>& sent = client.sent();
+    size_t peak = 0;
+    for (size_t i = 0; i < sent.size(); ++i) {
+      size_t bytes = 0;
+      for (size_t j = i; j < sent.size() &&
+           talk_base::TimeDiff(sent[j].time, sent[i].time) < window; ++j) {
+        bytes += sent[j].size;
+      }
+      peak = talk_base::_max(peak, bytes);
+    }
+    return peak;
+  }
+
+  BaseSession* session_;
+  PacedSender* pacer_;
+  uint32 now_;
+  FakePacedClient audio_;
+  FakePacedClient video_;
+};
+
+TEST_F(PacedSenderTest, SharedPerSession) {
+  EXPECT_EQ(pacer_, PacedSender::ForSession(talk_base::Thread::Current(),
+                                            session_));
+  EXPECT_EQ(talk_base::Thread::Current(), pacer_->worker_thread());
+}
+
+TEST_F(PacedSenderTest, SendsAtOnceWithoutEstimate) {
+  EXPECT_EQ(0, pacer_->bandwidth());
+  SendVideo(100);
+  EXPECT_EQ(100, video_.num_sent());
+  EXPECT_EQ(0U, pacer_->queued_packets());
+}
+
+TEST_F(PacedSenderTest, PacesToEstimate) {
+  // 400 kbps is let out at 1 Mbps, i.e. 125 bytes per millisecond, so 50
+  // packets of 1200 bytes take about 480 ms.
+  pacer_->SetBandwidth(400000);
+  SendVideo(50);
+  EXPECT_LT(video_.num_sent(), 50);
+  EXPECT_GT(pacer_->queued_packets(), 0U);
+
+  AdvanceTime(400);
+  EXPECT_LT(video_.num_sent(), 50);
+  AdvanceTime(100);
+  EXPECT_EQ(50, video_.num_sent());
+  EXPECT_EQ(0U, pacer_->queued_packets());
+}
+
+// Test that the pacer's own timer lets out the queue in real time.
+TEST_F(PacedSenderTest, DrainsQueueOnTimer) {
+  pacer_->SetBandwidth(400000);
+  FakePacedClient client(NULL);
+  pacer_->AddClient(&client);
+  for (int i = 0; i < 10; ++i) {
+    std::vector<char> data(kVideoPacketSize);
+    talk_base::Buffer packet(&data[0], data.size());
+    pacer_->SendPacket(&client, PacedSender::PRIORITY_NORMAL, false, &packet);
+  }
+  EXPECT_GT(pacer_->queued_packets(), 0U);
+  EXPECT_EQ_WAIT(10, client.num_sent(), kTimeout);
+  pacer_->RemoveClient(&client);
+}
+
+TEST_F(PacedSenderTest, AudioAndRtcpSkipQueue) {
+  pacer_->SetBandwidth(400000);
+  SendVideo(20);
+  ASSERT_GT(pacer_->queued_packets(), 0U);
+
+  SendAudio();
+  Send(&video_, PacedSender::PRIORITY_HIGH, true, 100);
+  EXPECT_EQ(1, audio_.num_sent());
+  EXPECT_TRUE(video_.sent().back().rtcp);
+  AdvanceTime(500);
+  EXPECT_EQ(21, video_.num_sent());
+}
+
+TEST_F(PacedSenderTest, NeverHoldsPacketsTooLong) {
+  // At 8 kbps, this would take many seconds without the delay limit.
+  pacer_->SetBandwidth(8000);
+  SendVideo(20);
+  AdvanceTime(PacedSender::kMaxQueueDelayMs - 1);
+  EXPECT_LT(video_.num_sent(), 20);
+  AdvanceTime(1);
+  EXPECT_EQ(20, video_.num_sent());
+  PacerInfo info;
+  pacer_->GetInfo(&video_, &info);
+  EXPECT_EQ(PacedSender::kMaxQueueDelayMs, info.max_queue_delay_ms);
+}
+
+TEST_F(PacedSenderTest, ReportsQueueDelay) {
+  pacer_->SetBandwidth(400000);
+  SendVideo(30);
+  SendAudio();
+
+  PacerInfo info;
+  pacer_->GetInfo(&video_, &info);
+  EXPECT_EQ(400000, info.bandwidth);
+  EXPECT_GT(info.packets_queued, 0);
+  EXPECT_EQ(30, info.packets_sent + info.packets_queued);
+
+  AdvanceTime(500);
+  EXPECT_EQ(30, video_.num_sent());
+  pacer_->GetInfo(&video_, &info);
+  EXPECT_EQ(0, info.packets_queued);
+  EXPECT_GT(info.avg_queue_delay_ms, 0);
+  EXPECT_GE(info.max_queue_delay_ms, info.avg_queue_delay_ms);
+
+  pacer_->GetInfo(&audio_, &info);
+  EXPECT_EQ(1, info.packets_sent);
+  EXPECT_EQ(0, info.max_queue_delay_ms);
+
+  // The counters start over after each report.
+  pacer_->GetInfo(&video_, &info);
+  EXPECT_EQ(0, info.packets_sent);
+  EXPECT_EQ(0, info.max_queue_delay_ms);
+}
+
+TEST_F(PacedSenderTest, RemoveClientDropsItsPackets) {
+  FakePacedClient other(&now_);
+  pacer_->AddClient(&other);
+  pacer_->SetBandwidth(400000);
+  for (int i = 0; i < 20; ++i) {
+    SendVideo(1);
+    Send(&other, PacedSender::PRIORITY_NORMAL, false, kVideoPacketSize);
+  }
+
+  // The other client removes itself as its first queued packet goes out.
+  other.RemoveOnSend(pacer_);
+  AdvanceTime(500);
+  EXPECT_EQ(20, video_.num_sent());
+  EXPECT_LE(other.num_sent(), 1);
+  EXPECT_EQ(0U, pacer_->queued_packets());
+}
+
+// Test that a video key frame sent alongside a steady audio stream goes out
+// smoothly, and that the audio does not wait behind it.
+TEST_F(PacedSenderTest, PacesKeyFrameAlongsideAudio) {
+  const int kKeyFramePackets = 60;  // 72 KB
+  const int32 kWindow = 10;
+  pacer_->SetBandwidth(1000000);
+
+  uint32 start = now_;
+  SendVideo(kKeyFramePackets);
+  int audio_packets = 0;
+  while (video_.num_sent() < kKeyFramePackets &&
+         talk_base::TimeDiff(now_, start) < PacedSender::kMaxQueueDelayMs) {
+    SendAudio();
+    ++audio_packets;
+    AdvanceTime(20);
+  }
+  EXPECT_EQ(kKeyFramePackets, video_.num_sent());
+  EXPECT_EQ(audio_packets, audio_.num_sent());
+
+  PacerInfo info;
+  pacer_->GetInfo(&audio_, &info);
+  EXPECT_EQ(0, info.max_queue_delay_ms);
+  // 1 Mbps is let out at 2.5 Mbps, about 3 KB per window, besides the
+  // initial burst.
+  EXPECT_LE(PeakBytes(video_, kWindow), 5 * kVideoPacketSize);
+  // 72 KB at 2.5 Mbps take about 230 ms.
+  EXPECT_GE(video_.sent().back().time - start, 200U);
+}
+
+// Sends a video key frame alongside a steady audio stream and measures how
+// bursty the output is, and how long packets wait, with and without pacing,
+// in real time.
+TEST_F(PacedSenderTest, DISABLED_KeyFrameBenchmark) {
+  const int kKeyFramePackets = 60;  // 72 KB
+  const int kBandwidth = 1000000;
+  const int32 kWindow = 10;
+
+  for (int paced = 0; paced < 2; ++paced) {
+    FakePacedClient audio(NULL), video(NULL);
+    pacer_->AddClient(&audio);
+    pacer_->AddClient(&video);
+    pacer_->SetBandwidth(paced ? kBandwidth : 0);
+
+    uint32 start = talk_base::Time();
+    now_ = start;
+    for (int i = 0; i < kKeyFramePackets; ++i)
+      Send(&video, PacedSender::PRIORITY_NORMAL, false, kVideoPacketSize);
+    int audio_packets = 0;
+    while (video.num_sent() < kKeyFramePackets &&
+           talk_base::TimeSince(start) < kTimeout) {
+      now_ = talk_base::Time();
+      Send(&audio, PacedSender::PRIORITY_HIGH, false, kAudioPacketSize);
+      ++audio_packets;
+      talk_base::Thread::Current()->ProcessMessages(20);
+    }
+
+    PacerInfo video_info, audio_info;
+    pacer_->GetInfo(&video, &video_info);
+    pacer_->GetInfo(&audio, &audio_info);
+    LOG(LS_INFO) << (paced ? "Paced" : "Unpaced") << " key frame: "
+                 << PeakBytes(video, kWindow) << " bytes peak in " << kWindow
+                 << "ms, " << video.sent().back().time - start
+                 << "ms to send, " << video_info.avg_queue_delay_ms
+                 << "ms average and " << video_info.max_queue_delay_ms
+                 << "ms max video delay, " << audio_info.max_queue_delay_ms
+                 << "ms max audio delay";
+
+    pacer_->RemoveClient(&audio);
+    pacer_->RemoveClient(&video);
+  }
+}
+
+}  // namespace cricket
@@ -0,0 +1,135 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "talk/session/phone/rtpdemuxer.h"
+
+#include "talk/base/buffer.h"
+#include "talk/base/common.h"
+
+namespace cricket {
+
+static const size_t kInitialSlots = 16;
+
+// Spreads the SSRCs over the table. They are random already, but nothing
+// stops a peer from picking sequential ones.
+static inline size_t HashSsrc(uint32 ssrc, size_t mask) {
+  uint32 hash = ssrc * 2654435761U;
+  return static_cast<size_t>(hash ^ (hash >> 16)) & mask;
+}
+
+RtpDemuxer::RtpDemuxer()
+    : size_(0),
+      default_sink_(NULL) {
+  Slot empty = { 0, NULL };
+  slots_.resize(kInitialSlots, empty);
+}
+
+RtpDemuxer::~RtpDemuxer() {
+}
+
+void RtpDemuxer::AddSink(uint32 ssrc, RtpDemuxerSink* sink) {
+  ASSERT(sink != NULL);
+  size_t index = FindSlot(ssrc);
+  if (slots_[index].sink) {
+    // Already registered; only the sink changes.
+    slots_[index].sink = sink;
+    return;
+  }
+  // Keep the table at most half full so that probes stay short.
+  if ((size_ + 1) * 2 > slots_.size()) {
+    Grow();
+    index = FindSlot(ssrc);
+  }
+  slots_[index].ssrc = ssrc;
+  slots_[index].sink = sink;
+  ++size_;
+}
+
+bool RtpDemuxer::RemoveSink(uint32 ssrc) {
+  size_t mask = slots_.size() - 1;
+  size_t index = FindSlot(ssrc);
+  if (!slots_[index].sink)
+    return false;
+  slots_[index].sink = NULL;
+  --size_;
+
+  // Move back any later entries of the probe run that could now be found
+  // sooner, so that lookups can stop at the first free slot.
+  size_t free = index;
+  for (size_t next = (index + 1) & mask; slots_[next].sink;
+       next = (next + 1) & mask) {
+    size_t home = HashSsrc(slots_[next].ssrc, mask);
+    // The entry may move to the free slot unless its home lies cyclically
+    // in (free, next].
+    bool stays = (free <= next) ? (free < home && home <= next)
+                                : (free < home || home <= next);
+    if (!stays) {
+      slots_[free] = slots_[next];
+      slots_[next].sink = NULL;
+      free = next;
+    }
+  }
+  return true;
+}
+
+RtpDemuxerSink* RtpDemuxer::GetSink(uint32 ssrc) const {
+  return slots_[FindSlot(ssrc)].sink;
+}
+
+bool RtpDemuxer::Demux(talk_base::Buffer* packet) {
+  RtpHeader header;
+  if (!ParseRtpHeader(packet->data(), packet->length(), &header))
+    return false;
+  RtpDemuxerSink* sink = slots_[FindSlot(header.ssrc)].sink;
+  if (!sink)
+    sink = default_sink_;
+  if (!sink)
+    return false;
+  sink->OnRtpPacket(header, packet);
+  return true;
+}
+
+size_t RtpDemuxer::FindSlot(uint32 ssrc) const {
+  size_t mask = slots_.size() - 1;
+  size_t index = HashSsrc(ssrc, mask);
+  while (slots_[index].sink && slots_[index].ssrc != ssrc)
+    index = (index + 1) & mask;
+  return index;
+}
+
+void RtpDemuxer::Grow() {
+  std::vector<Slot> old_slots;
+  old_slots.swap(slots_);
+  Slot empty = { 0, NULL };
+  slots_.resize(old_slots.size() * 2, empty);
+  for (size_t i = 0; i < old_slots.size(); ++i) {
+    if (old_slots[i].sink)
+      slots_[FindSlot(old_slots[i].ssrc)] = old_slots[i];
+  }
+}
+
+}  // namespace cricket
@@ -0,0 +1,93 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TALK_SESSION_PHONE_RTPDEMUXER_H_
+#define TALK_SESSION_PHONE_RTPDEMUXER_H_
+
+#include <vector>
+
+#include "talk/base/basictypes.h"
+#include "talk/base/constructormagic.h"
+#include "talk/session/phone/rtputils.h"
+
+namespace talk_base {
+class Buffer;
+}
+
+namespace cricket {
+
+// Receives the RTP packets of the SSRCs it is registered for.
+class RtpDemuxerSink {
+ public:
+  virtual ~RtpDemuxerSink() {}
+
+  // The header has already been parsed, so the sink need not do so again.
+  virtual void OnRtpPacket(const RtpHeader& header,
+                           talk_base::Buffer* packet) = 0;
+};
+
+// Parses the header of each incoming RTP packet once and hands the packet to
+// the sink registered for its SSRC, or to the default sink if there is none.
+// The sinks are kept in an open-addressed hash table, so that finding one
+// costs the same however many streams a conference has.
+class RtpDemuxer {
+ public:
+  RtpDemuxer();
+  ~RtpDemuxer();
+
+  // Replaces any sink already registered for the SSRC.
+  void AddSink(uint32 ssrc, RtpDemuxerSink* sink);
+  // Returns false if no sink was registered for the SSRC.
+  bool RemoveSink(uint32 ssrc);
+  RtpDemuxerSink* GetSink(uint32 ssrc) const;
+  size_t num_sinks() const { return size_; }
+
+  // Receives the packets of unregistered SSRCs. May be NULL.
+  void set_default_sink(RtpDemuxerSink* sink) { default_sink_ = sink; }
+
+  // Returns false if the packet is not RTP or nobody wanted it.
+  bool Demux(talk_base::Buffer* packet);
+
+ private:
+  struct Slot {
+    uint32 ssrc;
+    RtpDemuxerSink* sink;  // NULL if the slot is free
+  };
+
+  size_t FindSlot(uint32 ssrc) const;
+  void Grow();
+
+  std::vector<Slot> slots_;  // size is a power of two
+  size_t size_;
+  RtpDemuxerSink* default_sink_;
+
+  DISALLOW_COPY_AND_ASSIGN(RtpDemuxer);
+};
+
+}  // namespace cricket
+
+#endif  // TALK_SESSION_PHONE_RTPDEMUXER_H_
@@ -0,0 +1,285 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <vector>
+
+#include "talk/base/buffer.h"
+#include "talk/base/byteorder.h"
+#include "talk/base/gunit.h"
+#include "talk/base/logging.h"
+#include "talk/base/sigslot.h"
+#include "talk/base/time.h"
+#include "talk/session/phone/rtpdemuxer.h"
+#include "talk/session/phone/rtputils.h"
+
+namespace cricket {
+
+static const uint32 kSsrc1 = 0x11111111;
+static const uint32 kSsrc2 = 0x22222222;
+
+static void MakePacket(uint32 ssrc, int seq_num, talk_base::Buffer* packet) {
+  uint8 rtp[20] = { 0x80, 0x00 };
+  talk_base::SetBE16(rtp + 2, static_cast<uint16>(seq_num));
+  talk_base::SetBE32(rtp + 4, seq_num * 160);
+  talk_base::SetBE32(rtp + 8, ssrc);
+  packet->SetData(rtp, sizeof(rtp));
+}
+
+class CountingSink : public RtpDemuxerSink {
+ public:
+  CountingSink() : packets_(0), last_ssrc_(0) {}
+  virtual void OnRtpPacket(const RtpHeader& header,
+                           talk_base::Buffer* packet) {
+    ++packets_;
+    last_ssrc_ = header.ssrc;
+  }
+  int packets() const { return packets_; }
+  uint32 last_ssrc() const { return last_ssrc_; }
+
+ private:
+  int packets_;
+  uint32 last_ssrc_;
+};
+
+TEST(RtpUtilsTest, ParseRtpHeader) {
+  static const uint8 kPacket[] = {
+    0x80, 0xE0, 0x12, 0x34, 0x00, 0x00, 0x56, 0x78,
+    0x9A, 0xBC, 0xDE, 0xF0, 0xAA, 0xBB, 0xCC, 0xDD,
+  };
+  RtpHeader header;
+  EXPECT_TRUE(ParseRtpHeader(kPacket, sizeof(kPacket), &header));
+  EXPECT_EQ(0x60, header.payload_type);
+  EXPECT_TRUE(header.marker);
+  EXPECT_EQ(0x1234, header.seq_num);
+  EXPECT_EQ(0x5678U, header.timestamp);
+  EXPECT_EQ(0x9ABCDEF0U, header.ssrc);
+  EXPECT_EQ(0, header.csrc_count);
+  EXPECT_EQ(12U, header.header_len);
+  EXPECT_EQ(-1, header.extension_profile);
+}
+
+TEST(RtpUtilsTest, ParseRtpHeaderWithCsrcsAndExtension) {
+  static const uint8 kPacket[] = {
+    0x92, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02,
+    0x00, 0x00, 0x00, 0x03,
+    0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x05,  // 2 CSRCs
+    0xBE, 0xDE, 0x00, 0x01, 0x10, 0x20, 0x30, 0x40,  // 1 word extension
+    0xFF,
+  };
+  RtpHeader header;
+  EXPECT_TRUE(ParseRtpHeader(kPacket, sizeof(kPacket), &header));
+  EXPECT_EQ(2, header.csrc_count);
+  EXPECT_EQ(0xBEDE, header.extension_profile);
+  EXPECT_EQ(24U, header.extension_offset);
+  EXPECT_EQ(4U, header.extension_len);
+  EXPECT_EQ(28U, header.header_len);
+  EXPECT_EQ(3U, header.ssrc);
+}
+
+TEST(RtpUtilsTest, ParseBadRtpHeader) {
+  RtpHeader header;
+  // Wrong version.
+  static const uint8 kVersion1[12] = { 0x40 };
+  EXPECT_FALSE(ParseRtpHeader(kVersion1, sizeof(kVersion1), &header));
+  // Too short for the fixed header.
+  static const uint8 kShort[11] = { 0x80 };
+  EXPECT_FALSE(ParseRtpHeader(kShort, sizeof(kShort), &header));
+  // Too short for the CSRCs it claims.
+  static const uint8 kCsrcs[16] = { 0x82 };
+  EXPECT_FALSE(ParseRtpHeader(kCsrcs, sizeof(kCsrcs), &header));
+  // Too short for the extension it claims.
+  static const uint8 kExtension[16] = { 0x90, 0, 0, 0, 0, 0, 0, 0,
+                                        0, 0, 0, 0, 0xBE, 0xDE, 0x00, 0x02 };
+  EXPECT_FALSE(ParseRtpHeader(kExtension, sizeof(kExtension), &header));
+}
+
+TEST(RtpDemuxerTest, RoutesBySsrc) {
+  RtpDemuxer demuxer;
+  CountingSink sink1, sink2, default_sink;
+  demuxer.AddSink(kSsrc1, &sink1);
+  demuxer.AddSink(kSsrc2, &sink2);
+  EXPECT_EQ(2U, demuxer.num_sinks());
+  EXPECT_EQ(&sink1, demuxer.GetSink(kSsrc1));
+
+  talk_base::Buffer packet;
+  MakePacket(kSsrc1, 1, &packet);
+  EXPECT_TRUE(demuxer.Demux(&packet));
+  MakePacket(kSsrc2, 2, &packet);
+  EXPECT_TRUE(demuxer.Demux(&packet));
+  EXPECT_TRUE(demuxer.Demux(&packet));
+  EXPECT_EQ(1, sink1.packets());
+  EXPECT_EQ(2, sink2.packets());
+  EXPECT_EQ(kSsrc2, sink2.last_ssrc());
+
+  // Nobody wants an unknown SSRC until there is a default sink.
+  MakePacket(0x33333333, 3, &packet);
+  EXPECT_FALSE(demuxer.Demux(&packet));
+  demuxer.set_default_sink(&default_sink);
+  EXPECT_TRUE(demuxer.Demux(&packet));
+  EXPECT_EQ(1, default_sink.packets());
+
+  // Nor a packet that isn't RTP.
+  static const char kGarbage[] = "garbage";
+  packet.SetData(kGarbage, sizeof(kGarbage));
+  EXPECT_FALSE(demuxer.Demux(&packet));
+  EXPECT_EQ(1, default_sink.packets());
+}
+
+TEST(RtpDemuxerTest, AddReplacesAndRemoveFallsBack) {
+  RtpDemuxer demuxer;
+  CountingSink sink1, sink2, default_sink;
+  demuxer.set_default_sink(&default_sink);
+  demuxer.AddSink(kSsrc1, &sink1);
+  demuxer.AddSink(kSsrc1, &sink2);
+  EXPECT_EQ(1U, demuxer.num_sinks());
+
+  talk_base::Buffer packet;
+  MakePacket(kSsrc1, 1, &packet);
+  demuxer.Demux(&packet);
+  EXPECT_EQ(0, sink1.packets());
+  EXPECT_EQ(1, sink2.packets());
+
+  EXPECT_TRUE(demuxer.RemoveSink(kSsrc1));
+  EXPECT_FALSE(demuxer.RemoveSink(kSsrc1));
+  EXPECT_EQ(0U, demuxer.num_sinks());
+  EXPECT_TRUE(demuxer.GetSink(kSsrc1) == NULL);
+  demuxer.Demux(&packet);
+  EXPECT_EQ(1, default_sink.packets());
+}
+
+// Re-registering the streams of a full table swaps their sinks in place.
+TEST(RtpDemuxerTest, ReplaceSinks) {
+  static const int kNumSsrcs = 8;
+  RtpDemuxer demuxer;
+  std::vector<CountingSink> old_sinks(kNumSsrcs), new_sinks(kNumSsrcs);
+  for (int i = 0; i < kNumSsrcs; ++i) {
+    demuxer.AddSink(i * 0x10000, &old_sinks[i]);
+  }
+  for (int round = 0; round < 100; ++round) {
+    for (int i = 0; i < kNumSsrcs; ++i) {
+      demuxer.AddSink(i * 0x10000, (round % 2) ? &old_sinks[i]
+                                               : &new_sinks[i]);
+    }
+  }
+  EXPECT_EQ(static_cast<size_t>(kNumSsrcs), demuxer.num_sinks());
+  for (int i = 0; i < kNumSsrcs; ++i) {
+    EXPECT_EQ(&old_sinks[i], demuxer.GetSink(i * 0x10000));
+  }
+  for (int i = 0; i < kNumSsrcs; ++i) {
+    EXPECT_TRUE(demuxer.RemoveSink(i * 0x10000));
+  }
+  EXPECT_EQ(0U, demuxer.num_sinks());
+}
+
+// Adds enough SSRCs that the table grows and probes collide, then removes
+// every other one and checks that the rest can still be found.
+TEST(RtpDemuxerTest, ManySinks) {
+  static const int kNumSsrcs = 1000;
+  RtpDemuxer demuxer;
+  std::vector<CountingSink> sinks(kNumSsrcs);
+  for (int i = 0; i < kNumSsrcs; ++i) {
+    demuxer.AddSink(i * 0x10000, &sinks[i]);
+  }
+  EXPECT_EQ(static_cast<size_t>(kNumSsrcs), demuxer.num_sinks());
+  for (int i = 0; i < kNumSsrcs; i += 2) {
+    EXPECT_TRUE(demuxer.RemoveSink(i * 0x10000));
+  }
+  EXPECT_EQ(static_cast<size_t>(kNumSsrcs / 2), demuxer.num_sinks());
+  for (int i = 0; i < kNumSsrcs; ++i) {
+    EXPECT_EQ((i % 2) ? &sinks[i] : NULL, demuxer.GetSink(i * 0x10000));
+  }
+}
+
+// The way the packets of a conference used to reach their streams: every
+// stream hears every packet and parses it to see whether it is for them.
+class BroadcastSink : public sigslot::has_slots<> {
+ public:
+  explicit BroadcastSink(uint32 ssrc) : ssrc_(ssrc), packets_(0) {}
+  void OnPacket(talk_base::Buffer* packet) {
+    uint32 ssrc;
+    if (GetRtpSsrc(packet->data(), packet->length(), &ssrc) && ssrc == ssrc_)
+      ++packets_;
+  }
+  int packets() const { return packets_; }
+
+ private:
+  uint32 ssrc_;
+  int packets_;
+};
+
+// Compares demuxing a conference's packets through the SSRC table with
+// broadcasting them to every stream.
+TEST(RtpDemuxerTest, DISABLED_ConferenceBenchmark) {
+  static const int kNumStreams = 200;
+  static const int kNumPackets = 100000;
+
+  std::vector<talk_base::Buffer*> packets;
+  for (int i = 0; i < kNumPackets; ++i) {
+    packets.push_back(new talk_base::Buffer());
+    MakePacket(1000 + (i * 7919) % kNumStreams, i, packets.back());
+  }
+
+  RtpDemuxer demuxer;
+  std::vector<CountingSink> sinks(kNumStreams);
+  for (int i = 0; i < kNumStreams; ++i) {
+    demuxer.AddSink(1000 + i, &sinks[i]);
+  }
+  uint32 start = talk_base::Time();
+  for (int i = 0; i < kNumPackets; ++i) {
+    demuxer.Demux(packets[i]);
+  }
+  uint32 demux_ms = talk_base::TimeSince(start);
+
+  sigslot::signal1<talk_base::Buffer*> signal;
+  std::vector<BroadcastSink*> broadcast;
+  for (int i = 0; i < kNumStreams; ++i) {
+    broadcast.push_back(new BroadcastSink(1000 + i));
+    signal.connect(broadcast.back(), &BroadcastSink::OnPacket);
+  }
+  start = talk_base::Time();
+  for (int i = 0; i < kNumPackets; ++i) {
+    signal(packets[i]);
+  }
+  uint32 broadcast_ms = talk_base::TimeSince(start);
+
+  int demuxed = 0, broadcasted = 0;
+  for (int i = 0; i < kNumStreams; ++i) {
+    demuxed += sinks[i].packets();
+    broadcasted += broadcast[i]->packets();
+    delete broadcast[i];
+  }
+  for (int i = 0; i < kNumPackets; ++i) {
+    delete packets[i];
+  }
+  EXPECT_EQ(kNumPackets, demuxed);
+  EXPECT_EQ(kNumPackets, broadcasted);
+  LOG(LS_INFO) << kNumPackets << " packets for " << kNumStreams
+               << " streams: demuxed in " << demux_ms << " ms, broadcast in "
+               << broadcast_ms << " ms";
+}
+
+}  // namespace cricket
@@ -29,10 +29,15 @@
 
 #include <ctype.h>
 
+#include <algorithm>
 #include <string>
 
 #include "talk/base/byteorder.h"
+#include "talk/base/fileutils.h"
+#include "talk/base/pathutils.h"
 #include "talk/base/logging.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/base/thread.h"
 #include "talk/base/time.h"
 #include "talk/session/phone/rtputils.h"
 
@@ -60,6 +65,48 @@ void RtpDumpFileHeader::WriteToByteBuffer(talk_base::ByteBuffer* buf) {
 
 static const uint32 kDefaultTimeIncrease = 30;
 
+// Returns the number of bytes of the packet to record under the given
+// RtpDumpPacketFilter, or 0 if the packet is filtered out.
+static size_t FilterRtpDumpPacket(int packet_filter, const void* data,
+                                  size_t data_len, bool rtcp) {
+  size_t filtered_len = 0;
+  if (!rtcp) {
+    if ((packet_filter & PF_RTPPACKET) == PF_RTPPACKET) {
+      // RTP header + payload
+      filtered_len = data_len;
+    } else if ((packet_filter & PF_RTPHEADER) == PF_RTPHEADER) {
+      // RTP header only
+      size_t header_len;
+      if (GetRtpHeaderLen(data, data_len, &header_len)) {
+        filtered_len = header_len;
+      }
+    }
+  } else {
+    if ((packet_filter & PF_RTCPPACKET) == PF_RTCPPACKET) {
+      // RTCP header + payload
+      filtered_len = data_len;
+    }
+  }
+
+  return filtered_len;
+}
+
+// Check if its matches "#!rtpplay1.0 address/port".
+static bool IsRtpDumpFirstLine(const std::string& first_line) {
+  // The first line is like "#!rtpplay1.0 address/port"
+  bool matched = (0 == first_line.find("#!rtpplay1.0 "));
+
+  // The address could be IP or hostname. We do not check it here. Instead, we
+  // check the port at the end.
+  size_t pos = first_line.find('/');
+  matched &= (pos != std::string::npos && pos < first_line.size() - 1);
+  for (++pos; pos < first_line.size() && matched; ++pos) {
+    matched &= (0 != isdigit(first_line[pos]));
+  }
+
+  return matched;
+}
+
 bool RtpDumpPacket::IsValidRtpPacket() const {
   return !is_rtcp && data.size() >= kMinRtpPacketLen;
 }
@@ -177,18 +224,7 @@ talk_base::StreamResult RtpDumpReader::ReadFileHeader() {
 }
 
 bool RtpDumpReader::CheckFirstLine(const std::string& first_line) {
-  // The first line is like "#!rtpplay1.0 address/port"
-  bool matched = (0 == first_line.find("#!rtpplay1.0 "));
-
-  // The address could be IP or hostname. We do not check it here. Instead, we
-  // check the port at the end.
-  size_t pos = first_line.find('/');
-  matched &= (pos != std::string::npos && pos < first_line.size() - 1);
-  for (++pos; pos < first_line.size() && matched; ++pos) {
-    matched &= (0 != isdigit(first_line[pos]));
-  }
-
-  return matched;
+  return IsRtpDumpFirstLine(first_line);
 }
 
 ///////////////////////////////////////////////////////////////////////////
@@ -304,6 +340,244 @@ void RtpDumpLoopReader::UpdateDumpPacket(RtpDumpPacket* packet) {
   }
 }
 
+///////////////////////////////////////////////////////////////////////////
+// Implementation of RtpDumpMappedReader.
+///////////////////////////////////////////////////////////////////////////
+
+const char RtpDumpMappedReader::kIndexSuffix[] = ".idx";
+
+// Layout of the sidecar index: a header of magic, version, dump file size
+// and packet count, followed by one entry of offset, elapsed time and SSRC
+// per packet, all in network byte order.
+static const uint32 kIndexMagic = 0x52444958;  // "RDIX"
+static const uint32 kIndexVersion = 1;
+static const size_t kIndexHeaderLength = 24;
+static const size_t kIndexEntryLength = 16;
+// How far into the dump to look for the end of the first line.
+static const size_t kMaxFirstLineLength = 256;
+
+RtpDumpMappedReader::RtpDumpMappedReader()
+    : first_packet_offset_(0),
+      start_time_ms_(0),
+      next_packet_(0) {
+}
+
+RtpDumpMappedReader::~RtpDumpMappedReader() {
+  Close();
+}
+
+bool RtpDumpMappedReader::Open(const std::string& filename) {
+  Close();
+  if (!file_.Open(filename)) {
+    return false;
+  }
+  if (!ReadFileHeader()) {
+    LOG(LS_ERROR) << filename << " is not an RTP dump";
+    Close();
+    return false;
+  }
+
+  std::string index_filename = filename + kIndexSuffix;
+  if (!LoadIndex(index_filename)) {
+    BuildIndex();
+    SaveIndex(index_filename);
+  }
+
+  for (size_t i = 0; i < index_.size(); ++i) {
+    ssrc_packets_[index_[i].ssrc].push_back(i);
+  }
+  return true;
+}
+
+void RtpDumpMappedReader::Close() {
+  file_.Close();
+  index_.clear();
+  ssrc_packets_.clear();
+  first_packet_offset_ = 0;
+  start_time_ms_ = 0;
+  next_packet_ = 0;
+}
+
+talk_base::StreamResult RtpDumpMappedReader::ReadPacket(
+    RtpDumpPacketView* packet) {
+  if (!packet || !file_.is_open()) return talk_base::SR_ERROR;
+  if (next_packet_ >= index_.size()) {
+    return talk_base::SR_EOS;
+  }
+  return GetPacket(next_packet_++, packet) ?
+      talk_base::SR_SUCCESS : talk_base::SR_ERROR;
+}
+
+bool RtpDumpMappedReader::GetPacket(size_t n,
+                                    RtpDumpPacketView* packet) const {
+  if (!packet || n >= index_.size()) {
+    return false;
+  }
+  // The index only refers to complete packets, so no bounds checks needed.
+  const uint8* header = file_.data() + index_[n].offset;
+  packet->elapsed_time = index_[n].elapsed_time;
+  packet->is_rtcp = (0 == talk_base::GetBE16(header + 2));
+  packet->data = header + RtpDumpPacket::kHeaderLength;
+  packet->size = talk_base::GetBE16(header) - RtpDumpPacket::kHeaderLength;
+  return true;
+}
+
+size_t RtpDumpMappedReader::FindPacket(uint32 elapsed_ms) const {
+  IndexEntry key;
+  key.elapsed_time = elapsed_ms;
+  return std::lower_bound(index_.begin(), index_.end(), key, EarlierThan()) -
+      index_.begin();
+}
+
+void RtpDumpMappedReader::GetSsrcs(std::vector<uint32>* ssrcs) const {
+  ssrcs->clear();
+  for (SsrcMap::const_iterator it = ssrc_packets_.begin();
+       it != ssrc_packets_.end(); ++it) {
+    ssrcs->push_back(it->first);
+  }
+}
+
+const std::vector<size_t>* RtpDumpMappedReader::GetSsrcPackets(
+    uint32 ssrc) const {
+  SsrcMap::const_iterator it = ssrc_packets_.find(ssrc);
+  return it != ssrc_packets_.end() ? &it->second : NULL;
+}
+
+bool RtpDumpMappedReader::ReadFileHeader() {
+  const char* data = reinterpret_cast<const char*>(file_.data());
+  const char* end = static_cast<const char*>(
+      memchr(data, '\n', talk_base::_min(file_.size(), kMaxFirstLineLength)));
+  if (!end || !IsRtpDumpFirstLine(std::string(data, end))) {
+    return false;
+  }
+  size_t offset = end + 1 - data;
+  if (offset + RtpDumpFileHeader::kHeaderLength > file_.size()) {
+    return false;
+  }
+  uint32 start_sec = talk_base::GetBE32(data + offset);
+  uint32 start_usec = talk_base::GetBE32(data + offset + 4);
+  start_time_ms_ = start_sec * 1000 + start_usec / 1000;
+  first_packet_offset_ = offset + RtpDumpFileHeader::kHeaderLength;
+  return true;
+}
+
+void RtpDumpMappedReader::BuildIndex() {
+  index_.clear();
+  const uint8* data = file_.data();
+  size_t size = file_.size();
+  size_t offset = first_packet_offset_;
+  bool sorted = true;
+  while (offset + RtpDumpPacket::kHeaderLength <= size) {
+    const uint8* header = data + offset;
+    size_t dump_packet_len = talk_base::GetBE16(header);
+    if (dump_packet_len < RtpDumpPacket::kHeaderLength ||
+        offset + dump_packet_len > size) {
+      LOG(LS_WARNING) << "RTP dump is truncated at offset " << offset;
+      break;
+    }
+    const uint8* packet = header + RtpDumpPacket::kHeaderLength;
+    size_t packet_len = dump_packet_len - RtpDumpPacket::kHeaderLength;
+
+    IndexEntry entry;
+    entry.offset = offset;
+    entry.elapsed_time = talk_base::GetBE32(header + 4);
+    entry.ssrc = 0;
+    if (0 == talk_base::GetBE16(header + 2)) {
+      // RTCP; every RTCP packet starts with the sender's SSRC.
+      if (packet_len >= 8) {
+        entry.ssrc = talk_base::GetBE32(packet + 4);
+      }
+    } else {
+      GetRtpSsrc(packet, packet_len, &entry.ssrc);
+    }
+    if (!index_.empty() && entry.elapsed_time < index_.back().elapsed_time) {
+      sorted = false;
+    }
+    index_.push_back(entry);
+    offset += dump_packet_len;
+  }
+  if (!sorted) {
+    std::stable_sort(index_.begin(), index_.end(), EarlierThan());
+  }
+}
+
+bool RtpDumpMappedReader::LoadIndex(const std::string& filename) {
+  if (!talk_base::Filesystem::IsFile(talk_base::Pathname(filename))) {
+    return false;
+  }
+  talk_base::MappedFile index_file;
+  if (!index_file.Open(filename) ||
+      index_file.size() < kIndexHeaderLength) {
+    return false;
+  }
+  const uint8* data = index_file.data();
+  uint64 count = talk_base::GetBE64(data + 16);
+  // Bounded before multiplying, so that a corrupt count can't wrap around.
+  uint64 max_count =
+      (index_file.size() - kIndexHeaderLength) / kIndexEntryLength;
+  if (talk_base::GetBE32(data) != kIndexMagic ||
+      talk_base::GetBE32(data + 4) != kIndexVersion ||
+      talk_base::GetBE64(data + 8) != file_.size() ||
+      count > max_count ||
+      index_file.size() != kIndexHeaderLength + count * kIndexEntryLength) {
+    LOG(LS_INFO) << "Ignoring stale RTP dump index " << filename;
+    return false;
+  }
+
+  index_.resize(static_cast<size_t>(count));
+  const uint8* entry = data + kIndexHeaderLength;
+  for (size_t i = 0; i < index_.size(); ++i, entry += kIndexEntryLength) {
+    index_[i].offset = talk_base::GetBE64(entry);
+    index_[i].elapsed_time = talk_base::GetBE32(entry + 8);
+    index_[i].ssrc = talk_base::GetBE32(entry + 12);
+    // Don't trust the index with packets that are not wholly inside the
+    // dump; GetPacket() relies on it.
+    // Compared without adding to the offset, which is just as untrusted.
+    bool valid = index_[i].offset >= first_packet_offset_ &&
+        file_.size() >= RtpDumpPacket::kHeaderLength &&
+        index_[i].offset <= file_.size() - RtpDumpPacket::kHeaderLength;
+    if (valid) {
+      size_t dump_packet_len =
+          talk_base::GetBE16(file_.data() + index_[i].offset);
+      valid = dump_packet_len >= RtpDumpPacket::kHeaderLength &&
+          dump_packet_len <= file_.size() - index_[i].offset;
+    }
+    if (!valid) {
+      LOG(LS_WARNING) << "Ignoring corrupt RTP dump index " << filename;
+      index_.clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+void RtpDumpMappedReader::SaveIndex(const std::string& filename) {
+  talk_base::scoped_ptr<talk_base::FileStream> stream(
+      talk_base::Filesystem::OpenFile(talk_base::Pathname(filename), "wb"));
+  if (!stream.get()) {
+    // The dump may be on read-only storage; we just rebuild the index on
+    // every Open() then.
+    LOG(LS_WARNING) << "Cannot write RTP dump index " << filename;
+    return;
+  }
+  talk_base::ByteBuffer buf;
+  buf.WriteUInt32(kIndexMagic);
+  buf.WriteUInt32(kIndexVersion);
+  buf.WriteUInt64(file_.size());
+  buf.WriteUInt64(index_.size());
+  for (size_t i = 0; i < index_.size(); ++i) {
+    buf.WriteUInt64(index_[i].offset);
+    buf.WriteUInt32(index_[i].elapsed_time);
+    buf.WriteUInt32(index_[i].ssrc);
+  }
+  if (stream->WriteAll(buf.Data(), buf.Length(), NULL, NULL) !=
+      talk_base::SR_SUCCESS) {
+    LOG(LS_WARNING) << "Failed to write RTP dump index " << filename;
+    stream.reset();
+    talk_base::Filesystem::DeleteFile(talk_base::Pathname(filename));
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////
 // Implementation of RtpDumpWriter.
 ///////////////////////////////////////////////////////////////////////////
@@ -375,26 +649,181 @@ talk_base::StreamResult RtpDumpWriter::WritePacket(
 
 size_t RtpDumpWriter::FilterPacket(const void* data, size_t data_len,
                                    bool rtcp) {
-  size_t filtered_len = 0;
-  if (!rtcp) {
-    if ((packet_filter_ & PF_RTPPACKET) == PF_RTPPACKET) {
-      // RTP header + payload
-      filtered_len = data_len;
-    } else if ((packet_filter_ & PF_RTPHEADER) == PF_RTPHEADER) {
-      // RTP header only
-      size_t header_len;
-      if (GetRtpHeaderLen(data, data_len, &header_len)) {
-        filtered_len = header_len;
+  return FilterRtpDumpPacket(packet_filter_, data, data_len, rtcp);
+}
+
+///////////////////////////////////////////////////////////////////////////
+// Implementation of AsyncRtpDumpWriter.
+///////////////////////////////////////////////////////////////////////////
+
+enum {
+  MSG_WRITE_CHUNKS = 1,
+};
+
+struct AsyncRtpDumpWriter::Chunk {
+  explicit Chunk(size_t size) : data(new char[size]), length(0), packets(0) {}
+
+  talk_base::scoped_array<char> data;
+  size_t length;
+  size_t packets;
+};
+
+AsyncRtpDumpWriter::AsyncRtpDumpWriter(talk_base::StreamInterface* stream,
+                                       size_t chunk_size, size_t num_chunks)
+    : stream_(stream),
+      chunk_size_(chunk_size),
+      packet_filter_(PF_ALL),
+      start_time_ms_(talk_base::Time()),
+      current_(NULL),
+      packets_written_(0),
+      packets_dropped_(0),
+      write_failed_(false),
+      thread_(new talk_base::Thread()) {
+  ASSERT(num_chunks >= 2);
+  for (size_t i = 0; i < num_chunks; ++i) {
+    chunks_.push_back(new Chunk(chunk_size_));
+    free_chunks_.push_back(chunks_.back());
+  }
+  current_ = free_chunks_.back();
+  free_chunks_.pop_back();
+
+  // The file header goes first into the first chunk.
+  talk_base::ByteBuffer buf;
+  buf.WriteBytes(RtpDumpFileHeader::kFirstLine,
+                 strlen(RtpDumpFileHeader::kFirstLine));
+  RtpDumpFileHeader file_header(start_time_ms_, 0, 0);
+  file_header.WriteToByteBuffer(&buf);
+  ASSERT(buf.Length() <= chunk_size_);
+  memcpy(current_->data.get(), buf.Data(), buf.Length());
+  current_->length = buf.Length();
+
+  thread_->Start();
+}
+
+AsyncRtpDumpWriter::~AsyncRtpDumpWriter() {
+  Flush();
+  thread_->Stop();
+  for (size_t i = 0; i < chunks_.size(); ++i) {
+    delete chunks_[i];
+  }
+  if (packets_dropped_ > 0) {
+    LOG(LS_WARNING) << "AsyncRtpDumpWriter dropped " << packets_dropped_
+                    << " of " << packets_written_ + packets_dropped_
+                    << " packets";
+  }
+}
+
+void AsyncRtpDumpWriter::set_packet_filter(int filter) {
+  talk_base::CritScope cs(&crit_);
+  packet_filter_ = filter;
+  LOG(LS_INFO) << "AsyncRtpDumpWriter set_packet_filter to " << packet_filter_;
+}
+
+uint32 AsyncRtpDumpWriter::GetElapsedTime() const {
+  return talk_base::TimeSince(start_time_ms_);
+}
+
+void AsyncRtpDumpWriter::Flush() {
+  {
+    talk_base::CritScope cs(&crit_);
+    if (current_ && current_->length > 0) {
+      QueueCurrentChunk();
+    }
+  }
+  // Send() returns once the background thread has drained the full queue.
+  thread_->Send(this, MSG_WRITE_CHUNKS);
+}
+
+size_t AsyncRtpDumpWriter::packets_written() const {
+  talk_base::CritScope cs(&crit_);
+  return packets_written_;
+}
+
+size_t AsyncRtpDumpWriter::packets_dropped() const {
+  talk_base::CritScope cs(&crit_);
+  return packets_dropped_;
+}
+
+void AsyncRtpDumpWriter::OnMessage(talk_base::Message* msg) {
+  ASSERT(msg->message_id == MSG_WRITE_CHUNKS);
+  WriteFullChunks();
+}
+
+bool AsyncRtpDumpWriter::WritePacket(
+    const void* data, size_t data_len, uint32 elapsed, bool rtcp) {
+  if (!stream_ || !data || 0 == data_len) return false;
+
+  talk_base::CritScope cs(&crit_);
+  // Figure out what to write.
+  size_t write_len = FilterRtpDumpPacket(packet_filter_, data, data_len, rtcp);
+  if (write_len == 0) {
+    return true;
+  }
+  size_t dump_len = RtpDumpPacket::kHeaderLength + write_len;
+  if (current_ && current_->length + dump_len > chunk_size_) {
+    QueueCurrentChunk();
+  }
+  if (!current_ && !free_chunks_.empty()) {
+    current_ = free_chunks_.back();
+    free_chunks_.pop_back();
+  }
+  if (!current_ || dump_len > chunk_size_) {
+    // The disk is not keeping up, or the chunks are too small.
+    ++packets_dropped_;
+    return false;
+  }
+
+  // Write the dump packet header, then the header or full packet as
+  // indicated by write_len.
+  char* p = current_->data.get() + current_->length;
+  talk_base::SetBE16(p, static_cast<uint16>(dump_len));
+  talk_base::SetBE16(p + 2, static_cast<uint16>(rtcp ? 0 : data_len));
+  talk_base::SetBE32(p + 4, elapsed);
+  memcpy(p + RtpDumpPacket::kHeaderLength, data, write_len);
+  current_->length += dump_len;
+  ++current_->packets;
+  return true;
+}
+
+void AsyncRtpDumpWriter::QueueCurrentChunk() {
+  full_chunks_.push_back(current_);
+  current_ = NULL;
+  thread_->Post(this, MSG_WRITE_CHUNKS);
+}
+
+void AsyncRtpDumpWriter::WriteFullChunks() {
+  ASSERT(talk_base::Thread::Current() == thread_.get());
+  while (true) {
+    Chunk* chunk;
+    {
+      talk_base::CritScope cs(&crit_);
+      if (full_chunks_.empty()) {
+        break;
       }
+      chunk = full_chunks_.front();
+      full_chunks_.pop_front();
     }
-  } else {
-    if ((packet_filter_ & PF_RTCPPACKET) == PF_RTCPPACKET) {
-      // RTCP header + payload
-      filtered_len = data_len;
+
+    // Once a write has failed, the dump is corrupt and we don't write to it
+    // anymore.
+    bool success = !write_failed_ &&
+        stream_->WriteAll(chunk->data.get(), chunk->length, NULL, NULL) ==
+        talk_base::SR_SUCCESS;
+    if (!success && !write_failed_) {
+      LOG(LS_ERROR) << "AsyncRtpDumpWriter failed to write to the dump";
+      write_failed_ = true;
     }
-  }
 
-  return filtered_len;
+    talk_base::CritScope cs(&crit_);
+    if (success) {
+      packets_written_ += chunk->packets;
+    } else {
+      packets_dropped_ += chunk->packets;
+    }
+    chunk->length = 0;
+    chunk->packets = 0;
+    free_chunks_.push_back(chunk);
+  }
 }
 
 }  // namespace cricket
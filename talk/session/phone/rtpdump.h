@@ -29,13 +29,23 @@
 #define TALK_SESSION_PHONE_RTPDUMP_H_
 
 #include <cstring>
+#include <deque>
+#include <map>
 #include <string>
 #include <vector>
 
 #include "talk/base/basictypes.h"
 #include "talk/base/bytebuffer.h"
+#include "talk/base/criticalsection.h"
+#include "talk/base/mappedfile.h"
+#include "talk/base/messagehandler.h"
+#include "talk/base/scoped_ptr.h"
 #include "talk/base/stream.h"
 
+namespace talk_base {
+class Thread;
+}
+
 namespace cricket {
 
 // We use the RTP dump file format compatible to the format used by rtptools
@@ -177,6 +187,85 @@ class RtpDumpLoopReader : public RtpDumpReader {
   DISALLOW_COPY_AND_ASSIGN(RtpDumpLoopReader);
 };
 
+// A dump packet inside the memory mapping of a RtpDumpMappedReader. The data
+// is valid until the reader is closed.
+struct RtpDumpPacketView {
+  RtpDumpPacketView() : elapsed_time(0), is_rtcp(false), data(NULL), size(0) {}
+
+  uint32 elapsed_time;  // Milliseconds since the start of recording.
+  bool is_rtcp;         // True if data points to a RTCP packet.
+  const uint8* data;    // The actual RTP or RTCP packet.
+  size_t size;
+};
+
+// RtpDumpMappedReader reads an RTP dump file through a read-only memory
+// mapping and returns views into it, so that replaying even a multi-GB dump
+// costs no copies or allocations per packet. It keeps an index of all dump
+// packets in elapsed time order, which allows seeking in O(log n) and
+// replaying each SSRC of the dump separately. The index is saved next to the
+// dump as a sidecar file, kIndexSuffix appended to its name, and reused while
+// the dump is unchanged. Once opened, the const methods may be used from
+// several threads at once, e.g. one per replayed stream.
+class RtpDumpMappedReader {
+ public:
+  static const char kIndexSuffix[];
+
+  RtpDumpMappedReader();
+  ~RtpDumpMappedReader();
+
+  bool Open(const std::string& filename);
+  void Close();
+
+  size_t packet_count() const { return index_.size(); }
+  uint32 start_time_ms() const { return start_time_ms_; }
+
+  // Sequential reading, in elapsed time order.
+  talk_base::StreamResult ReadPacket(RtpDumpPacketView* packet);
+  void Rewind() { next_packet_ = 0; }
+  // Makes ReadPacket() continue at the first packet with an elapsed time of
+  // at least elapsed_ms.
+  void SeekToTime(uint32 elapsed_ms) { next_packet_ = FindPacket(elapsed_ms); }
+
+  // Random access by position in elapsed time order.
+  bool GetPacket(size_t n, RtpDumpPacketView* packet) const;
+  // Returns the position of the first packet with an elapsed time of at
+  // least elapsed_ms, or packet_count() if there is none.
+  size_t FindPacket(uint32 elapsed_ms) const;
+
+  // The SSRCs in the dump, taken from the RTP header or the RTCP sender.
+  void GetSsrcs(std::vector<uint32>* ssrcs) const;
+  // Returns the positions of the packets of one SSRC, in elapsed time order,
+  // or NULL if the SSRC is not in the dump.
+  const std::vector<size_t>* GetSsrcPackets(uint32 ssrc) const;
+
+ private:
+  struct IndexEntry {
+    uint64 offset;  // Of the dump packet header in the file.
+    uint32 elapsed_time;
+    uint32 ssrc;
+  };
+  struct EarlierThan {
+    bool operator()(const IndexEntry& a, const IndexEntry& b) const {
+      return a.elapsed_time < b.elapsed_time;
+    }
+  };
+  typedef std::map<uint32, std::vector<size_t> > SsrcMap;
+
+  bool ReadFileHeader();
+  void BuildIndex();
+  bool LoadIndex(const std::string& filename);
+  void SaveIndex(const std::string& filename);
+
+  talk_base::MappedFile file_;
+  size_t first_packet_offset_;
+  uint32 start_time_ms_;
+  std::vector<IndexEntry> index_;
+  SsrcMap ssrc_packets_;
+  size_t next_packet_;
+
+  DISALLOW_COPY_AND_ASSIGN(RtpDumpMappedReader);
+};
+
 class RtpDumpWriter {
  public:
   explicit RtpDumpWriter(talk_base::StreamInterface* stream);
@@ -218,6 +307,78 @@ class RtpDumpWriter {
   DISALLOW_COPY_AND_ASSIGN(RtpDumpWriter);
 };
 
+// AsyncRtpDumpWriter records packets in the same format as RtpDumpWriter, but
+// never touches the stream on the calling thread. Packets are appended to an
+// in-memory chunk; full chunks are handed to a background thread which writes
+// each of them to the stream with a single large write. If all chunks are
+// still waiting for the disk, packets are dropped and counted rather than
+// blocking the caller, so recording can be left on for live calls.
+// The Write methods may be called from any thread.
+class AsyncRtpDumpWriter : public talk_base::MessageHandler {
+ public:
+  static const size_t kDefaultChunkSize = 256 * 1024;
+  static const size_t kDefaultNumChunks = 4;
+
+  // The stream is not owned, and must outlive the writer. Packets that do
+  // not fit into a chunk are dropped.
+  explicit AsyncRtpDumpWriter(talk_base::StreamInterface* stream,
+                              size_t chunk_size = kDefaultChunkSize,
+                              size_t num_chunks = kDefaultNumChunks);
+  // Writes out all recorded packets before returning.
+  virtual ~AsyncRtpDumpWriter();
+
+  void set_packet_filter(int filter);
+  // Return false if the packet was dropped, either because it was invalid or
+  // because there was no free chunk to record it into.
+  bool WriteRtpPacket(const void* data, size_t data_len) {
+    return WritePacket(data, data_len, GetElapsedTime(), false);
+  }
+  bool WriteRtcpPacket(const void* data, size_t data_len) {
+    return WritePacket(data, data_len, GetElapsedTime(), true);
+  }
+  bool WritePacket(const RtpDumpPacket& packet) {
+    return WritePacket(&packet.data[0], packet.data.size(),
+                       packet.elapsed_time, packet.is_rtcp);
+  }
+  uint32 GetElapsedTime() const;
+
+  // Hands the partially filled chunk to the background thread and waits until
+  // everything recorded so far has been written to the stream.
+  void Flush();
+
+  // Statistics. Packets lost to stream errors count as dropped.
+  size_t packets_written() const;
+  size_t packets_dropped() const;
+
+  // MessageHandler implementation.
+  virtual void OnMessage(talk_base::Message* msg);
+
+ private:
+  struct Chunk;
+
+  bool WritePacket(const void* data, size_t data_len, uint32 elapsed,
+                   bool rtcp);
+  // Moves current_ to the full queue and wakes up the background thread.
+  // Must be called with crit_ held.
+  void QueueCurrentChunk();
+  void WriteFullChunks();
+
+  talk_base::StreamInterface* stream_;
+  size_t chunk_size_;
+  int packet_filter_;
+  uint32 start_time_ms_;
+  std::vector<Chunk*> chunks_;  // Owns all chunks.
+  Chunk* current_;              // NULL if no chunk was free.
+  std::vector<Chunk*> free_chunks_;
+  std::deque<Chunk*> full_chunks_;
+  size_t packets_written_;
+  size_t packets_dropped_;
+  bool write_failed_;
+  mutable talk_base::CriticalSection crit_;
+  talk_base::scoped_ptr<talk_base::Thread> thread_;
+  DISALLOW_COPY_AND_ASSIGN(AsyncRtpDumpWriter);
+};
+
 }  // namespace cricket
 
 #endif  // TALK_SESSION_PHONE_RTPDUMP_H_
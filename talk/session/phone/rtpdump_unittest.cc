@@ -0,0 +1,399 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string>
+#include <vector>
+
+#include "talk/base/byteorder.h"
+#include "talk/base/event.h"
+#include "talk/base/fileutils.h"
+#include "talk/base/gunit.h"
+#include "talk/base/pathutils.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/session/phone/rtpdump.h"
+
+namespace cricket {
+
+static const uint32 kSsrcs[] = { 0x11111111, 0x22222222 };
+static const int kPacketsPerSsrc = 50;
+static const uint32 kPacketInterval = 10;
+
+class RtpDumpMappedReaderTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    talk_base::Pathname temp_dir;
+    ASSERT_TRUE(talk_base::Filesystem::GetTemporaryFolder(temp_dir, true,
+                                                          NULL));
+    filename_ = talk_base::Filesystem::TempFilename(temp_dir, "rtpdump");
+    WriteDump();
+  }
+
+  virtual void TearDown() {
+    DeleteIfExists(filename_);
+    DeleteIfExists(filename_ + RtpDumpMappedReader::kIndexSuffix);
+  }
+
+  static void DeleteIfExists(const std::string& filename) {
+    talk_base::Pathname path(filename);
+    if (talk_base::Filesystem::IsFile(path)) {
+      talk_base::Filesystem::DeleteFile(path);
+    }
+  }
+
+  // Writes alternating RTP packets of the two SSRCs, one every
+  // kPacketInterval ms, and an RTCP packet from the first SSRC every 10th.
+  void WriteDump() {
+    talk_base::scoped_ptr<talk_base::FileStream> stream(
+        talk_base::Filesystem::OpenFile(talk_base::Pathname(filename_), "wb"));
+    ASSERT_TRUE(stream.get() != NULL);
+    RtpDumpWriter writer(stream.get());
+    uint32 elapsed = 0;
+    for (int i = 0; i < kPacketsPerSsrc; ++i) {
+      for (size_t s = 0; s < ARRAY_SIZE(kSsrcs); ++s) {
+        uint8 rtp[20] = { 0x80, 0x00 };
+        talk_base::SetBE16(rtp + 2, i);
+        talk_base::SetBE32(rtp + 4, i * 90);
+        talk_base::SetBE32(rtp + 8, kSsrcs[s]);
+        RtpDumpPacket packet(rtp, sizeof(rtp), elapsed, false);
+        ASSERT_EQ(talk_base::SR_SUCCESS, writer.WritePacket(packet));
+        elapsed += kPacketInterval;
+      }
+      if (i % 10 == 0) {
+        uint8 rtcp[8] = { 0x80, 200, 0x00, 0x01 };
+        talk_base::SetBE32(rtcp + 4, kSsrcs[0]);
+        RtpDumpPacket packet(rtcp, sizeof(rtcp), elapsed, true);
+        ASSERT_EQ(talk_base::SR_SUCCESS, writer.WritePacket(packet));
+      }
+    }
+  }
+
+  size_t NumPackets() const {
+    return kPacketsPerSsrc * ARRAY_SIZE(kSsrcs) + kPacketsPerSsrc / 10;
+  }
+
+  std::string filename_;
+};
+
+// Test that the mapped reader returns the same packets as RtpDumpReader.
+TEST_F(RtpDumpMappedReaderTest, ReadMatchesStreamReader) {
+  RtpDumpMappedReader mapped;
+  ASSERT_TRUE(mapped.Open(filename_));
+  EXPECT_EQ(NumPackets(), mapped.packet_count());
+
+  talk_base::scoped_ptr<talk_base::FileStream> stream(
+      talk_base::Filesystem::OpenFile(talk_base::Pathname(filename_), "rb"));
+  ASSERT_TRUE(stream.get() != NULL);
+  RtpDumpReader reader(stream.get());
+
+  RtpDumpPacket packet;
+  RtpDumpPacketView view;
+  size_t count = 0;
+  while (reader.ReadPacket(&packet) == talk_base::SR_SUCCESS) {
+    ASSERT_EQ(talk_base::SR_SUCCESS, mapped.ReadPacket(&view));
+    EXPECT_EQ(packet.elapsed_time, view.elapsed_time);
+    EXPECT_EQ(packet.is_rtcp, view.is_rtcp);
+    ASSERT_EQ(packet.data.size(), view.size);
+    EXPECT_EQ(0, memcmp(&packet.data[0], view.data, view.size));
+    ++count;
+  }
+  EXPECT_EQ(NumPackets(), count);
+  EXPECT_EQ(talk_base::SR_EOS, mapped.ReadPacket(&view));
+
+  mapped.Rewind();
+  EXPECT_EQ(talk_base::SR_SUCCESS, mapped.ReadPacket(&view));
+  EXPECT_EQ(0U, view.elapsed_time);
+}
+
+TEST_F(RtpDumpMappedReaderTest, SeekToTime) {
+  RtpDumpMappedReader reader;
+  ASSERT_TRUE(reader.Open(filename_));
+
+  RtpDumpPacketView view;
+  reader.SeekToTime(505);
+  ASSERT_EQ(talk_base::SR_SUCCESS, reader.ReadPacket(&view));
+  EXPECT_EQ(510U, view.elapsed_time);
+
+  // Seeking before the start or past the end.
+  reader.SeekToTime(0);
+  ASSERT_EQ(talk_base::SR_SUCCESS, reader.ReadPacket(&view));
+  EXPECT_EQ(0U, view.elapsed_time);
+  reader.SeekToTime(0xFFFFFFFF);
+  EXPECT_EQ(talk_base::SR_EOS, reader.ReadPacket(&view));
+
+  size_t n = reader.FindPacket(200);
+  ASSERT_TRUE(reader.GetPacket(n, &view));
+  EXPECT_EQ(200U, view.elapsed_time);
+  EXPECT_FALSE(reader.GetPacket(reader.packet_count(), &view));
+}
+
+TEST_F(RtpDumpMappedReaderTest, SsrcIndex) {
+  RtpDumpMappedReader reader;
+  ASSERT_TRUE(reader.Open(filename_));
+
+  std::vector<uint32> ssrcs;
+  reader.GetSsrcs(&ssrcs);
+  ASSERT_EQ(2U, ssrcs.size());
+  EXPECT_EQ(kSsrcs[0], ssrcs[0]);
+  EXPECT_EQ(kSsrcs[1], ssrcs[1]);
+  EXPECT_TRUE(reader.GetSsrcPackets(0x33333333) == NULL);
+
+  // The first SSRC also owns the RTCP packets.
+  const std::vector<size_t>* packets = reader.GetSsrcPackets(kSsrcs[0]);
+  ASSERT_TRUE(packets != NULL);
+  EXPECT_EQ(static_cast<size_t>(kPacketsPerSsrc + kPacketsPerSsrc / 10),
+            packets->size());
+  packets = reader.GetSsrcPackets(kSsrcs[1]);
+  ASSERT_TRUE(packets != NULL);
+  ASSERT_EQ(static_cast<size_t>(kPacketsPerSsrc), packets->size());
+  uint32 last_elapsed = 0;
+  for (size_t i = 0; i < packets->size(); ++i) {
+    RtpDumpPacketView view;
+    ASSERT_TRUE(reader.GetPacket((*packets)[i], &view));
+    EXPECT_FALSE(view.is_rtcp);
+    EXPECT_EQ(kSsrcs[1], talk_base::GetBE32(view.data + 8));
+    EXPECT_LE(last_elapsed, view.elapsed_time);
+    last_elapsed = view.elapsed_time;
+  }
+}
+
+// Test that the sidecar index is written, reused, and ignored once the dump
+// no longer matches it.
+TEST_F(RtpDumpMappedReaderTest, SidecarIndex) {
+  talk_base::Pathname index(filename_ + RtpDumpMappedReader::kIndexSuffix);
+  RtpDumpMappedReader reader;
+  ASSERT_TRUE(reader.Open(filename_));
+  EXPECT_TRUE(talk_base::Filesystem::IsFile(index));
+
+  ASSERT_TRUE(reader.Open(filename_));
+  EXPECT_EQ(NumPackets(), reader.packet_count());
+  reader.Close();
+
+  // Append a packet; the stale index must not be used.
+  {
+    talk_base::scoped_ptr<talk_base::FileStream> stream(
+        talk_base::Filesystem::OpenFile(talk_base::Pathname(filename_), "ab"));
+    ASSERT_TRUE(stream.get() != NULL);
+    uint8 header[RtpDumpPacket::kHeaderLength + 12] = { 0 };
+    talk_base::SetBE16(header, sizeof(header));
+    talk_base::SetBE16(header + 2, 12);
+    talk_base::SetBE32(header + 4, 100000);
+    header[8] = 0x80;
+    talk_base::SetBE32(header + 16, 0x33333333);
+    ASSERT_EQ(talk_base::SR_SUCCESS,
+              stream->WriteAll(header, sizeof(header), NULL, NULL));
+  }
+  ASSERT_TRUE(reader.Open(filename_));
+  EXPECT_EQ(NumPackets() + 1, reader.packet_count());
+  EXPECT_TRUE(reader.GetSsrcPackets(0x33333333) != NULL);
+}
+
+// Test that an index entry whose packet length is shorter than the packet
+// header is not trusted.
+TEST_F(RtpDumpMappedReaderTest, IgnoresIndexOfCorruptPacket) {
+  RtpDumpMappedReader reader;
+  ASSERT_TRUE(reader.Open(filename_));
+  reader.Close();
+
+  // Overwrite the length of the last packet, keeping the dump's size so that
+  // the index still looks current.
+  {
+    talk_base::scoped_ptr<talk_base::FileStream> stream(
+        talk_base::Filesystem::OpenFile(talk_base::Pathname(filename_), "r+b"));
+    ASSERT_TRUE(stream.get() != NULL);
+    size_t size;
+    ASSERT_TRUE(stream->GetSize(&size));
+    ASSERT_TRUE(stream->SetPosition(size - RtpDumpPacket::kHeaderLength - 20));
+    uint8 len[2];
+    talk_base::SetBE16(len, RtpDumpPacket::kHeaderLength - 4);
+    ASSERT_EQ(talk_base::SR_SUCCESS,
+              stream->WriteAll(len, sizeof(len), NULL, NULL));
+  }
+
+  // The rebuilt index stops at the corrupt packet.
+  ASSERT_TRUE(reader.Open(filename_));
+  EXPECT_EQ(NumPackets() - 1, reader.packet_count());
+  RtpDumpPacketView packet;
+  for (size_t i = 0; i < reader.packet_count(); ++i) {
+    ASSERT_TRUE(reader.GetPacket(i, &packet));
+    EXPECT_LE(packet.size, 20U);
+  }
+}
+
+// Test that an index whose entry count only matches its size once the
+// multiplication wraps is not trusted.
+TEST_F(RtpDumpMappedReaderTest, IgnoresIndexWithHugeCount) {
+  RtpDumpMappedReader reader;
+  ASSERT_TRUE(reader.Open(filename_));
+  reader.Close();
+
+  {
+    talk_base::scoped_ptr<talk_base::FileStream> stream(
+        talk_base::Filesystem::OpenFile(
+            talk_base::Pathname(filename_ + RtpDumpMappedReader::kIndexSuffix),
+            "r+b"));
+    ASSERT_TRUE(stream.get() != NULL);
+    ASSERT_TRUE(stream->SetPosition(16));
+    uint8 count[8];
+    talk_base::SetBE64(count, NumPackets() + (static_cast<uint64>(1) << 60));
+    ASSERT_EQ(talk_base::SR_SUCCESS,
+              stream->WriteAll(count, sizeof(count), NULL, NULL));
+  }
+
+  ASSERT_TRUE(reader.Open(filename_));
+  EXPECT_EQ(NumPackets(), reader.packet_count());
+}
+
+TEST_F(RtpDumpMappedReaderTest, RejectsNonDump) {
+  talk_base::Filesystem::DeleteFile(talk_base::Pathname(filename_));
+  RtpDumpMappedReader reader;
+  EXPECT_FALSE(reader.Open(filename_));
+  {
+    talk_base::scoped_ptr<talk_base::FileStream> stream(
+        talk_base::Filesystem::OpenFile(talk_base::Pathname(filename_), "wb"));
+    ASSERT_TRUE(stream.get() != NULL);
+    static const char kNotADump[] = "#!rtpplay1.0 1.2.3.4/x\n0123456789abcdef";
+    ASSERT_EQ(talk_base::SR_SUCCESS,
+              stream->WriteAll(kNotADump, sizeof(kNotADump), NULL, NULL));
+  }
+  EXPECT_FALSE(reader.Open(filename_));
+}
+
+// A MemoryStream whose writes block until it is unblocked.
+class BlockingMemoryStream : public talk_base::MemoryStream {
+ public:
+  BlockingMemoryStream() : unblocked_(true, false) {}
+  void Unblock() { unblocked_.Set(); }
+
+  virtual talk_base::StreamResult Write(const void* data, size_t data_len,
+                                        size_t* written, int* error) {
+    unblocked_.Wait(talk_base::kForever);
+    return talk_base::MemoryStream::Write(data, data_len, written, error);
+  }
+
+ private:
+  talk_base::Event unblocked_;
+};
+
+static void WriteTestRtpPacket(int seq_num, uint8* rtp, size_t len) {
+  memset(rtp, 0, len);
+  rtp[0] = 0x80;
+  talk_base::SetBE16(rtp + 2, seq_num);
+  talk_base::SetBE32(rtp + 8, kSsrcs[0]);
+}
+
+// Test that AsyncRtpDumpWriter produces the same dump as RtpDumpWriter.
+TEST(AsyncRtpDumpWriterTest, WriteAndRead) {
+  static const int kNumPackets = 1000;
+  talk_base::MemoryStream stream;
+  {
+    // Small chunks, so that many of them are written.
+    AsyncRtpDumpWriter writer(&stream, 4096, 2);
+    uint8 rtp[100];
+    for (int i = 0; i < kNumPackets; ++i) {
+      WriteTestRtpPacket(i, rtp, sizeof(rtp));
+      RtpDumpPacket packet(rtp, sizeof(rtp), i, false);
+      if (!writer.WritePacket(packet)) {
+        // Let the background thread catch up.
+        writer.Flush();
+        ASSERT_TRUE(writer.WritePacket(packet));
+      }
+      if (i % 100 == 0) {
+        uint8 rtcp[8] = { 0x80, 200, 0x00, 0x01 };
+        ASSERT_TRUE(writer.WritePacket(
+            RtpDumpPacket(rtcp, sizeof(rtcp), i, true)));
+      }
+    }
+    writer.Flush();
+    EXPECT_EQ(static_cast<size_t>(kNumPackets + kNumPackets / 100),
+              writer.packets_written());
+  }
+
+  stream.Rewind();
+  RtpDumpReader reader(&stream);
+  RtpDumpPacket packet;
+  int rtp_packets = 0;
+  int rtcp_packets = 0;
+  while (reader.ReadPacket(&packet) == talk_base::SR_SUCCESS) {
+    if (packet.is_rtcp) {
+      ++rtcp_packets;
+      continue;
+    }
+    int seq_num;
+    ASSERT_TRUE(packet.GetRtpSeqNum(&seq_num));
+    EXPECT_EQ(rtp_packets, seq_num);
+    EXPECT_EQ(static_cast<uint32>(rtp_packets), packet.elapsed_time);
+    EXPECT_EQ(100U, packet.data.size());
+    ++rtp_packets;
+  }
+  EXPECT_EQ(kNumPackets, rtp_packets);
+  EXPECT_EQ(kNumPackets / 100, rtcp_packets);
+}
+
+TEST(AsyncRtpDumpWriterTest, HeaderFilter) {
+  talk_base::MemoryStream stream;
+  {
+    AsyncRtpDumpWriter writer(&stream);
+    writer.set_packet_filter(PF_RTPHEADER);
+    uint8 rtp[100];
+    WriteTestRtpPacket(1, rtp, sizeof(rtp));
+    EXPECT_TRUE(writer.WriteRtpPacket(rtp, sizeof(rtp)));
+    uint8 rtcp[8] = { 0x80, 200, 0x00, 0x01 };
+    EXPECT_TRUE(writer.WriteRtcpPacket(rtcp, sizeof(rtcp)));
+  }
+
+  stream.Rewind();
+  RtpDumpReader reader(&stream);
+  RtpDumpPacket packet;
+  ASSERT_EQ(talk_base::SR_SUCCESS, reader.ReadPacket(&packet));
+  EXPECT_FALSE(packet.is_rtcp);
+  EXPECT_EQ(12U, packet.data.size());
+  EXPECT_EQ(talk_base::SR_EOS, reader.ReadPacket(&packet));
+}
+
+// Test that packets are dropped, not blocked on, while the stream is stuck.
+TEST(AsyncRtpDumpWriterTest, DropsWhenStreamBlocks) {
+  BlockingMemoryStream stream;
+  AsyncRtpDumpWriter writer(&stream, 1024, 2);
+  uint8 rtp[100];
+  WriteTestRtpPacket(0, rtp, sizeof(rtp));
+  int accepted = 0;
+  for (int i = 0; i < 100; ++i) {
+    if (writer.WriteRtpPacket(rtp, sizeof(rtp))) {
+      ++accepted;
+    }
+  }
+  // Both chunks are full or waiting for the stream.
+  EXPECT_LT(accepted, 100);
+  EXPECT_EQ(static_cast<size_t>(100 - accepted), writer.packets_dropped());
+
+  stream.Unblock();
+  writer.Flush();
+  EXPECT_EQ(static_cast<size_t>(accepted), writer.packets_written());
+  EXPECT_TRUE(writer.WriteRtpPacket(rtp, sizeof(rtp)));
+}
+
+}  // namespace cricket
@@ -0,0 +1,241 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "talk/session/phone/rtpjitterbuffer.h"
+
+#include <stdlib.h>
+
+#include "talk/base/buffer.h"
+#include "talk/base/common.h"
+#include "talk/base/thread.h"
+#include "talk/base/time.h"
+#include "talk/session/phone/rtputils.h"
+
+namespace cricket {
+
+static const uint32 MSG_RELEASE = 1;
+
+// The first sequence number of a stream is put this far up, so that packets
+// from before it still get positive extended sequence numbers.
+static const int64 kSeqNumOffset = 1 << 16;
+
+const int RtpJitterBuffer::kDefaultTargetDelayMs;
+const size_t RtpJitterBuffer::kMaxHeldPackets;
+
+RtpJitterBuffer::RtpJitterBuffer(talk_base::Thread* thread,
+                                 int target_delay_ms)
+    : thread_(thread),
+      release_pending_(false),
+      release_time_(0),
+      target_delay_(target_delay_ms),
+      clock_rate_(0) {
+}
+
+RtpJitterBuffer::~RtpJitterBuffer() {
+  if (thread_)
+    thread_->Clear(this);
+  for (StreamMap::iterator it = streams_.begin(); it != streams_.end(); ++it) {
+    PacketMap& held = it->second.held;
+    for (PacketMap::iterator p = held.begin(); p != held.end(); ++p)
+      delete p->second.packet;
+  }
+}
+
+void RtpJitterBuffer::InsertPacket(talk_base::Buffer* packet) {
+  InsertPacket(packet, talk_base::Time());
+}
+
+void RtpJitterBuffer::InsertPacket(talk_base::Buffer* packet, uint32 now) {
+  RtpHeader header;
+  if (!ParseRtpHeader(packet->data(), packet->length(), &header)) {
+    ++stats_.packets_received;
+    Release(packet);
+    return;
+  }
+  InsertPacket(header, packet, now);
+}
+
+void RtpJitterBuffer::InsertPacket(const RtpHeader& header,
+                                   talk_base::Buffer* packet, uint32 now) {
+  ++stats_.packets_received;
+  Stream& stream = streams_[header.ssrc];
+  int64 seq = Unwrap(stream, header.seq_num);
+  if (stream.started && seq < stream.next_seq) {
+    ++stats_.packets_late;
+    return;
+  }
+  if (stream.held.find(seq) != stream.held.end()) {
+    ++stats_.packets_duplicate;
+    return;
+  }
+  if (seq < stream.highest_seq)
+    ++stats_.packets_reordered;
+  else
+    stream.highest_seq = seq;
+
+  if (clock_rate_ > 0)
+    UpdateJitter(&stream, header.timestamp, now);
+
+  // The common case: the packet is the one we were waiting for.
+  if (stream.started && seq == stream.next_seq && stream.held.empty()) {
+    ++stream.next_seq;
+    Release(packet);
+    return;
+  }
+
+  HeldPacket held;
+  held.packet = new talk_base::Buffer();
+  held.arrival_time = now;
+  packet->TransferTo(held.packet);
+  stream.held[seq] = held;
+
+  int delay = ReleaseStream(&stream, now, false);
+  if (delay >= 0)
+    ScheduleRelease(delay);
+}
+
+int RtpJitterBuffer::ReleasePackets(uint32 now) {
+  int next = -1;
+  for (StreamMap::iterator it = streams_.begin(); it != streams_.end(); ++it) {
+    int delay = ReleaseStream(&it->second, now, false);
+    if (delay >= 0 && (next < 0 || delay < next))
+      next = delay;
+  }
+  return next;
+}
+
+void RtpJitterBuffer::Flush() {
+  for (StreamMap::iterator it = streams_.begin(); it != streams_.end(); ++it)
+    ReleaseStream(&it->second, 0, true);
+}
+
+size_t RtpJitterBuffer::held_packets() const {
+  size_t count = 0;
+  for (StreamMap::const_iterator it = streams_.begin(); it != streams_.end();
+       ++it) {
+    count += it->second.held.size();
+  }
+  return count;
+}
+
+RtpJitterBufferStats RtpJitterBuffer::stats() const {
+  RtpJitterBufferStats stats(stats_);
+  if (clock_rate_ > 0) {
+    for (StreamMap::const_iterator it = streams_.begin();
+         it != streams_.end(); ++it) {
+      int jitter_ms = static_cast<int>(it->second.jitter * 1000 / clock_rate_);
+      stats.jitter_ms = talk_base::_max(stats.jitter_ms, jitter_ms);
+    }
+  }
+  return stats;
+}
+
+void RtpJitterBuffer::OnMessage(talk_base::Message* pmsg) {
+  ASSERT(pmsg->message_id == MSG_RELEASE);
+  release_pending_ = false;
+  int delay = ReleasePackets(thread_->LoopTime());
+  if (delay >= 0)
+    ScheduleRelease(delay);
+}
+
+int64 RtpJitterBuffer::Unwrap(const Stream& stream, int seq) {
+  if (stream.highest_seq == 0)
+    return kSeqNumOffset + seq;
+  // Pick the wrap-around that puts the packet closest to the highest one.
+  int64 seq64 = (stream.highest_seq & ~static_cast<int64>(0xFFFF)) + seq;
+  if (seq64 - stream.highest_seq > 0x8000)
+    seq64 -= 0x10000;
+  else if (stream.highest_seq - seq64 > 0x8000)
+    seq64 += 0x10000;
+  return seq64;
+}
+
+void RtpJitterBuffer::UpdateJitter(Stream* stream, uint32 timestamp,
+                                   uint32 now) {
+  // Interarrival jitter as in RFC 3550, section 6.4.1.
+  uint32 arrival = static_cast<uint32>(
+      static_cast<int64>(now) * clock_rate_ / 1000);
+  uint32 transit = arrival - timestamp;
+  if (stream->has_transit) {
+    int d = abs(static_cast<int32>(transit - stream->last_transit));
+    stream->jitter += (d - stream->jitter) / 16;
+  }
+  stream->has_transit = true;
+  stream->last_transit = transit;
+}
+
+int RtpJitterBuffer::ReleaseStream(Stream* stream, uint32 now, bool flush) {
+  PacketMap& held = stream->held;
+  while (!held.empty()) {
+    PacketMap::iterator it = held.begin();
+    if (!stream->started || it->first != stream->next_seq) {
+      // There is a gap before the first held packet (or the stream has only
+      // just begun, and earlier packets may still be on their way). Wait for
+      // it to fill until the packets have waited long enough.
+      if (!flush && held.size() < kMaxHeldPackets) {
+        uint32 oldest = it->second.arrival_time;
+        for (PacketMap::iterator p = held.begin(); p != held.end(); ++p)
+          oldest = talk_base::TimeMin(oldest, p->second.arrival_time);
+        int waited = talk_base::TimeDiff(now, oldest);
+        if (waited < target_delay_)
+          return target_delay_ - waited;
+      }
+      if (stream->started)
+        stats_.packets_lost += static_cast<int>(it->first - stream->next_seq);
+      stream->started = true;
+      stream->next_seq = it->first;
+    }
+
+    talk_base::Buffer* packet = it->second.packet;
+    held.erase(it);
+    ++stream->next_seq;
+    Release(packet);
+    delete packet;
+  }
+  return -1;
+}
+
+void RtpJitterBuffer::Release(talk_base::Buffer* packet) {
+  ++stats_.packets_released;
+  SignalPacketReady(packet);
+}
+
+void RtpJitterBuffer::ScheduleRelease(int delay) {
+  if (!thread_)
+    return;
+  uint32 release_time = talk_base::Time() + delay;
+  if (release_pending_ &&
+      talk_base::TimeIsLaterOrEqual(release_time_, release_time)) {
+    return;
+  }
+  thread_->Clear(this, MSG_RELEASE);
+  thread_->PostDelayed(delay, this, MSG_RELEASE);
+  release_pending_ = true;
+  release_time_ = release_time;
+}
+
+}  // namespace cricket
@@ -0,0 +1,145 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TALK_SESSION_PHONE_RTPJITTERBUFFER_H_
+#define TALK_SESSION_PHONE_RTPJITTERBUFFER_H_
+
+#include <map>
+
+#include "talk/base/basictypes.h"
+#include "talk/base/constructormagic.h"
+#include "talk/base/messagehandler.h"
+#include "talk/base/sigslot.h"
+#include "talk/session/phone/rtputils.h"
+
+namespace talk_base {
+class Buffer;
+class Thread;
+}
+
+namespace cricket {
+
+struct RtpJitterBufferStats {
+  RtpJitterBufferStats()
+      : packets_received(0), packets_released(0), packets_reordered(0),
+        packets_lost(0), packets_late(0), packets_duplicate(0),
+        jitter_ms(0) {
+  }
+  int packets_received;
+  int packets_released;
+  int packets_reordered;  // arrived out of order but in time
+  int packets_lost;       // never arrived before their turn was given up
+  int packets_late;       // arrived after their turn, dropped
+  int packets_duplicate;  // already held or released, dropped
+  int jitter_ms;          // interarrival jitter (RFC 3550), if clock rate set
+};
+
+// Puts the incoming RTP packets of each SSRC back in sequence number order
+// before they are handed on, independently of the media engine. A packet
+// that arrives in order is released right away. When there is a gap, the
+// packets after it are held for up to the target delay in case the missing
+// ones turn up; after that the gap is counted as lost and skipped.
+// Packets that turn up after their turn are dropped and counted as late.
+// With a thread, the buffer releases held packets on its own on that thread;
+// without one, its owner must call ReleasePackets() at the times it asks for.
+class RtpJitterBuffer : public talk_base::MessageHandler {
+ public:
+  static const int kDefaultTargetDelayMs = 50;
+  // A stream never holds more packets than this, whatever the delay.
+  static const size_t kMaxHeldPackets = 512;
+
+  RtpJitterBuffer(talk_base::Thread* thread, int target_delay_ms);
+  virtual ~RtpJitterBuffer();
+
+  void set_target_delay(int delay_ms) { target_delay_ = delay_ms; }
+  int target_delay() const { return target_delay_; }
+  // The RTP clock rate of the streams, used only to measure jitter.
+  void set_clock_rate(int hz) { clock_rate_ = hz; }
+
+  // Takes the data of the packet, which arrived at |now|. Packets that are
+  // not RTP are released at once.
+  void InsertPacket(talk_base::Buffer* packet, uint32 now);
+  void InsertPacket(talk_base::Buffer* packet);
+  // Same, for a packet whose header has been parsed already.
+  void InsertPacket(const RtpHeader& header, talk_base::Buffer* packet,
+                    uint32 now);
+
+  // Releases the packets whose turn has come by |now|. Returns the number of
+  // milliseconds until more may be released, or -1 if nothing is held.
+  int ReleasePackets(uint32 now);
+  // Releases every held packet in order, skipping gaps.
+  void Flush();
+
+  size_t held_packets() const;
+  RtpJitterBufferStats stats() const;
+
+  // Fired for each packet as it is released, in sequence order per SSRC.
+  sigslot::signal1<talk_base::Buffer*> SignalPacketReady;
+
+  virtual void OnMessage(talk_base::Message* pmsg);
+
+ private:
+  struct HeldPacket {
+    talk_base::Buffer* packet;
+    uint32 arrival_time;
+  };
+  typedef std::map<int64, HeldPacket> PacketMap;
+  struct Stream {
+    Stream() : started(false), next_seq(0), highest_seq(0),
+               has_transit(false), last_transit(0), jitter(0) {}
+    bool started;       // whether next_seq has been set
+    int64 next_seq;     // extended sequence number of the next release
+    int64 highest_seq;  // highest extended sequence number seen, 0 if none
+    PacketMap held;
+    bool has_transit;
+    uint32 last_transit;
+    double jitter;      // in RTP clock units
+  };
+  typedef std::map<uint32, Stream> StreamMap;
+
+  static int64 Unwrap(const Stream& stream, int seq);
+  void UpdateJitter(Stream* stream, uint32 timestamp, uint32 now);
+  // Releases what it can from the stream, returning the time until the
+  // next release or -1.
+  int ReleaseStream(Stream* stream, uint32 now, bool flush);
+  void Release(talk_base::Buffer* packet);
+  void ScheduleRelease(int delay);
+
+  talk_base::Thread* thread_;
+  bool release_pending_;
+  uint32 release_time_;
+  int target_delay_;
+  int clock_rate_;
+  StreamMap streams_;
+  RtpJitterBufferStats stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(RtpJitterBuffer);
+};
+
+}  // namespace cricket
+
+#endif  // TALK_SESSION_PHONE_RTPJITTERBUFFER_H_
@@ -0,0 +1,324 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "talk/base/buffer.h"
+#include "talk/base/byteorder.h"
+#include "talk/base/gunit.h"
+#include "talk/base/logging.h"
+#include "talk/base/stream.h"
+#include "talk/base/stringutils.h"
+#include "talk/base/thread.h"
+#include "talk/base/time.h"
+#include "talk/session/phone/rtpdump.h"
+#include "talk/session/phone/rtpjitterbuffer.h"
+#include "talk/session/phone/rtputils.h"
+
+namespace cricket {
+
+static const uint32 kSsrc1 = 0x11111111;
+static const uint32 kSsrc2 = 0x22222222;
+static const int kTargetDelay = 50;
+static const int kTimeout = 5000;
+
+class RtpJitterBufferTest : public testing::Test, public sigslot::has_slots<> {
+ protected:
+  RtpJitterBufferTest() : buffer_(NULL, kTargetDelay) {
+    Connect(&buffer_);
+  }
+
+  void Connect(RtpJitterBuffer* buffer) {
+    buffer->SignalPacketReady.connect(this,
+                                      &RtpJitterBufferTest::OnPacketReady);
+  }
+
+  static void MakePacket(uint32 ssrc, int seq_num, uint32 timestamp,
+                         talk_base::Buffer* packet) {
+    uint8 rtp[20] = { 0x80, 0x00 };
+    talk_base::SetBE16(rtp + 2, static_cast<uint16>(seq_num));
+    talk_base::SetBE32(rtp + 4, timestamp);
+    talk_base::SetBE32(rtp + 8, ssrc);
+    packet->SetData(rtp, sizeof(rtp));
+  }
+
+  void Insert(RtpJitterBuffer* buffer, uint32 ssrc, int seq_num,
+              uint32 now) {
+    talk_base::Buffer packet;
+    MakePacket(ssrc, seq_num, seq_num * 160, &packet);
+    buffer->InsertPacket(&packet, now);
+  }
+  void Insert(uint32 ssrc, int seq_num, uint32 now) {
+    Insert(&buffer_, ssrc, seq_num, now);
+  }
+
+  void OnPacketReady(talk_base::Buffer* packet) {
+    uint32 ssrc = 0;
+    int seq_num = -1;
+    GetRtpSsrc(packet->data(), packet->length(), &ssrc);
+    GetRtpSeqNum(packet->data(), packet->length(), &seq_num);
+    released_.push_back(std::make_pair(ssrc, seq_num));
+  }
+
+  // The sequence numbers released for |ssrc|, in order.
+  std::vector<int> Released(uint32 ssrc) const {
+    std::vector<int> seqs;
+    for (size_t i = 0; i < released_.size(); ++i) {
+      if (released_[i].first == ssrc)
+        seqs.push_back(released_[i].second);
+    }
+    return seqs;
+  }
+
+  RtpJitterBuffer buffer_;
+  std::vector<std::pair<uint32, int> > released_;
+};
+
+// Describes the release order as a string such as "1 2 4", for comparisons.
+static std::string ToString(const std::vector<int>& seqs) {
+  std::string str;
+  for (size_t i = 0; i < seqs.size(); ++i) {
+    if (i > 0)
+      str += " ";
+    char buf[16];
+    talk_base::sprintfn(buf, sizeof(buf), "%d", seqs[i]);
+    str += buf;
+  }
+  return str;
+}
+
+TEST_F(RtpJitterBufferTest, InOrderPacketsGoStraightThrough) {
+  // The first packet waits in case earlier ones are still on their way.
+  Insert(kSsrc1, 10, 0);
+  EXPECT_EQ(kTargetDelay, buffer_.ReleasePackets(0));
+  EXPECT_EQ(kTargetDelay - 20, buffer_.ReleasePackets(20));
+  EXPECT_EQ(-1, buffer_.ReleasePackets(kTargetDelay));
+  EXPECT_EQ("10", ToString(Released(kSsrc1)));
+
+  // After that, packets in order are not held at all.
+  Insert(kSsrc1, 11, 60);
+  Insert(kSsrc1, 12, 80);
+  EXPECT_EQ("10 11 12", ToString(Released(kSsrc1)));
+  EXPECT_EQ(0U, buffer_.held_packets());
+  EXPECT_EQ(3, buffer_.stats().packets_released);
+}
+
+TEST_F(RtpJitterBufferTest, ReordersWithinTargetDelay) {
+  Insert(kSsrc1, 2, 0);
+  Insert(kSsrc1, 1, 10);
+  Insert(kSsrc1, 0, 20);
+  buffer_.ReleasePackets(kTargetDelay);
+  EXPECT_EQ("0 1 2", ToString(Released(kSsrc1)));
+
+  Insert(kSsrc1, 5, 100);
+  Insert(kSsrc1, 4, 110);
+  EXPECT_EQ("0 1 2", ToString(Released(kSsrc1)));
+  Insert(kSsrc1, 3, 120);
+  EXPECT_EQ("0 1 2 3 4 5", ToString(Released(kSsrc1)));
+
+  RtpJitterBufferStats stats = buffer_.stats();
+  EXPECT_EQ(6, stats.packets_received);
+  EXPECT_EQ(6, stats.packets_released);
+  EXPECT_EQ(4, stats.packets_reordered);
+  EXPECT_EQ(0, stats.packets_lost);
+}
+
+TEST_F(RtpJitterBufferTest, SkipsGapAfterTargetDelay) {
+  Insert(kSsrc1, 0, 0);
+  buffer_.ReleasePackets(kTargetDelay);
+  Insert(kSsrc1, 3, 100);
+  Insert(kSsrc1, 4, 110);
+  EXPECT_EQ(kTargetDelay - 30, buffer_.ReleasePackets(130));
+  EXPECT_EQ("0", ToString(Released(kSsrc1)));
+  EXPECT_EQ(-1, buffer_.ReleasePackets(100 + kTargetDelay));
+  EXPECT_EQ("0 3 4", ToString(Released(kSsrc1)));
+  EXPECT_EQ(2, buffer_.stats().packets_lost);
+
+  // The missing packets are too late now.
+  Insert(kSsrc1, 1, 200);
+  Insert(kSsrc1, 4, 200);
+  EXPECT_EQ("0 3 4", ToString(Released(kSsrc1)));
+  EXPECT_EQ(2, buffer_.stats().packets_late);
+}
+
+TEST_F(RtpJitterBufferTest, DropsDuplicates) {
+  Insert(kSsrc1, 0, 0);
+  buffer_.ReleasePackets(kTargetDelay);
+  Insert(kSsrc1, 2, 100);
+  Insert(kSsrc1, 2, 110);
+  Insert(kSsrc1, 1, 120);
+  EXPECT_EQ("0 1 2", ToString(Released(kSsrc1)));
+  EXPECT_EQ(1, buffer_.stats().packets_duplicate);
+}
+
+TEST_F(RtpJitterBufferTest, HandlesSequenceNumberWrap) {
+  Insert(kSsrc1, 65534, 0);
+  buffer_.ReleasePackets(kTargetDelay);
+  Insert(kSsrc1, 0, 100);
+  Insert(kSsrc1, 65535, 110);
+  Insert(kSsrc1, 1, 120);
+  EXPECT_EQ("65534 65535 0 1", ToString(Released(kSsrc1)));
+  EXPECT_EQ(0, buffer_.stats().packets_lost);
+}
+
+TEST_F(RtpJitterBufferTest, KeepsStreamsApart) {
+  Insert(kSsrc1, 100, 0);
+  Insert(kSsrc2, 7, 0);
+  buffer_.ReleasePackets(kTargetDelay);
+  Insert(kSsrc1, 102, 100);
+  Insert(kSsrc2, 8, 100);
+  EXPECT_EQ("100", ToString(Released(kSsrc1)));
+  EXPECT_EQ("7 8", ToString(Released(kSsrc2)));
+  Insert(kSsrc1, 101, 110);
+  EXPECT_EQ("100 101 102", ToString(Released(kSsrc1)));
+}
+
+TEST_F(RtpJitterBufferTest, FlushReleasesEverything) {
+  Insert(kSsrc1, 0, 0);
+  Insert(kSsrc1, 2, 0);
+  Insert(kSsrc1, 5, 0);
+  buffer_.Flush();
+  EXPECT_EQ("0 2 5", ToString(Released(kSsrc1)));
+  EXPECT_EQ(0U, buffer_.held_packets());
+}
+
+TEST_F(RtpJitterBufferTest, PassesOnNonRtp) {
+  char data[4] = { 0 };
+  talk_base::Buffer packet(data, sizeof(data));
+  buffer_.InsertPacket(&packet, 0);
+  EXPECT_EQ(1, buffer_.stats().packets_released);
+  EXPECT_EQ(0U, buffer_.held_packets());
+}
+
+TEST_F(RtpJitterBufferTest, ReleasesOnThread) {
+  RtpJitterBuffer buffer(talk_base::Thread::Current(), kTargetDelay);
+  Connect(&buffer);
+  uint32 start = talk_base::Time();
+  Insert(&buffer, kSsrc1, 1, start);
+  Insert(&buffer, kSsrc1, 0, start);
+  EXPECT_EQ_WAIT(2U, released_.size(), kTimeout);
+  EXPECT_GE(talk_base::TimeSince(start), kTargetDelay);
+  Insert(&buffer, kSsrc1, 3, talk_base::Time());
+  EXPECT_EQ_WAIT(3U, released_.size(), kTimeout);
+  EXPECT_EQ("0 1 3", ToString(Released(kSsrc1)));
+}
+
+TEST_F(RtpJitterBufferTest, MeasuresJitter) {
+  buffer_.set_clock_rate(8000);
+  // 20ms packets at 8 kHz, arriving alternately 10ms early and late.
+  for (int i = 0; i < 100; ++i) {
+    talk_base::Buffer packet;
+    MakePacket(kSsrc1, i, i * 160, &packet);
+    buffer_.InsertPacket(&packet, i * 20 + ((i % 2) ? 10 : 0));
+  }
+  RtpJitterBufferStats stats = buffer_.stats();
+  EXPECT_GE(stats.jitter_ms, 8);
+  EXPECT_LE(stats.jitter_ms, 10);
+}
+
+// Replays a recorded two-stream trace with random network jitter added and
+// measures how many packets come out in order, and how late, for a range of
+// target delays.
+TEST_F(RtpJitterBufferTest, DISABLED_JitterBenchmark) {
+  const int kPacketsPerSsrc = 1000;
+  const uint32 kPacketInterval = 20;
+  const int kMaxJitter = 60;
+  const uint32 kSsrcs[] = { kSsrc1, kSsrc2 };
+
+  // Record the trace.
+  talk_base::MemoryStream dump;
+  {
+    RtpDumpWriter writer(&dump);
+    for (int i = 0; i < kPacketsPerSsrc; ++i) {
+      for (size_t s = 0; s < ARRAY_SIZE(kSsrcs); ++s) {
+        talk_base::Buffer packet;
+        MakePacket(kSsrcs[s], i, i * 160, &packet);
+        RtpDumpPacket dump_packet(packet.data(), packet.length(),
+                                  i * kPacketInterval, false);
+        ASSERT_EQ(talk_base::SR_SUCCESS, writer.WritePacket(dump_packet));
+      }
+    }
+  }
+
+  // Read it back, delaying each packet by up to kMaxJitter ms.
+  dump.SetPosition(0);
+  RtpDumpReader reader(&dump);
+  std::vector<std::pair<uint32, std::vector<uint8> > > arrivals;
+  RtpDumpPacket dump_packet;
+  uint32 seed = 1;
+  while (reader.ReadPacket(&dump_packet) == talk_base::SR_SUCCESS) {
+    seed = seed * 1103515245 + 12345;
+    uint32 jitter = (seed >> 16) % kMaxJitter;
+    arrivals.push_back(std::make_pair(dump_packet.elapsed_time + jitter,
+                                      dump_packet.data));
+  }
+  ASSERT_EQ(static_cast<size_t>(kPacketsPerSsrc * 2), arrivals.size());
+  std::stable_sort(arrivals.begin(), arrivals.end());
+
+  const int kDelays[] = { 1, 20, 40, 60, 80 };
+  for (size_t d = 0; d < ARRAY_SIZE(kDelays); ++d) {
+    RtpJitterBuffer buffer(NULL, kDelays[d]);
+    Connect(&buffer);
+    released_.clear();
+
+    uint32 start = talk_base::Time();
+    for (size_t i = 0; i < arrivals.size(); ++i) {
+      uint32 now = arrivals[i].first;
+      buffer.ReleasePackets(now);
+      talk_base::Buffer packet(&arrivals[i].second[0],
+                               arrivals[i].second.size());
+      buffer.InsertPacket(&packet, now);
+    }
+    buffer.Flush();
+    int elapsed = talk_base::TimeSince(start);
+
+    RtpJitterBufferStats stats = buffer.stats();
+    EXPECT_EQ(static_cast<int>(arrivals.size()),
+              stats.packets_released + stats.packets_late);
+    for (size_t s = 0; s < ARRAY_SIZE(kSsrcs); ++s) {
+      std::vector<int> seqs = Released(kSsrcs[s]);
+      EXPECT_TRUE(std::adjacent_find(seqs.begin(), seqs.end(),
+                                     std::greater_equal<int>()) == seqs.end());
+    }
+    LOG(LS_INFO) << kDelays[d] << "ms target delay: "
+                 << stats.packets_reordered << " reordered, "
+                 << stats.packets_late << " late, "
+                 << stats.packets_lost << " lost of "
+                 << stats.packets_received << " packets, in "
+                 << elapsed << "ms";
+    if (kDelays[d] >= kMaxJitter) {
+      EXPECT_EQ(0, stats.packets_late);
+      EXPECT_EQ(0, stats.packets_lost);
+    }
+  }
+}
+
+}  // namespace cricket
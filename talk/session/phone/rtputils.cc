@@ -77,5 +77,35 @@ bool GetRtcpType(const void* data, size_t len, int* value) {
   return true;
 }
 
+bool ParseRtpHeader(const void* data, size_t len, RtpHeader* header) {
+  if (!data || len < kMinRtpPacketLen || !header) return false;
+  const uint8* p = static_cast<const uint8*>(data);
+  if ((p[0] >> 6) != 2) return false;
+
+  header->csrc_count = p[0] & 0xF;
+  header->marker = (p[1] & 0x80) != 0;
+  header->payload_type = p[1] & 0x7F;
+  header->seq_num = static_cast<int>(talk_base::GetBE16(p + 2));
+  header->timestamp = talk_base::GetBE32(p + 4);
+  header->ssrc = talk_base::GetBE32(p + 8);
+
+  size_t header_len = kMinRtpPacketLen + header->csrc_count * sizeof(uint32);
+  if (len < header_len) return false;
+  header->extension_profile = -1;
+  header->extension_offset = 0;
+  header->extension_len = 0;
+  if (p[0] & 0x10) {
+    if (len < header_len + sizeof(uint32)) return false;
+    header->extension_profile = talk_base::GetBE16(p + header_len);
+    header->extension_len =
+        talk_base::GetBE16(p + header_len + 2) * sizeof(uint32);
+    header->extension_offset = header_len + sizeof(uint32);
+    header_len = header->extension_offset + header->extension_len;
+    if (len < header_len) return false;
+  }
+  header->header_len = header_len;
+  return true;
+}
+
 }  // namespace cricket
 
@@ -36,6 +36,20 @@ const size_t kMinRtpPacketLen = 12;
 const size_t kMaxRtpPacketLen = 2048;
 const size_t kMinRtcpPacketLen = 4;
 
+// The fields of an RTP header, parsed in one go.
+struct RtpHeader {
+  int payload_type;
+  bool marker;
+  int seq_num;
+  uint32 timestamp;
+  uint32 ssrc;
+  int csrc_count;
+  size_t header_len;        // including CSRCs and the extension
+  int extension_profile;    // -1 if there is no header extension
+  size_t extension_offset;  // start of the extension data after its header
+  size_t extension_len;     // length of the extension data in bytes
+};
+
 bool GetRtpPayloadType(const void* data, size_t len, int* value);
 bool GetRtpSeqNum(const void* data, size_t len, int* value);
 bool GetRtpTimestamp(const void* data, size_t len, uint32* value);
@@ -43,6 +57,10 @@ bool GetRtpSsrc(const void* data, size_t len, uint32* value);
 bool GetRtpHeaderLen(const void* data, size_t len, size_t* value);
 bool GetRtcpType(const void* data, size_t len, int* value);
 
+// Parses the whole header at once, which is cheaper than the getters above
+// when several fields are needed. Fails unless the packet is RTP version 2.
+bool ParseRtpHeader(const void* data, size_t len, RtpHeader* header);
+
 }  // namespace cricket
 
 #endif  // TALK_SESSION_PHONE_RTPUTILS_H_
@@ -0,0 +1,153 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "talk/session/phone/videoframebufferpool.h"
+
+#include <string.h>
+
+#include "talk/base/common.h"
+
+namespace cricket {
+
+static const int kDefaultMaxFreeBuffers = 4;
+
+VideoFrameBuffer::VideoFrameBuffer(uint8* data, size_t size)
+    : pool_(NULL), data_(data), size_(size), ref_count_(1) {
+}
+
+VideoFrameBuffer::VideoFrameBuffer(VideoFrameBufferPool* pool, size_t size)
+    : pool_(pool), data_(new uint8[size]), size_(size), ref_count_(1) {
+}
+
+VideoFrameBuffer::~VideoFrameBuffer() {
+  delete [] data_;
+}
+
+void VideoFrameBuffer::AddRef() {
+  talk_base::AtomicOps::Increment(&ref_count_);
+}
+
+void VideoFrameBuffer::Release() {
+  if (talk_base::AtomicOps::Decrement(&ref_count_) == 0) {
+    if (pool_) {
+      pool_->Return(this);
+    } else {
+      delete this;
+    }
+  }
+}
+
+bool VideoFrameBuffer::HasOneRef() const {
+  return talk_base::AtomicOps::AcquireLoad(&ref_count_) == 1;
+}
+
+uint8* VideoFrameBuffer::Detach() {
+  if (!HasOneRef()) {
+    uint8* copy = new uint8[size_];
+    memcpy(copy, data_, size_);
+    Release();
+    return copy;
+  }
+  uint8* data = data_;
+  data_ = NULL;
+  if (pool_)
+    pool_->Forget(this);
+  delete this;
+  return data;
+}
+
+VideoFrameBufferPool::VideoFrameBufferPool()
+    : max_free_buffers_(kDefaultMaxFreeBuffers) {
+}
+
+VideoFrameBufferPool::~VideoFrameBufferPool() {
+  ASSERT(stats_.outstanding == 0);
+  for (FreeMap::iterator it = free_buffers_.begin();
+       it != free_buffers_.end(); ++it) {
+    for (size_t i = 0; i < it->second.size(); ++i) {
+      delete it->second[i];
+    }
+  }
+}
+
+VideoFrameBufferPool* VideoFrameBufferPool::Default() {
+  static VideoFrameBufferPool* pool = new VideoFrameBufferPool();
+  return pool;
+}
+
+VideoFrameBuffer* VideoFrameBufferPool::Acquire(size_t size) {
+  {
+    talk_base::CritScope cs(&crit_);
+    ++stats_.acquisitions;
+    ++stats_.outstanding;
+    FreeMap::iterator it = free_buffers_.find(size);
+    if (it != free_buffers_.end() && !it->second.empty()) {
+      VideoFrameBuffer* buffer = it->second.back();
+      it->second.pop_back();
+      --stats_.free_buffers;
+      buffer->ref_count_ = 1;
+      return buffer;
+    }
+    ++stats_.allocations;
+  }
+  return new VideoFrameBuffer(this, size);
+}
+
+VideoFrameBuffer* VideoFrameBufferPool::Copy(const VideoFrameBuffer* buffer) {
+  VideoFrameBuffer* copy = Acquire(buffer->size());
+  memcpy(copy->data(), buffer->data(), buffer->size());
+  talk_base::CritScope cs(&crit_);
+  stats_.bytes_copied += buffer->size();
+  return copy;
+}
+
+void VideoFrameBufferPool::GetStats(Stats* stats) const {
+  talk_base::CritScope cs(&crit_);
+  *stats = stats_;
+}
+
+void VideoFrameBufferPool::Return(VideoFrameBuffer* buffer) {
+  {
+    talk_base::CritScope cs(&crit_);
+    --stats_.outstanding;
+    std::vector<VideoFrameBuffer*>& free_buffers =
+        free_buffers_[buffer->size()];
+    if (static_cast<int>(free_buffers.size()) < max_free_buffers_) {
+      free_buffers.push_back(buffer);
+      ++stats_.free_buffers;
+      return;
+    }
+  }
+  delete buffer;
+}
+
+void VideoFrameBufferPool::Forget(VideoFrameBuffer* buffer) {
+  talk_base::CritScope cs(&crit_);
+  --stats_.outstanding;
+}
+
+}  // namespace cricket
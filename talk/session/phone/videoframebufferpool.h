@@ -0,0 +1,129 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TALK_SESSION_PHONE_VIDEOFRAMEBUFFERPOOL_H_
+#define TALK_SESSION_PHONE_VIDEOFRAMEBUFFERPOOL_H_
+
+#include <map>
+#include <vector>
+
+#include "talk/base/basictypes.h"
+#include "talk/base/constructormagic.h"
+#include "talk/base/criticalsection.h"
+
+namespace cricket {
+
+class VideoFrameBufferPool;
+
+// A reference-counted block of memory holding the planes of one frame, so
+// that copies of a frame handed to several renderers can share it. Buffers
+// from a VideoFrameBufferPool go back to it when the last reference is
+// released; others free their memory.
+class VideoFrameBuffer {
+ public:
+  // Takes ownership of "data", which must have been allocated with new[].
+  VideoFrameBuffer(uint8* data, size_t size);
+
+  uint8* data() const { return data_; }
+  size_t size() const { return size_; }
+  // False for buffers wrapping memory that was handed in.
+  bool pooled() const { return pool_ != NULL; }
+
+  void AddRef();
+  void Release();
+  // True if nobody else holds a reference, so the planes may be written.
+  bool HasOneRef() const;
+
+  // Hands the memory to the caller, who must delete[] it, and drops the
+  // caller's reference. If the buffer is still shared, the other holders
+  // may be reading it, so the caller gets a copy instead.
+  uint8* Detach();
+
+ private:
+  friend class VideoFrameBufferPool;
+  VideoFrameBuffer(VideoFrameBufferPool* pool, size_t size);
+  ~VideoFrameBuffer();
+
+  VideoFrameBufferPool* pool_;  // NULL if not pooled
+  uint8* data_;
+  size_t size_;
+  int ref_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(VideoFrameBuffer);
+};
+
+// Keeps released frame buffers for reuse, keyed by size, so that a stream of
+// frames of one resolution stops allocating once it is running.
+class VideoFrameBufferPool {
+ public:
+  struct Stats {
+    Stats() : allocations(0), acquisitions(0), outstanding(0),
+              free_buffers(0), bytes_copied(0) {}
+    int allocations;   // buffers that had to be allocated
+    int acquisitions;  // buffers handed out, new or reused
+    int outstanding;   // buffers handed out and not yet released
+    int free_buffers;  // buffers waiting to be reused
+    size_t bytes_copied;  // by Copy()
+  };
+
+  VideoFrameBufferPool();
+  // All the buffers handed out must have been released.
+  ~VideoFrameBufferPool();
+
+  // The pool that video frames take their buffers from. Never deleted.
+  static VideoFrameBufferPool* Default();
+
+  // Returns a buffer of "size" bytes with one reference, reusing a released
+  // one if possible. Its contents are undefined.
+  VideoFrameBuffer* Acquire(size_t size);
+  // Returns a buffer with one reference holding a copy of "buffer".
+  VideoFrameBuffer* Copy(const VideoFrameBuffer* buffer);
+
+  // How many released buffers of each size are kept. Defaults to 4.
+  void set_max_free_buffers(int max) { max_free_buffers_ = max; }
+  void GetStats(Stats* stats) const;
+
+ private:
+  friend class VideoFrameBuffer;
+  typedef std::map<size_t, std::vector<VideoFrameBuffer*> > FreeMap;
+
+  // Called by a pooled buffer when its last reference is released.
+  void Return(VideoFrameBuffer* buffer);
+  // Called by a pooled buffer that is detached instead of returned.
+  void Forget(VideoFrameBuffer* buffer);
+
+  mutable talk_base::CriticalSection crit_;
+  FreeMap free_buffers_;
+  int max_free_buffers_;
+  Stats stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(VideoFrameBufferPool);
+};
+
+}  // namespace cricket
+
+#endif  // TALK_SESSION_PHONE_VIDEOFRAMEBUFFERPOOL_H_
@@ -0,0 +1,215 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include <vector>
+
+#include "talk/base/gunit.h"
+#include "talk/base/logging.h"
+#include "talk/base/time.h"
+#include "talk/session/phone/videoframe.h"
+#include "talk/session/phone/videoframebufferpool.h"
+
+namespace cricket {
+
+static const size_t kSize = 1000;
+
+TEST(VideoFrameBufferPoolTest, ReusesReleasedBuffers) {
+  VideoFrameBufferPool pool;
+  VideoFrameBuffer* buffer1 = pool.Acquire(kSize);
+  EXPECT_EQ(kSize, buffer1->size());
+  EXPECT_TRUE(buffer1->HasOneRef());
+  buffer1->Release();
+
+  VideoFrameBuffer* buffer2 = pool.Acquire(kSize);
+  EXPECT_EQ(buffer1, buffer2);
+  EXPECT_TRUE(buffer2->HasOneRef());
+  // A different size needs a new buffer.
+  VideoFrameBuffer* buffer3 = pool.Acquire(kSize * 2);
+  EXPECT_NE(buffer2, buffer3);
+
+  VideoFrameBufferPool::Stats stats;
+  pool.GetStats(&stats);
+  EXPECT_EQ(2, stats.allocations);
+  EXPECT_EQ(3, stats.acquisitions);
+  EXPECT_EQ(2, stats.outstanding);
+  EXPECT_EQ(0, stats.free_buffers);
+  buffer2->Release();
+  buffer3->Release();
+  pool.GetStats(&stats);
+  EXPECT_EQ(0, stats.outstanding);
+  EXPECT_EQ(2, stats.free_buffers);
+}
+
+TEST(VideoFrameBufferPoolTest, KeepsOnlySomeFreeBuffers) {
+  VideoFrameBufferPool pool;
+  pool.set_max_free_buffers(2);
+  VideoFrameBuffer* buffers[3];
+  for (int i = 0; i < 3; ++i) {
+    buffers[i] = pool.Acquire(kSize);
+  }
+  for (int i = 0; i < 3; ++i) {
+    buffers[i]->Release();
+  }
+  VideoFrameBufferPool::Stats stats;
+  pool.GetStats(&stats);
+  EXPECT_EQ(2, stats.free_buffers);
+}
+
+TEST(VideoFrameBufferPoolTest, SharesUntilLastRelease) {
+  VideoFrameBufferPool pool;
+  VideoFrameBuffer* buffer = pool.Acquire(kSize);
+  buffer->AddRef();
+  EXPECT_FALSE(buffer->HasOneRef());
+  buffer->Release();
+  EXPECT_TRUE(buffer->HasOneRef());
+  VideoFrameBufferPool::Stats stats;
+  pool.GetStats(&stats);
+  EXPECT_EQ(0, stats.free_buffers);
+  buffer->Release();
+  pool.GetStats(&stats);
+  EXPECT_EQ(1, stats.free_buffers);
+}
+
+TEST(VideoFrameBufferPoolTest, Copy) {
+  VideoFrameBufferPool pool;
+  VideoFrameBuffer* buffer = pool.Acquire(kSize);
+  memset(buffer->data(), 7, kSize);
+  VideoFrameBuffer* copy = pool.Copy(buffer);
+  EXPECT_NE(buffer->data(), copy->data());
+  EXPECT_EQ(0, memcmp(buffer->data(), copy->data(), kSize));
+  VideoFrameBufferPool::Stats stats;
+  pool.GetStats(&stats);
+  EXPECT_EQ(kSize, stats.bytes_copied);
+  buffer->Release();
+  copy->Release();
+}
+
+TEST(VideoFrameBufferPoolTest, Detach) {
+  VideoFrameBufferPool pool;
+  // The only holder gets the memory itself.
+  VideoFrameBuffer* buffer = pool.Acquire(kSize);
+  uint8* data = buffer->data();
+  EXPECT_EQ(data, buffer->Detach());
+  delete [] data;
+  VideoFrameBufferPool::Stats stats;
+  pool.GetStats(&stats);
+  EXPECT_EQ(0, stats.outstanding);
+
+  // Other holders keep the memory, and the caller gets a copy.
+  buffer = new VideoFrameBuffer(new uint8[kSize], kSize);
+  memset(buffer->data(), 9, kSize);
+  data = buffer->data();
+  buffer->AddRef();
+  uint8* copy = buffer->Detach();
+  EXPECT_NE(data, copy);
+  EXPECT_EQ(9, copy[kSize - 1]);
+  EXPECT_EQ(data, buffer->data());
+  EXPECT_TRUE(buffer->HasOneRef());
+  buffer->Release();
+  delete [] copy;
+}
+
+// Hands one captured frame to several consumers, which share one pooled
+// buffer instead of copying it.
+TEST(VideoFrameBufferPoolTest, FanOut) {
+  static const int kConsumers = 4;
+  VideoFrameBufferPool pool;
+  for (int i = 0; i < 3; ++i) {
+    VideoFrameBuffer* buffer = pool.Acquire(kSize);
+    memset(buffer->data(), i, kSize);
+    VideoFrameBuffer* consumers[kConsumers];
+    for (int j = 0; j < kConsumers; ++j) {
+      buffer->AddRef();
+      consumers[j] = buffer;
+    }
+    buffer->Release();
+    for (int j = 0; j < kConsumers; ++j) {
+      EXPECT_EQ(i, consumers[j]->data()[kSize - 1]);
+      consumers[j]->Release();
+    }
+  }
+  VideoFrameBufferPool::Stats stats;
+  pool.GetStats(&stats);
+  EXPECT_EQ(1, stats.allocations);
+  EXPECT_EQ(3, stats.acquisitions);
+  EXPECT_EQ(0, stats.outstanding);
+  EXPECT_EQ(0U, stats.bytes_copied);
+}
+
+// Captures 720p frames and hands each to an encoder and three renderers,
+// first giving each of them its own copy, then sharing one pooled buffer,
+// and reports the allocations and bytes copied per frame.
+TEST(VideoFrameBufferPoolTest, DISABLED_FanOutBenchmark) {
+  const size_t size = VideoFrame::SizeOf(1280, 720);
+  const int kFrames = 300;
+  const int kConsumers = 4;
+  std::vector<uint8> captured(size, 128);
+
+  uint32 start = talk_base::Time();
+  for (int i = 0; i < kFrames; ++i) {
+    // The captured frame and a copy for each consumer.
+    uint8* copies[kConsumers + 1];
+    for (int j = 0; j <= kConsumers; ++j) {
+      copies[j] = new uint8[size];
+      memcpy(copies[j], &captured[0], size);
+    }
+    for (int j = 0; j <= kConsumers; ++j) {
+      delete [] copies[j];
+    }
+  }
+  uint32 copy_ms = talk_base::TimeSince(start);
+  LOG(LS_INFO) << "Copied: " << kConsumers + 1 << " allocations and "
+               << (kConsumers + 1) * size << " bytes copied per frame, "
+               << copy_ms << " ms for " << kFrames << " frames";
+
+  VideoFrameBufferPool pool;
+  start = talk_base::Time();
+  for (int i = 0; i < kFrames; ++i) {
+    VideoFrameBuffer* buffer = pool.Acquire(size);
+    memcpy(buffer->data(), &captured[0], size);
+    for (int j = 0; j < kConsumers; ++j) {
+      buffer->AddRef();
+    }
+    for (int j = 0; j < kConsumers; ++j) {
+      buffer->Release();
+    }
+    buffer->Release();
+  }
+  uint32 shared_ms = talk_base::TimeSince(start);
+  VideoFrameBufferPool::Stats stats;
+  pool.GetStats(&stats);
+  EXPECT_EQ(1, stats.allocations);
+  EXPECT_EQ(0U, stats.bytes_copied);
+  LOG(LS_INFO) << "Shared: " << static_cast<double>(stats.allocations) /
+                  kFrames << " allocations and " << size
+               << " bytes copied per frame, " << shared_ms
+               << " ms for " << kFrames << " frames";
+}
+
+}  // namespace cricket
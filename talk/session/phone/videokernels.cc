@@ -0,0 +1,332 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "talk/session/phone/videokernels.h"
+
+#include <string.h>
+
+#include <vector>
+
+#include "talk/base/common.h"
+#include "talk/session/phone/videocommon.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VIDEO_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace cricket {
+
+// BT.601 coefficients for studio-range YUV, scaled by 64 so that the
+// products of the SSE2 path fit in 16 bits. Luma is scaled by a further
+// 2^16 / 257 and multiplied by y * 257, keeping the high 16 bits, which
+// avoids rounding its coefficient to 74 or 75.
+static const int kYToRgb = 18997;
+static const int kYBias = 16 * 1164 * 64 / 1000;
+static const int kVToR = 102;
+static const int kUToG = 25;
+static const int kVToG = 52;
+static const int kUToB = 129;
+static const int kRgbShift = 6;
+
+static inline uint8 Clip(int value) {
+  if (value < 0) {
+    return 0;
+  } else if (value > 255) {
+    return 255;
+  }
+  return static_cast<uint8>(value);
+}
+
+static void CopyPlane(const uint8* src, int src_pitch, uint8* dest,
+                      int dest_pitch, int width, int height) {
+  for (int y = 0; y < height; ++y) {
+    memcpy(dest + y * dest_pitch, src + y * src_pitch, width);
+  }
+}
+
+// Averages each 2x2 block of two source rows into one destination pixel.
+static void HalveRow(const uint8* row0, const uint8* row1, uint8* dest,
+                     int dest_width) {
+  int x = 0;
+#ifdef VIDEO_HAS_SSE2
+  const __m128i low_bytes = _mm_set1_epi16(0xFF);
+  for (; x + 16 <= dest_width; x += 16) {
+    const __m128i* s0 = reinterpret_cast<const __m128i*>(row0 + 2 * x);
+    const __m128i* s1 = reinterpret_cast<const __m128i*>(row1 + 2 * x);
+    __m128i v0 = _mm_avg_epu8(_mm_loadu_si128(s0), _mm_loadu_si128(s1));
+    __m128i v1 = _mm_avg_epu8(_mm_loadu_si128(s0 + 1),
+                              _mm_loadu_si128(s1 + 1));
+    // Average the even bytes with the odd ones, in 16-bit lanes.
+    __m128i h0 = _mm_avg_epu16(_mm_and_si128(v0, low_bytes),
+                               _mm_srli_epi16(v0, 8));
+    __m128i h1 = _mm_avg_epu16(_mm_and_si128(v1, low_bytes),
+                               _mm_srli_epi16(v1, 8));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + x),
+                     _mm_packus_epi16(h0, h1));
+  }
+#endif
+  for (; x < dest_width; ++x) {
+    int left = (row0[2 * x] + row1[2 * x] + 1) >> 1;
+    int right = (row0[2 * x + 1] + row1[2 * x + 1] + 1) >> 1;
+    dest[x] = static_cast<uint8>((left + right + 1) >> 1);
+  }
+}
+
+// Blends two rows, weighting the second by fraction / 256.
+static void BlendRows(const uint8* row0, const uint8* row1, int fraction,
+                      uint8* dest, int width) {
+  int x = 0;
+#ifdef VIDEO_HAS_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i w0 = _mm_set1_epi16(static_cast<int16>(256 - fraction));
+  const __m128i w1 = _mm_set1_epi16(static_cast<int16>(fraction));
+  const __m128i round = _mm_set1_epi16(128);
+  for (; x + 16 <= width; x += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x));
+    // The weighted sum is at most 255 * 256 + 128, which fits in an
+    // unsigned 16-bit lane.
+    __m128i lo = _mm_add_epi16(
+        _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), w0),
+                      _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), w1)),
+        round);
+    __m128i hi = _mm_add_epi16(
+        _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), w0),
+                      _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), w1)),
+        round);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + x),
+                     _mm_packus_epi16(_mm_srli_epi16(lo, 8),
+                                      _mm_srli_epi16(hi, 8)));
+  }
+#endif
+  for (; x < width; ++x) {
+    dest[x] = static_cast<uint8>(
+        (row0[x] * (256 - fraction) + row1[x] * fraction + 128) >> 8);
+  }
+}
+
+// Maps each destination pixel to a source position in 24.8 fixed point,
+// lining up the pixel centers and clamping to the edges.
+static void MapPositions(int src_size, int dest_size,
+                         std::vector<int>* positions) {
+  positions->resize(dest_size);
+  int64 step = (static_cast<int64>(src_size) << 8) / dest_size;
+  int64 max_position = static_cast<int64>(src_size - 1) << 8;
+  int64 position = step / 2 - 128;
+  for (int i = 0; i < dest_size; ++i, position += step) {
+    (*positions)[i] = static_cast<int>(
+        talk_base::_max<int64>(0, talk_base::_min(position, max_position)));
+  }
+}
+
+static void BilinearPlane(const uint8* src, int src_pitch, int src_width,
+                          int src_height, uint8* dest, int dest_pitch,
+                          int dest_width, int dest_height) {
+  std::vector<int> xs, ys;
+  MapPositions(src_width, dest_width, &xs);
+  MapPositions(src_height, dest_height, &ys);
+  // One extra pixel so that the right edge can be blended with itself.
+  std::vector<uint8> row(src_width + 1);
+  for (int y = 0; y < dest_height; ++y) {
+    const uint8* row0 = src + (ys[y] >> 8) * src_pitch;
+    int fraction = ys[y] & 0xFF;
+    if (fraction) {
+      BlendRows(row0, row0 + src_pitch, fraction, &row[0], src_width);
+    } else {
+      memcpy(&row[0], row0, src_width);
+    }
+    row[src_width] = row[src_width - 1];
+
+    uint8* out = dest + y * dest_pitch;
+    for (int x = 0; x < dest_width; ++x) {
+      const uint8* p = &row[xs[x] >> 8];
+      int f = xs[x] & 0xFF;
+      out[x] = static_cast<uint8>((p[0] * (256 - f) + p[1] * f + 128) >> 8);
+    }
+  }
+}
+
+static void NearestPlane(const uint8* src, int src_pitch, int src_width,
+                         int src_height, uint8* dest, int dest_pitch,
+                         int dest_width, int dest_height) {
+  std::vector<int> xs(dest_width);
+  for (int x = 0; x < dest_width; ++x) {
+    xs[x] = (2 * x + 1) * src_width / (2 * dest_width);
+  }
+  for (int y = 0; y < dest_height; ++y) {
+    const uint8* in =
+        src + (2 * y + 1) * src_height / (2 * dest_height) * src_pitch;
+    uint8* out = dest + y * dest_pitch;
+    for (int x = 0; x < dest_width; ++x) {
+      out[x] = in[xs[x]];
+    }
+  }
+}
+
+void ScalePlane(const uint8* src, int src_pitch, int src_width,
+                int src_height, uint8* dest, int dest_pitch, int dest_width,
+                int dest_height, bool interpolate) {
+  if (src_width <= 0 || src_height <= 0 ||
+      dest_width <= 0 || dest_height <= 0) {
+    return;
+  }
+
+  if (src_width == dest_width && src_height == dest_height) {
+    CopyPlane(src, src_pitch, dest, dest_pitch, dest_width, dest_height);
+  } else if (!interpolate) {
+    NearestPlane(src, src_pitch, src_width, src_height,
+                 dest, dest_pitch, dest_width, dest_height);
+  } else if (src_width == 2 * dest_width && src_height == 2 * dest_height) {
+    for (int y = 0; y < dest_height; ++y) {
+      const uint8* row0 = src + 2 * y * src_pitch;
+      HalveRow(row0, row0 + src_pitch, dest + y * dest_pitch, dest_width);
+    }
+  } else {
+    BilinearPlane(src, src_pitch, src_width, src_height,
+                  dest, dest_pitch, dest_width, dest_height);
+  }
+}
+
+void ScaleI420(const uint8* src_y, const uint8* src_u, const uint8* src_v,
+               int src_pitch_y, int src_pitch_u, int src_pitch_v,
+               int src_width, int src_height,
+               uint8* dest_y, uint8* dest_u, uint8* dest_v,
+               int dest_pitch_y, int dest_pitch_u, int dest_pitch_v,
+               int dest_width, int dest_height, bool interpolate) {
+  ScalePlane(src_y, src_pitch_y, src_width, src_height,
+             dest_y, dest_pitch_y, dest_width, dest_height, interpolate);
+  int src_chroma_width = (src_width + 1) / 2;
+  int src_chroma_height = (src_height + 1) / 2;
+  int dest_chroma_width = (dest_width + 1) / 2;
+  int dest_chroma_height = (dest_height + 1) / 2;
+  ScalePlane(src_u, src_pitch_u, src_chroma_width, src_chroma_height,
+             dest_u, dest_pitch_u, dest_chroma_width, dest_chroma_height,
+             interpolate);
+  ScalePlane(src_v, src_pitch_v, src_chroma_width, src_chroma_height,
+             dest_v, dest_pitch_v, dest_chroma_width, dest_chroma_height,
+             interpolate);
+}
+
+// Converts one row. "offsets" gives the byte offsets of blue, green, red and
+// alpha within each output pixel.
+static void ConvertRowToRgb32(const uint8* y, const uint8* u, const uint8* v,
+                              const int* offsets, uint8* dest, int width) {
+  int x = 0;
+#ifdef VIDEO_HAS_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i uv_offset = _mm_set1_epi16(128);
+  const __m128i bias = _mm_set1_epi16((1 << (kRgbShift - 1)) - kYBias);
+  const __m128i y_to_rgb = _mm_set1_epi16(kYToRgb);
+  const __m128i v_to_r = _mm_set1_epi16(kVToR);
+  const __m128i u_to_g = _mm_set1_epi16(kUToG);
+  const __m128i v_to_g = _mm_set1_epi16(kVToG);
+  const __m128i u_to_b = _mm_set1_epi16(kUToB);
+  for (; x + 8 <= width; x += 8) {
+    int32 u4, v4;
+    memcpy(&u4, u + x / 2, sizeof(u4));
+    memcpy(&v4, v + x / 2, sizeof(v4));
+    __m128i uu = _mm_cvtsi32_si128(u4);
+    __m128i vv = _mm_cvtsi32_si128(v4);
+    // Each chroma sample covers two pixels.
+    uu = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_unpacklo_epi8(uu, uu), zero),
+                       uv_offset);
+    vv = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_unpacklo_epi8(vv, vv), zero),
+                       uv_offset);
+    __m128i yy = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(y + x));
+    yy = _mm_add_epi16(_mm_mulhi_epu16(_mm_unpacklo_epi8(yy, yy), y_to_rgb),
+                       bias);
+
+    __m128i r = _mm_add_epi16(yy, _mm_mullo_epi16(vv, v_to_r));
+    __m128i g = _mm_sub_epi16(
+        _mm_sub_epi16(yy, _mm_mullo_epi16(uu, u_to_g)),
+        _mm_mullo_epi16(vv, v_to_g));
+    // Only blue can overflow, and only when it would be clipped to 255
+    // anyway, so a saturating add keeps it exact.
+    __m128i b = _mm_adds_epi16(yy, _mm_mullo_epi16(uu, u_to_b));
+
+    __m128i channels[4];
+    channels[offsets[0]] = _mm_srai_epi16(b, kRgbShift);
+    channels[offsets[1]] = _mm_srai_epi16(g, kRgbShift);
+    channels[offsets[2]] = _mm_srai_epi16(r, kRgbShift);
+    channels[offsets[3]] = _mm_set1_epi16(255);
+    __m128i c01 = _mm_packus_epi16(channels[0], channels[0]);
+    __m128i c23 = _mm_packus_epi16(channels[2], channels[2]);
+    c01 = _mm_unpacklo_epi8(c01, _mm_packus_epi16(channels[1], channels[1]));
+    c23 = _mm_unpacklo_epi8(c23, _mm_packus_epi16(channels[3], channels[3]));
+    __m128i* out = reinterpret_cast<__m128i*>(dest + 4 * x);
+    _mm_storeu_si128(out, _mm_unpacklo_epi16(c01, c23));
+    _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(c01, c23));
+  }
+#endif
+  for (; x < width; ++x) {
+    int c = static_cast<int>((y[x] * 257U * kYToRgb) >> 16) - kYBias +
+        (1 << (kRgbShift - 1));
+    int d = u[x / 2] - 128;
+    int e = v[x / 2] - 128;
+    uint8* out = dest + 4 * x;
+    out[offsets[0]] = Clip((c + kUToB * d) >> kRgbShift);
+    out[offsets[1]] = Clip((c - kUToG * d - kVToG * e) >> kRgbShift);
+    out[offsets[2]] = Clip((c + kVToR * e) >> kRgbShift);
+    out[offsets[3]] = 255;
+  }
+}
+
+bool ConvertI420ToRgb32(const uint8* src_y, const uint8* src_u,
+                        const uint8* src_v, int src_pitch_y, int src_pitch_u,
+                        int src_pitch_v, int width, int height,
+                        uint32 to_fourcc, uint8* dest, int dest_pitch) {
+  // Byte offsets of blue, green, red and alpha. The fourccs name the
+  // channels from the most significant byte of a little-endian word.
+  static const int kArgbOffsets[] = { 0, 1, 2, 3 };
+  static const int kAbgrOffsets[] = { 2, 1, 0, 3 };
+  static const int kBgraOffsets[] = { 3, 2, 1, 0 };
+  const int* offsets;
+  switch (to_fourcc) {
+    case FOURCC_ARGB:
+      offsets = kArgbOffsets;
+      break;
+    case FOURCC_ABGR:
+      offsets = kAbgrOffsets;
+      break;
+    case FOURCC_BGRA:
+      offsets = kBgraOffsets;
+      break;
+    default:
+      return false;
+  }
+
+  for (int y = 0; y < height; ++y) {
+    ConvertRowToRgb32(src_y + y * src_pitch_y, src_u + y / 2 * src_pitch_u,
+                      src_v + y / 2 * src_pitch_v, offsets,
+                      dest + y * dest_pitch, width);
+  }
+  return true;
+}
+
+}  // namespace cricket
@@ -0,0 +1,65 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TALK_SESSION_PHONE_VIDEOKERNELS_H_
+#define TALK_SESSION_PHONE_VIDEOKERNELS_H_
+
+#include "talk/base/basictypes.h"
+
+// Pixel-processing kernels for I420 frames: scaling and conversion to 32-bit
+// RGB. Each kernel has a portable implementation and, on x86, an SSE2 one;
+// the SSE2 versions are picked automatically and produce exactly the same
+// output.
+
+namespace cricket {
+
+// Scales one 8-bit plane. With "interpolate", halving is done with a 2x2 box
+// filter and any other ratio bilinearly; without it the nearest source pixel
+// is taken.
+void ScalePlane(const uint8* src, int src_pitch, int src_width,
+                int src_height, uint8* dest, int dest_pitch, int dest_width,
+                int dest_height, bool interpolate);
+
+// Scales all three planes of an I420 image.
+void ScaleI420(const uint8* src_y, const uint8* src_u, const uint8* src_v,
+               int src_pitch_y, int src_pitch_u, int src_pitch_v,
+               int src_width, int src_height,
+               uint8* dest_y, uint8* dest_u, uint8* dest_v,
+               int dest_pitch_y, int dest_pitch_u, int dest_pitch_v,
+               int dest_width, int dest_height, bool interpolate);
+
+// Converts an I420 image to 32-bit RGB, using the BT.601 coefficients.
+// "to_fourcc" must be FOURCC_ARGB, FOURCC_ABGR or FOURCC_BGRA; returns false
+// otherwise.
+bool ConvertI420ToRgb32(const uint8* src_y, const uint8* src_u,
+                        const uint8* src_v, int src_pitch_y, int src_pitch_u,
+                        int src_pitch_v, int width, int height,
+                        uint32 to_fourcc, uint8* dest, int dest_pitch);
+
+}  // namespace cricket
+
+#endif  // TALK_SESSION_PHONE_VIDEOKERNELS_H_
@@ -0,0 +1,221 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "talk/base/gunit.h"
+#include "talk/base/logging.h"
+#include "talk/base/time.h"
+#include "talk/session/phone/videocommon.h"
+#include "talk/session/phone/videokernels.h"
+
+namespace cricket {
+
+// Odd sizes so that both the vector loops and the scalar tails run.
+static const int kWidth = 83;
+static const int kHeight = 41;
+
+static void FillRandom(std::vector<uint8>* plane) {
+  srand(1234);
+  for (size_t i = 0; i < plane->size(); ++i) {
+    (*plane)[i] = static_cast<uint8>(rand());
+  }
+}
+
+TEST(VideoKernelsTest, ScalePlaneCopiesSameSize) {
+  std::vector<uint8> src(kWidth * kHeight), dest(kWidth * kHeight);
+  FillRandom(&src);
+  ScalePlane(&src[0], kWidth, kWidth, kHeight, &dest[0], kWidth,
+             kWidth, kHeight, true);
+  EXPECT_TRUE(src == dest);
+}
+
+TEST(VideoKernelsTest, ScalePlaneHalvesWithBoxFilter) {
+  const int src_width = 2 * kWidth, src_height = 2 * kHeight;
+  std::vector<uint8> src(src_width * src_height), dest(kWidth * kHeight);
+  FillRandom(&src);
+  ScalePlane(&src[0], src_width, src_width, src_height,
+             &dest[0], kWidth, kWidth, kHeight, true);
+  for (int y = 0; y < kHeight; ++y) {
+    for (int x = 0; x < kWidth; ++x) {
+      const uint8* p = &src[2 * y * src_width + 2 * x];
+      int sum = p[0] + p[1] + p[src_width] + p[src_width + 1];
+      // Averaging in two steps may round up by one.
+      int value = dest[y * kWidth + x];
+      EXPECT_LE(sum / 4, value);
+      EXPECT_GE((sum + 3) / 4 + 1, value);
+    }
+  }
+}
+
+TEST(VideoKernelsTest, ScalePlaneTakesNearestPoint) {
+  std::vector<uint8> src(kWidth * kHeight);
+  std::vector<uint8> dest(2 * kWidth * 2 * kHeight);
+  FillRandom(&src);
+  ScalePlane(&src[0], kWidth, kWidth, kHeight,
+             &dest[0], 2 * kWidth, 2 * kWidth, 2 * kHeight, false);
+  for (int y = 0; y < 2 * kHeight; ++y) {
+    for (int x = 0; x < 2 * kWidth; ++x) {
+      EXPECT_EQ(src[y / 2 * kWidth + x / 2], dest[y * 2 * kWidth + x]);
+    }
+  }
+}
+
+TEST(VideoKernelsTest, ScalePlaneInterpolates) {
+  // A horizontal ramp stays a ramp, whatever the vertical scale.
+  const int src_width = 256, dest_width = 100, dest_height = 77;
+  std::vector<uint8> src(src_width * kHeight);
+  std::vector<uint8> dest(dest_width * dest_height);
+  for (int y = 0; y < kHeight; ++y) {
+    for (int x = 0; x < src_width; ++x) {
+      src[y * src_width + x] = static_cast<uint8>(x);
+    }
+  }
+  ScalePlane(&src[0], src_width, src_width, kHeight,
+             &dest[0], dest_width, dest_width, dest_height, true);
+  for (int y = 0; y < dest_height; ++y) {
+    for (int x = 0; x < dest_width; ++x) {
+      double expected = (x + 0.5) * src_width / dest_width - 0.5;
+      EXPECT_NEAR(expected, dest[y * dest_width + x], 1.0) << x << "," << y;
+    }
+  }
+
+  // A flat plane stays flat.
+  std::vector<uint8> flat(kWidth * kHeight, 77);
+  ScalePlane(&flat[0], kWidth, kWidth, kHeight,
+             &dest[0], dest_width, dest_width, dest_height, true);
+  EXPECT_EQ(std::vector<uint8>(dest.size(), 77), dest);
+}
+
+TEST(VideoKernelsTest, ScaleI420ScalesChroma) {
+  const int dest_width = 2 * kWidth, dest_height = 2 * kHeight;
+  const int src_chroma = ((kWidth + 1) / 2) * ((kHeight + 1) / 2);
+  const int dest_chroma = kWidth * kHeight;
+  std::vector<uint8> y(kWidth * kHeight, 10), u(src_chroma, 20),
+      v(src_chroma, 30);
+  std::vector<uint8> dy(dest_width * dest_height), du(dest_chroma),
+      dv(dest_chroma);
+  ScaleI420(&y[0], &u[0], &v[0], kWidth, (kWidth + 1) / 2, (kWidth + 1) / 2,
+            kWidth, kHeight, &dy[0], &du[0], &dv[0],
+            dest_width, kWidth, kWidth, dest_width, dest_height, true);
+  EXPECT_EQ(std::vector<uint8>(dy.size(), 10), dy);
+  EXPECT_EQ(std::vector<uint8>(du.size(), 20), du);
+  EXPECT_EQ(std::vector<uint8>(dv.size(), 30), dv);
+}
+
+TEST(VideoKernelsTest, ConvertI420ToRgb32) {
+  const int chroma_width = (kWidth + 1) / 2;
+  const int chroma_size = chroma_width * ((kHeight + 1) / 2);
+  std::vector<uint8> y(kWidth * kHeight), u(chroma_size), v(chroma_size);
+  FillRandom(&y);
+  FillRandom(&u);
+  FillRandom(&v);
+  // Byte offsets of red, green, blue and alpha for each format.
+  static const uint32 kFourccs[] = { FOURCC_ARGB, FOURCC_ABGR, FOURCC_BGRA };
+  static const int kOffsets[][4] = { { 2, 1, 0, 3 }, { 0, 1, 2, 3 },
+                                     { 1, 2, 3, 0 } };
+  const int pitch = kWidth * 4 + 12;
+  std::vector<uint8> rgb(pitch * kHeight);
+  for (int f = 0; f < 3; ++f) {
+    ASSERT_TRUE(ConvertI420ToRgb32(&y[0], &u[0], &v[0], kWidth,
+                                   chroma_width, chroma_width, kWidth,
+                                   kHeight, kFourccs[f], &rgb[0], pitch));
+    for (int row = 0; row < kHeight; ++row) {
+      for (int x = 0; x < kWidth; ++x) {
+        double c = y[row * kWidth + x] - 16;
+        double d = u[row / 2 * chroma_width + x / 2] - 128;
+        double e = v[row / 2 * chroma_width + x / 2] - 128;
+        double r = 1.164 * c + 1.596 * e;
+        double g = 1.164 * c - 0.391 * d - 0.813 * e;
+        double b = 1.164 * c + 2.018 * d;
+        const uint8* p = &rgb[row * pitch + 4 * x];
+        EXPECT_NEAR(talk_base::_max(0.0, talk_base::_min(255.0, r)),
+                    p[kOffsets[f][0]], 2.0);
+        EXPECT_NEAR(talk_base::_max(0.0, talk_base::_min(255.0, g)),
+                    p[kOffsets[f][1]], 2.0);
+        EXPECT_NEAR(talk_base::_max(0.0, talk_base::_min(255.0, b)),
+                    p[kOffsets[f][2]], 2.0);
+        EXPECT_EQ(255, p[kOffsets[f][3]]);
+      }
+    }
+  }
+  EXPECT_FALSE(ConvertI420ToRgb32(&y[0], &u[0], &v[0], kWidth, chroma_width,
+                                  chroma_width, kWidth, kHeight, FOURCC_RAW,
+                                  &rgb[0], pitch));
+}
+
+// Reports frames per second for each kernel at common frame sizes.
+TEST(VideoKernelsTest, DISABLED_Benchmark) {
+  static const int kSizes[][2] = { { 640, 360 }, { 1280, 720 },
+                                   { 1920, 1080 } };
+  const int kIterations = 50;
+  for (int s = 0; s < 3; ++s) {
+    const int width = kSizes[s][0], height = kSizes[s][1];
+    std::vector<uint8> src(width * height * 3 / 2);
+    std::vector<uint8> dest(width * height * 4);
+    FillRandom(&src);
+    const uint8* y = &src[0];
+    const uint8* u = y + width * height;
+    const uint8* v = u + width * height / 4;
+
+    for (int kernel = 0; kernel < 4; ++kernel) {
+      // Halving, scaling by 2/3 and by 3/2.
+      int dest_width = kernel == 0 ? width / 2 :
+          kernel == 1 ? width * 2 / 3 : width * 3 / 2;
+      int dest_height = kernel == 0 ? height / 2 :
+          kernel == 1 ? height * 2 / 3 : height * 3 / 2;
+      uint8* dy = &dest[0];
+      uint8* du = dy + dest_width * dest_height;
+      uint8* dv = du + dest_width * dest_height / 4;
+      uint32 start = talk_base::Time();
+      for (int i = 0; i < kIterations; ++i) {
+        if (kernel < 3) {
+          ScaleI420(y, u, v, width, width / 2, width / 2, width, height,
+                    dy, du, dv, dest_width, dest_width / 2, dest_width / 2,
+                    dest_width, dest_height, true);
+        } else {
+          ConvertI420ToRgb32(y, u, v, width, width / 2, width / 2,
+                             width, height, FOURCC_ARGB, &dest[0],
+                             width * 4);
+        }
+      }
+      uint32 elapsed =
+          talk_base::_max<uint32>(1, talk_base::TimeSince(start));
+      static const char* const kNames[] = {
+        "ScaleI420 1/2", "ScaleI420 2/3", "ScaleI420 3/2",
+        "ConvertI420ToRgb32"
+      };
+      LOG(LS_INFO) << kNames[kernel] << " " << width << "x" << height << ": "
+                   << kIterations * 1000.0 / elapsed << " frames/sec";
+    }
+  }
+}
+
+}  // namespace cricket
@@ -0,0 +1,205 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "talk/session/phone/videorenderqueue.h"
+
+#include "talk/base/common.h"
+#include "talk/base/logging.h"
+#include "talk/base/thread.h"
+#include "talk/base/time.h"
+#include "talk/session/phone/videoframe.h"
+
+namespace cricket {
+
+enum {
+  MSG_RENDER = 1,
+  MSG_FLUSH
+};
+
+VideoRenderPool::VideoRenderPool(size_t size) : size_(size) {
+  ASSERT(size > 0);
+}
+
+VideoRenderPool::~VideoRenderPool() {
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    ASSERT(num_queues_[i] == 0);
+    threads_[i]->Stop();
+    delete threads_[i];
+  }
+}
+
+VideoRenderPool* VideoRenderPool::Default() {
+  static VideoRenderPool* pool = new VideoRenderPool();
+  return pool;
+}
+
+size_t VideoRenderPool::num_threads() {
+  talk_base::CritScope cs(&crit_);
+  return threads_.size();
+}
+
+talk_base::Thread* VideoRenderPool::AddQueue() {
+  talk_base::CritScope cs(&crit_);
+  size_t best = 0;
+  for (size_t i = 1; i < threads_.size(); ++i) {
+    if (num_queues_[i] < num_queues_[best])
+      best = i;
+  }
+  // Start another thread rather than share a busy one.
+  if (threads_.size() < size_ &&
+      (threads_.empty() || num_queues_[best] > 0)) {
+    threads_.push_back(new talk_base::Thread());
+    num_queues_.push_back(0);
+    threads_.back()->Start();
+    best = threads_.size() - 1;
+  }
+  ++num_queues_[best];
+  return threads_[best];
+}
+
+void VideoRenderPool::RemoveQueue(talk_base::Thread* thread) {
+  talk_base::CritScope cs(&crit_);
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    if (threads_[i] == thread) {
+      --num_queues_[i];
+      return;
+    }
+  }
+  ASSERT(false);
+}
+
+VideoRenderQueue::VideoRenderQueue(VideoRenderer* renderer,
+                                   VideoRenderPool* pool)
+    : renderer_(renderer),
+      pool_(pool),
+      thread_(pool->AddQueue()),
+      posted_(false),
+      size_changed_(false),
+      width_(0),
+      height_(0),
+      pending_frame_(NULL),
+      pending_time_(0),
+      total_latency_ms_(0) {
+  ASSERT(renderer != NULL);
+}
+
+VideoRenderQueue::~VideoRenderQueue() {
+  thread_->Clear(this);
+  // Wait for a frame being rendered.
+  thread_->Send(this, MSG_FLUSH);
+  pool_->RemoveQueue(thread_);
+  delete pending_frame_;
+}
+
+bool VideoRenderQueue::SetSize(int width, int height, int reserved) {
+  talk_base::CritScope cs(&crit_);
+  size_changed_ = true;
+  width_ = width;
+  height_ = height;
+  PostRender();
+  return true;
+}
+
+bool VideoRenderQueue::RenderFrame(const VideoFrame* frame) {
+  if (!frame) {
+    return false;
+  }
+
+  // Copies of pooled frames share their buffers, so this is cheap. Frames
+  // over the caller's own memory are copied, since the caller may reuse it
+  // as soon as we return.
+  VideoFrame* copy = frame->Copy();
+  if (!copy) {
+    return false;
+  }
+
+  talk_base::CritScope cs(&crit_);
+  ++stats_.frames_received;
+  if (pending_frame_) {
+    delete pending_frame_;
+    ++stats_.frames_dropped;
+  }
+  pending_frame_ = copy;
+  pending_time_ = talk_base::Time();
+  PostRender();
+  return true;
+}
+
+void VideoRenderQueue::GetStats(VideoRenderStats* stats) const {
+  talk_base::CritScope cs(&crit_);
+  *stats = stats_;
+}
+
+void VideoRenderQueue::PostRender() {
+  if (!posted_) {
+    posted_ = true;
+    thread_->Post(this, MSG_RENDER);
+  }
+}
+
+void VideoRenderQueue::OnMessage(talk_base::Message* msg) {
+  if (msg->message_id != MSG_RENDER) {
+    return;
+  }
+
+  bool size_changed;
+  int width, height;
+  VideoFrame* frame;
+  uint32 queued_time;
+  {
+    talk_base::CritScope cs(&crit_);
+    posted_ = false;
+    size_changed = size_changed_;
+    size_changed_ = false;
+    width = width_;
+    height = height_;
+    frame = pending_frame_;
+    pending_frame_ = NULL;
+    queued_time = pending_time_;
+  }
+
+  if (size_changed && !renderer_->SetSize(width, height, 0)) {
+    LOG(LS_WARNING) << "Renderer failed to change size to "
+                    << width << "x" << height;
+  }
+  if (!frame) {
+    return;
+  }
+
+  renderer_->RenderFrame(frame);
+  delete frame;
+  int latency = talk_base::TimeSince(queued_time);
+
+  talk_base::CritScope cs(&crit_);
+  ++stats_.frames_rendered;
+  total_latency_ms_ += latency;
+  stats_.avg_latency_ms =
+      static_cast<int>(total_latency_ms_ / stats_.frames_rendered);
+  stats_.max_latency_ms = talk_base::_max(stats_.max_latency_ms, latency);
+}
+
+}  // namespace cricket
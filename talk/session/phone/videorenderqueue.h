@@ -0,0 +1,135 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TALK_SESSION_PHONE_VIDEORENDERQUEUE_H_
+#define TALK_SESSION_PHONE_VIDEORENDERQUEUE_H_
+
+#include <vector>
+
+#include "talk/base/basictypes.h"
+#include "talk/base/constructormagic.h"
+#include "talk/base/criticalsection.h"
+#include "talk/base/messagehandler.h"
+#include "talk/session/phone/videorenderer.h"
+
+namespace talk_base {
+class Thread;
+}
+
+namespace cricket {
+
+class VideoFrame;
+
+struct VideoRenderStats {
+  VideoRenderStats()
+      : frames_received(0), frames_rendered(0), frames_dropped(0),
+        avg_latency_ms(0), max_latency_ms(0) {}
+  int frames_received;
+  int frames_rendered;
+  // Frames replaced by a newer one before the renderer got to them.
+  int frames_dropped;
+  // From the frame arriving to the renderer being done with it.
+  int avg_latency_ms;
+  int max_latency_ms;
+};
+
+// The threads that VideoRenderQueues render on. Each queue sticks to one
+// thread, so its frames stay in order, and queues are spread over the
+// threads so that several streams can be converted and drawn at once.
+class VideoRenderPool {
+ public:
+  static const size_t kDefaultSize = 2;
+
+  explicit VideoRenderPool(size_t size = kDefaultSize);
+  // All the queues must have been deleted.
+  ~VideoRenderPool();
+
+  // The pool used by the media channels. Never deleted.
+  static VideoRenderPool* Default();
+
+  size_t size() const { return size_; }
+  // The number of threads started so far. Threads are started as queues
+  // are added, up to size().
+  size_t num_threads();
+
+ private:
+  friend class VideoRenderQueue;
+
+  // Returns the thread with the fewest queues.
+  talk_base::Thread* AddQueue();
+  void RemoveQueue(talk_base::Thread* thread);
+
+  const size_t size_;
+  talk_base::CriticalSection crit_;
+  std::vector<talk_base::Thread*> threads_;
+  std::vector<int> num_queues_;
+
+  DISALLOW_COPY_AND_ASSIGN(VideoRenderPool);
+};
+
+// A VideoRenderer that hands frames on to another renderer on a thread of a
+// VideoRenderPool, so that the decoder's thread does not wait for color
+// conversion and drawing. If the renderer falls behind, only the newest
+// frame is kept waiting for it; the older ones are dropped.
+class VideoRenderQueue : public VideoRenderer,
+                         public talk_base::MessageHandler {
+ public:
+  VideoRenderQueue(VideoRenderer* renderer, VideoRenderPool* pool);
+  // Waits for the renderer to finish the frame it is on. Frames still
+  // queued are dropped.
+  virtual ~VideoRenderQueue();
+
+  // Both return at once, without waiting for the renderer.
+  virtual bool SetSize(int width, int height, int reserved);
+  virtual bool RenderFrame(const VideoFrame* frame);
+
+  void GetStats(VideoRenderStats* stats) const;
+
+ private:
+  virtual void OnMessage(talk_base::Message* msg);
+  // Posts a message to the render thread unless one is on its way.
+  void PostRender();
+
+  VideoRenderer* renderer_;
+  VideoRenderPool* pool_;
+  talk_base::Thread* thread_;
+  mutable talk_base::CriticalSection crit_;
+  bool posted_;
+  bool size_changed_;
+  int width_;
+  int height_;
+  VideoFrame* pending_frame_;
+  uint32 pending_time_;
+  VideoRenderStats stats_;
+  int64 total_latency_ms_;
+
+  DISALLOW_COPY_AND_ASSIGN(VideoRenderQueue);
+};
+
+}  // namespace cricket
+
+#endif  // TALK_SESSION_PHONE_VIDEORENDERQUEUE_H_
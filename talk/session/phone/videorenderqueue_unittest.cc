@@ -0,0 +1,305 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include <vector>
+
+#include "talk/base/criticalsection.h"
+#include "talk/base/event.h"
+#include "talk/base/gunit.h"
+#include "talk/base/logging.h"
+#include "talk/base/thread.h"
+#include "talk/base/time.h"
+#include "talk/session/phone/videoframe.h"
+#include "talk/session/phone/videorenderqueue.h"
+#include "talk/session/phone/webrtcvideoframe.h"
+
+namespace cricket {
+
+static const int kTimeout = 5000;
+
+// Just enough of a frame to tell the frames apart.
+class FakeVideoFrame : public VideoFrame {
+ public:
+  explicit FakeVideoFrame(int64 time_stamp) : time_stamp_(time_stamp) {}
+
+  virtual size_t GetWidth() const { return 0; }
+  virtual size_t GetHeight() const { return 0; }
+  virtual const uint8* GetYPlane() const { return NULL; }
+  virtual const uint8* GetUPlane() const { return NULL; }
+  virtual const uint8* GetVPlane() const { return NULL; }
+  virtual uint8* GetYPlane() { return NULL; }
+  virtual uint8* GetUPlane() { return NULL; }
+  virtual uint8* GetVPlane() { return NULL; }
+  virtual int32 GetYPitch() const { return 0; }
+  virtual int32 GetUPitch() const { return 0; }
+  virtual int32 GetVPitch() const { return 0; }
+  virtual size_t GetPixelWidth() const { return 1; }
+  virtual size_t GetPixelHeight() const { return 1; }
+  virtual int64 GetElapsedTime() const { return 0; }
+  virtual int64 GetTimeStamp() const { return time_stamp_; }
+  virtual void SetElapsedTime(int64 elapsed_time) {}
+  virtual void SetTimeStamp(int64 time_stamp) { time_stamp_ = time_stamp; }
+  virtual int GetRotation() const { return 0; }
+  virtual VideoFrame* Copy() const { return new FakeVideoFrame(time_stamp_); }
+  virtual bool MakeExclusive() { return true; }
+  virtual size_t CopyToBuffer(uint8* buffer, size_t size) const { return 0; }
+  virtual size_t ConvertToRgbBuffer(uint32 to_fourcc, uint8* buffer,
+                                    size_t size, size_t pitch_rgb) const {
+    return 0;
+  }
+  virtual void StretchToPlanes(uint8* y, uint8* u, uint8* v,
+                               int32 pitchY, int32 pitchU, int32 pitchV,
+                               size_t width, size_t height,
+                               bool interpolate, bool crop) const {}
+  virtual size_t StretchToBuffer(size_t w, size_t h, uint8* buffer,
+                                 size_t size, bool interpolate,
+                                 bool crop) const {
+    return 0;
+  }
+  virtual void StretchToFrame(VideoFrame* target, bool interpolate,
+                              bool crop) const {}
+  virtual VideoFrame* Stretch(size_t w, size_t h, bool interpolate,
+                              bool crop) const {
+    return NULL;
+  }
+
+ private:
+  int64 time_stamp_;
+};
+
+// Records what it is asked to render, and can be made to hold on to a
+// frame, or to take a while over each, like a slow color conversion.
+class FakeVideoRenderer : public VideoRenderer {
+ public:
+  FakeVideoRenderer()
+      : thread_(NULL), width_(0), frames_(0), last_time_stamp_(-1),
+        last_y_(-1), render_delay_ms_(0), blocked_(true, true) {}
+
+  virtual bool SetSize(int width, int height, int reserved) {
+    talk_base::CritScope cs(&crit_);
+    width_ = width;
+    return true;
+  }
+  virtual bool RenderFrame(const VideoFrame* frame) {
+    blocked_.Wait(talk_base::kForever);
+    if (render_delay_ms_)
+      talk_base::Thread::SleepMs(render_delay_ms_);
+    talk_base::CritScope cs(&crit_);
+    thread_ = talk_base::Thread::Current();
+    size_at_frame_ = width_;
+    ++frames_;
+    last_time_stamp_ = frame->GetTimeStamp();
+    last_y_ = frame->GetYPlane() ? *frame->GetYPlane() : -1;
+    return true;
+  }
+
+  void Block() { blocked_.Reset(); }
+  void Unblock() { blocked_.Set(); }
+  void set_render_delay_ms(int delay) { render_delay_ms_ = delay; }
+  talk_base::Thread* thread() {
+    talk_base::CritScope cs(&crit_);
+    return thread_;
+  }
+  int frames() {
+    talk_base::CritScope cs(&crit_);
+    return frames_;
+  }
+  int64 last_time_stamp() {
+    talk_base::CritScope cs(&crit_);
+    return last_time_stamp_;
+  }
+  int size_at_frame() {
+    talk_base::CritScope cs(&crit_);
+    return size_at_frame_;
+  }
+  // The first luma sample of the last frame, or -1 if it had no planes.
+  int last_y() {
+    talk_base::CritScope cs(&crit_);
+    return last_y_;
+  }
+
+ private:
+  talk_base::CriticalSection crit_;
+  talk_base::Thread* thread_;
+  int width_;
+  int size_at_frame_;
+  int frames_;
+  int64 last_time_stamp_;
+  int last_y_;
+  int render_delay_ms_;
+  talk_base::Event blocked_;
+};
+
+TEST(VideoRenderQueueTest, RendersOnPoolThread) {
+  VideoRenderPool pool;
+  FakeVideoRenderer renderer;
+  {
+    VideoRenderQueue queue(&renderer, &pool);
+    EXPECT_TRUE(queue.SetSize(320, 240, 0));
+    FakeVideoFrame frame(1);
+    EXPECT_TRUE(queue.RenderFrame(&frame));
+    EXPECT_EQ_WAIT(1, renderer.frames(), kTimeout);
+    EXPECT_EQ(1, renderer.last_time_stamp());
+    EXPECT_EQ(320, renderer.size_at_frame());
+    EXPECT_TRUE(renderer.thread() != NULL);
+    EXPECT_TRUE(renderer.thread() != talk_base::Thread::Current());
+
+    VideoRenderStats stats;
+    queue.GetStats(&stats);
+    EXPECT_EQ(1, stats.frames_received);
+    EXPECT_EQ(1, stats.frames_rendered);
+    EXPECT_EQ(0, stats.frames_dropped);
+  }
+  EXPECT_EQ(1U, pool.num_threads());
+}
+
+TEST(VideoRenderQueueTest, DropsStaleFrames) {
+  VideoRenderPool pool;
+  FakeVideoRenderer renderer;
+  VideoRenderQueue queue(&renderer, &pool);
+  renderer.Block();
+  for (int i = 0; i < 6; ++i) {
+    FakeVideoFrame frame(i);
+    EXPECT_TRUE(queue.RenderFrame(&frame));
+    // Let the render thread pick up the first frame.
+    if (i == 0)
+      talk_base::Thread::SleepMs(50);
+  }
+  renderer.Unblock();
+  // The first frame, which was being rendered, and the newest.
+  EXPECT_EQ_WAIT(5, renderer.last_time_stamp(), kTimeout);
+  EXPECT_EQ(2, renderer.frames());
+
+  VideoRenderStats stats;
+  queue.GetStats(&stats);
+  EXPECT_EQ(6, stats.frames_received);
+  EXPECT_EQ(2, stats.frames_rendered);
+  EXPECT_EQ(4, stats.frames_dropped);
+  EXPECT_GE(stats.max_latency_ms, 50);
+}
+
+TEST(VideoRenderQueueTest, SpreadsQueuesOverThreads) {
+  VideoRenderPool pool(2);
+  FakeVideoRenderer renderer1, renderer2, renderer3;
+  VideoRenderQueue queue1(&renderer1, &pool);
+  VideoRenderQueue queue2(&renderer2, &pool);
+  VideoRenderQueue queue3(&renderer3, &pool);
+  EXPECT_EQ(2U, pool.num_threads());
+
+  FakeVideoFrame frame(1);
+  queue1.RenderFrame(&frame);
+  queue2.RenderFrame(&frame);
+  EXPECT_EQ_WAIT(1, renderer1.frames(), kTimeout);
+  EXPECT_EQ_WAIT(1, renderer2.frames(), kTimeout);
+  EXPECT_NE(renderer1.thread(), renderer2.thread());
+}
+
+TEST(VideoRenderQueueTest, DeleteWaitsForRenderer) {
+  VideoRenderPool pool;
+  FakeVideoRenderer renderer;
+  renderer.set_render_delay_ms(100);
+  {
+    VideoRenderQueue queue(&renderer, &pool);
+    FakeVideoFrame frame(1);
+    queue.RenderFrame(&frame);
+    talk_base::Thread::SleepMs(20);
+  }
+  EXPECT_EQ(1, renderer.frames());
+}
+
+// Test that the decoder may take back its buffer, as WebRtcRenderAdapter
+// does, while the frame is still waiting to be rendered.
+TEST(VideoRenderQueueTest, DecoderReusesBufferWhileQueued) {
+  const int kWidth = 16;
+  const int kHeight = 16;
+  VideoRenderPool pool;
+  FakeVideoRenderer renderer;
+  VideoRenderQueue queue(&renderer, &pool);
+  renderer.Block();
+
+  size_t size = VideoFrame::SizeOf(kWidth, kHeight);
+  uint8* memory = new uint8[size];
+  memset(memory, 99, size);
+  WebRtcVideoFrame frame;
+  frame.Attach(memory, size, kWidth, kHeight, 1, 1, 0, 1, 0);
+  EXPECT_TRUE(queue.RenderFrame(&frame));
+  uint8* detached;
+  size_t detached_size;
+  frame.Detach(&detached, &detached_size);
+  EXPECT_EQ(memory, detached);
+  memset(detached, 0, size);
+  delete [] detached;
+
+  renderer.Unblock();
+  EXPECT_EQ_WAIT(1, renderer.frames(), kTimeout);
+  EXPECT_EQ(99, renderer.last_y());
+}
+
+// Feeds 60 frames at 30 fps to a renderer that takes 50 ms per frame, first
+// directly and then through a queue, and reports how long the decoder's
+// thread is held up and what is dropped.
+TEST(VideoRenderQueueTest, DISABLED_SlowRendererBenchmark) {
+  const int kFrames = 60;
+  const int kFrameIntervalMs = 33;
+  FakeVideoRenderer renderer;
+  renderer.set_render_delay_ms(50);
+
+  uint32 start = talk_base::Time();
+  for (int i = 0; i < kFrames / 10; ++i) {
+    FakeVideoFrame frame(i);
+    renderer.RenderFrame(&frame);
+  }
+  LOG(LS_INFO) << "Direct: decoder held up "
+               << talk_base::TimeSince(start) * 10 / kFrames
+               << " ms per frame";
+
+  VideoRenderPool pool;
+  VideoRenderQueue queue(&renderer, &pool);
+  int blocked_ms = 0;
+  for (int i = 0; i < kFrames; ++i) {
+    FakeVideoFrame frame(i);
+    uint32 before = talk_base::Time();
+    queue.RenderFrame(&frame);
+    blocked_ms += talk_base::TimeSince(before);
+    talk_base::Thread::SleepMs(kFrameIntervalMs);
+  }
+  EXPECT_EQ_WAIT(kFrames - 1, renderer.last_time_stamp(), kTimeout);
+  VideoRenderStats stats;
+  queue.GetStats(&stats);
+  EXPECT_EQ(kFrames, stats.frames_rendered + stats.frames_dropped);
+  EXPECT_GT(stats.frames_dropped, 0);
+  LOG(LS_INFO) << "Queued: decoder held up "
+               << static_cast<double>(blocked_ms) / kFrames
+               << " ms per frame; " << stats.frames_rendered
+               << " rendered, " << stats.frames_dropped << " dropped, "
+               << stats.avg_latency_ms << " ms average and "
+               << stats.max_latency_ms << " ms maximum latency";
+}
+
+}  // namespace cricket
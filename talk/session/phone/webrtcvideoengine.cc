@@ -35,6 +35,7 @@
 #include "talk/base/logging.h"
 #include "talk/base/stringutils.h"
 #include "talk/session/phone/videorenderer.h"
+#include "talk/session/phone/videorenderqueue.h"
 #include "talk/session/phone/webrtcpassthroughrender.h"
 #include "talk/session/phone/webrtcvoiceengine.h"
 #include "talk/session/phone/webrtcvideoframe.h"
@@ -70,6 +71,8 @@ class WebRtcRenderAdapter : public webrtc::ExternalRenderer {
     WebRtcVideoFrame video_frame;
     video_frame.Attach(buffer, buffer_size, width_, height_,
                        1, 1, 0, time_stamp, 0);
+    // A renderer that keeps the frame, like VideoRenderQueue, keeps a copy
+    // of it, so the decoder's buffer can be taken back here.
     int ret = renderer_->RenderFrame(&video_frame) ? 0 : -1;
     uint8* buffer_temp;
     size_t buffer_size_temp;
@@ -819,7 +822,9 @@ bool WebRtcVideoMediaChannel::SetRenderer(
       LOG_RTCERR1(RemoveRenderer, vie_channel_);
     }
   }
-  remote_renderer_.reset(new WebRtcRenderAdapter(renderer));
+  remote_render_queue_.reset(renderer ?
+      new VideoRenderQueue(renderer, VideoRenderPool::Default()) : NULL);
+  remote_renderer_.reset(new WebRtcRenderAdapter(remote_render_queue_.get()));
 
   if (engine_->video_engine()->render()->AddRenderer(vie_channel_,
       webrtc::kVideoI420, remote_renderer_.get()) != 0) {
@@ -899,6 +904,14 @@ bool WebRtcVideoMediaChannel::GetStats(VideoMediaInfo* info) {
   }
   rinfo.ssrc = ssrc;
 
+  if (remote_render_queue_.get()) {
+    VideoRenderStats render_stats;
+    remote_render_queue_->GetStats(&render_stats);
+    rinfo.frames_dropped = render_stats.frames_dropped;
+    rinfo.render_latency_ms = render_stats.avg_latency_ms;
+    rinfo.max_render_latency_ms = render_stats.max_latency_ms;
+  }
+
   // Get codec for wxh
   info->receivers.push_back(rinfo);
   return true;
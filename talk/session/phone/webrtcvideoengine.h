@@ -50,6 +50,7 @@ namespace cricket {
 struct Device;
 class VideoCapturer;
 class VideoRenderer;
+class VideoRenderQueue;
 class ViEWrapper;
 class VoiceMediaChannel;
 class WebRtcRenderAdapter;
@@ -209,6 +210,8 @@ class WebRtcVideoMediaChannel : public VideoMediaChannel,
   bool connected_;
   bool render_started_;
   talk_base::scoped_ptr<webrtc::VideoCodec> send_codec_;
+  // Hands the decoded frames on to the renderer off the decoder's thread.
+  talk_base::scoped_ptr<VideoRenderQueue> remote_render_queue_;
   talk_base::scoped_ptr<WebRtcRenderAdapter> remote_renderer_;
 };
 }  // namespace cricket
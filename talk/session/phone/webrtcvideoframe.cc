@@ -27,21 +27,30 @@
 
 #include "talk/session/phone/webrtcvideoframe.h"
 
+#include <string.h>
+
 #include "talk/base/logging.h"
 #include "talk/session/phone/videocapturer.h"
 #include "talk/session/phone/videocommon.h"
-#ifdef WEBRTC_RELATIVE_PATH
-#include "common_video/vplib/main/interface/vplib.h"
-#else
-#include "third_party/webrtc/files/include/vplib.h"
-#endif
+#include "talk/session/phone/videoframebufferpool.h"
+#include "talk/session/phone/videokernels.h"
 
 namespace cricket {
 
-WebRtcVideoFrame::WebRtcVideoFrame() {
+WebRtcVideoFrame::WebRtcVideoFrame()
+    : buffer_(NULL),
+      width_(0),
+      height_(0),
+      pixel_width_(0),
+      pixel_height_(0),
+      elapsed_time_(0),
+      time_stamp_(0),
+      rotation_(0) {
 }
 
 WebRtcVideoFrame::~WebRtcVideoFrame() {
+  if (buffer_)
+    buffer_->Release();
 }
 
 bool WebRtcVideoFrame::Init(uint32 format, int w, int h, int dw, int dh,
@@ -54,10 +63,15 @@ bool WebRtcVideoFrame::Init(uint32 format, int w, int h, int dw, int dh,
     return false;
   }
 
-  uint8* buffer = new uint8[sample_size];
-  memcpy(buffer, sample, sample_size);
-  Attach(buffer, sample_size, w, h, pixel_width, pixel_height,
-         elapsed_time, time_stamp, rotation);
+  size_t size = VideoFrame::SizeOf(w, h);
+  if (sample_size < size) {
+    return false;
+  }
+
+  VideoFrameBuffer* buffer = VideoFrameBufferPool::Default()->Acquire(size);
+  memcpy(buffer->data(), sample, size);
+  SetBuffer(buffer, w, h, pixel_width, pixel_height,
+            elapsed_time, time_stamp, rotation);
   return true;
 }
 
@@ -71,13 +85,14 @@ bool WebRtcVideoFrame::Init(const CapturedFrame* frame, int dw, int dh) {
 bool WebRtcVideoFrame::InitToBlack(int w, int h,
                                    size_t pixel_width, size_t pixel_height,
                                    int64 elapsed_time, int64 time_stamp) {
-  size_t buffer_size = VideoFrame::SizeOf(w, h);
-  uint8* buffer = new uint8[buffer_size];
-  Attach(buffer, buffer_size, w, h, pixel_width, pixel_height,
-         elapsed_time, time_stamp, 0);
+  VideoFrameBuffer* buffer =
+      VideoFrameBufferPool::Default()->Acquire(VideoFrame::SizeOf(w, h));
+  SetBuffer(buffer, w, h, pixel_width, pixel_height,
+            elapsed_time, time_stamp, 0);
+  int chroma_size = GetUPitch() * ((h + 1) / 2);
   memset(GetYPlane(), 16, w * h);
-  memset(GetUPlane(), 128, w * h / 4);
-  memset(GetVPlane(), 128, w * h / 4);
+  memset(GetUPlane(), 128, chroma_size);
+  memset(GetVPlane(), 128, chroma_size);
   return true;
 }
 
@@ -85,105 +100,110 @@ void WebRtcVideoFrame::Attach(uint8* buffer, size_t buffer_size, int w, int h,
                               size_t pixel_width, size_t pixel_height,
                               int64 elapsed_time, int64 time_stamp,
                               int rotation) {
-  video_frame_.Free();
-  WebRtc_UWord8* new_memory = buffer;
-  WebRtc_UWord32 new_length = buffer_size;
-  WebRtc_UWord32 new_size = buffer_size;
-  video_frame_.Swap(new_memory, new_length, new_size);
-  video_frame_.SetWidth(w);
-  video_frame_.SetHeight(h);
+  SetBuffer(new VideoFrameBuffer(buffer, buffer_size), w, h,
+            pixel_width, pixel_height, elapsed_time, time_stamp, rotation);
+}
+
+void WebRtcVideoFrame::Detach(uint8** buffer, size_t* buffer_size) {
+  if (!buffer_) {
+    *buffer = NULL;
+    *buffer_size = 0;
+    return;
+  }
+
+  *buffer_size = buffer_->size();
+  *buffer = buffer_->Detach();
+  buffer_ = NULL;
+  width_ = height_ = 0;
+}
+
+void WebRtcVideoFrame::SetBuffer(VideoFrameBuffer* buffer, int w, int h,
+                                 size_t pixel_width, size_t pixel_height,
+                                 int64 elapsed_time, int64 time_stamp,
+                                 int rotation) {
+  if (buffer_)
+    buffer_->Release();
+  buffer_ = buffer;
+  width_ = w;
+  height_ = h;
   pixel_width_ = pixel_width;
   pixel_height_ = pixel_height;
   elapsed_time_ = elapsed_time;
-  video_frame_.SetTimeStamp(static_cast<WebRtc_UWord32>(time_stamp));
+  time_stamp_ = time_stamp;
   rotation_ = rotation;
 }
 
-void WebRtcVideoFrame::Detach(uint8** buffer, size_t* buffer_size) {
-  WebRtc_UWord8* new_memory = NULL;
-  WebRtc_UWord32 new_length = 0;
-  WebRtc_UWord32 new_size = 0;
-  video_frame_.Swap(new_memory, new_length, new_size);
-  *buffer = new_memory;
-  *buffer_size = new_size;
-}
-
 size_t WebRtcVideoFrame::GetWidth() const {
-  return video_frame_.Width();
+  return width_;
 }
 
 size_t WebRtcVideoFrame::GetHeight() const {
-  return video_frame_.Height();
+  return height_;
 }
 
 const uint8* WebRtcVideoFrame::GetYPlane() const {
-  WebRtc_UWord8* buffer = video_frame_.Buffer();
-  return buffer;
+  return buffer_ ? buffer_->data() : NULL;
 }
 
 const uint8* WebRtcVideoFrame::GetUPlane() const {
-  WebRtc_UWord8* buffer = video_frame_.Buffer();
-  if (buffer)
-    buffer += (video_frame_.Width() * video_frame_.Height());
-  return buffer;
+  return buffer_ ? buffer_->data() + width_ * height_ : NULL;
 }
 
 const uint8* WebRtcVideoFrame::GetVPlane() const {
-  WebRtc_UWord8* buffer = video_frame_.Buffer();
-  if (buffer)
-    buffer += (video_frame_.Width() * video_frame_.Height() * 5 / 4);
-  return buffer;
+  const uint8* u = GetUPlane();
+  return u ? u + GetUPitch() * ((height_ + 1) / 2) : NULL;
 }
 
 uint8* WebRtcVideoFrame::GetYPlane() {
-  WebRtc_UWord8* buffer = video_frame_.Buffer();
-  return buffer;
+  return const_cast<uint8*>(
+      static_cast<const WebRtcVideoFrame*>(this)->GetYPlane());
 }
 
 uint8* WebRtcVideoFrame::GetUPlane() {
-  WebRtc_UWord8* buffer = video_frame_.Buffer();
-  if (buffer)
-    buffer += (video_frame_.Width() * video_frame_.Height());
-  return buffer;
+  return const_cast<uint8*>(
+      static_cast<const WebRtcVideoFrame*>(this)->GetUPlane());
 }
 
 uint8* WebRtcVideoFrame::GetVPlane() {
-  WebRtc_UWord8* buffer = video_frame_.Buffer();
-  if (buffer)
-    buffer += (video_frame_.Width() * video_frame_.Height() * 5 / 4);
-  return buffer;
+  return const_cast<uint8*>(
+      static_cast<const WebRtcVideoFrame*>(this)->GetVPlane());
 }
 
 VideoFrame* WebRtcVideoFrame::Copy() const {
-  WebRtc_UWord8* buffer = video_frame_.Buffer();
-  if (!buffer)
+  if (!buffer_)
     return NULL;
 
-  size_t new_buffer_size = video_frame_.Length();
-  uint8* new_buffer = new uint8[new_buffer_size];
-  memcpy(new_buffer, buffer, new_buffer_size);
+  // Attached memory goes back to its owner on Detach(), so it can't be
+  // shared.
+  VideoFrameBuffer* buffer = buffer_;
+  if (buffer->pooled()) {
+    buffer->AddRef();
+  } else {
+    buffer = VideoFrameBufferPool::Default()->Copy(buffer_);
+  }
   WebRtcVideoFrame* copy = new WebRtcVideoFrame();
-  copy->Attach(new_buffer, new_buffer_size,
-               video_frame_.Width(), video_frame_.Height(),
-               pixel_width_, pixel_height_,
-               elapsed_time_, video_frame_.TimeStamp(), rotation_);
+  copy->SetBuffer(buffer, width_, height_, pixel_width_, pixel_height_,
+                  elapsed_time_, time_stamp_, rotation_);
   return copy;
 }
 
 bool WebRtcVideoFrame::MakeExclusive() {
-  // WebRtcVideoFrame::Copy makes a deep copy of the frame buffer.  No action
-  // is needed for MakeExclusive.
+  if (buffer_ && !buffer_->HasOneRef()) {
+    VideoFrameBuffer* copy = VideoFrameBufferPool::Default()->Copy(buffer_);
+    buffer_->Release();
+    buffer_ = copy;
+  }
   return true;
 }
 
 size_t WebRtcVideoFrame::CopyToBuffer(uint8* buffer, size_t size) const {
-  if (!video_frame_.Buffer()) {
+  if (!buffer_) {
     return 0;
   }
 
-  size_t needed = video_frame_.Length();
+  size_t needed = VideoFrame::SizeOf(width_, height_);
   if (needed <= size) {
-    memcpy(buffer, video_frame_.Buffer(), needed);
+    memcpy(buffer, buffer_->data(), needed);
   }
   return needed;
 }
@@ -192,12 +212,12 @@ size_t WebRtcVideoFrame::ConvertToRgbBuffer(uint32 to_fourcc,
                                             uint8* buffer,
                                             size_t size,
                                             size_t pitch_rgb) const {
-  if (!video_frame_.Buffer()) {
+  if (!buffer_) {
     return 0;
   }
 
-  size_t width = video_frame_.Width();
-  size_t height = video_frame_.Height();
+  size_t width = width_;
+  size_t height = height_;
   // See http://www.virtualdub.org/blog/pivot/entry.php?id=190 for a good
   // explanation of pitch and why this is the amount of space we need.
   size_t needed = pitch_rgb * (height - 1) + 4 * width;
@@ -207,19 +227,11 @@ size_t WebRtcVideoFrame::ConvertToRgbBuffer(uint32 to_fourcc,
     return 0;
   }
 
-  webrtc::VideoType to_type = webrtc::kUnknown;
-  switch (to_fourcc) {
-    case FOURCC_ARGB:
-      to_type = webrtc::kARGB;
-      break;
-    default:
-      LOG(LS_WARNING) << "RGB type not supported: " << to_fourcc;
-      return 0;
-  }
-
-  if (to_type != webrtc::kUnknown) {
-    webrtc::ConvertFromI420(to_type, video_frame_.Buffer(),
-                            width, height, buffer);
+  if (!ConvertI420ToRgb32(GetYPlane(), GetUPlane(), GetVPlane(),
+                          GetYPitch(), GetUPitch(), GetVPitch(),
+                          width, height, to_fourcc, buffer, pitch_rgb)) {
+    LOG(LS_WARNING) << "RGB type not supported: " << to_fourcc;
+    return 0;
   }
 
   return needed;
@@ -229,18 +241,52 @@ void WebRtcVideoFrame::StretchToPlanes(
     uint8* y, uint8* u, uint8* v,
     int32 dst_pitch_y, int32 dst_pitch_u, int32 dst_pitch_v,
     size_t width, size_t height, bool interpolate, bool crop) const {
-  // TODO: Implement StretchToPlanes
+  if (!buffer_) {
+    return;
+  }
+
+  int src_width = GetWidth();
+  int src_height = GetHeight();
+  const uint8* src_y = GetYPlane();
+  const uint8* src_u = GetUPlane();
+  const uint8* src_v = GetVPlane();
+  if (crop) {
+    // Cut the sides or the top and bottom evenly to get the target's aspect
+    // ratio. Offsets are kept even so that the chroma planes line up.
+    int64 src_area = static_cast<int64>(src_width) * height;
+    int64 dest_area = static_cast<int64>(width) * src_height;
+    if (src_area > dest_area) {
+      int crop_width = static_cast<int>(dest_area / height) & ~1;
+      int offset = ((src_width - crop_width) / 2) & ~1;
+      src_y += offset;
+      src_u += offset / 2;
+      src_v += offset / 2;
+      src_width = crop_width;
+    } else if (src_area < dest_area) {
+      int crop_height = static_cast<int>(src_area / width) & ~1;
+      int offset = ((src_height - crop_height) / 2) & ~1;
+      src_y += offset * GetYPitch();
+      src_u += offset / 2 * GetUPitch();
+      src_v += offset / 2 * GetVPitch();
+      src_height = crop_height;
+    }
+  }
+
+  ScaleI420(src_y, src_u, src_v, GetYPitch(), GetUPitch(), GetVPitch(),
+            src_width, src_height, y, u, v,
+            dst_pitch_y, dst_pitch_u, dst_pitch_v,
+            static_cast<int>(width), static_cast<int>(height), interpolate);
 }
 
 size_t WebRtcVideoFrame::StretchToBuffer(size_t w, size_t h,
                                          uint8* buffer, size_t size,
                                          bool interpolate,
                                          bool crop) const {
-  if (!video_frame_.Buffer()) {
+  if (!buffer_) {
     return 0;
   }
 
-  size_t needed = video_frame_.Length();
+  size_t needed = VideoFrame::SizeOf(w, h);
 
   if (needed <= size) {
     uint8* bufy = buffer;
@@ -271,8 +317,15 @@ void WebRtcVideoFrame::StretchToFrame(VideoFrame* target,
 
 VideoFrame* WebRtcVideoFrame::Stretch(size_t w, size_t h,
     bool interpolate, bool crop) const {
-  // TODO: implement
-  return NULL;
+  if (!buffer_) {
+    return NULL;
+  }
+
+  WebRtcVideoFrame* frame = new WebRtcVideoFrame();
+  frame->InitToBlack(w, h, pixel_width_, pixel_height_,
+                     elapsed_time_, GetTimeStamp());
+  StretchToFrame(frame, interpolate, crop);
+  return frame;
 }
 
 }  // namespace cricket
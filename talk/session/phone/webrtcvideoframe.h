@@ -28,18 +28,18 @@
 #ifndef TALK_SESSION_PHONE_WEBRTCVIDEOFRAME_H_
 #define TALK_SESSION_PHONE_WEBRTCVIDEOFRAME_H_
 
-#ifdef WEBRTC_RELATIVE_PATH
-#include "common_types.h"
-#include "modules/interface/module_common_types.h"
-#else
-#include "third_party/webrtc/files/include/common_types.h"
-#include "third_party/webrtc/files/include/module_common_types.h"
-#endif
+#include "talk/base/constructormagic.h"
 #include "talk/session/phone/videoframe.h"
 
 namespace cricket {
 
 struct CapturedFrame;
+class VideoFrameBuffer;
+
+// A VideoFrame whose planes live in a VideoFrameBuffer from the default
+// pool. Copy() shares the buffer; MakeExclusive() copies it on demand.
+// Frames that Attach() someone else's memory are copied into the pool
+// instead, since Detach() gives that memory back.
 
 class WebRtcVideoFrame : public VideoFrame {
  public:
@@ -61,7 +61,7 @@ class WebRtcVideoFrame : public VideoFrame {
               int64 elapsed_time, int64 time_stamp, int rotation);
   void Detach(uint8** buffer, size_t* buffer_size);
 
-  bool HasImage() const { return video_frame_.Buffer() != NULL; }
+  bool HasImage() const { return buffer_ != NULL; }
 
   virtual size_t GetWidth() const;
   virtual size_t GetHeight() const;
@@ -71,20 +71,18 @@ class WebRtcVideoFrame : public VideoFrame {
   virtual uint8* GetYPlane();
   virtual uint8* GetUPlane();
   virtual uint8* GetVPlane();
-  virtual int32 GetYPitch() const { return video_frame_.Width(); }
-  virtual int32 GetUPitch() const { return video_frame_.Width() / 2; }
-  virtual int32 GetVPitch() const { return video_frame_.Width() / 2; }
+  virtual int32 GetYPitch() const { return width_; }
+  virtual int32 GetUPitch() const { return (width_ + 1) / 2; }
+  virtual int32 GetVPitch() const { return (width_ + 1) / 2; }
 
   virtual size_t GetPixelWidth() const { return pixel_width_; }
   virtual size_t GetPixelHeight() const { return pixel_height_; }
   virtual int64 GetElapsedTime() const { return elapsed_time_; }
-  virtual int64 GetTimeStamp() const { return video_frame_.TimeStamp(); }
+  virtual int64 GetTimeStamp() const { return time_stamp_; }
   virtual void SetElapsedTime(int64 elapsed_time) {
     elapsed_time_ = elapsed_time;
   }
-  virtual void SetTimeStamp(int64 time_stamp) {
-    video_frame_.SetTimeStamp(static_cast<WebRtc_UWord32>(time_stamp));
-  }
+  virtual void SetTimeStamp(int64 time_stamp) { time_stamp_ = time_stamp; }
 
   virtual int GetRotation() const { return rotation_; }
 
@@ -105,11 +103,21 @@ class WebRtcVideoFrame : public VideoFrame {
                               bool crop) const;
 
  private:
-  webrtc::VideoFrame video_frame_;
+  // Takes over the caller's reference to "buffer".
+  void SetBuffer(VideoFrameBuffer* buffer, int w, int h,
+                 size_t pixel_width, size_t pixel_height,
+                 int64 elapsed_time, int64 time_stamp, int rotation);
+
+  VideoFrameBuffer* buffer_;
+  int width_;
+  int height_;
   size_t pixel_width_;
   size_t pixel_height_;
   int64 elapsed_time_;
+  int64 time_stamp_;
   int rotation_;
+
+  DISALLOW_COPY_AND_ASSIGN(WebRtcVideoFrame);
 };
 }  // namespace cricket
 
@@ -401,6 +401,46 @@ TEST_F(WebRtcVideoFrameTest, Copy) {
   EXPECT_TRUE(IsEqual(frame1, *frame2.get(), 0));
 }
 
+// Test that copies share the frame buffer until one of them is written.
+TEST_F(WebRtcVideoFrameTest, CopyIsShallow) {
+  WebRtcVideoFrame frame1;
+  ASSERT_TRUE(frame1.InitToBlack(kWidth, kHeight, 1, 1, 10, 20));
+  talk_base::scoped_ptr<cricket::VideoFrame> frame2(frame1.Copy());
+  EXPECT_EQ(frame1.GetYPlane(), frame2->GetYPlane());
+  EXPECT_EQ(10, frame2->GetElapsedTime());
+  EXPECT_EQ(20, frame2->GetTimeStamp());
+
+  EXPECT_TRUE(frame2->MakeExclusive());
+  EXPECT_NE(frame1.GetYPlane(), frame2->GetYPlane());
+  *frame2->GetYPlane() = 235;
+  EXPECT_EQ(16, *frame1.GetYPlane());
+  // Already exclusive, so nothing more is copied.
+  const uint8* y = frame2->GetYPlane();
+  EXPECT_TRUE(frame2->MakeExclusive());
+  EXPECT_EQ(y, frame2->GetYPlane());
+}
+
+// Test that copies of an attached frame don't keep the attached memory, so
+// that detaching it leaves them intact.
+TEST_F(WebRtcVideoFrameTest, DetachCopied) {
+  size_t size = cricket::VideoFrame::SizeOf(kWidth, kHeight);
+  uint8* memory = new uint8[size];
+  memset(memory, 99, size);
+  WebRtcVideoFrame frame1;
+  frame1.Attach(memory, size, kWidth, kHeight, 1, 1, 0, 0, 0);
+  talk_base::scoped_ptr<cricket::VideoFrame> frame2(frame1.Copy());
+  EXPECT_NE(frame1.GetYPlane(), frame2->GetYPlane());
+  uint8* detached;
+  size_t detached_size;
+  frame1.Detach(&detached, &detached_size);
+  EXPECT_EQ(memory, detached);
+  EXPECT_EQ(size, detached_size);
+  EXPECT_TRUE(IsNull(frame1));
+  memset(detached, 0, size);
+  EXPECT_EQ(99, *frame2->GetYPlane());
+  delete [] detached;
+}
+
 TEST_F(WebRtcVideoFrameTest, CopyToBuffer) {
   size_t out_size = kWidth * kHeight * 3 / 2;
   talk_base::scoped_array<uint8> out(new uint8[out_size]);
@@ -435,5 +475,59 @@ TEST_F(WebRtcVideoFrameTest, CopyToBuffer1Pixel) {
   EXPECT_EQ(0xfb, out.get()[3]);  // Check sentinel is still intact.
 }
 
+TEST_F(WebRtcVideoFrameTest, ConvertToABGRBuffer) {
+  size_t out_size = kWidth * kHeight * 4;
+  talk_base::scoped_array<uint8> outbuf(new uint8[out_size + kAlignment]);
+  uint8 *out = ALIGNP(outbuf.get(), kAlignment);
+  WebRtcVideoFrame frame;
+  EXPECT_TRUE(frame.InitToBlack(kWidth, kHeight, 1, 1, 0, 0));
+  EXPECT_EQ(out_size, frame.ConvertToRgbBuffer(cricket::FOURCC_ABGR,
+                                               out, out_size, kWidth * 4));
+  // Black is black whatever the channel order, with an opaque alpha.
+  EXPECT_EQ(0, out[0]);
+  EXPECT_EQ(0, out[1]);
+  EXPECT_EQ(0, out[2]);
+  EXPECT_EQ(255, out[3]);
+  EXPECT_EQ(0U, frame.ConvertToRgbBuffer(cricket::FOURCC_I420,
+                                         out, out_size, kWidth * 4));
+}
+
+// Test stretching a flat image to half size, with and without
+// interpolation.
+TEST_F(WebRtcVideoFrameTest, StretchToFrame) {
+  WebRtcVideoFrame frame1, frame2, target;
+  ASSERT_TRUE(frame1.InitToBlack(kWidth, kHeight, 1, 1, 10, 20));
+  ASSERT_TRUE(target.InitToBlack(kWidth / 2, kHeight / 2, 1, 1, 0, 0));
+  frame1.StretchToFrame(&target, true, false);
+  ASSERT_TRUE(frame2.InitToBlack(kWidth / 2, kHeight / 2, 1, 1, 10, 20));
+  EXPECT_TRUE(IsEqual(frame2, target, 0));
+  frame1.StretchToFrame(&target, false, false);
+  EXPECT_TRUE(IsEqual(frame2, target, 0));
+}
+
+// Test stretching to a new frame, cropping a 16:9 image to 4:3.
+TEST_F(WebRtcVideoFrameTest, StretchWithCrop) {
+  WebRtcVideoFrame frame;
+  ASSERT_TRUE(frame.InitToBlack(kWidth, kHeight, 1, 1, 10, 20));
+  // Mark the columns that cropping should cut off.
+  for (int y = 0; y < kHeight; ++y) {
+    memset(frame.GetYPlane() + y * frame.GetYPitch(), 235, 160);
+    memset(frame.GetYPlane() + y * frame.GetYPitch() + kWidth - 160, 235,
+           160);
+  }
+  talk_base::scoped_ptr<cricket::VideoFrame> stretched(
+      frame.Stretch(640, 480, true, true));
+  ASSERT_TRUE(stretched.get() != NULL);
+  EXPECT_EQ(640U, stretched->GetWidth());
+  EXPECT_EQ(480U, stretched->GetHeight());
+  EXPECT_EQ(10, stretched->GetElapsedTime());
+  EXPECT_EQ(20, stretched->GetTimeStamp());
+  for (int y = 0; y < 480; ++y) {
+    for (int x = 0; x < 640; ++x) {
+      ASSERT_EQ(16, stretched->GetYPlane()[y * stretched->GetYPitch() + x]);
+    }
+  }
+}
+
 // TODO: Merge this with the LmiVideoFrame test for more test cases
 // when they are supported.
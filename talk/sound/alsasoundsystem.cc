@@ -27,11 +27,23 @@
 
 #include "talk/sound/alsasoundsystem.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
 #include "talk/base/common.h"
+#include "talk/base/criticalsection.h"
 #include "talk/base/logging.h"
+#include "talk/base/messagehandler.h"
 #include "talk/base/scoped_ptr.h"
+#include "talk/base/socketserver.h"
 #include "talk/base/stringutils.h"
-#include "talk/base/worker.h"
+#include "talk/base/thread.h"
+#include "talk/base/time.h"
 #include "talk/sound/sounddevicelocator.h"
 #include "talk/sound/soundinputstreaminterface.h"
 #include "talk/sound/soundoutputstreaminterface.h"
@@ -85,6 +97,214 @@ class AlsaDeviceLocator : public SoundDeviceLocator {
   }
 };
 
+// Interface for the streams serviced by an AlsaPollServer. All methods are
+// called on the I/O thread.
+class AlsaPollClient {
+ public:
+  virtual ~AlsaPollClient() {}
+
+  // Returns how many poll descriptors GetPollDescriptors() will fill in.
+  virtual int PollDescriptorsCount() = 0;
+  // Fills in up to "space" poll descriptors and returns the number filled in.
+  virtual int GetPollDescriptors(struct pollfd *fds, unsigned int space) = 0;
+  // How long we may go without activity before the stream is considered
+  // stalled.
+  virtual int WaitTimeoutMs() = 0;
+  // How long the client's descriptors should be left out of poll(), because
+  // its last wake-up made no progress, or 0 to poll them now.
+  virtual int StarvedDelayMs() = 0;
+  // Called when poll() has reported activity on the client's descriptors.
+  virtual void OnPollEvents(struct pollfd *fds, unsigned int nfds) = 0;
+};
+
+enum {
+  MSG_POLL_ADD = 0,
+  MSG_POLL_REMOVE,
+};
+
+// A SocketServer that waits on the poll descriptors of every running
+// AlsaPollClient, so that a single thread can service any number of streams
+// and wake up exactly when a period is ready. WakeUp() uses the same
+// self-pipe scheme as PhysicalSocketServer's EventDispatcher.
+class AlsaPollServer :
+    public talk_base::SocketServer,
+    public talk_base::MessageHandler {
+ public:
+  AlsaPollServer() : signaled_(false) {
+    wakeup_fds_[0] = wakeup_fds_[1] = -1;
+  }
+
+  virtual ~AlsaPollServer() {
+    ASSERT(clients_.empty());
+    if (wakeup_fds_[0] != -1) {
+      close(wakeup_fds_[0]);
+      close(wakeup_fds_[1]);
+    }
+  }
+
+  bool Initialize() {
+    if (pipe(wakeup_fds_) < 0) {
+      LOG_ERR(LS_ERROR) << "pipe()";
+      wakeup_fds_[0] = wakeup_fds_[1] = -1;
+      return false;
+    }
+    fcntl(wakeup_fds_[0], F_SETFL, fcntl(wakeup_fds_[0], F_GETFL) | O_NONBLOCK);
+    return true;
+  }
+
+  // SocketFactory: the I/O thread never creates sockets.
+  virtual talk_base::Socket *CreateSocket(int type) {
+    return NULL;
+  }
+
+  virtual talk_base::AsyncSocket *CreateAsyncSocket(int type) {
+    return NULL;
+  }
+
+  virtual bool Wait(int cms, bool process_io) {
+    // Build the descriptor set from scratch on every pass, since ALSA may
+    // change the descriptors (and requested events) of a PCM as it runs.
+    // These are deliberately locals: a client callback may Send() to another
+    // thread, which re-enters Wait() with process_io == false.
+    std::vector<struct pollfd> fds(1);
+    fds[0].fd = wakeup_fds_[0];
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+
+    std::vector<PollEntry> entries;
+    int timeout = cms;
+    bool stream_timeout = false;
+    if (process_io) {
+      for (ClientList::iterator it = clients_.begin(); it != clients_.end();
+           ++it) {
+        // A starved stream's descriptors would report the same readiness
+        // again straight away, so just wait for it to be resumed.
+        int delay = (*it)->StarvedDelayMs();
+        if (delay > 0) {
+          if (timeout == talk_base::kForever || delay < timeout) {
+            timeout = delay;
+          }
+          continue;
+        }
+
+        int count = (*it)->PollDescriptorsCount();
+        if (count <= 0) {
+          continue;
+        }
+        size_t offset = fds.size();
+        fds.resize(offset + count);
+        int filled = (*it)->GetPollDescriptors(&fds[offset], count);
+        if (filled <= 0) {
+          fds.resize(offset);
+          continue;
+        }
+        fds.resize(offset + filled);
+        entries.push_back(PollEntry(*it, offset, filled));
+
+        int client_timeout = (*it)->WaitTimeoutMs();
+        if (timeout == talk_base::kForever || client_timeout < timeout) {
+          timeout = client_timeout;
+          stream_timeout = true;
+        }
+      }
+    }
+
+    int n = poll(&fds[0], fds.size(), timeout);
+    if (n < 0) {
+      if (errno == EINTR) {
+        return true;
+      }
+      LOG_ERR(LS_ERROR) << "poll()";
+      return false;
+    } else if (n == 0) {
+      if (stream_timeout) {
+        // We set the timeout to twice the requested latency, so continuous
+        // timeouts are indicative of a problem, so log as a warning.
+        LOG(LS_WARNING) << "Timeout while waiting on stream";
+      }
+      return true;
+    }
+
+    if (fds[0].revents & POLLIN) {
+      talk_base::CritScope cs(&crit_);
+      uint8 b[16];
+      while (read(wakeup_fds_[0], b, sizeof(b)) > 0) {}
+      signaled_ = false;
+    }
+
+    for (std::vector<PollEntry>::iterator it = entries.begin();
+         it != entries.end(); ++it) {
+      bool active = false;
+      for (size_t i = it->offset; i < it->offset + it->count; ++i) {
+        if (fds[i].revents) {
+          active = true;
+          break;
+        }
+      }
+      // An earlier callback may have stopped this client.
+      if (active && std::find(clients_.begin(), clients_.end(), it->client) !=
+          clients_.end()) {
+        it->client->OnPollEvents(&fds[it->offset], it->count);
+      }
+    }
+    return true;
+  }
+
+  virtual void WakeUp() {
+    talk_base::CritScope cs(&crit_);
+    if (!signaled_) {
+      const uint8 b[1] = { 0 };
+      if (VERIFY(1 == write(wakeup_fds_[1], b, sizeof(b)))) {
+        signaled_ = true;
+      }
+    }
+  }
+
+  // Inherited from MessageHandler. Runs on the I/O thread.
+  virtual void OnMessage(talk_base::Message *msg) {
+    talk_base::TypedMessageData<AlsaPollClient *> *data =
+        static_cast<talk_base::TypedMessageData<AlsaPollClient *> *>(
+            msg->pdata);
+    AlsaPollClient *client = data->data();
+    ClientList::iterator it =
+        std::find(clients_.begin(), clients_.end(), client);
+    switch (msg->message_id) {
+      case MSG_POLL_ADD:
+        if (it == clients_.end()) {
+          clients_.push_back(client);
+        }
+        break;
+      case MSG_POLL_REMOVE:
+        if (it != clients_.end()) {
+          clients_.erase(it);
+        }
+        break;
+      default:
+        ASSERT(false);
+        break;
+    }
+    delete data;
+  }
+
+ private:
+  typedef std::vector<AlsaPollClient *> ClientList;
+
+  struct PollEntry {
+    PollEntry(AlsaPollClient *c, size_t o, size_t n)
+        : client(c), offset(o), count(n) {}
+    AlsaPollClient *client;
+    size_t offset;
+    size_t count;
+  };
+
+  ClientList clients_;
+  int wakeup_fds_[2];
+  bool signaled_;
+  talk_base::CriticalSection crit_;
+
+  DISALLOW_COPY_AND_ASSIGN(AlsaPollServer);
+};
+
 // Accesses ALSA functions through our late-binding symbol table instead of
 // directly. This way we don't have to link to libasound, which means our binary
 // will load faster and we can run on strange systems that may not have
@@ -106,51 +326,92 @@ class AlsaStream {
         frame_size_(frame_size),
         wait_timeout_ms_(wait_timeout_ms),
         flags_(flags),
-        freq_(freq) {
+        freq_(freq),
+        starved_until_(0) {
   }
 
   ~AlsaStream() {
     Close();
   }
 
-  // Waits for the stream to be ready to accept/return more data, and returns
-  // how much can be written/read, or 0 if we need to Wait() again.
-  snd_pcm_uframes_t Wait() {
-    snd_pcm_sframes_t frames;
-    // Ideally we would not use snd_pcm_wait() and instead hook snd_pcm_poll_*
-    // into PhysicalSocketServer, but PhysicalSocketServer is nasty enough
-    // already and the current clients of SoundSystemInterface do not run
-    // anything else on their worker threads, so snd_pcm_wait() is good enough.
-    frames = LATE(snd_pcm_avail_update)(handle_);
-    if (frames < 0) {
-      LOG(LS_ERROR) << "snd_pcm_avail_update(): " << GetError(frames);
-      Recover(frames);
+  int PollDescriptorsCount() {
+    int count = LATE(snd_pcm_poll_descriptors_count)(handle_);
+    if (count < 0) {
+      LOG(LS_ERROR) << "snd_pcm_poll_descriptors_count(): "
+                    << GetError(count);
+      return 0;
+    }
+    return count;
+  }
+
+  int GetPollDescriptors(struct pollfd *fds, unsigned int space) {
+    int filled = LATE(snd_pcm_poll_descriptors)(handle_, fds, space);
+    if (filled < 0) {
+      LOG(LS_ERROR) << "snd_pcm_poll_descriptors(): " << GetError(filled);
+      return 0;
+    }
+    return filled;
+  }
+
+  int wait_timeout_ms() {
+    return wait_timeout_ms_;
+  }
+
+  // Called when a wake-up made no progress: there was nothing to read, or
+  // nothing to play. The device stays ready, so rather than spin in poll()
+  // we leave it alone for half the requested latency (a quarter of the wait
+  // timeout), or until Resume().
+  void Starve() {
+    talk_base::CritScope cs(&crit_);
+    starved_until_ =
+        talk_base::Time() + talk_base::_max(wait_timeout_ms_ / 4, 1);
+  }
+
+  // Returns whether the stream was starved. May be called from any thread.
+  bool Resume() {
+    talk_base::CritScope cs(&crit_);
+    bool starved = (starved_until_ != 0);
+    starved_until_ = 0;
+    return starved;
+  }
+
+  int StarvedDelayMs() {
+    talk_base::CritScope cs(&crit_);
+    if (starved_until_ == 0) {
+      return 0;
+    }
+    int delay = talk_base::TimeUntil(starved_until_);
+    if (delay <= 0) {
+      starved_until_ = 0;
       return 0;
-    } else if (frames > 0) {
-      // Already ready, so no need to wait.
-      return frames;
-    }
-    // Else no space/data available, so must wait.
-    int ready = LATE(snd_pcm_wait)(handle_, wait_timeout_ms_);
-    if (ready < 0) {
-      LOG(LS_ERROR) << "snd_pcm_wait(): " << GetError(ready);
-      Recover(ready);
+    }
+    return delay;
+  }
+
+  // Called once poll() has reported activity on our descriptors. Returns how
+  // much can be written/read, or 0 if we need to wait again.
+  snd_pcm_uframes_t Ready(struct pollfd *fds, unsigned int nfds) {
+    unsigned short revents = 0;
+    int err = LATE(snd_pcm_poll_descriptors_revents)(handle_, fds, nfds,
+                                                     &revents);
+    if (err < 0) {
+      LOG(LS_ERROR) << "snd_pcm_poll_descriptors_revents(): "
+                    << GetError(err);
       return 0;
-    } else if (ready == 0) {
-      // Timeout, so nothing can be written/read right now.
-      // We set the timeout to twice the requested latency, so continuous
-      // timeouts are indicative of a problem, so log as a warning.
-      LOG(LS_WARNING) << "Timeout while waiting on stream";
+    }
+    if (!(revents & (POLLIN | POLLOUT | POLLERR))) {
+      // Activity on a descriptor that ALSA doesn't consider a wake-up.
       return 0;
     }
-    // Else ready > 0 (i.e., 1), so it's ready. Get count.
-    frames = LATE(snd_pcm_avail_update)(handle_);
+    // On POLLERR the stream is in an xrun or suspended, which
+    // snd_pcm_avail_update() reports so that we can recover.
+    snd_pcm_sframes_t frames = LATE(snd_pcm_avail_update)(handle_);
     if (frames < 0) {
       LOG(LS_ERROR) << "snd_pcm_avail_update(): " << GetError(frames);
       Recover(frames);
       return 0;
     } else if (frames == 0) {
-      // wait() said we were ready, so this ought to have been positive. Has
+      // poll() said we were ready, so this ought to have been positive. Has
       // been observed to happen in practice though.
       LOG(LS_WARNING) << "Spurious wake-up";
     }
@@ -246,6 +507,9 @@ class AlsaStream {
   int wait_timeout_ms_;
   int flags_;
   int freq_;
+  talk_base::CriticalSection crit_;
+  // Set on the I/O thread, cleared from any thread by Resume().
+  uint32 starved_until_;
 
   DISALLOW_COPY_AND_ASSIGN(AlsaStream);
 };
@@ -259,7 +523,7 @@ class AlsaStream {
 // thread-safety.
 class AlsaInputStream :
     public SoundInputStreamInterface,
-    private talk_base::Worker {
+    private AlsaPollClient {
  public:
   AlsaInputStream(AlsaSoundSystem *alsa,
                   snd_pcm_t *handle,
@@ -278,11 +542,11 @@ class AlsaInputStream :
   }
 
   virtual bool StartReading() {
-    return StartWork();
+    return stream_.alsa()->StartPolling(this);
   }
 
   virtual bool StopReading() {
-    return StopWork();
+    return stream_.alsa()->StopPolling(this);
   }
 
   virtual bool GetVolume(int *volume) {
@@ -304,49 +568,100 @@ class AlsaInputStream :
   }
 
  private:
-  // Inherited from Worker.
-  virtual void OnStart() {
-    HaveWork();
-  }
-
-  // Inherited from Worker.
-  virtual void OnHaveWork() {
-    // Block waiting for data.
-    snd_pcm_uframes_t avail = stream_.Wait();
-    if (avail > 0) {
-      // Data is available.
-      size_t size = avail * stream_.frame_size();
-      if (size > buffer_size_) {
-        // Must increase buffer size.
-        buffer_.reset(new char[size]);
-        buffer_size_ = size;
+  // Inherited from AlsaPollClient.
+  virtual int PollDescriptorsCount() {
+    return stream_.PollDescriptorsCount();
+  }
+
+  // Inherited from AlsaPollClient.
+  virtual int GetPollDescriptors(struct pollfd *fds, unsigned int space) {
+    return stream_.GetPollDescriptors(fds, space);
+  }
+
+  // Inherited from AlsaPollClient.
+  virtual int WaitTimeoutMs() {
+    return stream_.wait_timeout_ms();
+  }
+
+  // Inherited from AlsaPollClient.
+  virtual int StarvedDelayMs() {
+    return stream_.StarvedDelayMs();
+  }
+
+  // Inherited from AlsaPollClient.
+  virtual void OnPollEvents(struct pollfd *fds, unsigned int nfds) {
+    snd_pcm_uframes_t avail = stream_.Ready(fds, nfds);
+    if (avail == 0) {
+      stream_.Starve();
+      return;
+    }
+    // Data is available.
+    PcmRingBuffer *ring = ring_buffer();
+    if (ring) {
+      ReadIntoRingBuffer(ring, avail);
+      return;
+    }
+    snd_pcm_sframes_t read = ReadIntoBuffer(avail);
+    if (read > 0) {
+      // Got data. Pass it off to the app.
+      SignalSamplesRead(buffer_.get(),
+                        read * stream_.frame_size(),
+                        this);
+    }
+  }
+
+  // Reads straight into the ring buffer's free space, so that the samples are
+  // not copied again on their way to the consumer.
+  void ReadIntoRingBuffer(PcmRingBuffer *ring, snd_pcm_uframes_t avail) {
+    size_t size;
+    // Counts an overrun if the consumer has fallen behind completely.
+    void *dest = ring->GetWriteBuffer(&size);
+    while (avail > 0) {
+      if (!dest) {
+        // Drain the device anyway so that it doesn't overrun too, dropping
+        // the samples.
+        ReadIntoBuffer(avail);
+        return;
       }
-      // Read all the data.
-      snd_pcm_sframes_t read = LATE(snd_pcm_readi)(stream_.handle(),
-                                                   buffer_.get(),
-                                                   avail);
-      if (read < 0) {
-        LOG(LS_ERROR) << "snd_pcm_readi(): " << GetError(read);
-        stream_.Recover(read);
-      } else if (read == 0) {
-        // Docs say this shouldn't happen.
-        ASSERT(false);
-        LOG(LS_ERROR) << "No data?";
-      } else {
-        // Got data. Pass it off to the app.
-        SignalSamplesRead(buffer_.get(),
-                          read * stream_.frame_size(),
-                          this);
+      snd_pcm_uframes_t frames = talk_base::_min<snd_pcm_uframes_t>(
+          avail, size / stream_.frame_size());
+      snd_pcm_sframes_t read = ReadFrames(dest, frames);
+      if (read <= 0) {
+        return;
       }
+      ring->CommitWrite(read * stream_.frame_size());
+      avail -= read;
+      dest = ring->GetWriteBuffer(&size);
     }
-    // Check for more data with no delay, after any pending messages are
-    // dispatched.
-    HaveWork();
   }
 
-  // Inherited from Worker.
-  virtual void OnStop() {
-    // Nothing to do.
+  // Reads up to "avail" frames into buffer_, growing it as needed.
+  snd_pcm_sframes_t ReadIntoBuffer(snd_pcm_uframes_t avail) {
+    size_t size = avail * stream_.frame_size();
+    if (size > buffer_size_) {
+      // Must increase buffer size.
+      buffer_.reset(new char[size]);
+      buffer_size_ = size;
+    }
+    return ReadFrames(buffer_.get(), avail);
+  }
+
+  // Reads all of "frames" into "dest". Returns the number of frames read, or
+  // 0 if there was an error.
+  snd_pcm_sframes_t ReadFrames(void *dest, snd_pcm_uframes_t frames) {
+    snd_pcm_sframes_t read = LATE(snd_pcm_readi)(stream_.handle(),
+                                                 dest,
+                                                 frames);
+    if (read < 0) {
+      LOG(LS_ERROR) << "snd_pcm_readi(): " << GetError(read);
+      stream_.Recover(read);
+      return 0;
+    } else if (read == 0) {
+      // Docs say this shouldn't happen.
+      ASSERT(false);
+      LOG(LS_ERROR) << "No data?";
+    }
+    return read;
   }
 
   const char *GetError(int err) {
@@ -364,7 +679,8 @@ class AlsaInputStream :
 // regarding thread-safety.
 class AlsaOutputStream :
     public SoundOutputStreamInterface,
-    private talk_base::Worker {
+    public sigslot::has_slots<>,
+    private AlsaPollClient {
  public:
   AlsaOutputStream(AlsaSoundSystem *alsa,
                    snd_pcm_t *handle,
@@ -372,7 +688,8 @@ class AlsaOutputStream :
                    int wait_timeout_ms,
                    int flags,
                    int freq)
-      : stream_(alsa, handle, frame_size, wait_timeout_ms, flags, freq) {
+      : stream_(alsa, handle, frame_size, wait_timeout_ms, flags, freq),
+        wrote_(false) {
   }
 
   virtual ~AlsaOutputStream() {
@@ -382,11 +699,20 @@ class AlsaOutputStream :
   }
 
   virtual bool EnableBufferMonitoring() {
-    return StartWork();
+    PcmRingBuffer *ring = ring_buffer();
+    if (ring) {
+      ring->SignalDataAvailable.connect(
+          this, &AlsaOutputStream::OnDataAvailable);
+    }
+    return stream_.alsa()->StartPolling(this);
   }
 
   virtual bool DisableBufferMonitoring() {
-    return StopWork();
+    PcmRingBuffer *ring = ring_buffer();
+    if (ring) {
+      ring->SignalDataAvailable.disconnect(this);
+    }
+    return stream_.alsa()->StopPolling(this);
   }
 
   virtual bool WriteSamples(const void *sample_data,
@@ -403,6 +729,17 @@ class AlsaOutputStream :
     snd_pcm_sframes_t written = LATE(snd_pcm_writei)(stream_.handle(),
                                                      sample_data,
                                                      frames);
+    if (written > 0) {
+      {
+        talk_base::CritScope cs(&crit_);
+        wrote_ = true;
+      }
+      // There is data again, so there is no point in waiting out the rest
+      // of the delay before telling the application about more space.
+      if (stream_.Resume()) {
+        stream_.alsa()->WakeUpPolling();
+      }
+    }
     if (written < 0) {
       LOG(LS_ERROR) << "snd_pcm_writei(): " << GetError(written);
       stream_.Recover(written);
@@ -435,24 +772,98 @@ class AlsaOutputStream :
   }
 
  private:
-  // Inherited from Worker.
-  virtual void OnStart() {
-    HaveWork();
+  // Inherited from AlsaPollClient.
+  virtual int PollDescriptorsCount() {
+    return stream_.PollDescriptorsCount();
+  }
+
+  // Inherited from AlsaPollClient.
+  virtual int GetPollDescriptors(struct pollfd *fds, unsigned int space) {
+    return stream_.GetPollDescriptors(fds, space);
   }
 
-  // Inherited from Worker.
-  virtual void OnHaveWork() {
-    snd_pcm_uframes_t avail = stream_.Wait();
-    if (avail > 0) {
+  // Inherited from AlsaPollClient.
+  virtual int WaitTimeoutMs() {
+    return stream_.wait_timeout_ms();
+  }
+
+  // Inherited from AlsaPollClient.
+  virtual int StarvedDelayMs() {
+    return stream_.StarvedDelayMs();
+  }
+
+  // Inherited from AlsaPollClient.
+  virtual void OnPollEvents(struct pollfd *fds, unsigned int nfds) {
+    snd_pcm_uframes_t avail = stream_.Ready(fds, nfds);
+    if (avail == 0) {
+      stream_.Starve();
+      return;
+    }
+    {
+      talk_base::CritScope cs(&crit_);
+      wrote_ = false;
+    }
+    PcmRingBuffer *ring = ring_buffer();
+    if (ring) {
+      WriteFromRingBuffer(ring, avail);
+    } else {
       size_t space = avail * stream_.frame_size();
       SignalBufferSpace(space, this);
     }
-    HaveWork();
+    bool wrote;
+    {
+      talk_base::CritScope cs(&crit_);
+      wrote = wrote_;
+    }
+    if (!wrote) {
+      // Nothing to play, and the device will keep reporting that it has
+      // space for it.
+      stream_.Starve();
+      // The producer may have filled the ring between our read and
+      // Starve(), in which case its OnDataAvailable() found nothing to
+      // resume.
+      if (ring && ring->GetReadAvailable() > 0) {
+        stream_.Resume();
+      }
+    }
   }
 
-  // Inherited from Worker.
-  virtual void OnStop() {
-    // Nothing to do.
+  // Called on the producer's thread when it writes into an empty ring.
+  void OnDataAvailable(PcmRingBuffer *ring) {
+    if (stream_.Resume()) {
+      stream_.alsa()->WakeUpPolling();
+    }
+  }
+
+  // Writes straight out of the ring buffer's pending data, so that the
+  // samples are not copied again on their way to the device.
+  void WriteFromRingBuffer(PcmRingBuffer *ring, snd_pcm_uframes_t avail) {
+    size_t size;
+    // Counts an underrun if there is nothing at all to play.
+    const void *data = ring->GetReadData(&size);
+    while (data && avail > 0) {
+      snd_pcm_uframes_t frames = talk_base::_min<snd_pcm_uframes_t>(
+          avail, size / stream_.frame_size());
+      snd_pcm_sframes_t written = LATE(snd_pcm_writei)(stream_.handle(),
+                                                       data,
+                                                       frames);
+      if (written < 0) {
+        LOG(LS_ERROR) << "snd_pcm_writei(): " << GetError(written);
+        stream_.Recover(written);
+        return;
+      }
+      if (written > 0) {
+        talk_base::CritScope cs(&crit_);
+        wrote_ = true;
+      }
+      ring->ConsumeRead(written * stream_.frame_size());
+      avail -= written;
+      if (static_cast<snd_pcm_uframes_t>(written) < frames ||
+          ring->GetReadAvailable() == 0) {
+        return;
+      }
+      data = ring->GetReadData(&size);
+    }
   }
 
   const char *GetError(int err) {
@@ -460,6 +871,10 @@ class AlsaOutputStream :
   }
 
   AlsaStream stream_;
+  talk_base::CriticalSection crit_;
+  // Whether anything was written since the last wake-up. WriteSamples() may
+  // be called from the application's thread while not monitoring.
+  bool wrote_;
 
   DISALLOW_COPY_AND_ASSIGN(AlsaOutputStream);
 };
@@ -471,8 +886,11 @@ class AlsaOutputStream :
 AlsaSoundSystem::AlsaSoundSystem() : initialized_(false) {}
 
 AlsaSoundSystem::~AlsaSoundSystem() {
-  // Not really necessary, because Terminate() doesn't really do anything.
   Terminate();
+  // All streams must have been closed by now, so nothing is left for the I/O
+  // thread to service.
+  io_thread_.reset();
+  poll_server_.reset();
 }
 
 bool AlsaSoundSystem::Init() {
@@ -487,6 +905,23 @@ bool AlsaSoundSystem::Init() {
     return false;
   }
 
+  if (!io_thread_.get()) {
+    talk_base::scoped_ptr<AlsaPollServer> server(new AlsaPollServer());
+    if (!server->Initialize()) {
+      LOG(LS_ERROR) << "Failed to create poll server";
+      return false;
+    }
+    talk_base::scoped_ptr<talk_base::Thread> thread(
+        new talk_base::Thread(server.get()));
+    thread->SetName("AlsaSoundSystem", this);
+    if (!thread->Start()) {
+      LOG(LS_ERROR) << "Failed to start I/O thread";
+      return false;
+    }
+    poll_server_.reset(server.release());
+    io_thread_.reset(thread.release());
+  }
+
   initialized_ = true;
 
   return true;
@@ -499,8 +934,8 @@ void AlsaSoundSystem::Terminate() {
 
   initialized_ = false;
 
-  // We do not unload the symbol table because we may need it again soon if
-  // Init() is called again.
+  // We do not unload the symbol table or stop the I/O thread because we may
+  // need them again soon if Init() is called again.
 }
 
 bool AlsaSoundSystem::EnumeratePlaybackDevices(
@@ -755,8 +1190,8 @@ SoundInputStreamInterface *AlsaSoundSystem::StartInputStream(
     int flags,
     int freq) {
   // Output streams start automatically once enough data has been written, but
-  // input streams must be started manually or else snd_pcm_wait() will never
-  // return true.
+  // input streams must be started manually or else poll() will never report
+  // them as readable.
   int err;
   err = LATE(snd_pcm_start)(handle);
   if (err != 0) {
@@ -767,6 +1202,34 @@ SoundInputStreamInterface *AlsaSoundSystem::StartInputStream(
       this, handle, frame_size, wait_timeout_ms, flags, freq);
 }
 
+bool AlsaSoundSystem::StartPolling(AlsaPollClient *client) {
+  // Without a running I/O thread nothing would ever service the stream.
+  if (!io_thread_.get() || !io_thread_->started()) {
+    LOG(LS_ERROR) << "No I/O thread to poll on";
+    return false;
+  }
+  io_thread_->Send(poll_server_.get(), MSG_POLL_ADD,
+                   new talk_base::TypedMessageData<AlsaPollClient *>(client));
+  return true;
+}
+
+bool AlsaSoundSystem::StopPolling(AlsaPollClient *client) {
+  if (!io_thread_.get()) {
+    return true;
+  }
+  // Send() is synchronous, so the client is never called back once this
+  // returns (and is run inline if we are already on the I/O thread).
+  io_thread_->Send(poll_server_.get(), MSG_POLL_REMOVE,
+                   new talk_base::TypedMessageData<AlsaPollClient *>(client));
+  return true;
+}
+
+void AlsaSoundSystem::WakeUpPolling() {
+  if (poll_server_.get()) {
+    poll_server_->WakeUp();
+  }
+}
+
 inline const char *AlsaSoundSystem::GetError(int err) {
   return LATE(snd_strerror)(err);
 }
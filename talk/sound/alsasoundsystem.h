@@ -31,17 +31,27 @@
 #include <alsa/asoundlib.h>
 
 #include "talk/base/constructormagic.h"
+#include "talk/base/scoped_ptr.h"
 #include "talk/sound/alsasymboltable.h"
 #include "talk/sound/soundsysteminterface.h"
 
+namespace talk_base {
+class Thread;
+}
+
 namespace cricket {
 
+class AlsaPollClient;
+class AlsaPollServer;
 class AlsaStream;
 class AlsaInputStream;
 class AlsaOutputStream;
 
 // Sound system implementation for ALSA, the predominant sound device API on
 // Linux (but typically not used directly by applications anymore).
+// All streams opened through one AlsaSoundSystem are serviced by a single
+// I/O thread that poll()s on their PCM descriptors, so SignalSamplesRead and
+// SignalBufferSpace are raised on that thread.
 class AlsaSoundSystem : public SoundSystemInterface {
   friend class AlsaStream;
   friend class AlsaInputStream;
@@ -109,10 +119,22 @@ class AlsaSoundSystem : public SoundSystemInterface {
       int flags,
       int freq);
 
+  // Begins/ends servicing the given stream on the I/O thread. These may be
+  // called from any thread; once StopPolling() returns the stream will not be
+  // called back again.
+  bool StartPolling(AlsaPollClient *client);
+  bool StopPolling(AlsaPollClient *client);
+  // Makes the I/O thread look at its streams again, e.g. because one that
+  // was starved has new data. May be called from any thread.
+  void WakeUpPolling();
+
   const char *GetError(int err);
 
   bool initialized_;
   AlsaSymbolTable symbol_table_;
+  // The I/O thread must be destroyed before the server it runs on.
+  talk_base::scoped_ptr<AlsaPollServer> poll_server_;
+  talk_base::scoped_ptr<talk_base::Thread> io_thread_;
 
   DISALLOW_COPY_AND_ASSIGN(AlsaSoundSystem);
 };
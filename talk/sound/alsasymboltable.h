@@ -44,13 +44,15 @@ namespace cricket {
   X(snd_pcm_delay) \
   X(snd_pcm_drop) \
   X(snd_pcm_open) \
+  X(snd_pcm_poll_descriptors) \
+  X(snd_pcm_poll_descriptors_count) \
+  X(snd_pcm_poll_descriptors_revents) \
   X(snd_pcm_prepare) \
   X(snd_pcm_readi) \
   X(snd_pcm_recover) \
   X(snd_pcm_set_params) \
   X(snd_pcm_start) \
   X(snd_pcm_stream) \
-  X(snd_pcm_wait) \
   X(snd_pcm_writei) \
   X(snd_strerror)
 
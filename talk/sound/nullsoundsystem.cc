@@ -80,13 +80,25 @@ class NullSoundInputStream : public SoundInputStreamInterface {
   }
 };
 
-class NullSoundOutputStream : public SoundOutputStreamInterface {
+// With a ring buffer attached, plays (that is, drops) whatever is queued in
+// it as soon as it is written, like a device that never runs out of space.
+class NullSoundOutputStream : public SoundOutputStreamInterface,
+                              public sigslot::has_slots<> {
  public:
   virtual bool EnableBufferMonitoring() {
+    PcmRingBuffer *ring = ring_buffer();
+    if (ring) {
+      ring->SignalDataAvailable.connect(
+          this, &NullSoundOutputStream::OnDataAvailable);
+    }
     return true;
   }
 
   virtual bool DisableBufferMonitoring() {
+    PcmRingBuffer *ring = ring_buffer();
+    if (ring) {
+      ring->SignalDataAvailable.disconnect(this);
+    }
     return true;
   }
 
@@ -112,6 +124,11 @@ class NullSoundOutputStream : public SoundOutputStreamInterface {
   virtual int LatencyUsecs() {
     return 0;
   }
+
+ private:
+  void OnDataAvailable(PcmRingBuffer *ring) {
+    NotifyBufferSpace(ring->GetReadAvailable());
+  }
 };
 
 NullSoundSystem::~NullSoundSystem() {
@@ -0,0 +1,301 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "talk/sound/pcmkernels.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "talk/base/common.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PCM_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace cricket {
+
+// Filter length of each resampler phase. Must be a multiple of 8 for the
+// SSE2 dot product.
+static const int kResamplerTaps = 16;
+// Fixed-point precision of the resampler coefficients.
+static const int kCoefficientBits = 14;
+
+static const float kS16ToFloat = 1.0f / 32768.0f;
+static const float kFloatToS16 = 32768.0f;
+
+static inline int16 SaturateToS16(int32 value) {
+  if (value > 32767) {
+    return 32767;
+  } else if (value < -32768) {
+    return -32768;
+  }
+  return static_cast<int16>(value);
+}
+
+void S16ToFloat(const int16 *src, float *dest, size_t count) {
+  size_t i = 0;
+#ifdef PCM_HAS_SSE2
+  const __m128 scale = _mm_set1_ps(kS16ToFloat);
+  for (; i + 8 <= count; i += 8) {
+    __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    // Sign-extend to 32 bits by unpacking into the high halves and shifting
+    // back down.
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+    _mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+    _mm_storeu_ps(dest + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+  }
+#endif
+  for (; i < count; ++i) {
+    dest[i] = src[i] * kS16ToFloat;
+  }
+}
+
+void FloatToS16(const float *src, int16 *dest, size_t count) {
+  size_t i = 0;
+#ifdef PCM_HAS_SSE2
+  const __m128 scale = _mm_set1_ps(kFloatToS16);
+  const __m128 max = _mm_set1_ps(32767.0f);
+  const __m128 min = _mm_set1_ps(-32768.0f);
+  for (; i + 8 <= count; i += 8) {
+    // Clamp before converting: cvtps turns anything outside the int32 range
+    // into 0x80000000, which would pack to -32768 even for large positive
+    // samples.
+    __m128 flo = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+    __m128 fhi = _mm_mul_ps(_mm_loadu_ps(src + i + 4), scale);
+    __m128i lo = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(flo, min), max));
+    __m128i hi = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(fhi, min), max));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i),
+                     _mm_packs_epi32(lo, hi));
+  }
+#endif
+  for (; i < count; ++i) {
+    float value = src[i] * kFloatToS16;
+    if (value >= 32767.0f) {
+      dest[i] = 32767;
+    } else if (value <= -32768.0f) {
+      dest[i] = -32768;
+    } else {
+      // Round half to even, like cvtps does in the default rounding mode.
+      float rounded = floorf(value + 0.5f);
+      if (rounded - value == 0.5f && fmodf(rounded, 2.0f) != 0.0f) {
+        rounded -= 1.0f;
+      }
+      dest[i] = static_cast<int16>(rounded);
+    }
+  }
+}
+
+void MonoToStereo(const int16 *src, int16 *dest, size_t frames) {
+  size_t i = 0;
+#ifdef PCM_HAS_SSE2
+  for (; i + 8 <= frames; i += 8) {
+    __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + 2 * i),
+                     _mm_unpacklo_epi16(s, s));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + 2 * i + 8),
+                     _mm_unpackhi_epi16(s, s));
+  }
+#endif
+  for (; i < frames; ++i) {
+    dest[2 * i] = dest[2 * i + 1] = src[i];
+  }
+}
+
+void StereoToMono(const int16 *src, int16 *dest, size_t frames) {
+  size_t i = 0;
+#ifdef PCM_HAS_SSE2
+  const __m128i ones = _mm_set1_epi16(1);
+  for (; i + 8 <= frames; i += 8) {
+    // madd against ones sums each left/right pair into 32 bits.
+    __m128i lo = _mm_madd_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i)), ones);
+    __m128i hi = _mm_madd_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i + 8)),
+        ones);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i),
+                     _mm_packs_epi32(_mm_srai_epi32(lo, 1),
+                                     _mm_srai_epi32(hi, 1)));
+  }
+#endif
+  for (; i < frames; ++i) {
+    dest[i] = static_cast<int16>((src[2 * i] + src[2 * i + 1]) >> 1);
+  }
+}
+
+void MixS16(const int16 *const *sources, size_t num_sources, int16 *dest,
+            size_t count) {
+  if (num_sources == 0) {
+    memset(dest, 0, count * sizeof(int16));
+    return;
+  }
+  size_t i = 0;
+#ifdef PCM_HAS_SSE2
+  for (; i + 8 <= count; i += 8) {
+    __m128i sum = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(sources[0] + i));
+    for (size_t j = 1; j < num_sources; ++j) {
+      sum = _mm_adds_epi16(sum, _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(sources[j] + i)));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i), sum);
+  }
+#endif
+  for (; i < count; ++i) {
+    // Saturate after every addition, like the SIMD version does.
+    int16 sum = sources[0][i];
+    for (size_t j = 1; j < num_sources; ++j) {
+      sum = SaturateToS16(sum + sources[j][i]);
+    }
+    dest[i] = sum;
+  }
+}
+
+// Returns the kResamplerTaps-long dot product of "samples" and
+// "coefficients", scaled back down from the coefficients' fixed point.
+static inline int16 DotProduct(const int16 *samples,
+                               const int16 *coefficients) {
+#ifdef PCM_HAS_SSE2
+  __m128i sum = _mm_setzero_si128();
+  for (int i = 0; i < kResamplerTaps; i += 8) {
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + i)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(coefficients + i))));
+  }
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  int32 total = _mm_cvtsi128_si32(sum);
+#else
+  int32 total = 0;
+  for (int i = 0; i < kResamplerTaps; ++i) {
+    total += samples[i] * coefficients[i];
+  }
+#endif
+  return SaturateToS16((total + (1 << (kCoefficientBits - 1))) >>
+                       kCoefficientBits);
+}
+
+static int GreatestCommonDivisor(int a, int b) {
+  while (b != 0) {
+    int t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+PcmResampler::PcmResampler(int in_rate, int out_rate, int channels)
+    : in_rate_(in_rate),
+      out_rate_(out_rate),
+      channels_(channels),
+      position_(0),
+      history_(channels) {
+  ASSERT(in_rate > 0 && out_rate > 0 && channels > 0);
+  int gcd = GreatestCommonDivisor(in_rate, out_rate);
+  up_ = out_rate / gcd;
+  down_ = in_rate / gcd;
+
+  // Design a windowed-sinc low-pass at the upsampled rate. When downsampling
+  // the cutoff moves down to the output's Nyquist frequency.
+  const double kPi = 3.14159265358979323846;
+  int length = up_ * kResamplerTaps;
+  double cutoff = talk_base::_min(1.0, static_cast<double>(up_) / down_);
+  double center = (length - 1) / 2.0;
+  std::vector<double> prototype(length);
+  double sum = 0.0;
+  for (int n = 0; n < length; ++n) {
+    double x = (n - center) * cutoff / up_;
+    double sinc = (x == 0.0) ? 1.0 : sin(kPi * x) / (kPi * x);
+    // Blackman window.
+    double phase = 2.0 * kPi * n / (length - 1);
+    double window = 0.42 - 0.5 * cos(phase) + 0.08 * cos(2.0 * phase);
+    prototype[n] = sinc * window;
+    sum += prototype[n];
+  }
+
+  // Split into phases, normalized to unity gain. Each row is stored reversed
+  // so that the filter is a plain dot product over the input history.
+  double scale = up_ * (1 << kCoefficientBits) / sum;
+  coefficients_.resize(length);
+  for (int phase = 0; phase < up_; ++phase) {
+    for (int k = 0; k < kResamplerTaps; ++k) {
+      double value = prototype[phase + (kResamplerTaps - 1 - k) * up_];
+      coefficients_[phase * kResamplerTaps + k] =
+          SaturateToS16(static_cast<int32>(floor(value * scale + 0.5)));
+    }
+  }
+  Reset();
+}
+
+size_t PcmResampler::MaxOutputFrames(size_t in_frames) const {
+  return (in_frames * up_ + down_ - 1) / down_;
+}
+
+void PcmResampler::Reset() {
+  for (int ch = 0; ch < channels_; ++ch) {
+    history_[ch].assign(kResamplerTaps - 1, 0);
+  }
+  position_ = (kResamplerTaps - 1) * up_;
+}
+
+size_t PcmResampler::Resample(const int16 *src, size_t in_frames,
+                              int16 *dest) {
+  for (int ch = 0; ch < channels_; ++ch) {
+    std::vector<int16> &history = history_[ch];
+    size_t offset = history.size();
+    history.resize(offset + in_frames);
+    for (size_t i = 0; i < in_frames; ++i) {
+      history[offset + i] = src[i * channels_ + ch];
+    }
+  }
+
+  size_t available = history_[0].size();
+  size_t out = 0;
+  for (size_t i = position_ / up_; i < available; i = position_ / up_) {
+    const int16 *coefficients =
+        &coefficients_[(position_ % up_) * kResamplerTaps];
+    for (int ch = 0; ch < channels_; ++ch) {
+      dest[out * channels_ + ch] = DotProduct(
+          &history_[ch][i + 1 - kResamplerTaps], coefficients);
+    }
+    ++out;
+    position_ += down_;
+  }
+
+  // Keep only the input the next output sample still needs.
+  size_t drop = talk_base::_min(position_ / up_ - (kResamplerTaps - 1),
+                                available);
+  for (int ch = 0; ch < channels_; ++ch) {
+    history_[ch].erase(history_[ch].begin(), history_[ch].begin() + drop);
+  }
+  position_ -= drop * up_;
+  return out;
+}
+
+}  // namespace cricket
@@ -0,0 +1,101 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TALK_SOUND_PCMKERNELS_H_
+#define TALK_SOUND_PCMKERNELS_H_
+
+#include <vector>
+
+#include "talk/base/basictypes.h"
+#include "talk/base/constructormagic.h"
+
+// Sample-processing kernels shared by the sound streams and media engines:
+// format conversion, channel conversion, mixing and resampling of
+// interleaved PCM. Each kernel has a portable implementation and, on x86, an
+// SSE2 one; the SSE2 versions are picked automatically and produce the same
+// results (up to rounding, for the float conversions).
+
+namespace cricket {
+
+// Converts "count" samples between 16-bit integer and float in [-1.0, 1.0).
+// Out-of-range floats are clamped.
+void S16ToFloat(const int16 *src, float *dest, size_t count);
+void FloatToS16(const float *src, int16 *dest, size_t count);
+
+// Converts "frames" frames between mono and interleaved stereo. Downmixing
+// averages the two channels.
+void MonoToStereo(const int16 *src, int16 *dest, size_t frames);
+void StereoToMono(const int16 *src, int16 *dest, size_t frames);
+
+// Mixes "num_sources" buffers of "count" samples each into "dest", with
+// saturation. "dest" may be one of the sources.
+void MixS16(const int16 *const *sources, size_t num_sources, int16 *dest,
+            size_t count);
+
+// Converts interleaved 16-bit PCM between two sample rates with a polyphase
+// windowed-sinc filter. State is kept between calls, so a stream can be fed
+// in arbitrary chunks.
+class PcmResampler {
+ public:
+  PcmResampler(int in_rate, int out_rate, int channels);
+
+  int in_rate() const { return in_rate_; }
+  int out_rate() const { return out_rate_; }
+
+  // The most frames Resample() can produce from "in_frames" frames.
+  size_t MaxOutputFrames(size_t in_frames) const;
+
+  // Resamples "in_frames" frames from "src" into "dest", which must have
+  // room for MaxOutputFrames(in_frames) frames. Returns the number of frames
+  // written.
+  size_t Resample(const int16 *src, size_t in_frames, int16 *dest);
+
+  // Forgets all buffered input.
+  void Reset();
+
+ private:
+  int in_rate_;
+  int out_rate_;
+  int channels_;
+  // The conversion ratio in lowest terms: "up" output phases per input
+  // sample, advancing "down" phases per output sample.
+  int up_;
+  int down_;
+  // Position of the next output sample, in phases, relative to the start of
+  // the (per-channel) history.
+  size_t position_;
+  // Filter coefficients, one row of kResamplerTaps per phase.
+  std::vector<int16> coefficients_;
+  // De-interleaved input still needed by the filter, one vector per channel.
+  std::vector<std::vector<int16> > history_;
+
+  DISALLOW_COPY_AND_ASSIGN(PcmResampler);
+};
+
+}  // namespace cricket
+
+#endif  // TALK_SOUND_PCMKERNELS_H_
@@ -0,0 +1,211 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <math.h>
+
+#include <vector>
+
+#include "talk/base/gunit.h"
+#include "talk/base/time.h"
+#include "talk/sound/pcmkernels.h"
+
+using cricket::PcmResampler;
+
+// Odd lengths so that both the vector loops and the scalar tails run.
+static const size_t kCount = 1003;
+
+static void FillRamp(std::vector<int16> *samples) {
+  for (size_t i = 0; i < samples->size(); ++i) {
+    (*samples)[i] = static_cast<int16>((i * 977) % 65536 - 32768);
+  }
+}
+
+TEST(PcmKernelsTest, S16FloatRoundTrip) {
+  std::vector<int16> in(kCount), out(kCount);
+  std::vector<float> f(kCount);
+  FillRamp(&in);
+  cricket::S16ToFloat(&in[0], &f[0], kCount);
+  for (size_t i = 0; i < kCount; ++i) {
+    EXPECT_FLOAT_EQ(in[i] / 32768.0f, f[i]);
+  }
+  cricket::FloatToS16(&f[0], &out[0], kCount);
+  EXPECT_TRUE(in == out);
+}
+
+TEST(PcmKernelsTest, FloatToS16Clamps) {
+  float in[10] = { 1.5f, -1.5f, 1.0f, -1.0f, 0.5f, 1.5f, -1.5f, 1.0f, -1.0f,
+                   2.0f };
+  int16 out[10];
+  cricket::FloatToS16(in, out, 10);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(in[i] >= 1.0f ? 32767 : in[i] <= -1.0f ? -32768 : 16384,
+              out[i]) << i;
+  }
+}
+
+// Converting a whole buffer runs the SSE2 loop where available; converting
+// one sample at a time always runs the scalar code. Both must agree,
+// including for samples far outside [-1, 1] and exact rounding ties.
+TEST(PcmKernelsTest, FloatToS16VectorMatchesScalar) {
+  std::vector<float> in(kCount);
+  for (size_t i = 0; i < kCount; ++i) {
+    switch (i % 8) {
+      case 0: in[i] = 3.0f; break;
+      case 1: in[i] = -3.0f; break;
+      case 2: in[i] = 1.0e9f; break;
+      case 3: in[i] = -1.0e9f; break;
+      case 4: in[i] = (static_cast<float>(i) - 500.0f) / 32768.0f; break;
+      case 5: in[i] = (static_cast<float>(i % 64) - 32.5f) / 32768.0f; break;
+      case 6: in[i] = 32767.5f / 32768.0f; break;
+      case 7: in[i] = sinf(static_cast<float>(i)) * 1.2f; break;
+    }
+  }
+  std::vector<int16> vector_out(kCount), scalar_out(kCount);
+  cricket::FloatToS16(&in[0], &vector_out[0], kCount);
+  for (size_t i = 0; i < kCount; ++i) {
+    cricket::FloatToS16(&in[i], &scalar_out[i], 1);
+  }
+  for (size_t i = 0; i < kCount; ++i) {
+    EXPECT_EQ(scalar_out[i], vector_out[i]) << i << ": " << in[i];
+  }
+  EXPECT_EQ(32767, vector_out[0]);
+  EXPECT_EQ(-32768, vector_out[1]);
+  EXPECT_EQ(32767, vector_out[2]);
+  EXPECT_EQ(-32768, vector_out[3]);
+}
+
+TEST(PcmKernelsTest, ChannelConversion) {
+  std::vector<int16> mono(kCount), stereo(2 * kCount), back(kCount);
+  FillRamp(&mono);
+  cricket::MonoToStereo(&mono[0], &stereo[0], kCount);
+  for (size_t i = 0; i < kCount; ++i) {
+    EXPECT_EQ(mono[i], stereo[2 * i]);
+    EXPECT_EQ(mono[i], stereo[2 * i + 1]);
+  }
+  cricket::StereoToMono(&stereo[0], &back[0], kCount);
+  EXPECT_TRUE(mono == back);
+
+  int16 lr[16] = { 100, 200, -100, -300, 32767, 32767, -32768, -32768,
+                   1, 2, 3, 4, 5, 6, 7, 8 };
+  int16 averaged[8];
+  cricket::StereoToMono(lr, averaged, 8);
+  EXPECT_EQ(150, averaged[0]);
+  EXPECT_EQ(-200, averaged[1]);
+  EXPECT_EQ(32767, averaged[2]);
+  EXPECT_EQ(-32768, averaged[3]);
+}
+
+TEST(PcmKernelsTest, MixSaturates) {
+  std::vector<int16> a(kCount, 20000), b(kCount, 20000), c(kCount, -30000);
+  std::vector<int16> out(kCount);
+  const int16 *sources[] = { &a[0], &b[0], &c[0] };
+  cricket::MixS16(sources, 2, &out[0], kCount);
+  EXPECT_EQ(32767, out[0]);
+  EXPECT_EQ(32767, out[kCount - 1]);
+  cricket::MixS16(sources, 3, &out[0], kCount);
+  // Saturates after the first addition, then adds the third source.
+  EXPECT_EQ(2767, out[0]);
+  EXPECT_EQ(2767, out[kCount - 1]);
+}
+
+// Measures the level of a resampled sine, which should come through a
+// conversion well inside the pass band at unity gain.
+static double ResampledSineGain(int in_rate, int out_rate, int channels) {
+  const double kPi = 3.14159265358979323846;
+  const int kFrames = in_rate / 10;
+  std::vector<int16> in(kFrames * channels);
+  for (int i = 0; i < kFrames; ++i) {
+    for (int ch = 0; ch < channels; ++ch) {
+      in[i * channels + ch] = static_cast<int16>(
+          10000 * sin(2 * kPi * 440 * i / in_rate));
+    }
+  }
+  PcmResampler resampler(in_rate, out_rate, channels);
+  std::vector<int16> out(resampler.MaxOutputFrames(kFrames) * channels);
+  // Feed it in uneven chunks to exercise the buffering.
+  size_t produced = 0;
+  for (int fed = 0; fed < kFrames; ) {
+    int chunk = talk_base::_min(97, kFrames - fed);
+    produced += resampler.Resample(&in[fed * channels], chunk,
+                                   &out[produced * channels]);
+    fed += chunk;
+  }
+  EXPECT_LE(produced, resampler.MaxOutputFrames(kFrames));
+  EXPECT_GE(produced + 16, static_cast<size_t>(kFrames) * out_rate / in_rate);
+
+  // Skip the filter's start-up transient.
+  int16 peak = 0;
+  for (size_t i = out_rate / 100 * channels; i < produced * channels; ++i) {
+    peak = talk_base::_max<int16>(peak, out[i]);
+  }
+  return peak / 10000.0;
+}
+
+TEST(PcmKernelsTest, ResamplerPreservesLevel) {
+  EXPECT_NEAR(1.0, ResampledSineGain(16000, 48000, 1), 0.02);
+  EXPECT_NEAR(1.0, ResampledSineGain(48000, 16000, 1), 0.02);
+  EXPECT_NEAR(1.0, ResampledSineGain(44100, 48000, 2), 0.02);
+  EXPECT_NEAR(1.0, ResampledSineGain(8000, 8000, 2), 0.02);
+}
+
+// Reports throughput of each kernel in samples per second. Disabled by
+// default; run with --gtest_also_run_disabled_tests.
+TEST(PcmKernelsTest, DISABLED_Benchmark) {
+  const size_t kSamples = 48000 * 2 / 100;  // 10 ms of 48 kHz stereo.
+  const int kIterations = 20000;
+  std::vector<int16> s16(kSamples), s16b(kSamples), out(kSamples * 2);
+  std::vector<float> f(kSamples);
+  FillRamp(&s16);
+  FillRamp(&s16b);
+  const int16 *sources[] = { &s16[0], &s16b[0], &s16[0], &s16b[0] };
+  PcmResampler resampler(48000, 44100, 2);
+  std::vector<int16> resampled(
+      resampler.MaxOutputFrames(kSamples / 2) * 2);
+
+  for (int kernel = 0; kernel < 6; ++kernel) {
+    uint32 start = talk_base::Time();
+    for (int i = 0; i < kIterations; ++i) {
+      switch (kernel) {
+        case 0: cricket::S16ToFloat(&s16[0], &f[0], kSamples); break;
+        case 1: cricket::FloatToS16(&f[0], &out[0], kSamples); break;
+        case 2: cricket::MonoToStereo(&s16[0], &out[0], kSamples); break;
+        case 3: cricket::StereoToMono(&s16[0], &out[0], kSamples / 2); break;
+        case 4: cricket::MixS16(sources, 4, &out[0], kSamples); break;
+        case 5: resampler.Resample(&s16[0], kSamples / 2, &resampled[0]);
+                break;
+      }
+    }
+    uint32 elapsed = talk_base::_max<uint32>(1, talk_base::TimeSince(start));
+    static const char *const kNames[] = {
+      "S16ToFloat", "FloatToS16", "MonoToStereo", "StereoToMono", "MixS16 x4",
+      "PcmResampler 48k->44.1k"
+    };
+    LOG(LS_INFO) << kNames[kernel] << ": "
+                 << static_cast<double>(kSamples) * kIterations * 1000 /
+                    elapsed << " samples/sec";
+  }
+}
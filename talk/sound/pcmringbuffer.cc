@@ -0,0 +1,155 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "talk/sound/pcmringbuffer.h"
+
+#include <string.h>
+
+#include "talk/base/common.h"
+#include "talk/base/criticalsection.h"
+#include "talk/base/logging.h"
+
+namespace cricket {
+
+using talk_base::AtomicOps;
+
+// The positions are 32-bit frame counters, which must tell a full buffer from
+// an empty one.
+static const uint32 kMaxCapacityFrames = 1U << 31;
+
+PcmRingBuffer::PcmRingBuffer(size_t frame_size, size_t min_frames)
+    : frame_size_(frame_size),
+      capacity_frames_(1),
+      write_position_(0),
+      overruns_(0),
+      read_position_(0),
+      underruns_(0) {
+  ASSERT(frame_size > 0);
+  if (min_frames > kMaxCapacityFrames) {
+    LOG(LS_WARNING) << "Ring buffer of " << min_frames << " frames requested; "
+                    << "using " << kMaxCapacityFrames;
+    min_frames = kMaxCapacityFrames;
+  }
+  while (capacity_frames_ < min_frames) {
+    capacity_frames_ <<= 1;
+  }
+  buffer_.reset(new char[capacity_frames_ * frame_size_]);
+}
+
+PcmRingBuffer::~PcmRingBuffer() {
+}
+
+size_t PcmRingBuffer::GetWriteSpace() const {
+  uint32 read = AtomicOps::AcquireLoad(&read_position_);
+  return (capacity_frames_ - (write_position_ - read)) * frame_size_;
+}
+
+size_t PcmRingBuffer::GetReadAvailable() const {
+  uint32 write = AtomicOps::AcquireLoad(&write_position_);
+  return (write - read_position_) * frame_size_;
+}
+
+void *PcmRingBuffer::GetWriteBuffer(size_t *size) {
+  size_t space = GetWriteSpace();
+  if (space == 0) {
+    ++overruns_;
+    *size = 0;
+    return NULL;
+  }
+  size_t offset = Offset(write_position_);
+  *size = talk_base::_min(space, capacity() - offset);
+  return &buffer_[offset];
+}
+
+void PcmRingBuffer::CommitWrite(size_t size) {
+  ASSERT(size % frame_size_ == 0);
+  ASSERT(size <= GetWriteSpace());
+  bool was_empty = (AtomicOps::AcquireLoad(&read_position_) == write_position_);
+  AtomicOps::ReleaseStore(&write_position_,
+      static_cast<uint32>(write_position_ + size / frame_size_));
+  if (was_empty && size > 0) {
+    SignalDataAvailable(this);
+  }
+}
+
+size_t PcmRingBuffer::Write(const void *data, size_t size) {
+  ASSERT(size % frame_size_ == 0);
+  const char *src = static_cast<const char *>(data);
+  size_t written = 0;
+  while (written < size) {
+    size_t region;
+    void *dest = GetWriteBuffer(&region);
+    if (!dest) {
+      break;
+    }
+    region = talk_base::_min(region, size - written);
+    memcpy(dest, src + written, region);
+    CommitWrite(region);
+    written += region;
+  }
+  return written;
+}
+
+const void *PcmRingBuffer::GetReadData(size_t *size) {
+  size_t available = GetReadAvailable();
+  if (available == 0) {
+    ++underruns_;
+    *size = 0;
+    return NULL;
+  }
+  size_t offset = Offset(read_position_);
+  *size = talk_base::_min(available, capacity() - offset);
+  return &buffer_[offset];
+}
+
+void PcmRingBuffer::ConsumeRead(size_t size) {
+  ASSERT(size % frame_size_ == 0);
+  ASSERT(size <= GetReadAvailable());
+  AtomicOps::ReleaseStore(&read_position_,
+      static_cast<uint32>(read_position_ + size / frame_size_));
+}
+
+size_t PcmRingBuffer::Read(void *data, size_t size) {
+  ASSERT(size % frame_size_ == 0);
+  char *dest = static_cast<char *>(data);
+  size_t read = 0;
+  while (read < size) {
+    size_t region;
+    const void *src = GetReadData(&region);
+    if (!src) {
+      memset(dest + read, 0, size - read);
+      break;
+    }
+    region = talk_base::_min(region, size - read);
+    memcpy(dest + read, src, region);
+    ConsumeRead(region);
+    read += region;
+  }
+  return read;
+}
+
+}  // namespace cricket
@@ -0,0 +1,116 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TALK_SOUND_PCMRINGBUFFER_H_
+#define TALK_SOUND_PCMRINGBUFFER_H_
+
+#include "talk/base/basictypes.h"
+#include "talk/base/constructormagic.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/base/sigslot.h"
+
+namespace cricket {
+
+// A lock-free ring buffer of interleaved PCM data with exactly one producer
+// thread and one consumer thread, typically a sound system's I/O thread and
+// the media engine's thread. Sound streams with a ring buffer attached write
+// captured samples into it (or drain playback samples from it) directly,
+// instead of handing raw buffers across threads via sigslot.
+//
+// All sizes are in bytes and must be a whole number of frames. The Write*
+// methods may only be called by the producer and the Read* methods only by
+// the consumer; the remaining accessors may be called from either thread but
+// are only approximate when called from the other one.
+class PcmRingBuffer {
+ public:
+  // Creates a buffer holding at least "min_frames" frames of "frame_size"
+  // bytes each. The frame count is rounded up to a power of two, and is at
+  // most 2^31.
+  PcmRingBuffer(size_t frame_size, size_t min_frames);
+  ~PcmRingBuffer();
+
+  size_t frame_size() const { return frame_size_; }
+  size_t capacity() const { return capacity_frames_ * frame_size_; }
+
+  // Amount of data that can currently be written/read.
+  size_t GetWriteSpace() const;
+  size_t GetReadAvailable() const;
+
+  // Producer side. Returns the largest contiguous region that can be written
+  // without wrapping, and sets "size" to its length. Returns NULL and counts
+  // an overrun if the buffer is full. The region is published with
+  // CommitWrite().
+  void *GetWriteBuffer(size_t *size);
+  void CommitWrite(size_t size);
+  // Copies "size" bytes in. Whatever does not fit is dropped and counted as an
+  // overrun, since a capture device cannot be paused. Returns the amount
+  // written.
+  size_t Write(const void *data, size_t size);
+
+  // Consumer side. Returns the largest contiguous region that can be read
+  // without wrapping, and sets "size" to its length. Returns NULL and counts
+  // an underrun if the buffer is empty. The region is released with
+  // ConsumeRead().
+  const void *GetReadData(size_t *size);
+  void ConsumeRead(size_t size);
+  // Copies up to "size" bytes out. If less is available then the remainder of
+  // "data" is filled with silence and an underrun is counted, since a
+  // playback device cannot wait. Returns the amount of real data read.
+  size_t Read(void *data, size_t size);
+
+  // Number of times the producer found the buffer full, or the consumer found
+  // it empty.
+  int overruns() const { return overruns_; }
+  int underruns() const { return underruns_; }
+
+  // Fired on the producer's thread when a write finds the buffer empty, so
+  // that a consumer that stopped looking can be woken up.
+  sigslot::signal1<PcmRingBuffer *> SignalDataAvailable;
+
+ private:
+  // Positions are free-running frame counters; they are reduced modulo the
+  // capacity only when indexing, so that full and empty are distinguishable.
+  size_t Offset(uint32 position) const {
+    return (position & (capacity_frames_ - 1)) * frame_size_;
+  }
+
+  size_t frame_size_;
+  uint32 capacity_frames_;
+  talk_base::scoped_array<char> buffer_;
+  // Written only by the producer.
+  volatile uint32 write_position_;
+  volatile int overruns_;
+  // Written only by the consumer.
+  volatile uint32 read_position_;
+  volatile int underruns_;
+
+  DISALLOW_COPY_AND_ASSIGN(PcmRingBuffer);
+};
+
+}  // namespace cricket
+
+#endif  // TALK_SOUND_PCMRINGBUFFER_H_
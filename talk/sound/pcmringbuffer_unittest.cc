@@ -0,0 +1,200 @@
+/*
+ * libjingle
+ * Copyright 2011, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "talk/base/gunit.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/base/sigslot.h"
+#include "talk/sound/nullsoundsystem.h"
+#include "talk/sound/pcmringbuffer.h"
+#include "talk/sound/sounddevicelocator.h"
+#include "talk/sound/soundoutputstreaminterface.h"
+
+using cricket::PcmRingBuffer;
+
+// 16-bit stereo.
+static const size_t kFrameSize = 4;
+
+TEST(PcmRingBufferTest, RoundsCapacityUpToPowerOfTwo) {
+  PcmRingBuffer buffer(kFrameSize, 100);
+  EXPECT_EQ(128 * kFrameSize, buffer.capacity());
+  EXPECT_EQ(buffer.capacity(), buffer.GetWriteSpace());
+  EXPECT_EQ(0U, buffer.GetReadAvailable());
+}
+
+TEST(PcmRingBufferTest, WriteAndReadAcrossWrap) {
+  PcmRingBuffer buffer(kFrameSize, 4);
+  char in[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+  char out[12];
+
+  EXPECT_EQ(12U, buffer.Write(in, 12));
+  EXPECT_EQ(8U, buffer.Read(out, 8));
+  EXPECT_EQ(0, memcmp(in, out, 8));
+
+  // This write wraps around the end of the storage.
+  EXPECT_EQ(12U, buffer.Write(in, 12));
+  size_t size;
+  const void *data = buffer.GetReadData(&size);
+  ASSERT_TRUE(data != NULL);
+  EXPECT_EQ(8U, size);  // Only up to the end of the storage.
+  EXPECT_EQ(16U, buffer.GetReadAvailable());
+
+  EXPECT_EQ(16U, buffer.Read(out, 4) + buffer.Read(out, 12));
+  EXPECT_EQ(0, memcmp(in, out, 12));
+  EXPECT_EQ(0, buffer.overruns());
+  EXPECT_EQ(0, buffer.underruns());
+}
+
+TEST(PcmRingBufferTest, CountsOverrunsAndUnderruns) {
+  PcmRingBuffer buffer(kFrameSize, 2);
+  char in[12];
+  memset(in, 1, sizeof(in));
+
+  // Only two of the three frames fit.
+  EXPECT_EQ(8U, buffer.Write(in, 12));
+  EXPECT_EQ(1, buffer.overruns());
+
+  // Asking for three frames gets two plus one frame of silence.
+  char out[12];
+  memset(out, 1, sizeof(out));
+  EXPECT_EQ(8U, buffer.Read(out, 12));
+  EXPECT_EQ(1, buffer.underruns());
+  EXPECT_EQ(0, out[8]);
+  EXPECT_EQ(0, out[11]);
+}
+
+// Counts how often the consumer would have been woken up.
+class DataAvailableCounter : public sigslot::has_slots<> {
+ public:
+  DataAvailableCounter() : count_(0) {}
+  void OnDataAvailable(PcmRingBuffer *buffer) { ++count_; }
+  int count() const { return count_; }
+
+ private:
+  int count_;
+};
+
+TEST(PcmRingBufferTest, SignalsOnlyWhenEmptyBufferIsWritten) {
+  PcmRingBuffer buffer(kFrameSize, 4);
+  DataAvailableCounter counter;
+  buffer.SignalDataAvailable.connect(&counter,
+                                     &DataAvailableCounter::OnDataAvailable);
+  char data[8] = { 0 };
+  EXPECT_EQ(8U, buffer.Write(data, 8));
+  EXPECT_EQ(1, counter.count());
+  // The consumer hasn't caught up, so it needs no wake-up.
+  EXPECT_EQ(4U, buffer.Write(data, 4));
+  EXPECT_EQ(1, counter.count());
+  EXPECT_EQ(12U, buffer.Read(data, 8) + buffer.Read(data, 4));
+  EXPECT_EQ(4U, buffer.Write(data, 4));
+  EXPECT_EQ(2, counter.count());
+}
+
+TEST(PcmRingBufferTest, NullSoundSystemDrainsRingBuffer) {
+  cricket::NullSoundSystem sound_system;
+  ASSERT_TRUE(sound_system.Init());
+  cricket::SoundDeviceLocator *device;
+  ASSERT_TRUE(sound_system.GetDefaultPlaybackDevice(&device));
+  cricket::SoundSystemInterface::OpenParams params = {
+    cricket::SoundSystemInterface::FORMAT_S16LE, 16000, 2, 0,
+    cricket::SoundSystemInterface::kNoLatencyRequirements
+  };
+  talk_base::scoped_ptr<cricket::SoundOutputStreamInterface> stream(
+      sound_system.OpenPlaybackDevice(device, params));
+  delete device;
+  ASSERT_TRUE(stream.get() != NULL);
+
+  PcmRingBuffer buffer(kFrameSize, 4);
+  stream->set_ring_buffer(&buffer);
+  ASSERT_TRUE(stream->EnableBufferMonitoring());
+  char data[24] = { 0 };
+  // More than the buffer holds, which only fits because it is played at once.
+  EXPECT_EQ(24U, buffer.Write(data, 24));
+  EXPECT_EQ(0U, buffer.GetReadAvailable());
+  EXPECT_EQ(0, buffer.overruns());
+  EXPECT_EQ(0, buffer.underruns());
+  EXPECT_TRUE(stream->DisableBufferMonitoring());
+}
+
+// Simulates a capture device delivering one period at a time with some
+// scheduling jitter while the media thread consumes a period every period
+// and plays it out through a NullSoundSystem stream. Time is simulated, so
+// the result does not depend on how loaded the machine running the test is.
+TEST(PcmRingBufferTest, AbsorbsJitterWithNullSoundSystem) {
+  const int kPeriodMs = 10;
+  const int kPeriods = 50;
+  const int kMaxJitterMs = 8;
+  const size_t kPeriodSize = 16000 * kPeriodMs / 1000 * kFrameSize;
+
+  cricket::NullSoundSystem sound_system;
+  ASSERT_TRUE(sound_system.Init());
+  cricket::SoundDeviceLocator *device;
+  ASSERT_TRUE(sound_system.GetDefaultPlaybackDevice(&device));
+  cricket::SoundSystemInterface::OpenParams params = {
+    cricket::SoundSystemInterface::FORMAT_S16LE, 16000, 2, 0,
+    cricket::SoundSystemInterface::kNoLatencyRequirements
+  };
+  talk_base::scoped_ptr<cricket::SoundOutputStreamInterface> stream(
+      sound_system.OpenPlaybackDevice(device, params));
+  delete device;
+  ASSERT_TRUE(stream.get() != NULL);
+
+  PcmRingBuffer buffer(kFrameSize, 4 * kPeriodSize / kFrameSize);
+  talk_base::scoped_array<char> in(new char[kPeriodSize]);
+  talk_base::scoped_array<char> out(new char[kPeriodSize]);
+
+  // Period i is due at i * kPeriodMs but arrives up to kMaxJitterMs late.
+  // The consumer starts kMaxJitterMs late so that it never runs dry.
+  int written = 0;
+  int received = 0;
+  int max_jitter = 0;
+  for (int now = 0; received < kPeriods; ++now) {
+    if (written < kPeriods) {
+      int due = written * kPeriodMs;
+      int arrival = due + (written * 7) % (kMaxJitterMs + 1);
+      if (now == arrival) {
+        memset(in.get(), written, kPeriodSize);
+        EXPECT_EQ(kPeriodSize, buffer.Write(in.get(), kPeriodSize));
+        max_jitter = talk_base::_max(max_jitter, abs(arrival - due));
+        ++written;
+      }
+    }
+    if (now == kMaxJitterMs + received * kPeriodMs) {
+      EXPECT_EQ(kPeriodSize, buffer.Read(out.get(), kPeriodSize));
+      EXPECT_EQ(received, out[0]);
+      EXPECT_EQ(received, out[kPeriodSize - 1]);
+      EXPECT_TRUE(stream->WriteSamples(out.get(), kPeriodSize));
+      ++received;
+    }
+  }
+
+  EXPECT_EQ(kMaxJitterMs, max_jitter);
+  EXPECT_EQ(0, buffer.overruns());
+  EXPECT_EQ(0, buffer.underruns());
+}
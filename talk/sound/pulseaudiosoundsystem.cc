@@ -474,9 +474,7 @@ class PulseAudioInputStream :
   // Inherited from Worker.
   virtual void OnHaveWork() {
     ASSERT(temp_sample_data_ && temp_sample_data_size_);
-    SignalSamplesRead(temp_sample_data_,
-                      temp_sample_data_size_,
-                      this);
+    NotifySamplesRead(temp_sample_data_, temp_sample_data_size_);
     temp_sample_data_ = NULL;
     temp_sample_data_size_ = 0;
 
@@ -504,7 +502,7 @@ class PulseAudioInputStream :
 
       // Drop lock for sigslot dispatch, which could take a while.
       Unlock();
-      SignalSamplesRead(sample_data, sample_data_size, this);
+      NotifySamplesRead(sample_data, sample_data_size);
       Lock();
 
       // Return to top of loop for the ack and the check for more data.
@@ -865,7 +863,7 @@ class PulseAudioOutputStream :
   virtual void OnHaveWork() {
     ASSERT(temp_buffer_space_ > 0);
 
-    SignalBufferSpace(temp_buffer_space_, this);
+    NotifyBufferSpace(temp_buffer_space_);
 
     temp_buffer_space_ = 0;
     Lock();
@@ -30,12 +30,15 @@
 
 #include "talk/base/constructormagic.h"
 #include "talk/base/sigslot.h"
+#include "talk/sound/pcmringbuffer.h"
 
 namespace cricket {
 
 // Interface for consuming an input stream from a recording device.
 // Semantics and thread-safety of StartReading()/StopReading() are the same as
-// for talk_base::Worker.
+// for talk_base::Worker, except that implementations which service their
+// streams from a shared I/O thread (e.g., ALSA) fire SignalSamplesRead on that
+// thread, which then is the "reading thread" referred to below.
 class SoundInputStreamInterface {
  public:
   virtual ~SoundInputStreamInterface() {}
@@ -64,6 +67,13 @@ class SoundInputStreamInterface {
   // Get the latency of the stream.
   virtual int LatencyUsecs() = 0;
 
+  // Makes the stream write the samples it reads into "buffer", as its
+  // producer, instead of firing SignalSamplesRead. The buffer must have the
+  // stream's frame size. Pass NULL to go back to SignalSamplesRead. May only
+  // be called while not reading.
+  void set_ring_buffer(PcmRingBuffer *buffer) { ring_buffer_ = buffer; }
+  PcmRingBuffer *ring_buffer() { return ring_buffer_; }
+
   // Notifies the consumer of new data read from the device.
   // The first parameter is a pointer to the data read, and is only valid for
   // the duration of the call.
@@ -74,9 +84,21 @@ class SoundInputStreamInterface {
       SoundInputStreamInterface *> SignalSamplesRead;
 
  protected:
-  SoundInputStreamInterface() {}
+  SoundInputStreamInterface() : ring_buffer_(NULL) {}
+
+  // Hands samples read from the device to the ring buffer, if there is one,
+  // and otherwise to SignalSamplesRead.
+  void NotifySamplesRead(const void *data, size_t size) {
+    if (ring_buffer_) {
+      ring_buffer_->Write(data, size);
+    } else {
+      SignalSamplesRead(data, size, this);
+    }
+  }
 
  private:
+  PcmRingBuffer *ring_buffer_;
+
   DISALLOW_COPY_AND_ASSIGN(SoundInputStreamInterface);
 };
 
@@ -30,12 +30,16 @@
 
 #include "talk/base/constructormagic.h"
 #include "talk/base/sigslot.h"
+#include "talk/sound/pcmringbuffer.h"
 
 namespace cricket {
 
 // Interface for outputting a stream to a playback device.
 // Semantics and thread-safety of EnableBufferMonitoring()/
-// DisableBufferMonitoring() are the same as for talk_base::Worker.
+// DisableBufferMonitoring() are the same as for talk_base::Worker, except
+// that implementations which service their streams from a shared I/O thread
+// (e.g., ALSA) fire SignalBufferSpace on that thread, which then is the
+// "monitoring thread" referred to below.
 class SoundOutputStreamInterface {
  public:
   virtual ~SoundOutputStreamInterface() {}
@@ -69,6 +73,13 @@ class SoundOutputStreamInterface {
   // Get the latency of the stream.
   virtual int LatencyUsecs() = 0;
 
+  // Makes the stream play the samples in "buffer", as its consumer, whenever
+  // there is buffer space, instead of firing SignalBufferSpace. The buffer
+  // must have the stream's frame size. Pass NULL to go back to
+  // SignalBufferSpace. May only be called while not monitoring.
+  void set_ring_buffer(PcmRingBuffer *buffer) { ring_buffer_ = buffer; }
+  PcmRingBuffer *ring_buffer() { return ring_buffer_; }
+
   // Notifies the producer of the available buffer space for writes.
   // It fires continuously as long as the space is greater than zero.
   // The first parameter is the amount of buffer space available for data to
@@ -78,9 +89,35 @@ class SoundOutputStreamInterface {
   sigslot::signal2<size_t, SoundOutputStreamInterface *> SignalBufferSpace;
 
  protected:
-  SoundOutputStreamInterface() {}
+  SoundOutputStreamInterface() : ring_buffer_(NULL) {}
+
+  // Fills up to "space" bytes of device buffer from the ring buffer, if there
+  // is one, and otherwise fires SignalBufferSpace.
+  void NotifyBufferSpace(size_t space) {
+    if (!ring_buffer_) {
+      SignalBufferSpace(space, this);
+      return;
+    }
+    size_t size;
+    // Counts an underrun if there is nothing at all to play.
+    const void *data = ring_buffer_->GetReadData(&size);
+    while (data && space >= ring_buffer_->frame_size()) {
+      size = talk_base::_min(size, space - space % ring_buffer_->frame_size());
+      if (!WriteSamples(data, size)) {
+        break;
+      }
+      ring_buffer_->ConsumeRead(size);
+      space -= size;
+      if (ring_buffer_->GetReadAvailable() == 0) {
+        break;
+      }
+      data = ring_buffer_->GetReadData(&size);
+    }
+  }
 
  private:
+  PcmRingBuffer *ring_buffer_;
+
   DISALLOW_COPY_AND_ASSIGN(SoundOutputStreamInterface);
 };
 